@@ -18,37 +18,25 @@
 
 */
 
+#include "analyse_audio_job.h"
+#include "audio_analyser.h"
+#include "audio_analysis_pass.h"
 #include "audio_analysis.h"
 #include "audio_buffers.h"
-#include "analyse_audio_job.h"
-#include "audio_content.h"
 #include "compose.hpp"
 #include "film.h"
 #include "player.h"
 #include "playlist.h"
-#include "filter.h"
-#include "audio_filter_graph.h"
-#include "config.h"
-extern "C" {
-#include <libavutil/channel_layout.h>
-#ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
-#include <libavfilter/f_ebur128.h>
-#endif
-}
 #include <boost/foreach.hpp>
+#include <boost/thread.hpp>
 #include <iostream>
 
 #include "i18n.h"
 
 using std::string;
-using std::vector;
 using std::max;
 using std::min;
-using std::cout;
 using boost::shared_ptr;
-using boost::dynamic_pointer_cast;
-
-int const AnalyseAudioJob::_num_points = 1024;
 
 /** @param from_zero true to analyse audio from time 0 in the playlist, otherwise begin at Playlist::start */
 AnalyseAudioJob::AnalyseAudioJob (shared_ptr<const Film> film, shared_ptr<const Playlist> playlist, bool from_zero)
@@ -57,37 +45,14 @@ AnalyseAudioJob::AnalyseAudioJob (shared_ptr<const Film> film, shared_ptr<const
 	, _path (film->audio_analysis_path(playlist))
 	, _from_zero (from_zero)
 	, _done (0)
-	, _samples_per_point (1)
-	, _current (0)
-	, _sample_peak (new float[film->audio_channels()])
-	, _sample_peak_frame (new Frame[film->audio_channels()])
-#ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
-	, _ebur128 (new AudioFilterGraph (film->audio_frame_rate(), film->audio_channels()))
-#endif
+	, _to_do (0)
 {
-#ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
-	_filters.push_back (new Filter ("ebur128", "ebur128", "audio", "ebur128=peak=true"));
-	_ebur128->setup (_filters);
-#endif
-
-	for (int i = 0; i < film->audio_channels(); ++i) {
-		_sample_peak[i] = 0;
-		_sample_peak_frame[i] = 0;
-	}
 
-	if (!_from_zero) {
-		_start = _playlist->start().get_value_or(DCPTime());
-	}
 }
 
 AnalyseAudioJob::~AnalyseAudioJob ()
 {
-	BOOST_FOREACH (Filter const * i, _filters) {
-		delete const_cast<Filter*> (i);
-	}
-	delete[] _current;
-	delete[] _sample_peak;
-	delete[] _sample_peak_frame;
+
 }
 
 string
@@ -105,21 +70,7 @@ AnalyseAudioJob::json_name () const
 void
 AnalyseAudioJob::run ()
 {
-	shared_ptr<Player> player (new Player (_film, _playlist));
-	player->set_ignore_video ();
-	player->set_ignore_text ();
-	player->set_fast ();
-	player->set_play_referenced ();
-	player->Audio.connect (bind (&AnalyseAudioJob::analyse, this, _1, _2));
-
-	DCPTime const length = _playlist->length (_film);
-
-	Frame const len = DCPTime (length - _start).frames_round (_film->audio_frame_rate());
-	_samples_per_point = max (int64_t (1), len / _num_points);
-
-	delete[] _current;
-	_current = new AudioPoint[_film->audio_channels ()];
-	_analysis.reset (new AudioAnalysis (_film->audio_channels ()));
+	_analyser.reset (new AudioAnalyser (_film, _playlist, _from_zero, max (1U, boost::thread::hardware_concurrency ())));
 
 	bool has_any_audio = false;
 	BOOST_FOREACH (shared_ptr<Content> c, _playlist->content ()) {
@@ -129,92 +80,95 @@ AnalyseAudioJob::run ()
 	}
 
 	if (has_any_audio) {
-		player->seek (_start, true);
 		_done = 0;
-		while (!player->pass ()) {}
-	}
+		_to_do = max (int64_t (1), _analyser->length());
+		if (_analyser->ebur128 ()) {
+			_to_do *= 2;
+		}
 
-	vector<AudioAnalysis::PeakTime> sample_peak;
-	for (int i = 0; i < _film->audio_channels(); ++i) {
-		sample_peak.push_back (
-			AudioAnalysis::PeakTime (_sample_peak[i], DCPTime::from_frames (_sample_peak_frame[i], _film->audio_frame_rate ()))
-			);
-	}
-	_analysis->set_sample_peak (sample_peak);
-
-#ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
-	if (Config::instance()->analyse_ebur128 ()) {
-		void* eb = _ebur128->get("Parsed_ebur128_0")->priv;
-		vector<float> true_peak;
-		for (int i = 0; i < _film->audio_channels(); ++i) {
-			true_peak.push_back (av_ebur128_get_true_peaks(eb)[i]);
+		boost::thread_group pool;
+		for (int i = 0; i < _analyser->segments(); ++i) {
+			pool.create_thread (boost::bind (&AnalyseAudioJob::analyse_segment, this, i));
 		}
-		_analysis->set_true_peak (true_peak);
-		_analysis->set_integrated_loudness (av_ebur128_get_integrated_loudness(eb));
-		_analysis->set_loudness_range (av_ebur128_get_loudness_range(eb));
-	}
-#endif
-
-	if (_playlist->content().size() == 1) {
-		/* If there was only one piece of content in this analysis we may later need to know what its
-		   gain was when we analysed it.
-		*/
-		shared_ptr<const AudioContent> ac = _playlist->content().front()->audio;
-		if (ac) {
-			_analysis->set_analysis_gain (ac->gain());
+
+		try {
+			pool.join_all ();
+		} catch (boost::thread_interrupted &) {
+			/* This job has been cancelled */
+			pool.interrupt_all ();
+			pool.join_all ();
+			throw;
+		}
+
+		if (_error) {
+			boost::rethrow_exception (_error);
 		}
 	}
 
-	_analysis->set_samples_per_point (_samples_per_point);
-	_analysis->set_sample_rate (_film->audio_frame_rate ());
-	_analysis->write (_path);
+	_analyser->finish()->write (_path);
 
 	set_progress (1);
 	set_state (FINISHED_OK);
 }
 
+shared_ptr<Player>
+AnalyseAudioJob::make_player () const
+{
+	shared_ptr<Player> player (new Player (_film, _playlist));
+	player->set_ignore_video ();
+	player->set_ignore_text ();
+	player->set_fast ();
+	player->set_play_referenced ();
+	return player;
+}
+
+/** Run a Player over one segment of the playlist, finding its points and sample peaks.
+ *  If we are doing EBU R128 analysis the Player for the first segment carries on to the
+ *  end of the playlist, and all its audio is given to the R128 analysis as well.
+ *  This is called in a thread of its own.
+ */
 void
-AnalyseAudioJob::analyse (shared_ptr<const AudioBuffers> b, DCPTime time)
+AnalyseAudioJob::analyse_segment (int segment)
+try
+{
+	bool const ebur128 = segment == 0 && _analyser->ebur128 ();
+	shared_ptr<Player> player = make_player ();
+	AudioAnalysisPass pass (_analyser, segment, ebur128, bind (&AnalyseAudioJob::add_done, this, _1));
+	player->Audio.connect (bind (&AudioAnalysisPass::audio, &pass, _1, _2));
+	player->seek (_analyser->segment_start (segment), true);
+	while ((ebur128 || !_analyser->segment_finished (segment)) && !player->pass ()) {}
+	pass.finish ();
+}
+catch (boost::thread_interrupted &)
 {
-	DCPOMATIC_ASSERT (time >= _start);
+	/* The job has been cancelled */
+}
+catch (...)
+{
+	store_error ();
+}
 
-#ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
-	if (Config::instance()->analyse_ebur128 ()) {
-		_ebur128->process (b);
+/** Remember the current exception, if it is the first that any of our threads has had */
+void
+AnalyseAudioJob::store_error ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	if (!_error) {
+		_error = boost::current_exception ();
 	}
-#endif
-
-	int const frames = b->frames ();
-	int const channels = b->channels ();
-
-	for (int j = 0; j < channels; ++j) {
-		float* data = b->data(j);
-		for (int i = 0; i < frames; ++i) {
-			float s = data[i];
-			float as = fabsf (s);
-			if (as < 10e-7) {
-				/* We may struggle to serialise and recover inf or -inf, so prevent such
-				   values by replacing with this (140dB down) */
-				s = as = 10e-7;
-			}
-			_current[j][AudioPoint::RMS] += pow (s, 2);
-			_current[j][AudioPoint::PEAK] = max (_current[j][AudioPoint::PEAK], as);
-
-			if (as > _sample_peak[j]) {
-				_sample_peak[j] = as;
-				_sample_peak_frame[j] = _done + i;
-			}
-
-			if (((_done + i) % _samples_per_point) == 0) {
-				_current[j][AudioPoint::RMS] = sqrt (_current[j][AudioPoint::RMS] / _samples_per_point);
-				_analysis->add_point (j, _current[j]);
-				_current[j] = AudioPoint ();
-			}
-		}
+}
+void
+AnalyseAudioJob::add_done (Frame frames)
+{
+	if (frames == 0) {
+		return;
 	}
 
-	_done += frames;
-
-	DCPTime const length = _playlist->length (_film);
-	set_progress ((time.seconds() - _start.seconds()) / (length.seconds() - _start.seconds()));
+	float progress;
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_done += frames;
+		progress = min (1.0f, float (_done) / _to_do);
+	}
+	set_progress (progress);
 }
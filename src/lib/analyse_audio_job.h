@@ -23,16 +23,14 @@
  */
 
 #include "job.h"
-#include "audio_point.h"
 #include "types.h"
 #include "dcpomatic_time.h"
+#include <boost/thread/mutex.hpp>
+#include <boost/exception_ptr.hpp>
 
-class AudioBuffers;
-class AudioAnalysis;
+class AudioAnalyser;
 class Playlist;
-class AudioPoint;
-class AudioFilterGraph;
-class Filter;
+class Player;
 
 /** @class AnalyseAudioJob
  *  @brief A job to analyse the audio of a film and make a note of its
@@ -40,6 +38,13 @@ class Filter;
  *
  *  After computing the peak and RMS levels the job will write a file
  *  to Film::audio_analysis_path.
+ *
+ *  The peak and RMS levels are found by splitting the playlist into
+ *  segments, each of which is played and analysed by its own thread.
+ *  The EBU R128 measurements need to see all the audio in order, so
+ *  if they are enabled the thread for the first segment carries on
+ *  playing to the end of the playlist, and its AudioAnalysisPass gives
+ *  the audio to another thread which does the R128 analysis.
  */
 class AnalyseAudioJob : public Job
 {
@@ -56,25 +61,26 @@ public:
 	}
 
 private:
-	void analyse (boost::shared_ptr<const AudioBuffers>, DCPTime time);
+	boost::shared_ptr<Player> make_player () const;
+	void analyse_segment (int segment);
+	void add_done (Frame frames);
+	void store_error ();
 
 	boost::shared_ptr<const Playlist> _playlist;
 	/** playlist's audio analysis path when the job was created */
 	boost::filesystem::path _path;
-	DCPTime _start;
 	bool _from_zero;
 
-	int64_t _done;
-	int64_t _samples_per_point;
-	AudioPoint* _current;
-
-	float* _sample_peak;
-	Frame* _sample_peak_frame;
+	boost::shared_ptr<AudioAnalyser> _analyser;
 
-	boost::shared_ptr<AudioAnalysis> _analysis;
-
-	boost::shared_ptr<AudioFilterGraph> _ebur128;
-	std::vector<Filter const *> _filters;
-
-	static const int _num_points;
+	/** mutex to protect _done and _error */
+	boost::mutex _mutex;
+	/** number of frames that our threads have analysed so far, counting
+	 *  the peak/RMS and the EBU R128 analyses separately.
+	 */
+	int64_t _done;
+	/** total number of frames that our threads will analyse */
+	int64_t _to_do;
+	/** first exception thrown by any of our threads */
+	boost::exception_ptr _error;
 };
@@ -0,0 +1,293 @@
+/*
+    Copyright (C) 2012-2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "audio_analyser.h"
+#include "audio_analysis.h"
+#include "audio_buffers.h"
+#include "audio_content.h"
+#include "audio_filter_graph.h"
+#include "config.h"
+#include "film.h"
+#include "filter.h"
+#include "playlist.h"
+extern "C" {
+#include <libavutil/channel_layout.h>
+#ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
+#include <libavfilter/f_ebur128.h>
+#endif
+}
+#include <boost/foreach.hpp>
+#include <cmath>
+
+using std::vector;
+using std::max;
+using std::min;
+using boost::shared_ptr;
+using boost::optional;
+
+int const AudioAnalyser::_num_points = 1024;
+
+/** Audio below this level is counted as being at it, as we may struggle to serialise
+ *  and recover inf or -inf (this is 140dB down).
+ */
+static float const minimum_level = 10e-7;
+
+/** Some part of the playlist which is analysed by one thread */
+struct AudioAnalyser::Segment
+{
+	Segment (int channels, Frame from_, optional<Frame> to_)
+		: from (from_)
+		, to (to_)
+		, points (channels)
+		, current (channels)
+		, sample_peak (channels, 0)
+		, sample_peak_frame (channels, 0)
+		, finished (false)
+	{}
+
+	/** first frame to analyse, relative to the start of the analysis */
+	Frame from;
+	/** frame after the last one to analyse, or empty to analyse to the end of the playlist */
+	optional<Frame> to;
+	/** complete points for each channel */
+	vector<vector<AudioPoint> > points;
+	/** point that is being built for each channel */
+	vector<AudioPoint> current;
+	vector<float> sample_peak;
+	vector<Frame> sample_peak_frame;
+	/** true if we have been given everything up to `to' */
+	bool finished;
+};
+
+/** @param from_zero true to analyse audio from time 0 in the playlist, otherwise begin at Playlist::start.
+ *  @param segments Maximum number of segments to split the playlist into; segments shorter than a minute
+ *  or so aren't worth the cost of the seek, so there may be fewer.
+ */
+AudioAnalyser::AudioAnalyser (shared_ptr<const Film> film, shared_ptr<const Playlist> playlist, bool from_zero, int segments)
+	: _film (film)
+	, _playlist (playlist)
+	, _ebur128 (false)
+{
+	if (!from_zero) {
+		_start = _playlist->start().get_value_or(DCPTime());
+	}
+
+	_length = DCPTime (_playlist->length(_film) - _start).frames_round (_film->audio_frame_rate());
+	_samples_per_point = max (int64_t (1), _length / _num_points);
+
+	/* A point is finished on every frame which is a multiple of _samples_per_point,
+	   so start each segment just after one of those to keep each point within a single
+	   segment.
+	*/
+#ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
+	_ebur128 = Config::instance()->analyse_ebur128 ();
+	if (_ebur128) {
+		_ebur128_graph.reset (new AudioFilterGraph (_film->audio_frame_rate(), _film->audio_channels()));
+		_filters.push_back (new Filter ("ebur128", "ebur128", "audio", "ebur128=peak=true"));
+		_ebur128_graph->setup (_filters);
+	}
+#endif
+
+	int64_t const points = _length / _samples_per_point + 1;
+	segments = int (min (int64_t (max (1, segments)), max (int64_t (1), _length / (_film->audio_frame_rate() * 60))));
+	int64_t const points_per_segment = (points + segments - 1) / segments;
+
+	for (int i = 0; i < segments; ++i) {
+		Frame const from = i == 0 ? 0 : (i * points_per_segment - 1) * _samples_per_point + 1;
+		optional<Frame> to;
+		if (i < (segments - 1)) {
+			to = ((i + 1) * points_per_segment - 1) * _samples_per_point + 1;
+		}
+		_segments.push_back (shared_ptr<Segment> (new Segment (_film->audio_channels(), from, to)));
+	}
+
+}
+
+AudioAnalyser::~AudioAnalyser ()
+{
+	BOOST_FOREACH (Filter const * i, _filters) {
+		delete const_cast<Filter*> (i);
+	}
+}
+
+/** @return Time that a Player should seek to before giving audio for a segment */
+DCPTime
+AudioAnalyser::segment_start (int segment) const
+{
+	return _start + DCPTime::from_frames (_segments[segment]->from, _film->audio_frame_rate());
+}
+
+/** @return true if a segment has been given all the audio that it needs */
+bool
+AudioAnalyser::segment_finished (int segment) const
+{
+	return _segments[segment]->finished;
+}
+
+/** Add up the squares of some samples and find their peak, treating anything quieter than
+ *  minimum_level as being at minimum_level.  This is written with several independent
+ *  accumulators so that the compiler can vectorise it.
+ */
+static void
+accumulate (float const * data, int frames, float& sum_of_squares, float& peak)
+{
+	float s[4] = { 0, 0, 0, 0 };
+	float p[4] = { 0, 0, 0, 0 };
+
+	int i = 0;
+	for (; i + 4 <= frames; i += 4) {
+		for (int j = 0; j < 4; ++j) {
+			float const a = max (fabsf (data[i + j]), minimum_level);
+			s[j] += a * a;
+			p[j] = max (p[j], a);
+		}
+	}
+
+	for (; i < frames; ++i) {
+		float const a = max (fabsf (data[i]), minimum_level);
+		s[0] += a * a;
+		p[0] = max (p[0], a);
+	}
+
+	sum_of_squares += (s[0] + s[1]) + (s[2] + s[3]);
+	peak = max (peak, max (max (p[0], p[1]), max (p[2], p[3])));
+}
+
+/** Analyse some audio for a segment; any of it which is outside the segment is ignored.
+ *  Different segments may be analysed at the same time from different threads.
+ *  @param segment_index Segment index.
+ *  @param b Audio.
+ *  @param time Time of the start of b.
+ *  @return Number of frames of b that were inside the segment.
+ */
+Frame
+AudioAnalyser::analyse (int segment_index, shared_ptr<const AudioBuffers> b, DCPTime time)
+{
+	DCPOMATIC_ASSERT (time >= _start);
+
+	Segment* segment = _segments[segment_index].get ();
+
+	/* Frame index of the start of b, relative to the start of the analysis */
+	Frame const offset = DCPTime (time - _start).frames_round (_film->audio_frame_rate ());
+	Frame const from = max (segment->from, offset);
+	Frame to = offset + b->frames ();
+	if (segment->to && *segment->to <= to) {
+		to = *segment->to;
+		segment->finished = true;
+	}
+
+	for (int i = 0; i < b->channels(); ++i) {
+		float const * data = b->data(i);
+		AudioPoint& current = segment->current[i];
+		Frame j = from;
+		while (j < to) {
+			/* The point is finished on the next multiple of _samples_per_point, inclusive */
+			Frame const end = ((j + _samples_per_point - 1) / _samples_per_point) * _samples_per_point;
+			Frame const chunk_end = min (to, end + 1);
+
+			float peak = 0;
+			accumulate (data + j - offset, chunk_end - j, current[AudioPoint::RMS], peak);
+			current[AudioPoint::PEAK] = max (current[AudioPoint::PEAK], peak);
+
+			if (peak > segment->sample_peak[i]) {
+				Frame k = j;
+				while (max (fabsf (data[k - offset]), minimum_level) != peak) {
+					++k;
+				}
+				segment->sample_peak[i] = peak;
+				segment->sample_peak_frame[i] = k;
+			}
+
+			if (chunk_end == end + 1) {
+				current[AudioPoint::RMS] = sqrt (current[AudioPoint::RMS] / _samples_per_point);
+				segment->points[i].push_back (current);
+				current = AudioPoint ();
+			}
+
+			j = chunk_end;
+		}
+	}
+
+	return max (Frame (0), to - from);
+}
+
+/** Give some audio to the EBU R128 analysis; this must be called with all the audio,
+ *  in order, if ebur128() is true.  It may be called at the same time as analyse(),
+ *  but not from more than one thread at once.
+ */
+void
+AudioAnalyser::analyse_ebur128 (shared_ptr<const AudioBuffers> b)
+{
+	if (_ebur128_graph) {
+		_ebur128_graph->process (b);
+	}
+}
+
+/** @return Analysis made from everything that we have been given */
+shared_ptr<AudioAnalysis>
+AudioAnalyser::finish () const
+{
+	int const channels = _film->audio_channels ();
+	shared_ptr<AudioAnalysis> analysis (new AudioAnalysis (channels));
+
+	vector<AudioAnalysis::PeakTime> sample_peak;
+	for (int i = 0; i < channels; ++i) {
+		shared_ptr<const Segment> peak = _segments.front ();
+		BOOST_FOREACH (shared_ptr<const Segment> j, _segments) {
+			BOOST_FOREACH (AudioPoint const & k, j->points[i]) {
+				analysis->add_point (i, k);
+			}
+			if (j->sample_peak[i] > peak->sample_peak[i]) {
+				peak = j;
+			}
+		}
+		sample_peak.push_back (
+			AudioAnalysis::PeakTime (peak->sample_peak[i], DCPTime::from_frames (peak->sample_peak_frame[i], _film->audio_frame_rate ()))
+			);
+	}
+	analysis->set_sample_peak (sample_peak);
+
+#ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
+	if (_ebur128_graph) {
+		void* eb = _ebur128_graph->get("Parsed_ebur128_0")->priv;
+		vector<float> true_peak;
+		for (int i = 0; i < channels; ++i) {
+			true_peak.push_back (av_ebur128_get_true_peaks(eb)[i]);
+		}
+		analysis->set_true_peak (true_peak);
+		analysis->set_integrated_loudness (av_ebur128_get_integrated_loudness(eb));
+		analysis->set_loudness_range (av_ebur128_get_loudness_range(eb));
+	}
+#endif
+
+	if (_playlist->content().size() == 1) {
+		/* If there was only one piece of content in this analysis we may later need to know what its
+		   gain was when we analysed it.
+		*/
+		shared_ptr<const AudioContent> ac = _playlist->content().front()->audio;
+		if (ac) {
+			analysis->set_analysis_gain (ac->gain());
+		}
+	}
+
+	analysis->set_samples_per_point (_samples_per_point);
+	analysis->set_sample_rate (_film->audio_frame_rate ());
+	return analysis;
+}
@@ -0,0 +1,104 @@
+/*
+    Copyright (C) 2012-2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/audio_analyser.h
+ *  @brief AudioAnalyser class.
+ */
+
+#ifndef DCPOMATIC_AUDIO_ANALYSER_H
+#define DCPOMATIC_AUDIO_ANALYSER_H
+
+#include "audio_point.h"
+#include "dcpomatic_time.h"
+#include "types.h"
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+#include <vector>
+
+class AudioAnalysis;
+class AudioBuffers;
+class AudioFilterGraph;
+class Film;
+class Filter;
+class Playlist;
+
+/** @class AudioAnalyser
+ *  @brief Builds an AudioAnalysis of a playlist from the audio that a Player gives for it.
+ *
+ *  The playlist can be split into segments, each of which can be fed from a different
+ *  thread by its own Player (seeked to segment_start()).  Each segment begins just after
+ *  a point boundary so the result is the same however many segments there are.
+ *
+ *  If EBU R128 analysis is enabled all the audio must also be given, in order and from
+ *  one thread at a time, to analyse_ebur128().  That can be done alongside the segments,
+ *  for example by letting the Player for the first segment carry on to the end of the
+ *  playlist.
+ */
+class AudioAnalyser : public boost::noncopyable
+{
+public:
+	AudioAnalyser (boost::shared_ptr<const Film> film, boost::shared_ptr<const Playlist> playlist, bool from_zero, int segments = 1);
+	~AudioAnalyser ();
+
+	/** @return time at which the analysis starts */
+	DCPTime start () const {
+		return _start;
+	}
+
+	/** @return number of frames that will be analysed */
+	Frame length () const {
+		return _length;
+	}
+
+	bool ebur128 () const {
+		return _ebur128;
+	}
+
+	int segments () const {
+		return _segments.size ();
+	}
+
+	DCPTime segment_start (int segment) const;
+	bool segment_finished (int segment) const;
+
+	Frame analyse (int segment, boost::shared_ptr<const AudioBuffers> b, DCPTime time);
+	void analyse_ebur128 (boost::shared_ptr<const AudioBuffers> b);
+
+	boost::shared_ptr<AudioAnalysis> finish () const;
+
+private:
+	struct Segment;
+
+	boost::shared_ptr<const Film> _film;
+	boost::shared_ptr<const Playlist> _playlist;
+	DCPTime _start;
+	Frame _length;
+	int64_t _samples_per_point;
+	std::vector<boost::shared_ptr<Segment> > _segments;
+
+	bool _ebur128;
+	boost::shared_ptr<AudioFilterGraph> _ebur128_graph;
+	std::vector<Filter const *> _filters;
+
+	static const int _num_points;
+};
+
+#endif
@@ -161,7 +161,12 @@ AudioAnalysis::write (boost::filesystem::path filename)
 	root->add_child("SamplesPerPoint")->add_child_text (raw_convert<string> (_samples_per_point));
 	root->add_child("SampleRate")->add_child_text (raw_convert<string> (_sample_rate));
 
-	doc->write_to_file_formatted (filename.string ());
+	/* Write to a temporary file and rename it into place, so that anything which is
+	   looking for this analysis never sees a partly-written file.
+	*/
+	boost::filesystem::path tmp = filename.string() + boost::filesystem::unique_path(".%%%%%%").string();
+	doc->write_to_file_formatted (tmp.string ());
+	boost::filesystem::rename (tmp, filename);
 }
 
 float
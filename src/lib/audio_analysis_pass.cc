@@ -0,0 +1,153 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/audio_analysis_pass.cc
+ *  @brief AudioAnalysisPass class.
+ */
+
+#include "audio_analysis_pass.h"
+#include "audio_analyser.h"
+#include "audio_buffers.h"
+#include <boost/bind.hpp>
+
+using boost::shared_ptr;
+
+/** Most blocks of audio that we hold while they wait for the EBU R128 analysis */
+size_t const AudioAnalysisPass::_maximum_queue = 64;
+
+/** @param analyser Analyser to give the audio to.
+ *  @param segment Segment of the analyser that the audio is for.
+ *  @param ebur128 true to give the audio to the analyser's EBU R128 analysis too; if so,
+ *  all the audio in the playlist must be given to audio(), in order.
+ *  @param done Function to call with the number of frames that have been analysed, or empty.
+ */
+AudioAnalysisPass::AudioAnalysisPass (shared_ptr<AudioAnalyser> analyser, int segment, bool ebur128, boost::function<void (Frame)> done)
+	: _analyser (analyser)
+	, _segment (segment)
+	, _done (done)
+	, _thread (0)
+	, _finished (false)
+{
+	if (ebur128) {
+		_thread = new boost::thread (boost::bind (&AudioAnalysisPass::ebur128_thread, this));
+	}
+}
+
+AudioAnalysisPass::~AudioAnalysisPass ()
+{
+	if (!_thread) {
+		return;
+	}
+
+	try {
+		_thread->interrupt ();
+		_thread->join ();
+	} catch (...) {
+
+	}
+
+	delete _thread;
+}
+
+/** Give some audio to the analyser; this should be connected to Player::Audio */
+void
+AudioAnalysisPass::audio (shared_ptr<const AudioBuffers> b, DCPTime time)
+{
+	Frame const frames = _analyser->analyse (_segment, b, time);
+	if (frames && _done) {
+		_done (frames);
+	}
+
+	if (!_thread) {
+		return;
+	}
+
+	boost::mutex::scoped_lock lm (_mutex);
+	while (_queue.size() >= _maximum_queue && !_error) {
+		_condition.wait (lm);
+	}
+	if (_error) {
+		/* The R128 analysis has stopped, so nothing will take this; finish() will throw */
+		return;
+	}
+	_queue.push_back (b);
+	_condition.notify_all ();
+}
+
+/** Wait for the EBU R128 analysis of everything given to audio() to finish.
+ *  Any exception thrown by that analysis is re-thrown here.
+ */
+void
+AudioAnalysisPass::finish ()
+{
+	if (!_thread) {
+		return;
+	}
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_finished = true;
+		_condition.notify_all ();
+	}
+
+	_thread->join ();
+
+	boost::mutex::scoped_lock lm (_mutex);
+	if (_error) {
+		boost::rethrow_exception (_error);
+	}
+}
+
+/** Give queued audio to the EBU R128 analysis, in order, until there is no more */
+void
+AudioAnalysisPass::ebur128_thread ()
+try
+{
+	while (true) {
+		shared_ptr<const AudioBuffers> b;
+		{
+			boost::mutex::scoped_lock lm (_mutex);
+			while (_queue.empty() && !_finished) {
+				_condition.wait (lm);
+			}
+			if (_queue.empty()) {
+				return;
+			}
+			b = _queue.front ();
+			_queue.pop_front ();
+			_condition.notify_all ();
+		}
+
+		_analyser->analyse_ebur128 (b);
+		if (_done) {
+			_done (b->frames ());
+		}
+	}
+}
+catch (boost::thread_interrupted &)
+{
+	/* We are being destroyed */
+}
+catch (...)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_error = boost::current_exception ();
+	_condition.notify_all ();
+}
@@ -0,0 +1,89 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/audio_analysis_pass.h
+ *  @brief AudioAnalysisPass class.
+ */
+
+#ifndef DCPOMATIC_AUDIO_ANALYSIS_PASS_H
+#define DCPOMATIC_AUDIO_ANALYSIS_PASS_H
+
+#include "dcpomatic_time.h"
+#include "types.h"
+#include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/exception_ptr.hpp>
+#include <list>
+
+class AudioAnalyser;
+class AudioBuffers;
+
+/** @class AudioAnalysisPass
+ *  @brief Gives the audio from one pass of a Player to an AudioAnalyser.
+ *
+ *  The audio goes to one of the analyser's segments and, if asked, to its EBU R128
+ *  analysis.  The R128 analysis is done in a thread of our own, fed from a short queue,
+ *  so that it does not hold up the Player.  This is used both by AnalyseAudioJob and by
+ *  Hints, which analyses the audio while it looks at the closed captions.
+ */
+class AudioAnalysisPass : public boost::noncopyable
+{
+public:
+	AudioAnalysisPass (
+		boost::shared_ptr<AudioAnalyser> analyser,
+		int segment,
+		bool ebur128,
+		boost::function<void (Frame)> done = boost::function<void (Frame)> ()
+		);
+	~AudioAnalysisPass ();
+
+	void audio (boost::shared_ptr<const AudioBuffers> b, DCPTime time);
+	void finish ();
+
+private:
+	void ebur128_thread ();
+
+	boost::shared_ptr<AudioAnalyser> _analyser;
+	int _segment;
+	/** called with the number of frames that have been analysed, from any thread */
+	boost::function<void (Frame)> _done;
+	boost::thread* _thread;
+
+	/** mutex to protect _queue, _finished and _error */
+	boost::mutex _mutex;
+	/** audio waiting to be given to the EBU R128 analysis, in order */
+	std::list<boost::shared_ptr<const AudioBuffers> > _queue;
+	/** true when everything has been put into _queue */
+	bool _finished;
+	/** exception thrown by the EBU R128 thread */
+	boost::exception_ptr _error;
+	/** condition to wake the EBU R128 thread when there is something in the queue,
+	 *  and the thread which fills the queue when there is space in it.
+	 */
+	boost::condition _condition;
+
+	static size_t const _maximum_queue;
+};
+
+#endif
@@ -20,14 +20,128 @@
 
 #include "audio_buffers.h"
 #include "dcpomatic_assert.h"
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
 #include <cassert>
 #include <cstring>
 #include <cmath>
+#include <cstdlib>
+#include <map>
 #include <stdexcept>
+#include <vector>
+#ifdef DCPOMATIC_WINDOWS
+#include <malloc.h>
+#endif
 
 using std::bad_alloc;
+using std::map;
+using std::vector;
 using boost::shared_ptr;
 
+/** Alignment of the start of each channel's data, in bytes */
+static size_t const alignment = 64;
+/** Largest block that we will keep in the pool for re-use, in bytes */
+static size_t const largest_pooled = 16 * 1024 * 1024;
+/** Most memory that we will keep in the pool for re-use, in bytes */
+static size_t const pool_limit = 64 * 1024 * 1024;
+
+/** @struct Pool
+ *  @brief Blocks of memory that have been used by AudioBuffers and may be used again.
+ */
+struct Pool
+{
+	Pool ()
+		: size (0)
+	{}
+
+	boost::mutex mutex;
+	/** Unused blocks of memory, indexed by their size */
+	map<size_t, vector<void*> > blocks;
+	/** Total size of blocks, in bytes */
+	size_t size;
+};
+
+/** @return Our Pool.  This is never destroyed, so that AudioBuffers which
+ *  outlive other static objects can still give their memory back.
+ */
+static Pool &
+pool ()
+{
+	static Pool* p = new Pool;
+	return *p;
+}
+
+/** @class AudioBuffers::Slab
+ *  @brief Some aligned memory for the data of an AudioBuffers.
+ *
+ *  The memory comes from the pool if a block of the right size is available,
+ *  and is put back there when the Slab is destroyed.  Sizes are rounded up to a power
+ *  of 2 so that blocks are more likely to be re-used.
+ */
+class AudioBuffers::Slab : public boost::noncopyable
+{
+public:
+	explicit Slab (size_t size)
+		: _size (alignment)
+		, _data (0)
+	{
+		while (_size < size) {
+			_size *= 2;
+		}
+
+		if (_size <= largest_pooled) {
+			Pool& p = pool ();
+			boost::mutex::scoped_lock lm (p.mutex);
+			map<size_t, vector<void*> >::iterator i = p.blocks.find (_size);
+			if (i != p.blocks.end() && !i->second.empty()) {
+				_data = static_cast<float*> (i->second.back ());
+				i->second.pop_back ();
+				p.size -= _size;
+				return;
+			}
+		}
+
+#ifdef DCPOMATIC_WINDOWS
+		_data = static_cast<float*> (_aligned_malloc (_size, alignment));
+#else
+		void* p;
+		if (posix_memalign (&p, alignment, _size) == 0) {
+			_data = static_cast<float*> (p);
+		}
+#endif
+		if (!_data) {
+			throw bad_alloc ();
+		}
+	}
+
+	~Slab ()
+	{
+		if (_size <= largest_pooled) {
+			Pool& p = pool ();
+			boost::mutex::scoped_lock lm (p.mutex);
+			if (p.size + _size <= pool_limit) {
+				p.blocks[_size].push_back (_data);
+				p.size += _size;
+				return;
+			}
+		}
+
+#ifdef DCPOMATIC_WINDOWS
+		_aligned_free (_data);
+#else
+		free (_data);
+#endif
+	}
+
+	float* data () const {
+		return _data;
+	}
+
+private:
+	size_t _size;
+	float* _data;
+};
+
 /** Construct an AudioBuffers.  Audio data is undefined after this constructor.
  *  @param channels Number of channels.
  *  @param frames Number of frames to reserve space for.
@@ -52,6 +166,54 @@ AudioBuffers::AudioBuffers (boost::shared_ptr<const AudioBuffers> other)
 	copy_from (other.get(), other->_frames, 0, 0);
 }
 
+/** Construct an AudioBuffers containing a copy of some of the frames of another.
+ *  @param other AudioBuffers to copy from.
+ *  @param frames Number of frames to copy.
+ *  @param offset Offset of the first frame to copy within other.
+ */
+AudioBuffers::AudioBuffers (boost::shared_ptr<const AudioBuffers> other, int32_t frames, int32_t offset)
+{
+	DCPOMATIC_ASSERT (frames >= 0);
+	DCPOMATIC_ASSERT (offset >= 0 && (offset + frames) <= other->_frames);
+	allocate (other->_channels, frames);
+	copy_from (other.get(), frames, offset, 0);
+}
+
+/** Construct an AudioBuffers which is a view onto some of the frames of another;
+ *  the data are not copied, so changes to one will be seen in the other.  If the
+ *  view is later extended using ensure_size() or append() it will get its own copy.
+ *  As the view can change other's data this is only possible if other is not const;
+ *  otherwise the frames are copied (see the other constructor, and view()).
+ *  @param other AudioBuffers to view.
+ *  @param frames Number of frames in the view.
+ *  @param offset Offset of the first frame of the view within other.
+ */
+AudioBuffers::AudioBuffers (boost::shared_ptr<AudioBuffers> other, int32_t frames, int32_t offset)
+	: _channels (other->_channels)
+	, _frames (frames)
+	, _allocated_frames (frames)
+	, _slab (other->_slab)
+	, _stride (other->_stride)
+	, _offset (other->_offset + offset)
+	, _data (0)
+{
+	DCPOMATIC_ASSERT (frames >= 0);
+	DCPOMATIC_ASSERT (offset >= 0 && (offset + frames) <= other->_frames);
+	set_data ();
+}
+
+/** @param other AudioBuffers to view.
+ *  @param frames Number of frames in the view.
+ *  @param offset Offset of the first frame of the view within other.
+ *  @return A view onto some of the frames of other, which shares other's data
+ *  rather than copying it.  The view is const, so it cannot be used to change other.
+ */
+shared_ptr<const AudioBuffers>
+AudioBuffers::view (shared_ptr<const AudioBuffers> other, int32_t frames, int32_t offset)
+{
+	return shared_ptr<const AudioBuffers> (new AudioBuffers (boost::const_pointer_cast<AudioBuffers> (other), frames, offset));
+}
+
 AudioBuffers &
 AudioBuffers::operator= (AudioBuffers const & other)
 {
@@ -81,28 +243,42 @@ AudioBuffers::allocate (int channels, int32_t frames)
 	_channels = channels;
 	_frames = frames;
 	_allocated_frames = frames;
+	_offset = 0;
+	_data = 0;
+
+	/* Round the stride up so that every channel starts on an aligned boundary */
+	int32_t const per_line = alignment / sizeof (float);
+	_stride = ((frames + per_line - 1) / per_line) * per_line;
+	_slab.reset (new Slab (size_t (_channels) * _stride * sizeof (float)));
+
+	set_data ();
+}
 
-	_data = static_cast<float**> (malloc (_channels * sizeof (float *)));
+/** Set up _data to point to each channel's data in _slab */
+void
+AudioBuffers::set_data ()
+{
 	if (!_data) {
-		throw bad_alloc ();
+		if (_channels <= int (sizeof (_small_data) / sizeof (float*))) {
+			_data = _small_data;
+		} else {
+			_data = new float*[_channels];
+		}
 	}
 
 	for (int i = 0; i < _channels; ++i) {
-		_data[i] = static_cast<float*> (malloc (frames * sizeof (float)));
-		if (!_data[i]) {
-			throw bad_alloc ();
-		}
+		_data[i] = _slab->data() + i * _stride + _offset;
 	}
 }
 
 void
 AudioBuffers::deallocate ()
 {
-	for (int i = 0; i < _channels; ++i) {
-		free (_data[i]);
+	if (_data != _small_data) {
+		delete[] _data;
 	}
-
-	free (_data);
+	_data = 0;
+	_slab.reset ();
 }
 
 /** @param c Channel index.
@@ -117,7 +293,9 @@ AudioBuffers::data (int c) const
 
 /** Set the number of frames that these AudioBuffers will report themselves
  *  as having.  If we reduce the number of frames, the `lost' frames will
- *  be silenced.
+ *  be silenced.  If our data are shared with a view, or we are a view, the
+ *  `lost' frames are not changed but given up instead, so that getting
+ *  more frames later means that we get our own copy of the data.
  *  @param f Frames; must be less than or equal to the number of allocated frames.
  */
 void
@@ -125,6 +303,11 @@ AudioBuffers::set_frames (int32_t f)
 {
 	DCPOMATIC_ASSERT (f <= _allocated_frames);
 
+	if (f < _frames && shared ()) {
+		_frames = _allocated_frames = f;
+		return;
+	}
+
 	for (int c = 0; c < _channels; ++c) {
 		for (int i = f; i < _frames; ++i) {
 			_data[c][i] = 0;
@@ -254,8 +437,26 @@ AudioBuffers::ensure_size (int32_t frames)
 		return;
 	}
 
+	if (_slab.unique() && frames <= _stride) {
+		/* There is enough space in our slab already (perhaps because trim_start() has
+		   left some at the start), and nobody else is looking at it, so just move our
+		   data back to the start if necessary and use the whole thing.
+		*/
+		for (int i = 0; i < _channels; ++i) {
+			float* d = _data[i] - _offset;
+			if (_offset) {
+				memmove (d, _data[i], _allocated_frames * sizeof (float));
+			}
+			memset (d + _allocated_frames, 0, (_stride - _allocated_frames) * sizeof (float));
+		}
+		_offset = 0;
+		_allocated_frames = _stride;
+		set_data ();
+		return;
+	}
+
 	/* Round up frames to the next power of 2 to reduce the number
-	   of realloc()s that are necessary.
+	   of reallocations that are necessary.
 	*/
 	frames--;
 	frames |= frames >> 1;
@@ -265,17 +466,21 @@ AudioBuffers::ensure_size (int32_t frames)
 	frames |= frames >> 16;
 	frames++;
 
-	for (int i = 0; i < _channels; ++i) {
-		_data[i] = static_cast<float*> (realloc (_data[i], frames * sizeof (float)));
-		if (!_data[i]) {
-			throw bad_alloc ();
-		}
-		for (int j = _allocated_frames; j < frames; ++j) {
-			_data[i][j] = 0;
-		}
-	}
+	shared_ptr<Slab> old_slab = _slab;
+	int32_t const old_allocated_frames = _allocated_frames;
+	vector<float*> old_data (_data, _data + _channels);
 
+	int32_t const per_line = alignment / sizeof (float);
+	_stride = ((frames + per_line - 1) / per_line) * per_line;
+	_slab.reset (new Slab (size_t (_channels) * _stride * sizeof (float)));
+	_offset = 0;
 	_allocated_frames = frames;
+	set_data ();
+
+	for (int i = 0; i < _channels; ++i) {
+		memcpy (_data[i], old_data[i], old_allocated_frames * sizeof (float));
+		memset (_data[i] + old_allocated_frames, 0, (frames - old_allocated_frames) * sizeof (float));
+	}
 }
 
 /** Mix some other buffers with these ones.  The AudioBuffers must have the same number of channels.
@@ -354,11 +559,15 @@ AudioBuffers::append (shared_ptr<const AudioBuffers> other)
 	_frames += other->frames();
 }
 
-/** Remove some frames from the start of these AudioBuffers */
+/** Remove some frames from the start of these AudioBuffers.  This does not
+ *  move any data; we just start looking at a later part of our memory.
+ */
 void
 AudioBuffers::trim_start (int32_t frames)
 {
-	DCPOMATIC_ASSERT (frames <= _frames);
-	move (_frames - frames, frames, 0);
-	set_frames (_frames - frames);
+	DCPOMATIC_ASSERT (frames >= 0 && frames <= _frames);
+	_offset += frames;
+	_frames -= frames;
+	_allocated_frames -= frames;
+	set_data ();
 }
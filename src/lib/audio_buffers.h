@@ -31,6 +31,14 @@
 /** @class AudioBuffers
  *  @brief A class to hold multi-channel audio data in float format.
  *
+ *  The data for all channels are held in a single block of memory, with each
+ *  channel starting on a 64-byte boundary.  These blocks are recycled through
+ *  a pool rather than being returned to the allocator.
+ *
+ *  An AudioBuffers may also be a view onto some of the frames of another
+ *  AudioBuffers, in which case the data are shared rather than copied.  Views
+ *  of a const AudioBuffers are made with view() and are themselves const.
+ *
  *  The use of int32_t for frame counts in this class is due to the
  *  round-up to the next power-of-2 code in ensure_size(); if that
  *  were changed the frame count could use any integer type.
@@ -41,10 +49,14 @@ public:
 	AudioBuffers (int channels, int32_t frames);
 	AudioBuffers (AudioBuffers const &);
 	explicit AudioBuffers (boost::shared_ptr<const AudioBuffers>);
+	AudioBuffers (boost::shared_ptr<const AudioBuffers> other, int32_t frames, int32_t offset);
+	AudioBuffers (boost::shared_ptr<AudioBuffers> other, int32_t frames, int32_t offset);
 	~AudioBuffers ();
 
 	AudioBuffers & operator= (AudioBuffers const &);
 
+	static boost::shared_ptr<const AudioBuffers> view (boost::shared_ptr<const AudioBuffers> other, int32_t frames, int32_t offset);
+
 	boost::shared_ptr<AudioBuffers> clone () const;
 	boost::shared_ptr<AudioBuffers> channel (int) const;
 
@@ -66,6 +78,11 @@ public:
 
 	void set_frames (int32_t f);
 
+	/** @return true if our data are shared with a view, or we are a view */
+	bool shared () const {
+		return !_slab.unique ();
+	}
+
 	void make_silent ();
 	void make_silent (int c);
 	void make_silent (int32_t from, int32_t frames);
@@ -81,8 +98,11 @@ public:
 	void trim_start (int32_t frames);
 
 private:
+	class Slab;
+
 	void allocate (int channels, int32_t frames);
 	void deallocate ();
+	void set_data ();
 
 	/** Number of channels */
 	int _channels;
@@ -90,8 +110,16 @@ private:
 	int32_t _frames;
 	/** Number of frames that _data can hold */
 	int32_t _allocated_frames;
+	/** Memory holding our audio data, which may be shared with views */
+	boost::shared_ptr<Slab> _slab;
+	/** Distance between the starts of each channel's data in _slab, in samples */
+	int32_t _stride;
+	/** Offset of our first frame from the start of each channel's data in _slab, in samples */
+	int32_t _offset;
 	/** Audio data (so that, e.g. _data[2][6] is channel 2, sample 6) */
 	float** _data;
+	/** Storage for _data if we have few enough channels */
+	float* _small_data[16];
 };
 
 #endif
@@ -0,0 +1,117 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "audio_matrix.h"
+#include "audio_mapping.h"
+#include "audio_buffers.h"
+#include "dcpomatic_assert.h"
+#include <cmath>
+#include <cstring>
+
+using std::vector;
+using boost::shared_ptr;
+
+/** @param mapping Mapping of input to output channels.
+ *  @param output_channels Number of output channels.
+ *  @param gain Gain to apply to all channels, in dB.
+ */
+AudioMatrix::AudioMatrix (AudioMapping const & mapping, int output_channels, float gain)
+	: _outputs (output_channels)
+{
+	float const linear = pow (10, gain / 20);
+
+	for (int i = 0; i < mapping.input_channels(); ++i) {
+		for (int j = 0; j < output_channels; ++j) {
+			float const g = mapping.get (i, j);
+			if (g > 0) {
+				_outputs[j].push_back (Input (i, gain == 0 ? g : g * linear));
+			}
+		}
+	}
+}
+
+/** Apply the matrix.
+ *  @param in Input; must have enough channels for the mapping that this matrix was made from.
+ *  @param out Output, which must have output_channels() channels (and must not be `in');
+ *  it will be resized to the same number of frames as `in'.
+ */
+void
+AudioMatrix::apply (AudioBuffers const * in, AudioBuffers* out) const
+{
+	DCPOMATIC_ASSERT (out->channels() == output_channels());
+	DCPOMATIC_ASSERT (out != in);
+
+	int const frames = in->frames ();
+	out->ensure_size (frames);
+	out->set_frames (frames);
+
+	for (size_t i = 0; i < _outputs.size(); ++i) {
+		vector<Input> const & inputs = _outputs[i];
+		float* d = out->data(i);
+
+		if (inputs.empty ()) {
+			memset (d, 0, frames * sizeof (float));
+			continue;
+		}
+
+		DCPOMATIC_ASSERT (inputs.back().channel < in->channels());
+
+		/* Write the first one or two inputs, then accumulate any others */
+		size_t j = 0;
+		if (inputs.size() == 1) {
+			float const * a = in->data (inputs[0].channel);
+			float const ga = inputs[0].gain;
+			if (ga == 1) {
+				memcpy (d, a, frames * sizeof (float));
+			} else {
+				for (int k = 0; k < frames; ++k) {
+					d[k] = a[k] * ga;
+				}
+			}
+			j = 1;
+		} else {
+			float const * a = in->data (inputs[0].channel);
+			float const * b = in->data (inputs[1].channel);
+			float const ga = inputs[0].gain;
+			float const gb = inputs[1].gain;
+			for (int k = 0; k < frames; ++k) {
+				d[k] = a[k] * ga + b[k] * gb;
+			}
+			j = 2;
+		}
+
+		for (; j < inputs.size(); ++j) {
+			float const * s = in->data (inputs[j].channel);
+			float const g = inputs[j].gain;
+			for (int k = 0; k < frames; ++k) {
+				d[k] += s[k] * g;
+			}
+		}
+	}
+}
+
+/** Apply the matrix into a new AudioBuffers */
+shared_ptr<AudioBuffers>
+AudioMatrix::apply (shared_ptr<const AudioBuffers> in) const
+{
+	shared_ptr<AudioBuffers> out (new AudioBuffers (output_channels(), in->frames()));
+	apply (in.get(), out.get());
+	return out;
+}
@@ -0,0 +1,66 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_AUDIO_MATRIX_H
+#define DCPOMATIC_AUDIO_MATRIX_H
+
+#include <boost/shared_ptr.hpp>
+#include <vector>
+
+class AudioMapping;
+class AudioBuffers;
+
+/** @class AudioMatrix
+ *  @brief A mixing matrix made from an AudioMapping and a gain, which can be applied to
+ *  AudioBuffers to route and scale their channels.
+ *
+ *  Only the non-zero entries of the mapping are kept, so applying the matrix makes one
+ *  pass over each output channel, reading just the input channels which contribute to it.
+ *  The loops are simple enough for the compiler to vectorise.
+ */
+class AudioMatrix
+{
+public:
+	AudioMatrix (AudioMapping const & mapping, int output_channels, float gain = 0);
+
+	void apply (AudioBuffers const * in, AudioBuffers* out) const;
+	boost::shared_ptr<AudioBuffers> apply (boost::shared_ptr<const AudioBuffers> in) const;
+
+	int output_channels () const {
+		return _outputs.size ();
+	}
+
+private:
+	struct Input
+	{
+		Input (int c, float g)
+			: channel (c)
+			, gain (g)
+		{}
+
+		int channel;
+		float gain;
+	};
+
+	/** for each output channel, the input channels that are mixed into it */
+	std::vector<std::vector<Input> > _outputs;
+};
+
+#endif
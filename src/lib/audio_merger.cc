@@ -31,11 +31,18 @@ using std::max;
 using std::list;
 using std::cout;
 using std::make_pair;
+using std::vector;
 using boost::shared_ptr;
 using boost::optional;
 
+/** Most seconds of our timeline that _ring will hold, if there are no pushes bigger than that */
+static int const maximum_window_seconds = 10;
+/** Most buffers returned by pull() that we keep track of so that we can use them again */
+static size_t const maximum_outputs = 16;
+
 AudioMerger::AudioMerger (int frame_rate)
 	: _frame_rate (frame_rate)
+	, _largest_window (0)
 {
 
 }
@@ -46,6 +53,170 @@ AudioMerger::frames (DCPTime t) const
 	return t.frames_floor (_frame_rate);
 }
 
+/** @return Index within a ring buffer of a given size of a frame in our timeline */
+static int32_t
+ring_index (Frame frame, Frame size)
+{
+	return ((frame % size) + size) % size;
+}
+
+/** Make sure that _ring can hold the given period of our timeline, and any data
+ *  that we already have.
+ */
+void
+AudioMerger::reserve (int channels, Frame from, Frame to)
+{
+	if (!_ranges.empty ()) {
+		from = min (from, _ranges.front().first);
+		to = max (to, _ranges.back().second);
+	}
+
+	_largest_window = max (_largest_window, to - from);
+
+	if (_ring && _ring->channels() == channels && (to - from) <= _ring->frames()) {
+		return;
+	}
+
+	/* If the channel count changes we can't have any data that we need to keep */
+	DCPOMATIC_ASSERT (!_ring || _ring->channels() == channels || _ranges.empty());
+
+	Frame size = max (Frame (_frame_rate), to - from);
+	if (_ring && _ring->channels() == channels) {
+		size = max (size, Frame (_ring->frames()) * 2);
+	}
+
+	shared_ptr<AudioBuffers> old = _ring;
+	_ring.reset (new AudioBuffers (channels, size));
+
+	if (!old || old->channels() != channels) {
+		return;
+	}
+
+	/* Move what we have into the new ring */
+	for (vector<pair<Frame, Frame> >::const_iterator i = _ranges.begin(); i != _ranges.end(); ++i) {
+		for (Frame f = i->first; f < i->second; ) {
+			int32_t const read = ring_index (f, old->frames());
+			int32_t const write = ring_index (f, _ring->frames());
+			int32_t const N = min (i->second - f, min (Frame (old->frames() - read), Frame (_ring->frames() - write)));
+			_ring->copy_from (old.get(), N, read, write);
+			f += N;
+		}
+	}
+}
+
+/** Copy or mix some data into the ring.
+ *  @param audio Data.
+ *  @param read_offset Offset into audio to start reading from.
+ *  @param from First timeline frame to write to.
+ *  @param to Timeline frame after the last one to write to.
+ *  @param accumulate true to mix the data with what is there, false to overwrite it.
+ */
+void
+AudioMerger::copy_in (AudioBuffers const * audio, int32_t read_offset, Frame from, Frame to, bool accumulate)
+{
+	for (Frame f = from; f < to; ) {
+		int32_t const write = ring_index (f, _ring->frames());
+		int32_t const N = min (to - f, Frame (_ring->frames() - write));
+		if (accumulate) {
+			_ring->accumulate_frames (audio, N, read_offset + f - from, write);
+		} else {
+			_ring->copy_from (audio, N, read_offset + f - from, write);
+		}
+		f += N;
+	}
+}
+
+/** Copy some data out of the ring.
+ *  @param out Buffers to write to, starting at their first frame.
+ *  @param from First timeline frame to read.
+ *  @param to Timeline frame after the last one to read.
+ */
+void
+AudioMerger::copy_out (AudioBuffers* out, Frame from, Frame to) const
+{
+	for (Frame f = from; f < to; ) {
+		int32_t const read = ring_index (f, _ring->frames());
+		int32_t const N = min (to - f, Frame (_ring->frames() - read));
+		out->copy_from (_ring.get(), N, read, f - from);
+		f += N;
+	}
+}
+
+/** @return true if the period [from, to) of our timeline can be put into _ring without
+ *  its window becoming too big.
+ */
+bool
+AudioMerger::fits (Frame from, Frame to) const
+{
+	if (_ranges.empty ()) {
+		return true;
+	}
+
+	return max (to, _ranges.back().second) - min (from, _ranges.front().first) <= Frame (_frame_rate) * maximum_window_seconds;
+}
+
+/** @return Buffers for pull() to return, re-using some that it returned before if
+ *  nobody is using them any more.
+ */
+shared_ptr<AudioBuffers>
+AudioMerger::output (int channels, int32_t frames)
+{
+	for (list<shared_ptr<AudioBuffers> >::iterator i = _outputs.begin(); i != _outputs.end(); ++i) {
+		if (i->unique() && !(*i)->shared() && (*i)->channels() == channels) {
+			(*i)->ensure_size (frames);
+			(*i)->set_frames (frames);
+			return *i;
+		}
+	}
+
+	shared_ptr<AudioBuffers> out (new AudioBuffers (channels, frames));
+	_outputs.push_back (out);
+	if (_outputs.size() > maximum_outputs) {
+		_outputs.pop_front ();
+	}
+	return out;
+}
+
+/** Take the data in _ring which are before a given frame of our timeline.
+ *  @param end Timeline frame to take data up to.
+ *  @param out List to add blocks of data to.
+ */
+void
+AudioMerger::pull_ring (Frame end, list<pair<shared_ptr<AudioBuffers>, DCPTime> >& out)
+{
+	vector<pair<Frame, Frame> >::iterator i = _ranges.begin ();
+	while (i != _ranges.end() && i->first < end) {
+		Frame const to = min (i->second, end);
+		shared_ptr<AudioBuffers> audio = output (_ring->channels(), to - i->first);
+		copy_out (audio.get(), i->first, to);
+		out.push_back (make_pair (audio, *_origin + DCPTime::from_frames (i->first, _frame_rate)));
+		if (to == i->second) {
+			++i;
+		} else {
+			i->first = to;
+			break;
+		}
+	}
+
+	_ranges.erase (_ranges.begin(), i);
+}
+
+/** Make _ring smaller if it is empty and it is much bigger than it has needed to be recently */
+void
+AudioMerger::shrink ()
+{
+	if (!_ring || !_ranges.empty ()) {
+		return;
+	}
+
+	Frame const size = max (Frame (_frame_rate), _largest_window);
+	if (_ring->frames() > size * 2) {
+		_ring.reset (new AudioBuffers (_ring->channels(), size));
+	}
+
+	_largest_window = 0;
+}
+
 /** Pull audio up to a given time; after this call, no more data can be pushed
  *  before the specified time.
  *  @param time Time to pull up to.
@@ -56,39 +227,26 @@ AudioMerger::pull (DCPTime time)
 {
 	list<pair<shared_ptr<AudioBuffers>, DCPTime> > out;
 
-	list<Buffer> new_buffers;
-
-	_buffers.sort (AudioMerger::BufferComparator());
-	BOOST_FOREACH (Buffer i, _buffers) {
-		if (i.period().to <= time) {
-			/* Completely within the pull period */
-			DCPOMATIC_ASSERT (i.audio->frames() > 0);
-			out.push_back (make_pair (i.audio, i.time));
-		} else if (i.time < time) {
-			/* Overlaps the end of the pull period */
-			shared_ptr<AudioBuffers> audio (new AudioBuffers (i.audio->channels(), frames(DCPTime(time - i.time))));
-			/* Though time > i.time, audio->frames() could be 0 if the difference in time is less than one frame */
-			if (audio->frames() > 0) {
-				audio->copy_from (i.audio.get(), audio->frames(), 0, 0);
-				out.push_back (make_pair (audio, i.time));
-				i.audio->trim_start (audio->frames ());
-				i.time += DCPTime::from_frames(audio->frames(), _frame_rate);
-				DCPOMATIC_ASSERT (i.audio->frames() > 0);
-				new_buffers.push_back (i);
-			}
-		} else {
-			/* Not involved */
-			DCPOMATIC_ASSERT (i.audio->frames() > 0);
-			new_buffers.push_back (i);
-		}
+	if (!_origin) {
+		return out;
 	}
 
-	_buffers = new_buffers;
+	Frame const end = frames (DCPTime (time - *_origin));
 
-	for (list<pair<shared_ptr<AudioBuffers>, DCPTime> >::const_iterator i = out.begin(); i != out.end(); ++i) {
-		DCPOMATIC_ASSERT (i->first->frames() > 0);
+	/* Put anything that was pushed far ahead, and which we have now reached, into the ring */
+	while (!_ahead.empty() && _ahead.front().second < end) {
+		shared_ptr<AudioBuffers> audio = _ahead.front().first;
+		Frame const from = _ahead.front().second;
+		_ahead.pop_front ();
+		if (!fits (from, from + audio->frames())) {
+			/* Take what we have before this data to make room for it */
+			pull_ring (from, out);
+		}
+		mix (audio.get(), from);
 	}
 
+	pull_ring (end, out);
+	shrink ();
 	return out;
 }
 
@@ -98,67 +256,80 @@ AudioMerger::push (boost::shared_ptr<const AudioBuffers> audio, DCPTime time)
 {
 	DCPOMATIC_ASSERT (audio->frames() > 0);
 
-	DCPTimePeriod period (time, time + DCPTime::from_frames (audio->frames(), _frame_rate));
-
-	/* Mix any overlapping parts of this new block with existing ones */
-	BOOST_FOREACH (Buffer i, _buffers) {
-		optional<DCPTimePeriod> overlap = i.period().overlap (period);
-		if (overlap) {
-			int32_t const offset = frames(DCPTime(overlap->from - i.time));
-			int32_t const frames_to_mix = frames(overlap->duration());
-			if (i.time < time) {
-				i.audio->accumulate_frames(audio.get(), frames_to_mix, 0, offset);
-			} else {
-				i.audio->accumulate_frames(audio.get(), frames_to_mix, offset, 0);
-			}
+	if (!_origin) {
+		_origin = time;
+	}
+
+	Frame const from = frames (DCPTime (time - *_origin));
+
+	if (!fits (from, from + audio->frames())) {
+		/* This is too far away from what we have to go into the ring yet, so keep a copy
+		   of it to one side, after anything else that starts at the same place.
+		*/
+		list<pair<shared_ptr<AudioBuffers>, Frame> >::iterator i = _ahead.begin ();
+		while (i != _ahead.end() && i->second <= from) {
+			++i;
 		}
+		_ahead.insert (i, make_pair (shared_ptr<AudioBuffers> (new AudioBuffers (audio)), from));
+		return;
 	}
 
-	list<DCPTimePeriod> periods;
-	BOOST_FOREACH (Buffer i, _buffers) {
-		periods.push_back (i.period ());
+	mix (audio.get(), from);
+}
+
+/** Mix some data into the ring.
+ *  @param audio Data.
+ *  @param from Timeline frame that the data start at.
+ */
+void
+AudioMerger::mix (AudioBuffers const * audio, Frame from)
+{
+	Frame const to = from + audio->frames ();
+
+	reserve (audio->channels(), from, to);
+	/* Mix the new data with anything that is already there, and copy it into anywhere
+	   that is empty; at the same time, work out the new _ranges.
+	*/
+
+	vector<pair<Frame, Frame> >::iterator i = _ranges.begin ();
+	while (i != _ranges.end() && i->second < from) {
+		++i;
 	}
 
-	/* Add the non-overlapping parts */
-	BOOST_FOREACH (DCPTimePeriod i, subtract (period, periods)) {
-		list<Buffer>::iterator before = _buffers.end();
-		list<Buffer>::iterator after = _buffers.end();
-		for (list<Buffer>::iterator j = _buffers.begin(); j != _buffers.end(); ++j) {
-			if (j->period().to == i.from) {
-				before = j;
-			}
-			if (j->period().from == i.to) {
-				after = j;
-			}
+	Frame f = from;
+	Frame merged_from = from;
+	Frame merged_to = to;
+	vector<pair<Frame, Frame> >::iterator j = i;
+	while (j != _ranges.end() && j->first <= to) {
+		if (f < j->first) {
+			copy_in (audio, f - from, f, j->first, false);
 		}
+		copy_in (audio, max (f, j->first) - from, max (f, j->first), min (to, j->second), true);
+		f = max (f, j->second);
+		merged_from = min (merged_from, j->first);
+		merged_to = max (merged_to, j->second);
+		++j;
+	}
 
-		/* Get the part of audio that we want to use */
-		shared_ptr<AudioBuffers> part (new AudioBuffers (audio->channels(), frames(i.to) - frames(i.from)));
-		part->copy_from (audio.get(), part->frames(), frames(DCPTime(i.from - time)), 0);
-
-		if (before == _buffers.end() && after == _buffers.end()) {
-			/* New buffer */
-			DCPOMATIC_ASSERT (part->frames() > 0);
-			_buffers.push_back (Buffer (part, time, _frame_rate));
-		} else if (before != _buffers.end() && after == _buffers.end()) {
-			/* We have an existing buffer before this one; append new data to it */
-			before->audio->append (part);
-		} else if (before ==_buffers.end() && after != _buffers.end()) {
-			/* We have an existing buffer after this one; append it to the new data and replace */
-			part->append (after->audio);
-			after->audio = part;
-			after->time = time;
-		} else {
-			/* We have existing buffers both before and after; coalesce them all */
-			before->audio->append (part);
-			before->audio->append (after->audio);
-			_buffers.erase (after);
-		}
+	if (f < to) {
+		copy_in (audio, f - from, f, to, false);
+	}
+
+	/* Replace the ranges [i, j) (which are all touching or overlapping the new data) with one */
+	if (i == j) {
+		_ranges.insert (i, make_pair (merged_from, merged_to));
+	} else {
+		i->first = merged_from;
+		i->second = merged_to;
+		_ranges.erase (i + 1, j);
 	}
 }
 
 void
 AudioMerger::clear ()
 {
-	_buffers.clear ();
+	_origin = optional<DCPTime> ();
+	_ranges.clear ();
+	_ahead.clear ();
+	shrink ();
 }
@@ -24,9 +24,19 @@
 #include "audio_buffers.h"
 #include "dcpomatic_time.h"
 #include "util.h"
+#include <boost/optional.hpp>
+#include <list>
+#include <vector>
 
 /** @class AudioMerger.
  *  @brief A class that can merge audio data from many sources.
+ *
+ *  Pushed data is mixed into a window of a timeline, held in a ring buffer, so
+ *  pushing and pulling do not need to allocate or move data around except when
+ *  the window has to grow.  The window is not allowed to grow beyond a few seconds;
+ *  data pushed further ahead than that are kept in separate buffers until pull()
+ *  reaches them.  The buffers returned by pull() are re-used once their callers
+ *  have finished with them.
  */
 class AudioMerger
 {
@@ -39,45 +49,38 @@ public:
 
 private:
 	Frame frames (DCPTime t) const;
+	void reserve (int channels, Frame from, Frame to);
+	void copy_in (AudioBuffers const * audio, int32_t read_offset, Frame from, Frame to, bool accumulate);
+	void copy_out (AudioBuffers* out, Frame from, Frame to) const;
+	bool fits (Frame from, Frame to) const;
+	void mix (AudioBuffers const * audio, Frame from);
+	void pull_ring (Frame end, std::list<std::pair<boost::shared_ptr<AudioBuffers>, DCPTime> >& out);
+	boost::shared_ptr<AudioBuffers> output (int channels, int32_t frames);
+	void shrink ();
 
-	class Buffer
-	{
-	public:
-		/** @param c Channels
-		 *  @param f Frames
-		 *  @param t Time
-		 *  @param r Frame rate.
-		 */
-		Buffer (int c, int32_t f, DCPTime t, int r)
-			: audio (new AudioBuffers (c, f))
-			, time (t)
-			, frame_rate (r)
-		{}
-
-		Buffer (boost::shared_ptr<AudioBuffers> a, DCPTime t, int r)
-			: audio (a)
-			, time (t)
-			, frame_rate (r)
-		{}
-
-		boost::shared_ptr<AudioBuffers> audio;
-		DCPTime time;
-		int frame_rate;
-
-		DCPTimePeriod period () const {
-			return DCPTimePeriod (time, time + DCPTime::from_frames (audio->frames(), frame_rate));
-		}
-	};
-
-	class BufferComparator
-	{
-	public:
-		bool operator() (AudioMerger::Buffer const & a, AudioMerger::Buffer const & b)
-		{
-			return a.time < b.time;
-		}
-	};
-
-	std::list<Buffer> _buffers;
 	int _frame_rate;
+	/** time of frame 0 of our timeline, or empty if nothing has been pushed since
+	 *  we were created or cleared.
+	 */
+	boost::optional<DCPTime> _origin;
+	/** storage for the window of the timeline that we are using; timeline frame f
+	 *  is held at index f modulo the size of the ring.
+	 */
+	boost::shared_ptr<AudioBuffers> _ring;
+	/** periods of the timeline which contain data, in frames; these are sorted, and
+	 *  neither overlap nor touch.
+	 */
+	std::vector<std::pair<Frame, Frame> > _ranges;
+	/** largest window of the timeline that _ring has had to hold since it last
+	 *  emptied, in frames.
+	 */
+	Frame _largest_window;
+	/** data which were pushed too far ahead of the window to be put into _ring,
+	 *  with the timeline frame that each one starts at, sorted by that frame.
+	 */
+	std::list<std::pair<boost::shared_ptr<AudioBuffers>, Frame> > _ahead;
+	/** buffers which we have returned from pull(), which we can use again once nobody
+	 *  else is using them.
+	 */
+	std::list<boost::shared_ptr<AudioBuffers> > _outputs;
 };
@@ -22,6 +22,7 @@
 #include "dcpomatic_assert.h"
 #include "exceptions.h"
 #include <boost/foreach.hpp>
+#include <cstring>
 #include <iostream>
 
 using std::min;
@@ -103,6 +104,53 @@ AudioRingBuffers::get (float* out, int channels, int frames)
 	return time;
 }
 
+/** Get some audio without interleaving it.
+ *  @param out Buffers to fill with out->frames() frames; any channels that we don't have will be silent.
+ *  @return time of the returned data; if it's not set this indicates an underrun
+ */
+optional<DCPTime>
+AudioRingBuffers::get (shared_ptr<AudioBuffers> out)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	optional<DCPTime> time;
+
+	int const channels = out->channels ();
+	int const frames = out->frames ();
+	int done = 0;
+
+	while (done < frames) {
+		if (_buffers.empty ()) {
+			out->make_silent (done, frames - done);
+			cout << "audio underrun; missing " << (frames - done) << "!\n";
+			return time;
+		}
+
+		pair<shared_ptr<const AudioBuffers>, DCPTime> front = _buffers.front ();
+		if (!time) {
+			time = front.second + DCPTime::from_frames(_used_in_head, 48000);
+		}
+
+		int const to_do = min (frames - done, front.first->frames() - _used_in_head);
+		int const c = min (front.first->channels(), channels);
+		for (int i = 0; i < c; ++i) {
+			memcpy (out->data(i) + done, front.first->data(i) + _used_in_head, to_do * sizeof(float));
+		}
+		for (int i = c; i < channels; ++i) {
+			memset (out->data(i) + done, 0, to_do * sizeof(float));
+		}
+		_used_in_head += to_do;
+		done += to_do;
+
+		if (_used_in_head == front.first->frames()) {
+			_buffers.pop_front ();
+			_used_in_head = 0;
+		}
+	}
+
+	return time;
+}
+
 optional<DCPTime>
 AudioRingBuffers::peek () const
 {
@@ -35,6 +35,7 @@ public:
 
 	void put (boost::shared_ptr<const AudioBuffers> data, DCPTime time, int frame_rate);
 	boost::optional<DCPTime> get (float* out, int channels, int frames);
+	boost::optional<DCPTime> get (boost::shared_ptr<AudioBuffers> out);
 	boost::optional<DCPTime> peek () const;
 
 	void clear ();
@@ -52,6 +52,8 @@ using boost::function;
  *  butler.  This will be used (where possible) to prepare the PlayerVideos so that calling image() on them is quick.
  *  @param aligned Same as above for the `aligned' flag.
  *  @param fast Same as above for the `fast' flag.
+ *  @param memory_stage Stage of the MemoryBudget to count our frames in; MemoryBudget::PREVIEW
+ *  for a butler which is feeding a viewer, otherwise MemoryBudget::BUTLER.
  */
 Butler::Butler (
 	shared_ptr<Player> player,
@@ -59,7 +61,8 @@ Butler::Butler (
 	int audio_channels,
 	function<AVPixelFormat (AVPixelFormat)> pixel_format,
 	bool aligned,
-	bool fast
+	bool fast,
+	MemoryBudget::Stage memory_stage
 	)
 	: _player (player)
 	, _prepare_work (new boost::asio::io_service::work (_prepare_service))
@@ -68,12 +71,13 @@ Butler::Butler (
 	, _finished (false)
 	, _died (false)
 	, _stop_thread (false)
-	, _audio_mapping (audio_mapping)
+	, _audio_matrix (audio_mapping, audio_channels)
 	, _audio_channels (audio_channels)
 	, _disable_audio (false)
 	, _pixel_format (pixel_format)
 	, _aligned (aligned)
 	, _fast (fast)
+	, _memory (memory_stage)
 {
 	_player_video_connection = _player->Video.connect (bind (&Butler::video, this, _1, _2));
 	_player_audio_connection = _player->Audio.connect (bind (&Butler::audio, this, _1, _2, _3));
@@ -82,6 +86,9 @@ Butler::Butler (
 	   get_video() to be called in response to this signal.
 	*/
 	_player_change_connection = _player->Change.connect (bind (&Butler::player_change, this, _1, _3), boost::signals2::at_front);
+	if (memory_stage != MemoryBudget::PREVIEW) {
+		_memory_freed_connection = MemoryBudget::instance()->Freed.connect (bind (&Butler::memory_freed, this));
+	}
 	_thread = new boost::thread (bind (&Butler::thread, this));
 #ifdef DCPOMATIC_LINUX
 	pthread_setname_np (_thread->native_handle(), "butler");
@@ -100,6 +107,9 @@ Butler::Butler (
 
 Butler::~Butler ()
 {
+	/* Stop MemoryBudget::Freed reaching us while we are being destroyed */
+	_memory_freed_connection.disconnect ();
+
 	{
 		boost::mutex::scoped_lock lm (_mutex);
 		_stop_thread = true;
@@ -164,6 +174,11 @@ Butler::should_run () const
 		return true;
 	}
 
+	if (_memory.stage() != MemoryBudget::PREVIEW && MemoryBudget::instance()->exceeded()) {
+		/* Don't fill up any more while the frames we have are using too much memory */
+		return false;
+	}
+
 	/* Run if we aren't full of video or audio */
 	return (_video.size() < MAXIMUM_VIDEO_READAHEAD) && (_audio.size() < MAXIMUM_AUDIO_READAHEAD);
 }
@@ -240,6 +255,7 @@ Butler::get_video (Error* e)
 	}
 
 	pair<shared_ptr<PlayerVideo>, DCPTime> const r = _video.get ();
+	update_memory ();
 	_summon.notify_all ();
 	return r;
 }
@@ -277,6 +293,7 @@ Butler::seek_unlocked (DCPTime position, bool accurate)
 		_closed_caption.clear ();
 	}
 
+	update_memory ();
 	_summon.notify_all ();
 }
 
@@ -290,6 +307,10 @@ try
 		LOG_TIMING("start-prepare in %1", thread_id());
 		video->prepare (_pixel_format, _aligned, _fast);
 		LOG_TIMING("finish-prepare in %1", thread_id());
+		/* Count the prepared image, if the video is still waiting to be collected */
+		_video.prepared (video);
+		boost::mutex::scoped_lock lm (_mutex);
+		update_memory ();
 	}
 }
 catch (...)
@@ -313,6 +334,7 @@ Butler::video (shared_ptr<PlayerVideo> video, DCPTime time)
 
 	boost::mutex::scoped_lock lm2 (_buffers_mutex);
 	_video.put (video, time);
+	update_memory ();
 }
 
 void
@@ -327,7 +349,7 @@ Butler::audio (shared_ptr<AudioBuffers> audio, DCPTime time, int frame_rate)
 	}
 
 	boost::mutex::scoped_lock lm2 (_buffers_mutex);
-	_audio.put (remap (audio, _audio_channels, _audio_mapping), time, frame_rate);
+	_audio.put (_audio_matrix.apply (audio), time, frame_rate);
 }
 
 /** Try to get `frames' frames of audio and copy it into `out'.  Silence
@@ -342,6 +364,20 @@ Butler::get_audio (float* out, Frame frames)
 	return t;
 }
 
+/** Try to get out->frames() frames of audio and copy it, without interleaving, into `out',
+ *  which must have the same number of channels as this Butler.  Silence will be filled if
+ *  no audio is available.
+ *  @return time of this audio, or unset if there was a buffer underrun.
+ */
+optional<DCPTime>
+Butler::get_audio (shared_ptr<AudioBuffers> out)
+{
+	DCPOMATIC_ASSERT (out->channels() == _audio_channels);
+	optional<DCPTime> t = _audio.get (out);
+	_summon.notify_all ();
+	return t;
+}
+
 void
 Butler::disable_audio ()
 {
@@ -349,6 +385,24 @@ Butler::disable_audio ()
 	_disable_audio = true;
 }
 
+/** Tell the memory budget how much our video is using.  Caller must hold a lock on _mutex */
+void
+Butler::update_memory ()
+{
+	_memory.set (_video.memory_used().first);
+}
+
+/** Called from whichever thread has freed some memory, when the budget is no longer exceeded.
+ *  This must not take _mutex, since Freed may be emitted by our own update_memory() (or by
+ *  another butler's, which may be waiting for our _mutex).  A wakeup missed because of that
+ *  only means that we wait until our next get_video() to fill up again.
+ */
+void
+Butler::memory_freed ()
+{
+	_summon.notify_all ();
+}
+
 pair<size_t, string>
 Butler::memory_used () const
 {
@@ -22,7 +22,9 @@
 #include "audio_ring_buffers.h"
 #include "text_ring_buffers.h"
 #include "audio_mapping.h"
+#include "audio_matrix.h"
 #include "exception_store.h"
+#include "memory_budget.h"
 #include <boost/shared_ptr.hpp>
 #include <boost/weak_ptr.hpp>
 #include <boost/thread.hpp>
@@ -42,7 +44,8 @@ public:
 		int audio_channels,
 		boost::function<AVPixelFormat (AVPixelFormat)> pixel_format,
 		bool aligned,
-		bool fast
+		bool fast,
+		MemoryBudget::Stage memory_stage
 		);
 
 	~Butler ();
@@ -56,6 +59,7 @@ public:
 
 	std::pair<boost::shared_ptr<PlayerVideo>, DCPTime> get_video (Error* e = 0);
 	boost::optional<DCPTime> get_audio (float* out, Frame frames);
+	boost::optional<DCPTime> get_audio (boost::shared_ptr<AudioBuffers> out);
 	boost::optional<TextRingBuffers::Data> get_closed_caption ();
 
 	void disable_audio ();
@@ -71,6 +75,8 @@ private:
 	void prepare (boost::weak_ptr<PlayerVideo> video);
 	void player_change (ChangeType type, bool frequent);
 	void seek_unlocked (DCPTime position, bool accurate);
+	void update_memory ();
+	void memory_freed ();
 
 	boost::shared_ptr<Player> _player;
 	boost::thread* _thread;
@@ -100,7 +106,8 @@ private:
 	bool _died;
 	bool _stop_thread;
 
-	AudioMapping _audio_mapping;
+	/** mixing matrix made from the AudioMapping we were given */
+	AudioMatrix _audio_matrix;
 	int _audio_channels;
 
 	bool _disable_audio;
@@ -109,6 +116,9 @@ private:
 	bool _aligned;
 	bool _fast;
 
+	/** our share of the memory budget; protected by _mutex */
+	MemoryBudget::Account _memory;
+
 	/** If we are waiting to be refilled following a seek, this is the time we were
 	    seeking to.
 	*/
@@ -118,4 +128,5 @@ private:
 	boost::signals2::scoped_connection _player_audio_connection;
 	boost::signals2::scoped_connection _player_text_connection;
 	boost::signals2::scoped_connection _player_change_connection;
+	boost::signals2::scoped_connection _memory_freed_connection;
 };
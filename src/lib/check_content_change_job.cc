@@ -23,17 +23,42 @@
 #include "examine_content_job.h"
 #include "content.h"
 #include "film.h"
+#include "digester.h"
 #include "dcpomatic_log.h"
 #include <boost/foreach.hpp>
+#include <boost/thread.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/function.hpp>
+#include <algorithm>
+#ifdef DCPOMATIC_POSIX
+#include <sys/stat.h>
+#endif
 #include <iostream>
 
 #include "i18n.h"
 
 using std::string;
 using std::list;
+using std::vector;
+using std::map;
+using std::pair;
+using std::make_pair;
+using std::min;
+using std::nth_element;
 using std::cout;
 using boost::shared_ptr;
 
+/** Maximum number of threads to use to look at files; this is mostly waiting for disks
+ *  (which may be on the network) so it need not be the same as the number of CPUs.
+ */
+static size_t const max_threads = 16;
+/** Maximum number of files to remember as unchanged */
+static size_t const max_unchanged = 4096;
+
+boost::mutex CheckContentChangeJob::_unchanged_mutex;
+map<boost::filesystem::path, CheckContentChangeJob::Unchanged> CheckContentChangeJob::_unchanged;
+boost::uintmax_t CheckContentChangeJob::_unchanged_uses = 0;
+
 CheckContentChangeJob::CheckContentChangeJob (shared_ptr<const Film> film, shared_ptr<Job> following)
 	: Job (film)
 	, _following (following)
@@ -53,28 +78,259 @@ CheckContentChangeJob::json_name () const
 	return N_("check_content_change");
 }
 
+CheckContentChangeJob::FileState
+CheckContentChangeJob::file_state (boost::filesystem::path path)
+{
+	FileState state;
+#ifdef DCPOMATIC_POSIX
+	struct stat st;
+	if (stat (path.c_str(), &st) == 0) {
+		state.write_time = st.st_mtime;
+		state.size = st.st_size;
+		state.inode = st.st_ino;
+		return state;
+	}
+	/* Fall through so that boost::filesystem throws a suitable exception */
+#endif
+	state.write_time = boost::filesystem::last_write_time (path);
+	state.size = boost::filesystem::file_size (path);
+	return state;
+}
+
+struct ParallelWork
+{
+	ParallelWork (Job* job_, size_t count_, boost::function<void (size_t)> task_)
+		: job (job_)
+		, count (count_)
+		, task (task_)
+		, next (0)
+		, done (0)
+	{}
+
+	Job* job;
+	size_t count;
+	boost::function<void (size_t)> task;
+	boost::mutex mutex;
+	size_t next;
+	size_t done;
+	/** first exception thrown by any thread */
+	boost::exception_ptr error;
+};
+
+static void
+parallel_thread (ParallelWork* work)
+{
+	while (true) {
+		size_t index;
+		{
+			boost::mutex::scoped_lock lm (work->mutex);
+			if (work->next == work->count || work->error) {
+				return;
+			}
+			index = work->next++;
+		}
+
+		try {
+			work->task (index);
+		} catch (boost::thread_interrupted &) {
+			return;
+		} catch (...) {
+			boost::mutex::scoped_lock lm (work->mutex);
+			if (!work->error) {
+				work->error = boost::current_exception ();
+			}
+			return;
+		}
+
+		try {
+			/* Report progress with the lock held so that it never goes backwards */
+			boost::mutex::scoped_lock lm (work->mutex);
+			work->job->set_progress (float (++work->done) / work->count);
+		} catch (boost::thread_interrupted &) {
+			return;
+		}
+	}
+}
+
+/** Call task for each index from 0 to count - 1, spread over a pool of threads */
+static void
+parallel_for (Job* job, size_t count, boost::function<void (size_t)> task)
+{
+	if (count == 0) {
+		return;
+	}
+
+	ParallelWork work (job, count, task);
+
+	boost::thread_group pool;
+	size_t const threads = min (count, max_threads);
+	for (size_t i = 0; i < threads; ++i) {
+		pool.create_thread (boost::bind (&parallel_thread, &work));
+	}
+
+	try {
+		pool.join_all ();
+	} catch (boost::thread_interrupted &) {
+		/* This job has been cancelled */
+		pool.interrupt_all ();
+		pool.join_all ();
+		throw;
+	}
+
+	if (work.error) {
+		boost::rethrow_exception (work.error);
+	}
+}
+
+void
+CheckContentChangeJob::find_file_state (vector<pair<shared_ptr<Content>, size_t> > const * files, vector<FileState>* states, size_t index)
+{
+	(*states)[index] = file_state ((*files)[index].first->path((*files)[index].second));
+}
+
+/** @param states States of the files of content, starting at index first.
+ *  @return true if every file of content is in the state it was in when we last found
+ *  the content to be unchanged.
+ */
+bool
+CheckContentChangeJob::known_unchanged (shared_ptr<const Content> content, vector<FileState> const & states, size_t first)
+{
+	boost::mutex::scoped_lock lm (_unchanged_mutex);
+
+	for (size_t i = 0; i < content->number_of_paths(); ++i) {
+		map<boost::filesystem::path, Unchanged>::const_iterator j = _unchanged.find (content->path(i));
+		if (j == _unchanged.end() || !(j->second.state == states[first + i]) || j->second.index != i || j->second.digest != content->digest()) {
+			return false;
+		}
+	}
+
+	++_unchanged_uses;
+	for (size_t i = 0; i < content->number_of_paths(); ++i) {
+		_unchanged[content->path(i)].last_use = _unchanged_uses;
+	}
+
+	return true;
+}
+
+/** Forget anything that we knew about the files of some content, as it has changed */
+void
+CheckContentChangeJob::forget_unchanged (shared_ptr<const Content> content)
+{
+	boost::mutex::scoped_lock lm (_unchanged_mutex);
+	for (size_t i = 0; i < content->number_of_paths(); ++i) {
+		_unchanged.erase (content->path(i));
+	}
+}
+
+/** Remove the least recently used entries from _unchanged if there are too many */
+void
+CheckContentChangeJob::prune_unchanged ()
+{
+	boost::mutex::scoped_lock lm (_unchanged_mutex);
+	if (_unchanged.size() <= max_unchanged) {
+		return;
+	}
+
+	vector<pair<boost::uintmax_t, boost::filesystem::path> > uses;
+	for (map<boost::filesystem::path, Unchanged>::const_iterator i = _unchanged.begin(); i != _unchanged.end(); ++i) {
+		uses.push_back (make_pair (i->second.last_use, i->first));
+	}
+
+	size_t const remove = _unchanged.size() - max_unchanged;
+	nth_element (uses.begin(), uses.begin() + remove, uses.end());
+	for (size_t i = 0; i < remove; ++i) {
+		_unchanged.erase (uses[i].second);
+	}
+}
+
+static void
+calculate_digest (vector<shared_ptr<Content> > const * content, vector<string>* digests, size_t index)
+{
+	(*digests)[index] = (*content)[index]->calculate_digest ();
+}
+
+/** Check the content of the film for changes.  First we look at the modification time of
+ *  every file, then for any content that looks unchanged we compare its digest with the
+ *  one that was taken when it was examined.  A digest is only calculated if the files'
+ *  sizes, modification times or inodes have changed since we last found it to be the same;
+ *  this is remembered for each file, so content which shares a file with, or is re-ordered
+ *  relative to, some other content is not confused with it.
+ *  The files are looked at, and the digests calculated, by a pool of threads.
+ */
 void
 CheckContentChangeJob::run ()
 {
-	set_progress_unknown ();
+	sub (_("Checking files"));
 
-	list<shared_ptr<Content> > changed;
+	ContentList const content = _film->content ();
 
-	BOOST_FOREACH (shared_ptr<Content> i, _film->content()) {
-		bool ic = false;
+	vector<pair<shared_ptr<Content>, size_t> > files;
+	BOOST_FOREACH (shared_ptr<Content> i, content) {
 		for (size_t j = 0; j < i->number_of_paths(); ++j) {
-			if (boost::filesystem::last_write_time(i->path(j)) != i->last_write_time(j)) {
-				LOG_GENERAL("File %1 changed; last_write_time now %2, was %3", i->path(j).string(), boost::filesystem::last_write_time(i->path(j)), i->last_write_time(j));
-				ic = true;
-				break;
+			files.push_back (make_pair (i, j));
+		}
+	}
+
+	vector<FileState> states (files.size ());
+	parallel_for (this, files.size(), boost::bind (&find_file_state, &files, &states, _1));
+
+	/* Whether each piece of content has changed, in the same order as content */
+	vector<bool> content_changed (content.size(), false);
+	/* Indices into content of content whose modification times are unchanged but whose digest we need to check */
+	vector<size_t> to_digest_indices;
+	/* Indices into states of the first file of each piece of content whose digest we need to check */
+	vector<size_t> to_digest_first;
+	vector<shared_ptr<Content> > to_digest;
+
+	size_t file = 0;
+	for (size_t i = 0; i < content.size(); ++i) {
+		shared_ptr<Content> c = content[i];
+		size_t const first = file;
+		for (size_t j = 0; j < c->number_of_paths(); ++j) {
+			FileState const & state = states[file++];
+			if (!content_changed[i] && state.write_time != c->last_write_time(j)) {
+				LOG_GENERAL("File %1 changed; last_write_time now %2, was %3", c->path(j).string(), state.write_time, c->last_write_time(j));
+				content_changed[i] = true;
 			}
 		}
-		if (!ic && i->calculate_digest() != i->digest()) {
-			LOG_GENERAL("Content %1 changed; digest now %2, was %3", i->path(0).string(), i->calculate_digest(), i->digest());
-			ic = true;
+
+		if (!content_changed[i] && !known_unchanged (c, states, first)) {
+			to_digest_indices.push_back (i);
+			to_digest_first.push_back (first);
+			to_digest.push_back (c);
 		}
-		if (ic) {
-			changed.push_back (i);
+	}
+
+	sub (_("Checking digests"));
+
+	vector<string> digests (to_digest.size ());
+	parallel_for (this, to_digest.size(), boost::bind (&calculate_digest, &to_digest, &digests, _1));
+
+	for (size_t i = 0; i < to_digest.size(); ++i) {
+		shared_ptr<Content> c = to_digest[i];
+		if (digests[i] != c->digest()) {
+			LOG_GENERAL("Content %1 changed; digest now %2, was %3", c->path(0).string(), digests[i], c->digest());
+			content_changed[to_digest_indices[i]] = true;
+		} else {
+			/* Remember the state of each of this content's files so that we need not
+			   calculate its digest again until one of them changes.
+			*/
+			boost::mutex::scoped_lock lm (_unchanged_mutex);
+			++_unchanged_uses;
+			for (size_t j = 0; j < c->number_of_paths(); ++j) {
+				_unchanged[c->path(j)] = Unchanged (states[to_digest_first[i] + j], c->digest(), j, _unchanged_uses);
+			}
+		}
+	}
+
+	prune_unchanged ();
+
+	/* Report changed content in the same order as it is in the film */
+	list<shared_ptr<Content> > changed;
+	for (size_t i = 0; i < content.size(); ++i) {
+		if (content_changed[i]) {
+			forget_unchanged (content[i]);
+			changed.push_back (content[i]);
 		}
 	}
 
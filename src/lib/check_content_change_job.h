@@ -19,6 +19,13 @@
 */
 
 #include "job.h"
+#include <boost/thread/mutex.hpp>
+#include <boost/filesystem.hpp>
+#include <ctime>
+#include <map>
+#include <vector>
+
+class Content;
 
 /** @class CheckContentChangeJob
  *  @brief A job to check whether content has changed since it was added to the film.
@@ -34,5 +41,64 @@ public:
 	void run ();
 
 private:
+	/** What we can find out about a file without reading it */
+	struct FileState
+	{
+		FileState ()
+			: write_time (0)
+			, size (0)
+			, inode (0)
+		{}
+
+		bool operator== (FileState const & other) const {
+			return write_time == other.write_time && size == other.size && inode == other.inode;
+		}
+
+		std::time_t write_time;
+		boost::uintmax_t size;
+		/** inode number, or 0 if we can't find it on this platform */
+		boost::uintmax_t inode;
+	};
+
+	/** A file which we have found to be unchanged */
+	struct Unchanged
+	{
+		Unchanged ()
+			: index (0)
+			, last_use (0)
+		{}
+
+		Unchanged (FileState state_, std::string digest_, size_t index_, boost::uintmax_t last_use_)
+			: state (state_)
+			, digest (digest_)
+			, index (index_)
+			, last_use (last_use_)
+		{}
+
+		/** state of the file when we checked it */
+		FileState state;
+		/** digest of the content that it was part of */
+		std::string digest;
+		/** index of the file in that content's paths */
+		size_t index;
+		/** value of _unchanged_uses when we last used this entry */
+		boost::uintmax_t last_use;
+	};
+
+	static FileState file_state (boost::filesystem::path path);
+	static void find_file_state (std::vector<std::pair<boost::shared_ptr<Content>, size_t> > const * files, std::vector<FileState>* states, size_t index);
+	static bool known_unchanged (boost::shared_ptr<const Content> content, std::vector<FileState> const & states, size_t first);
+	static void forget_unchanged (boost::shared_ptr<const Content> content);
+	static void prune_unchanged ();
+
 	boost::shared_ptr<Job> _following;
+
+	/** mutex to protect _unchanged and _unchanged_uses */
+	static boost::mutex _unchanged_mutex;
+	/** Files which we have checked and found to be unchanged (by calculating the digest of
+	 *  the content that they are part of), indexed by path.
+	 */
+	static std::map<boost::filesystem::path, Unchanged> _unchanged;
+	/** number of times that we have used _unchanged, so that the least recently used entries can be removed */
+	static boost::uintmax_t _unchanged_uses;
 };
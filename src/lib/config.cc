@@ -93,6 +93,7 @@ Config::set_defaults ()
 	_tms_path = ".";
 	_tms_user = "";
 	_tms_password = "";
+	_upload_streams = 4;
 	_cinema_sound_processor = CinemaSoundProcessor::from_id (N_("dolby_cp750"));
 	_allow_any_dcp_frame_rate = false;
 	_allow_any_container = false;
@@ -153,6 +154,12 @@ Config::set_defaults ()
 	   use about 240Mb with 72 encoding threads.
 	*/
 	_frames_in_memory_multiplier = 3;
+	_content_readahead = 8;
+	_image_readahead = 8;
+	_memory_budget = 0;
+	_export_threads = 0;
+	_export_segments = 1;
+	_memory_map_content = false;
 	_decode_reduction = optional<int>();
 	_default_notify = false;
 	for (int i = 0; i < NOTIFICATION_COUNT; ++i) {
@@ -291,6 +298,7 @@ try
 	_tms_path = f.string_child ("TMSPath");
 	_tms_user = f.string_child ("TMSUser");
 	_tms_password = f.string_child ("TMSPassword");
+	_upload_streams = f.optional_number_child<int>("UploadStreams").get_value_or(4);
 
 	optional<string> c;
 	c = f.optional_string_child ("SoundProcessor");
@@ -534,6 +542,12 @@ try
 		}
 	}
 	_frames_in_memory_multiplier = f.optional_number_child<int>("FramesInMemoryMultiplier").get_value_or(3);
+	_content_readahead = f.optional_number_child<int>("ContentReadahead").get_value_or(8);
+	_image_readahead = f.optional_number_child<int>("ImageReadahead").get_value_or(8);
+	_memory_budget = f.optional_number_child<int>("MemoryBudget").get_value_or(0);
+	_export_threads = f.optional_number_child<int>("ExportThreads").get_value_or(0);
+	_export_segments = f.optional_number_child<int>("ExportSegments").get_value_or(1);
+	_memory_map_content = f.optional_bool_child("MemoryMapContent").get_value_or(false);
 	_decode_reduction = f.optional_number_child<int>("DecodeReduction");
 	_default_notify = f.optional_bool_child("DefaultNotify").get_value_or(false);
 
@@ -673,6 +687,8 @@ Config::write_config () const
 	root->add_child("TMSUser")->add_child_text (_tms_user);
 	/* [XML] TMSPassword Password to log into the TMS with. */
 	root->add_child("TMSPassword")->add_child_text (_tms_password);
+	/* [XML] UploadStreams Number of files to send to the TMS at the same time. */
+	root->add_child("UploadStreams")->add_child_text (raw_convert<string> (_upload_streams));
 	if (_cinema_sound_processor) {
 		/* [XML:opt] CinemaSoundProcessor Identifier of the type of cinema sound processor to use when calculating
 		   gain changes from fader positions.  Currently can only be <code>dolby_cp750</code>.
@@ -926,6 +942,20 @@ Config::write_config () const
 	   frames to be held in memory at once.
 	*/
 	root->add_child("FramesInMemoryMultiplier")->add_child_text(raw_convert<string>(_frames_in_memory_multiplier));
+	/* [XML] ContentReadahead number of megabytes of content files to read ahead of the decoders, or 0 to not read ahead. */
+	root->add_child("ContentReadahead")->add_child_text(raw_convert<string>(_content_readahead));
+	/* [XML] ImageReadahead number of files of image sequences to read ahead of the decoders, or 0 to not read ahead. */
+	root->add_child("ImageReadahead")->add_child_text(raw_convert<string>(_image_readahead));
+	/* [XML] MemoryBudget maximum number of megabytes to use for frames waiting to be encoded and written, or 0 to use half of the machine's memory. */
+	root->add_child("MemoryBudget")->add_child_text(raw_convert<string>(_memory_budget));
+	/* [XML] ExportThreads number of threads for each video encoder to use when exporting, or 0 to decide automatically. */
+	root->add_child("ExportThreads")->add_child_text(raw_convert<string>(_export_threads));
+	/* [XML] ExportSegments maximum number of parts of the timeline to encode at the same time when exporting. */
+	root->add_child("ExportSegments")->add_child_text(raw_convert<string>(_export_segments));
+	/* [XML] MemoryMapContent 1 to memory-map content files which are on local disks, otherwise 0.  A content file
+	   which is truncated or replaced while it is mapped will crash DCP-o-matic.
+	*/
+	root->add_child("MemoryMapContent")->add_child_text(_memory_map_content ? "1" : "0");
 
 	/* [XML] DecodeReduction power of 2 to reduce DCP images by before decoding in the player. */
 	if (_decode_reduction) {
@@ -141,6 +141,11 @@ public:
 		return _tms_password;
 	}
 
+	/** @return Number of files to send to the TMS at the same time */
+	int upload_streams () const {
+		return _upload_streams;
+	}
+
 	/** @return The cinema sound processor that we are using */
 	CinemaSoundProcessor const * cinema_sound_processor () const {
 		return _cinema_sound_processor;
@@ -422,6 +427,35 @@ public:
 		return _frames_in_memory_multiplier;
 	}
 
+	/** @return Amount of content file data to read ahead of the decoder, in MB */
+	int content_readahead () const {
+		return _content_readahead;
+	}
+
+	/** @return Number of files of image sequences to read ahead of the decoder */
+	int image_readahead () const {
+		return _image_readahead;
+	}
+
+	/** @return Maximum memory for frames waiting in the encoding pipeline, in MB, or 0 to decide automatically */
+	int memory_budget () const {
+		return _memory_budget;
+	}
+
+	/** @return Number of threads for each FFmpeg video encoder to use when exporting, or 0 to decide automatically */
+	int export_threads () const {
+		return _export_threads;
+	}
+
+	/** @return Maximum number of parts of the timeline to encode at the same time when exporting */
+	int export_segments () const {
+		return _export_segments;
+	}
+
+	bool memory_map_content () const {
+		return _memory_map_content;
+	}
+
 	boost::optional<int> decode_reduction () const {
 		return _decode_reduction;
 	}
@@ -592,6 +626,10 @@ public:
 		maybe_set (_tms_password, p);
 	}
 
+	void set_upload_streams (int s) {
+		maybe_set (_upload_streams, s);
+	}
+
 	void add_cinema (boost::shared_ptr<Cinema> c) {
 		_cinemas.push_back (c);
 		changed (CINEMAS);
@@ -852,6 +890,30 @@ public:
 		maybe_set (_frames_in_memory_multiplier, m);
 	}
 
+	void set_content_readahead (int r) {
+		maybe_set (_content_readahead, r);
+	}
+
+	void set_image_readahead (int r) {
+		maybe_set (_image_readahead, r);
+	}
+
+	void set_memory_budget (int b) {
+		maybe_set (_memory_budget, b);
+	}
+
+	void set_export_threads (int t) {
+		maybe_set (_export_threads, t);
+	}
+
+	void set_export_segments (int s) {
+		maybe_set (_export_segments, s);
+	}
+
+	void set_memory_map_content (bool m) {
+		maybe_set (_memory_map_content, m);
+	}
+
 	void set_decode_reduction (boost::optional<int> r) {
 		maybe_set (_decode_reduction, r);
 	}
@@ -1152,6 +1214,8 @@ private:
 	std::string _tms_user;
 	/** Password to log into the TMS with */
 	std::string _tms_password;
+	/** Number of files to send to the TMS at the same time */
+	int _upload_streams;
 	/** Our cinema sound processor */
 	CinemaSoundProcessor const * _cinema_sound_processor;
 	/** The list of possible DCP frame rates that DCP-o-matic will use */
@@ -1241,6 +1305,15 @@ private:
 	boost::optional<KDMWriteType> _last_kdm_write_type;
 	boost::optional<DKDMWriteType> _last_dkdm_write_type;
 	int _frames_in_memory_multiplier;
+	int _content_readahead;
+	int _image_readahead;
+	int _memory_budget;
+	int _export_threads;
+	int _export_segments;
+	/** true to memory-map content files which are on local filesystems; off by default as changing
+	 *  a file while it is mapped can crash us.
+	 */
+	bool _memory_map_content;
 	boost::optional<int> _decode_reduction;
 	bool _default_notify;
 	bool _notification[NOTIFICATION_COUNT];
@@ -31,6 +31,7 @@ extern "C" {
 #ifdef DCPOMATIC_LINUX
 #include <unistd.h>
 #include <mntent.h>
+#include <sys/vfs.h>
 #endif
 #ifdef DCPOMATIC_WINDOWS
 #include <windows.h>
@@ -40,6 +41,8 @@ extern "C" {
 #include <fcntl.h>
 #endif
 #ifdef DCPOMATIC_OSX
+#include <sys/param.h>
+#include <sys/mount.h>
 #include <sys/sysctl.h>
 #include <mach-o/dyld.h>
 #include <IOKit/pwr_mgt/IOPMLib.h>
@@ -137,6 +140,37 @@ cpu_info ()
 	return info;
 }
 
+/** @return Amount of physical memory in the machine, in bytes, or 0 if it is not known */
+uint64_t
+physical_memory ()
+{
+#ifdef DCPOMATIC_LINUX
+	long const pages = sysconf (_SC_PHYS_PAGES);
+	long const page_size = sysconf (_SC_PAGE_SIZE);
+	if (pages > 0 && page_size > 0) {
+		return uint64_t (pages) * page_size;
+	}
+#endif
+
+#ifdef DCPOMATIC_OSX
+	uint64_t memory = 0;
+	size_t N = sizeof (memory);
+	if (sysctlbyname ("hw.memsize", &memory, &N, 0, 0) == 0) {
+		return memory;
+	}
+#endif
+
+#ifdef DCPOMATIC_WINDOWS
+	MEMORYSTATUSEX status;
+	status.dwLength = sizeof (status);
+	if (GlobalMemoryStatusEx (&status)) {
+		return status.ullTotalPhys;
+	}
+#endif
+
+	return 0;
+}
+
 #ifdef DCPOMATIC_OSX
 /** @return Path of the Contents directory in the .app */
 boost::filesystem::path
@@ -333,6 +367,51 @@ dcpomatic_fseek (FILE* stream, int64_t offset, int whence)
 #endif
 }
 
+/** @return true if p is on a filesystem which we think is local to this machine
+ *  (i.e. not a network share), otherwise false.
+ */
+bool
+local_filesystem (boost::filesystem::path p)
+{
+#ifdef DCPOMATIC_LINUX
+	struct statfs s;
+	if (statfs (p.c_str(), &s) != 0) {
+		return false;
+	}
+
+	switch (static_cast<unsigned long> (s.f_type)) {
+	case 0x6969:     /* NFS */
+	case 0x517b:     /* SMB */
+	case 0xfe534d42: /* SMB2 */
+	case 0xff534d42: /* CIFS */
+	case 0x65735546: /* FUSE, e.g. sshfs */
+	case 0x564c:     /* NCP */
+	case 0x73757245: /* Coda */
+	case 0x5346414f: /* AFS */
+	case 0x01021997: /* 9P */
+	case 0x00c36400: /* Ceph */
+		return false;
+	}
+	return true;
+#endif
+
+#ifdef DCPOMATIC_OSX
+	struct statfs s;
+	if (statfs (p.c_str(), &s) != 0) {
+		return false;
+	}
+	return s.f_flags & MNT_LOCAL;
+#endif
+
+#ifdef DCPOMATIC_WINDOWS
+	boost::filesystem::path const root = boost::filesystem::absolute(p).root_path();
+	/* c_str() here should give a UTF-16 string */
+	return GetDriveTypeW (root.c_str()) != DRIVE_REMOTE;
+#endif
+
+	return false;
+}
+
 void
 Waker::nudge ()
 {
@@ -39,6 +39,7 @@ struct AVIOContext;
 
 void dcpomatic_sleep (int);
 extern std::string cpu_info ();
+extern uint64_t physical_memory ();
 extern void run_ffprobe (boost::filesystem::path, boost::filesystem::path);
 extern std::list<std::pair<std::string, std::string> > mount_info ();
 extern boost::filesystem::path openssl_path ();
@@ -51,6 +52,7 @@ extern void maybe_open_console ();
 extern boost::filesystem::path shared_path ();
 extern FILE * fopen_boost (boost::filesystem::path, std::string);
 extern int dcpomatic_fseek (FILE *, int64_t, int);
+extern bool local_filesystem (boost::filesystem::path);
 extern void start_batch_converter (boost::filesystem::path dcpomatic);
 extern void start_player (boost::filesystem::path dcpomatic);
 extern uint64_t thread_id ();
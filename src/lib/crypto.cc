@@ -26,7 +26,10 @@
 #include <openssl/evp.h>
 #include <openssl/err.h>
 #include <openssl/rand.h>
+#include <openssl/crypto.h>
+#include <libxml/parser.h>
 #include <boost/scoped_array.hpp>
+#include <boost/thread/mutex.hpp>
 
 using std::string;
 using boost::shared_array;
@@ -35,6 +38,42 @@ using namespace dcpomatic;
 /** The cipher that this code uses */
 #define CIPHER EVP_aes_256_cbc()
 
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+/** Locks for OpenSSL to use, one per CRYPTO_num_locks() */
+static boost::mutex* openssl_locks = 0;
+
+static void
+openssl_lock (int mode, int n, char const *, int)
+{
+	if (mode & CRYPTO_LOCK) {
+		openssl_locks[n].lock ();
+	} else {
+		openssl_locks[n].unlock ();
+	}
+}
+#endif
+
+/** Set things up so that OpenSSL and xmlsec (which libdcp uses to encrypt and sign KDMs)
+ *  can be used from more than one thread at once.  Before 1.1.0 OpenSSL needs us to give
+ *  it some locks; after that it looks after itself.  libxml2's parser must also be set
+ *  up from one thread before any others use it.  xmlsec itself is set up by dcp::init().
+ *
+ *  This must be called once, before any threads which might use these libraries are started.
+ */
+void
+dcpomatic::crypto_thread_setup ()
+{
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+	if (!openssl_locks) {
+		openssl_locks = new boost::mutex[CRYPTO_num_locks()];
+		/* OpenSSL's default thread ID (the address of errno) is fine, so we only need to give it locks */
+		CRYPTO_set_locking_callback (openssl_lock);
+	}
+#endif
+
+	xmlInitParser ();
+}
+
 dcp::Data
 dcpomatic::random_iv ()
 {
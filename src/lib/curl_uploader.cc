@@ -29,41 +29,78 @@
 
 using std::string;
 using std::cout;
+using std::vector;
 using boost::function;
 
-static size_t
-read_callback (void* ptr, size_t size, size_t nmemb, void* object)
+size_t
+CurlUploader::read_callback (void* ptr, size_t size, size_t nmemb, void* stream)
 {
-	CurlUploader* u = reinterpret_cast<CurlUploader*> (object);
-	return u->read_callback (ptr, size, nmemb);
+	Stream* s = reinterpret_cast<Stream*> (stream);
+	size_t const r = fread (ptr, size, nmemb, s->file);
+	s->uploader->transferred (r * size);
+	return r;
+}
+
+/** Called by libcurl to skip the part of a file which is already on the server */
+int
+CurlUploader::seek_callback (void* stream, curl_off_t offset, int origin)
+{
+	Stream* s = reinterpret_cast<Stream*> (stream);
+	if (dcpomatic_fseek (s->file, offset, origin) != 0) {
+		/* libcurl will read and throw away what it wanted to skip */
+		return CURL_SEEKFUNC_CANTSEEK;
+	}
+	if (origin == SEEK_SET) {
+		s->uploader->transferred (offset);
+	}
+	return CURL_SEEKFUNC_OK;
 }
 
 CurlUploader::CurlUploader (function<void (string)> set_status, function<void (float)> set_progress)
 	: Uploader (set_status, set_progress)
-	, _file (0)
-	, _transferred (0)
-	, _total_size (0)
+	, _streams (Config::instance()->upload_streams())
 {
-	_curl = curl_easy_init ();
-	if (!_curl) {
-		throw NetworkError (_("Could not start transfer"));
+	for (vector<Stream>::iterator i = _streams.begin(); i != _streams.end(); ++i) {
+		i->curl = curl_easy_init ();
+		if (!i->curl) {
+			throw NetworkError (_("Could not start transfer"));
+		}
+
+		i->uploader = this;
+
+		curl_easy_setopt (i->curl, CURLOPT_READFUNCTION, &CurlUploader::read_callback);
+		curl_easy_setopt (i->curl, CURLOPT_READDATA, &(*i));
+		curl_easy_setopt (i->curl, CURLOPT_SEEKFUNCTION, &CurlUploader::seek_callback);
+		curl_easy_setopt (i->curl, CURLOPT_SEEKDATA, &(*i));
+		/* Each stream runs in its own thread, where libcurl must not use signals to time out DNS lookups */
+		curl_easy_setopt (i->curl, CURLOPT_NOSIGNAL, 1L);
+		curl_easy_setopt (i->curl, CURLOPT_UPLOAD, 1L);
+		curl_easy_setopt (i->curl, CURLOPT_FTP_CREATE_MISSING_DIRS, 1L);
+		curl_easy_setopt (i->curl, CURLOPT_USERNAME, Config::instance()->tms_user().c_str ());
+		curl_easy_setopt (i->curl, CURLOPT_PASSWORD, Config::instance()->tms_password().c_str ());
+#if LIBCURL_VERSION_NUM >= 0x073e00
+		/* Read and send files in bigger pieces than the default 64KB */
+		curl_easy_setopt (i->curl, CURLOPT_UPLOAD_BUFFERSIZE, 2 * 1024 * 1024L);
+#endif
 	}
-
-	curl_easy_setopt (_curl, CURLOPT_READFUNCTION, ::read_callback);
-	curl_easy_setopt (_curl, CURLOPT_READDATA, this);
-	curl_easy_setopt (_curl, CURLOPT_UPLOAD, 1L);
-	curl_easy_setopt (_curl, CURLOPT_FTP_CREATE_MISSING_DIRS, 1L);
-	curl_easy_setopt (_curl, CURLOPT_READDATA, this);
-	curl_easy_setopt (_curl, CURLOPT_USERNAME, Config::instance()->tms_user().c_str ());
-	curl_easy_setopt (_curl, CURLOPT_PASSWORD, Config::instance()->tms_password().c_str ());
 }
 
 CurlUploader::~CurlUploader ()
 {
-	if (_file) {
-		fclose (_file);
+	for (vector<Stream>::iterator i = _streams.begin(); i != _streams.end(); ++i) {
+		if (i->file) {
+			fclose (i->file);
+		}
+		if (i->curl) {
+			curl_easy_cleanup (i->curl);
+		}
 	}
-	curl_easy_cleanup (_curl);
+}
+
+int
+CurlUploader::streams () const
+{
+	return _streams.size ();
 }
 
 void
@@ -72,40 +109,76 @@ CurlUploader::create_directory (boost::filesystem::path)
 	/* this is done by libcurl */
 }
 
-void
-CurlUploader::upload_file (boost::filesystem::path from, boost::filesystem::path to, boost::uintmax_t& transferred, boost::uintmax_t total_size)
+string
+CurlUploader::url (boost::filesystem::path to) const
 {
-	curl_easy_setopt (
-		_curl, CURLOPT_URL,
-		/* Use generic_string so that we get forward-slashes in the path, even on Windows */
-		String::compose ("ftp://%1/%2/%3", Config::instance()->tms_ip(), Config::instance()->tms_path(), to.generic_string ()).c_str ()
-		);
-
-	_file = fopen_boost (from, "rb");
-	if (!_file) {
-		throw NetworkError (String::compose (_("Could not open %1 to send"), from));
-	}
-	_transferred = &transferred;
-	_total_size = total_size;
+	/* Use generic_string so that we get forward-slashes in the path, even on Windows */
+	return String::compose ("ftp://%1/%2/%3", Config::instance()->tms_ip(), Config::instance()->tms_path(), to.generic_string ());
+}
 
-	CURLcode const r = curl_easy_perform (_curl);
-	if (r != CURLE_OK) {
-		throw NetworkError (String::compose (_("Could not write to remote file (%1)"), curl_easy_strerror (r)));
+Uploader::RemoteFile
+CurlUploader::remote_file (boost::filesystem::path to, int stream)
+{
+	CURL* curl = _streams[stream].curl;
+
+	curl_easy_setopt (curl, CURLOPT_URL, url(to).c_str());
+	curl_easy_setopt (curl, CURLOPT_UPLOAD, 0L);
+	curl_easy_setopt (curl, CURLOPT_NOBODY, 1L);
+	curl_easy_setopt (curl, CURLOPT_FILETIME, 1L);
+	curl_easy_setopt (curl, CURLOPT_RESUME_FROM_LARGE, curl_off_t (0));
+
+	long time = -1;
+#if LIBCURL_VERSION_NUM >= 0x073700
+	curl_off_t size = -1;
+	if (curl_easy_perform (curl) == CURLE_OK) {
+		curl_easy_getinfo (curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &size);
+		curl_easy_getinfo (curl, CURLINFO_FILETIME, &time);
+	}
+#else
+	double size = -1;
+	if (curl_easy_perform (curl) == CURLE_OK) {
+		curl_easy_getinfo (curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &size);
+		curl_easy_getinfo (curl, CURLINFO_FILETIME, &time);
 	}
+#endif
 
-	fclose (_file);
-	_file = 0;
+	curl_easy_setopt (curl, CURLOPT_FILETIME, 0L);
+	curl_easy_setopt (curl, CURLOPT_NOBODY, 0L);
+	curl_easy_setopt (curl, CURLOPT_UPLOAD, 1L);
+
+	RemoteFile remote;
+	if (size > 0) {
+		remote.size = boost::uintmax_t (size);
+	}
+	if (time >= 0) {
+		remote.time = std::time_t (time);
+	}
+	return remote;
 }
 
-size_t
-CurlUploader::read_callback (void* ptr, size_t size, size_t nmemb)
+void
+CurlUploader::upload_file (boost::filesystem::path from, boost::filesystem::path to, boost::uintmax_t offset, int stream)
 {
-	size_t const r = fread (ptr, size, nmemb, _file);
-	*_transferred += size * nmemb;
+	Stream& s = _streams[stream];
+
+	curl_easy_setopt (s.curl, CURLOPT_URL, url(to).c_str());
 
-	if (_total_size > 0) {
-		_set_progress ((double) *_transferred / _total_size);
+	s.file = fopen_boost (from, "rb");
+	if (!s.file) {
+		throw NetworkError (String::compose (_("Could not open %1 to send"), from));
 	}
 
-	return r;
+	/* If we are carrying on from where a previous upload stopped libcurl will skip this much of
+	   the file (using seek_callback) and add the rest to the end of what is there.
+	*/
+	curl_easy_setopt (s.curl, CURLOPT_RESUME_FROM_LARGE, curl_off_t (offset));
+
+	CURLcode const r = curl_easy_perform (s.curl);
+
+	fclose (s.file);
+	s.file = 0;
+
+	if (r != CURLE_OK) {
+		throw NetworkError (String::compose (_("Could not write to remote file (%1)"), curl_easy_strerror (r)));
+	}
 }
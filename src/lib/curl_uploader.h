@@ -20,6 +20,7 @@
 
 #include "uploader.h"
 #include <curl/curl.h>
+#include <vector>
 
 class CurlUploader : public Uploader
 {
@@ -27,16 +28,32 @@ public:
 	CurlUploader (boost::function<void (std::string)> set_status, boost::function<void (float)> set_progress);
 	~CurlUploader ();
 
-	size_t read_callback (void* ptr, size_t size, size_t nmemb);
-
 protected:
+	virtual int streams () const;
 	virtual void create_directory (boost::filesystem::path directory);
-	virtual void upload_file (boost::filesystem::path from, boost::filesystem::path to, boost::uintmax_t& transferred, boost::uintmax_t total_size);
+	virtual RemoteFile remote_file (boost::filesystem::path to, int stream);
+	virtual void upload_file (boost::filesystem::path from, boost::filesystem::path to, boost::uintmax_t offset, int stream);
+	/** @return URL to send a file to, given its path relative to the target directory */
+	virtual std::string url (boost::filesystem::path to) const;
 
 private:
-	CURL* _curl;
-
-	FILE* _file;
-	boost::uintmax_t* _transferred;
-	boost::uintmax_t _total_size;
+	/** A connection to the server */
+	struct Stream
+	{
+		Stream ()
+			: curl (0)
+			, file (0)
+			, uploader (0)
+		{}
+
+		CURL* curl;
+		/** File that is being sent, or 0 */
+		FILE* file;
+		CurlUploader* uploader;
+	};
+
+	static size_t read_callback (void* ptr, size_t size, size_t nmemb, void* stream);
+	static int seek_callback (void* stream, curl_off_t offset, int origin);
+
+	std::vector<Stream> _streams;
 };
@@ -139,11 +139,14 @@ DCPDecoder::pass ()
 				_offset + frame
 				);
 		} else {
+			/* Read the frame once and use it for both eyes */
+			shared_ptr<const dcp::StereoPictureFrame> stereo_frame = _stereo_reader->get_frame (entry_point + frame);
+
 			video->emit (
 				film(),
 				shared_ptr<ImageProxy> (
 					new J2KImageProxy (
-						_stereo_reader->get_frame (entry_point + frame),
+						stereo_frame,
 						picture_asset->size(),
 						dcp::EYE_LEFT,
 						AV_PIX_FMT_XYZ12LE,
@@ -157,7 +160,7 @@ DCPDecoder::pass ()
 				film(),
 				shared_ptr<ImageProxy> (
 					new J2KImageProxy (
-						_stereo_reader->get_frame (entry_point + frame),
+						stereo_frame,
 						picture_asset->size(),
 						dcp::EYE_RIGHT,
 						AV_PIX_FMT_XYZ12LE,
@@ -53,6 +53,7 @@ public:
 	}
 
 	Eyes eyes () const;
+	size_t memory_used () const;
 
 	bool same (boost::shared_ptr<const DCPVideo> other) const;
 
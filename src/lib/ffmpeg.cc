@@ -29,6 +29,7 @@
 #include "ffmpeg_audio_stream.h"
 #include "digester.h"
 #include "compose.hpp"
+#include "config.h"
 #include <dcp/raw_convert.h>
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -54,7 +55,7 @@ boost::mutex FFmpeg::_mutex;
 FFmpeg::FFmpeg (boost::shared_ptr<const FFmpegContent> c)
 	: _ffmpeg_content (c)
 	, _avio_buffer (0)
-	, _avio_buffer_size (4096)
+	, _avio_buffer_size (65536)
 	, _avio_context (0)
 	, _format_context (0)
 	, _frame (0)
@@ -110,6 +111,8 @@ FFmpeg::setup_general ()
 	*/
 	av_log_set_callback (FFmpeg::ffmpeg_log_callback);
 
+	_file_group.set_mmap (Config::instance()->memory_map_content ());
+	_file_group.set_readahead (Config::instance()->content_readahead() * 1024 * 1024);
 	_file_group.set_paths (_ffmpeg_content->paths ());
 	_avio_buffer = static_cast<uint8_t*> (wrapped_av_malloc (_avio_buffer_size));
 	_avio_context = avio_alloc_context (_avio_buffer, _avio_buffer_size, 0, this, avio_read_wrapper, 0, avio_seek_wrapper);
@@ -263,9 +263,20 @@ FFmpegContent::examine (shared_ptr<const Film> film, shared_ptr<Job> job)
 
 	job->set_progress_unknown ();
 
+	string const old_digest = digest ();
+
 	Content::examine (film, job);
 
-	shared_ptr<FFmpegExaminer> examiner (new FFmpegExaminer (shared_from_this (), job));
+	optional<boost::filesystem::path> index;
+	if (film) {
+		index = film->ffmpeg_index_path (shared_from_this ());
+		if (digest() != old_digest) {
+			/* Our content has changed, so any index of what it was before is no use */
+			film->remove_ffmpeg_index (old_digest);
+		}
+	}
+
+	shared_ptr<FFmpegExaminer> examiner (new FFmpegExaminer (shared_from_this (), job, index));
 
 	if (examiner->has_video ()) {
 		video.reset (new VideoContent (this));
@@ -32,9 +32,9 @@
 #include "text_decoder.h"
 #include "ffmpeg_audio_stream.h"
 #include "ffmpeg_subtitle_stream.h"
-#include "video_filter_graph.h"
 #include "audio_buffers.h"
 #include "ffmpeg_content.h"
+#include "ffmpeg_index.h"
 #include "raw_image_proxy.h"
 #include "video_decoder.h"
 #include "film.h"
@@ -86,6 +86,8 @@ FFmpegDecoder::FFmpegDecoder (shared_ptr<const Film> film, shared_ptr<const FFmp
 		/* It doesn't matter what size or pixel format this is, it just needs to be black */
 		_black_image.reset (new Image (AV_PIX_FMT_RGB24, dcp::Size (128, 128), true));
 		_black_image->make_black ();
+		dcp::Fraction vfr (lrint(c->video_frame_rate().get() * 1000), 1000);
+		_filter_queue.reset (new VideoFilterQueue (c->filters(), vfr));
 	} else {
 		_pts_offset = ContentTime ();
 	}
@@ -100,6 +102,16 @@ FFmpegDecoder::FFmpegDecoder (shared_ptr<const Film> film, shared_ptr<const FFmp
 	}
 
 	_next_time.resize (_format_context->nb_streams);
+
+	optional<boost::filesystem::path> index = film->ffmpeg_index_path (c);
+	if (index && boost::filesystem::exists (*index)) {
+		try {
+			_index = FFmpegIndex::get (*index);
+			_index->add_to (_format_context);
+		} catch (FileError& e) {
+			LOG_WARNING ("Could not read FFmpeg index %1 (%2)", index->string(), e.what());
+		}
+	}
 }
 
 void
@@ -114,6 +126,11 @@ FFmpegDecoder::flush ()
 
 	while (video && decode_video_packet()) {}
 
+	if (video) {
+		/* Wait for the filters to finish with anything that they still have */
+		emit_video (_filter_queue->get(true));
+	}
+
 	if (audio) {
 		decode_audio_packet ();
 	}
@@ -370,19 +387,21 @@ FFmpegDecoder::seek (ContentTime time, bool accurate)
 	if (u < ContentTime ()) {
 		u = ContentTime ();
 	}
-	av_seek_frame (
-		_format_context,
-		stream.get(),
-		u.seconds() / av_q2d (_format_context->streams[stream.get()]->time_base),
-		AVSEEK_FLAG_BACKWARD
-		);
 
-	{
-		/* Force re-creation of filter graphs to reset them and hence to make sure
-		   they don't have any pre-seek frames knocking about.
-		*/
-		boost::mutex::scoped_lock lm (_filter_graphs_mutex);
-		_filter_graphs.clear ();
+	int64_t target = u.seconds() / av_q2d (_format_context->streams[stream.get()]->time_base);
+	if (_index) {
+		/* Seek exactly to the keyframe that we will have to decode from, if the index reaches that far */
+		optional<int64_t> key = _index->keyframe_before (stream.get(), target);
+		if (key) {
+			target = *key;
+		}
+	}
+
+	av_seek_frame (_format_context, stream.get(), target, AVSEEK_FLAG_BACKWARD);
+
+	if (_filter_queue) {
+		/* Reset the filters to make sure they don't have any pre-seek frames knocking about */
+		_filter_queue->clear ();
 	}
 
 	if (video_codec_context ()) {
@@ -503,28 +522,19 @@ FFmpegDecoder::decode_video_packet ()
 		return false;
 	}
 
-	boost::mutex::scoped_lock lm (_filter_graphs_mutex);
-
-	shared_ptr<VideoFilterGraph> graph;
-
-	list<shared_ptr<VideoFilterGraph> >::iterator i = _filter_graphs.begin();
-	while (i != _filter_graphs.end() && !(*i)->can_process (dcp::Size (_frame->width, _frame->height), (AVPixelFormat) _frame->format)) {
-		++i;
-	}
-
-	if (i == _filter_graphs.end ()) {
-		dcp::Fraction vfr (lrint(_ffmpeg_content->video_frame_rate().get() * 1000), 1000);
-		graph.reset (new VideoFilterGraph (dcp::Size (_frame->width, _frame->height), (AVPixelFormat) _frame->format, vfr));
-		graph->setup (_ffmpeg_content->filters ());
-		_filter_graphs.push_back (graph);
-		LOG_GENERAL (N_("New graph for %1x%2, pixel format %3"), _frame->width, _frame->height, _frame->format);
-	} else {
-		graph = *i;
-	}
+	/* The filters may run in another thread, so this frame may not come out straight away;
+	   emit whatever has been filtered so far.
+	*/
+	_filter_queue->put (_frame);
+	emit_video (_filter_queue->get(false));
 
-	list<pair<shared_ptr<Image>, int64_t> > images = graph->process (_frame);
+	return true;
+}
 
-	for (list<pair<shared_ptr<Image>, int64_t> >::iterator i = images.begin(); i != images.end(); ++i) {
+void
+FFmpegDecoder::emit_video (VideoFilterQueue::Images images)
+{
+	for (VideoFilterQueue::Images::iterator i = images.begin(); i != images.end(); ++i) {
 
 		shared_ptr<Image> image = i->first;
 
@@ -540,8 +550,6 @@ FFmpegDecoder::decode_video_packet ()
 			LOG_WARNING_NC ("Dropping frame without PTS");
 		}
 	}
-
-	return true;
 }
 
 void
@@ -25,6 +25,7 @@
 #include "util.h"
 #include "decoder.h"
 #include "ffmpeg.h"
+#include "video_filter_queue.h"
 extern "C" {
 #include <libavcodec/avcodec.h>
 }
@@ -33,10 +34,10 @@ extern "C" {
 #include <stdint.h>
 
 class Log;
-class VideoFilterGraph;
 class FFmpegAudioStream;
 class AudioBuffers;
 class Image;
+class FFmpegIndex;
 struct ffmpeg_pts_offset_test;
 
 /** @class FFmpegDecoder
@@ -59,6 +60,7 @@ private:
 	int bytes_per_audio_sample (boost::shared_ptr<FFmpegAudioStream> stream) const;
 
 	bool decode_video_packet ();
+	void emit_video (VideoFilterQueue::Images images);
 	void decode_audio_packet ();
 	void decode_subtitle_packet ();
 
@@ -68,8 +70,8 @@ private:
 	void maybe_add_subtitle ();
 	boost::shared_ptr<AudioBuffers> deinterleave_audio (boost::shared_ptr<FFmpegAudioStream> stream) const;
 
-	std::list<boost::shared_ptr<VideoFilterGraph> > _filter_graphs;
-	boost::mutex _filter_graphs_mutex;
+	/** Runs our content's filters over decoded video; only set up if we have video */
+	boost::shared_ptr<VideoFilterQueue> _filter_queue;
 
 	ContentTime _pts_offset;
 	boost::optional<ContentTime> _current_subtitle_to;
@@ -79,4 +81,7 @@ private:
 	boost::shared_ptr<Image> _black_image;
 
 	std::vector<boost::optional<ContentTime> > _next_time;
+
+	/** Index made when our content was examined, if there is one */
+	boost::shared_ptr<const FFmpegIndex> _index;
 };
@@ -27,7 +27,14 @@
 #include "image.h"
 #include "cross.h"
 #include "butler.h"
+#include "config.h"
+#include "exceptions.h"
+#include "audio_buffers.h"
 #include "compose.hpp"
+#include <boost/foreach.hpp>
+#include <cerrno>
+#include <cstring>
+#include <new>
 #include <iostream>
 
 #include "i18n.h"
@@ -38,6 +45,8 @@ using std::cout;
 using std::pair;
 using std::list;
 using std::map;
+using std::min;
+using std::max;
 using boost::shared_ptr;
 using boost::bind;
 using boost::weak_ptr;
@@ -52,10 +61,22 @@ FFmpegEncoder::FFmpegEncoder (
 	int x264_crf
 	)
 	: Encoder (film, job)
+	, _format (format)
+	, _x264_crf (x264_crf)
+	, _output (output)
+	, _frames_done (0)
 	, _history (1000)
 {
 	int const files = split_reels ? film->reels().size() : 1;
-	for (int i = 0; i < files; ++i) {
+
+	int segments = 1;
+	if (files == 1 && !_film->three_d()) {
+		/* Parts shorter than a minute or so aren't worth the cost of the seek and the join */
+		segments = max (1, min (Config::instance()->export_segments(), int (_film->length().seconds() / 60)));
+	}
+
+	/* If we are encoding in segments the output file is made by join_segments() */
+	for (int i = 0; segments == 1 && i < files; ++i) {
 
 		boost::filesystem::path filename = output;
 		string extension = boost::filesystem::extension (filename);
@@ -75,6 +96,7 @@ FFmpegEncoder::FFmpegEncoder (
 				mixdown_to_stereo ? 2 : film->audio_channels(),
 				format,
 				x264_crf,
+				Config::instance()->export_threads(),
 				_film->three_d(),
 				filename,
 				extension
@@ -107,7 +129,28 @@ FFmpegEncoder::FFmpegEncoder (
 		}
 	}
 
-	_butler.reset (new Butler(_player, map, _output_audio_channels, bind(&PlayerVideo::force, _1, FFmpegFileEncoder::pixel_format(format)), true, false));
+	_audio_mapping = map;
+
+	if (segments > 1) {
+		Frame const length = _film->length().frames_round (_film->video_frame_rate ());
+		Frame const per_segment = (length + segments - 1) / segments;
+		string const extension = boost::filesystem::extension (output);
+		boost::filesystem::path const stem = boost::filesystem::change_extension (output, "");
+		for (int i = 0; i < segments; ++i) {
+			_segments.push_back (
+				Segment (
+					DCPTimePeriod (
+						DCPTime::from_frames (i * per_segment, _film->video_frame_rate ()),
+						DCPTime::from_frames (min (length, (i + 1) * per_segment), _film->video_frame_rate ())
+						),
+					String::compose ("%1.part%2%3", stem.string(), i + 1, extension),
+					String::compose ("%1.part%2.audio", stem.string(), i + 1)
+					)
+				);
+		}
+	} else {
+		_butler.reset (new Butler(_player, map, _output_audio_channels, bind(&PlayerVideo::force, _1, FFmpegFileEncoder::pixel_format(format)), true, false, MemoryBudget::BUTLER));
+	}
 }
 
 void
@@ -119,14 +162,18 @@ FFmpegEncoder::go ()
 		job->sub (_("Encoding"));
 	}
 
+	if (!_segments.empty ()) {
+		go_in_segments ();
+		return;
+	}
+
 	list<DCPTimePeriod> reel_periods = _film->reels ();
 	list<DCPTimePeriod>::const_iterator reel = reel_periods.begin ();
 	list<FileEncoderSet>::iterator encoder = _file_encoders.begin ();
 
 	DCPTime const video_frame = DCPTime::from_frames (1, _film->video_frame_rate ());
 	int const audio_frames = video_frame.frames_round(_film->audio_frame_rate());
-	float* interleaved = new float[_output_audio_channels * audio_frames];
-	shared_ptr<AudioBuffers> deinterleaved (new AudioBuffers (_output_audio_channels, audio_frames));
+	shared_ptr<AudioBuffers> audio (new AudioBuffers (_output_audio_channels, audio_frames));
 	int const gets_per_frame = _film->three_d() ? 2 : 1;
 	for (DCPTime i; i < _film->length(); i += video_frame) {
 
@@ -147,7 +194,7 @@ FFmpegEncoder::go ()
 
 		{
 			boost::mutex::scoped_lock lm (_mutex);
-			_last_time = i;
+			_frames_done = i.frames_round (_film->video_frame_rate ());
 		}
 
 		shared_ptr<Job> job = _job.lock ();
@@ -155,17 +202,9 @@ FFmpegEncoder::go ()
 			job->set_progress (float(i.get()) / _film->length().get());
 		}
 
-		_butler->get_audio (interleaved, audio_frames);
-		/* XXX: inefficient; butler interleaves and we deinterleave again */
-		float* p = interleaved;
-		for (int j = 0; j < audio_frames; ++j) {
-			for (int k = 0; k < _output_audio_channels; ++k) {
-				deinterleaved->data(k)[j] = *p++;
-			}
-		}
-		encoder->audio (deinterleaved);
+		_butler->get_audio (audio);
+		encoder->audio (audio);
 	}
-	delete[] interleaved;
 
 	BOOST_FOREACH (FileEncoderSet i, _file_encoders) {
 		i.flush ();
@@ -182,7 +221,282 @@ Frame
 FFmpegEncoder::frames_done () const
 {
 	boost::mutex::scoped_lock lm (_mutex);
-	return _last_time.frames_round (_film->video_frame_rate ());
+	return _frames_done;
+}
+
+/** Encode each of our segments to its own file using a thread per segment, then
+ *  join the results into the output file.
+ */
+void
+FFmpegEncoder::go_in_segments ()
+{
+	int threads = Config::instance()->export_threads ();
+	if (threads == 0) {
+		/* Share the machine between the encoders */
+		threads = max (1, int (boost::thread::hardware_concurrency ()) / int (_segments.size ()));
+	}
+
+	try {
+		boost::thread_group pool;
+		for (size_t i = 0; i < _segments.size(); ++i) {
+			/* The first segment can use our Player; the others need their own */
+			shared_ptr<Player> player = _player;
+			if (i > 0) {
+				player.reset (new Player (_film, _film->playlist ()));
+				player->set_always_burn_open_subtitles ();
+				player->set_play_referenced ();
+			}
+			pool.create_thread (boost::bind (&FFmpegEncoder::encode_segment, this, _segments[i], player, threads));
+		}
+
+		try {
+			pool.join_all ();
+		} catch (boost::thread_interrupted &) {
+			/* This job has been cancelled */
+			pool.interrupt_all ();
+			pool.join_all ();
+			throw;
+		}
+
+		if (_segment_error) {
+			boost::rethrow_exception (_segment_error);
+		}
+
+		join_segments ();
+	} catch (...) {
+		BOOST_FOREACH (Segment const & i, _segments) {
+			boost::system::error_code ec;
+			boost::filesystem::remove (i.video, ec);
+			boost::filesystem::remove (i.audio, ec);
+		}
+		throw;
+	}
+
+	BOOST_FOREACH (Segment const & i, _segments) {
+		boost::system::error_code ec;
+		boost::filesystem::remove (i.video, ec);
+		boost::filesystem::remove (i.audio, ec);
+	}
+}
+
+/** Encode one segment; this is run in a thread for each segment, each with its own Player.
+ *  The video is encoded to segment.video with no audio, and the audio is written
+ *  to segment.audio as it comes from the butler (a frame's worth of each channel in
+ *  turn), so that join_segments() can encode
+ *  it all in one go without any joins.
+ */
+void
+FFmpegEncoder::encode_segment (Segment const & segment, shared_ptr<Player> player, int threads)
+{
+	try {
+		player->seek (segment.period.from, true);
+
+		Butler butler (player, _audio_mapping, _output_audio_channels, bind(&PlayerVideo::force, _1, FFmpegFileEncoder::pixel_format(_format)), true, false, MemoryBudget::BUTLER);
+
+		FFmpegFileEncoder encoder (
+			_film->frame_size(), _film->video_frame_rate(), _film->audio_frame_rate(), 0, _format, _x264_crf, threads, segment.video
+			);
+
+		FILE* audio = fopen_boost (segment.audio, "wb");
+		if (!audio) {
+			throw OpenFileError (segment.audio, errno, OpenFileError::WRITE);
+		}
+
+		DCPTime const video_frame = DCPTime::from_frames (1, _film->video_frame_rate ());
+		int const audio_frames = video_frame.frames_round(_film->audio_frame_rate());
+		shared_ptr<AudioBuffers> audio_buffers (new AudioBuffers (_output_audio_channels, audio_frames));
+
+		try {
+			for (DCPTime i = segment.period.from; i < segment.period.to; i += video_frame) {
+				pair<shared_ptr<PlayerVideo>, DCPTime> v = butler.get_video ();
+				/* Each segment's file starts at zero; join_segments() puts it in the right place */
+				encoder.video (v.first, v.second - segment.period.from);
+				butler.get_audio (audio_buffers);
+				for (int j = 0; j < _output_audio_channels; ++j) {
+					checked_fwrite (audio_buffers->data(j), audio_frames * sizeof(float), audio, segment.audio);
+				}
+				frame_done ();
+			}
+		} catch (...) {
+			fclose (audio);
+			throw;
+		}
+
+		fclose (audio);
+		encoder.flush ();
+	} catch (boost::thread_interrupted &) {
+		return;
+	} catch (...) {
+		boost::mutex::scoped_lock lm (_mutex);
+		if (!_segment_error) {
+			_segment_error = boost::current_exception ();
+		}
+	}
+}
+
+/** Called by a segment thread when it has encoded a frame */
+void
+FFmpegEncoder::frame_done ()
+{
+	_history.event ();
+
+	Frame done;
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		if (_segment_error) {
+			/* Another segment has failed, so there is no point in carrying on */
+			throw boost::thread_interrupted ();
+		}
+		done = ++_frames_done;
+	}
+
+	shared_ptr<Job> job = _job.lock ();
+	if (job) {
+		job->set_progress (float(done) / _film->length().frames_round(_film->video_frame_rate()));
+	}
+}
+
+/** Read one video frame's worth of audio from a segment's audio file.
+ *  @return false if there was nothing left to read.
+ */
+static bool
+read_segment_audio (FILE* file, shared_ptr<AudioBuffers> audio)
+{
+	for (int i = 0; i < audio->channels(); ++i) {
+		if (fread (audio->data(i), sizeof(float), audio->frames(), file) != size_t (audio->frames())) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/** @return true if packets from a stream with parameters b can be written to a stream set up with a */
+static bool
+same_video_parameters (AVCodecParameters const * a, AVCodecParameters const * b)
+{
+	return a->codec_id == b->codec_id && a->format == b->format && a->width == b->width && a->height == b->height &&
+		a->extradata_size == b->extradata_size &&
+		(a->extradata_size == 0 || memcmp (a->extradata, b->extradata, a->extradata_size) == 0);
+}
+
+/** @class SegmentReader
+ *  @brief An encoded segment file opened for reading, which is closed when this object is destroyed.
+ */
+class SegmentReader : public boost::noncopyable
+{
+public:
+	explicit SegmentReader (boost::filesystem::path file)
+		: _io (0)
+		, _context (0)
+	{
+		if (avio_open_boost (&_io, file, AVIO_FLAG_READ) < 0) {
+			throw OpenFileError (file, 0, OpenFileError::READ);
+		}
+
+		_context = avformat_alloc_context ();
+		if (!_context) {
+			avio_close (_io);
+			throw std::bad_alloc ();
+		}
+
+		_context->pb = _io;
+		/* This frees _context if it fails */
+		if (avformat_open_input (&_context, 0, 0, 0) < 0 || _context->nb_streams < 1) {
+			if (_context) {
+				avformat_close_input (&_context);
+			}
+			avio_close (_io);
+			throw DecodeError (String::compose ("could not open FFmpeg segment file %1", file.string()));
+		}
+	}
+
+	~SegmentReader ()
+	{
+		/* avformat_close_input does not close a pb which we opened ourselves */
+		avformat_close_input (&_context);
+		avio_close (_io);
+	}
+
+	AVFormatContext* context () const {
+		return _context;
+	}
+
+	AVStream const * video () const {
+		return _context->streams[0];
+	}
+
+private:
+	AVIOContext* _io;
+	AVFormatContext* _context;
+};
+
+/** Copy the encoded video from each segment into the output file, and encode
+ *  the audio alongside it.
+ */
+void
+FFmpegEncoder::join_segments ()
+{
+	shared_ptr<Job> job = _job.lock ();
+	if (job) {
+		job->sub (_("Joining"));
+	}
+
+	/* Made when we open the first segment, so that its video stream can be set up to match */
+	shared_ptr<FFmpegFileEncoder> encoder;
+
+	DCPTime const video_frame = DCPTime::from_frames (1, _film->video_frame_rate ());
+	int const audio_frames = video_frame.frames_round(_film->audio_frame_rate());
+	shared_ptr<AudioBuffers> audio_buffers (new AudioBuffers (_output_audio_channels, audio_frames));
+
+	for (size_t i = 0; i < _segments.size(); ++i) {
+		Segment const & segment = _segments[i];
+
+		SegmentReader input (segment.video);
+
+		if (!encoder) {
+			encoder.reset (
+				new FFmpegFileEncoder (
+					input.video(), _film->video_frame_rate(), _film->audio_frame_rate(), _output_audio_channels, _format, _output
+					)
+				);
+		} else if (!same_video_parameters (encoder->video_parameters(), input.video()->codecpar)) {
+			throw EncodeError (String::compose ("exported segment %1 was not encoded in the same way as the first", i + 1));
+		}
+
+		FILE* audio_file = fopen_boost (segment.audio, "rb");
+		if (!audio_file) {
+			throw OpenFileError (segment.audio, errno, OpenFileError::READ);
+		}
+		shared_ptr<FILE> audio (audio_file, &fclose);
+
+		AVPacket packet;
+		while (av_read_frame (input.context(), &packet) >= 0) {
+			if (packet.stream_index == 0) {
+				/* Give the encoder the audio for this frame as we go so that it can interleave it with the video */
+				if (read_segment_audio (audio.get(), audio_buffers)) {
+					encoder->audio (audio_buffers);
+				}
+				try {
+					encoder->video_packet (&packet, input.video()->time_base, segment.period.from);
+				} catch (...) {
+					av_packet_unref (&packet);
+					throw;
+				}
+			}
+			av_packet_unref (&packet);
+		}
+
+		while (read_segment_audio (audio.get(), audio_buffers)) {
+			encoder->audio (audio_buffers);
+		}
+
+		if (job) {
+			job->set_progress (float(i + 1) / _segments.size());
+		}
+	}
+
+	encoder->flush ();
 }
 
 FFmpegEncoder::FileEncoderSet::FileEncoderSet (
@@ -192,6 +506,7 @@ FFmpegEncoder::FileEncoderSet::FileEncoderSet (
 	int channels,
 	ExportFormat format,
 	int x264_crf,
+	int threads,
 	bool three_d,
 	boost::filesystem::path output,
 	string extension
@@ -200,15 +515,15 @@ FFmpegEncoder::FileEncoderSet::FileEncoderSet (
 	if (three_d) {
 		/// TRANSLATORS: L here is an abbreviation for "left", to indicate the left-eye part of a 3D export
 		_encoders[EYES_LEFT] = shared_ptr<FFmpegFileEncoder>(
-			new FFmpegFileEncoder(video_frame_size, video_frame_rate, audio_frame_rate, channels, format, x264_crf, String::compose("%1_%2%3", output.string(), _("L"), extension))
+			new FFmpegFileEncoder(video_frame_size, video_frame_rate, audio_frame_rate, channels, format, x264_crf, threads, String::compose("%1_%2%3", output.string(), _("L"), extension))
 			);
 		/// TRANSLATORS: R here is an abbreviation for "left", to indicate the left-eye part of a 3D export
 		_encoders[EYES_RIGHT] = shared_ptr<FFmpegFileEncoder>(
-			new FFmpegFileEncoder(video_frame_size, video_frame_rate, audio_frame_rate, channels, format, x264_crf, String::compose("%1_%2%3", output.string(), _("R"), extension))
+			new FFmpegFileEncoder(video_frame_size, video_frame_rate, audio_frame_rate, channels, format, x264_crf, threads, String::compose("%1_%2%3", output.string(), _("R"), extension))
 			);
 	} else {
 		_encoders[EYES_BOTH]  = shared_ptr<FFmpegFileEncoder>(
-			new FFmpegFileEncoder(video_frame_size, video_frame_rate, audio_frame_rate, channels, format, x264_crf, String::compose("%1%2", output.string(), extension))
+			new FFmpegFileEncoder(video_frame_size, video_frame_rate, audio_frame_rate, channels, format, x264_crf, threads, String::compose("%1%2", output.string(), extension))
 			);
 	}
 }
@@ -25,8 +25,11 @@
 #include "event_history.h"
 #include "audio_mapping.h"
 #include "ffmpeg_file_encoder.h"
+#include <boost/exception/all.hpp>
+#include <vector>
 
 class Butler;
+class Player;
 
 class FFmpegEncoder : public Encoder
 {
@@ -51,6 +54,27 @@ public:
 
 private:
 
+	/** Part of the film which is encoded on its own, in parallel with others */
+	struct Segment
+	{
+		Segment (DCPTimePeriod period_, boost::filesystem::path video_, boost::filesystem::path audio_)
+			: period (period_)
+			, video (video_)
+			, audio (audio_)
+		{}
+
+		DCPTimePeriod period;
+		/** File of encoded video */
+		boost::filesystem::path video;
+		/** File of float audio samples; a video frame's worth of each channel in turn */
+		boost::filesystem::path audio;
+	};
+
+	void go_in_segments ();
+	void encode_segment (Segment const & segment, boost::shared_ptr<Player> player, int threads);
+	void join_segments ();
+	void frame_done ();
+
 	class FileEncoderSet
 	{
 	public:
@@ -61,6 +85,7 @@ private:
 			int channels,
 			ExportFormat,
 			int x264_crf,
+			int threads,
 			bool three_d,
 			boost::filesystem::path output,
 			std::string extension
@@ -74,11 +99,23 @@ private:
 		std::map<Eyes, boost::shared_ptr<FFmpegFileEncoder> > _encoders;
 	};
 
+	/** Encoders for each output file, or empty if we are encoding in segments */
 	std::list<FileEncoderSet> _file_encoders;
 	int _output_audio_channels;
+	AudioMapping _audio_mapping;
+	ExportFormat _format;
+	int _x264_crf;
+	/** Output file, which is written by join_segments() if we encode in segments */
+	boost::filesystem::path _output;
+
+	/** Segments to encode in parallel, or empty to encode the whole film in order */
+	std::vector<Segment> _segments;
 
+	/** Mutex for _frames_done and _segment_error */
 	mutable boost::mutex _mutex;
-	DCPTime _last_time;
+	Frame _frames_done;
+	/** First error thrown by a thread encoding a segment */
+	boost::exception_ptr _segment_error;
 
 	EventHistory _history;
 
@@ -31,6 +31,9 @@ extern "C" {
 #include "job.h"
 #include "ffmpeg_audio_stream.h"
 #include "ffmpeg_subtitle_stream.h"
+#include "ffmpeg_index.h"
+#include "exceptions.h"
+#include "dcpomatic_log.h"
 #include "util.h"
 #include <boost/foreach.hpp>
 #include <iostream>
@@ -43,8 +46,11 @@ using std::max;
 using boost::shared_ptr;
 using boost::optional;
 
-/** @param job job that the examiner is operating in, or 0 */
-FFmpegExaminer::FFmpegExaminer (shared_ptr<const FFmpegContent> c, shared_ptr<Job> job)
+/** @param job job that the examiner is operating in, or 0.
+ *  @param index Path to an FFmpegIndex for the content.  If it exists it will be used to
+ *  avoid reading the whole content to find its length, otherwise it will be written.
+ */
+FFmpegExaminer::FFmpegExaminer (shared_ptr<const FFmpegContent> c, shared_ptr<Job> job, optional<boost::filesystem::path> index)
 	: FFmpeg (c)
 	, _video_length (0)
 	, _need_video_length (false)
@@ -85,11 +91,30 @@ FFmpegExaminer::FFmpegExaminer (shared_ptr<const FFmpegContent> c, shared_ptr<Jo
 		}
 	}
 
+	shared_ptr<const FFmpegIndex> existing_index;
+	if (index && boost::filesystem::exists (*index)) {
+		try {
+			existing_index = FFmpegIndex::get (*index);
+		} catch (FileError& e) {
+			LOG_WARNING ("Could not read FFmpeg index %1 (%2)", index->string(), e.what());
+		}
+	}
+
+	/* Index that we will build as we read the content, if there isn't one already */
+	shared_ptr<FFmpegIndex> new_index;
+	if (index && !existing_index) {
+		new_index.reset (new FFmpegIndex ());
+	}
+
 	if (has_video ()) {
 		/* See if the header has duration information in it */
 		_need_video_length = _format_context->duration == AV_NOPTS_VALUE;
 		if (!_need_video_length) {
 			_video_length = llrint ((double (_format_context->duration) / AV_TIME_BASE) * video_frame_rate().get());
+		} else if (existing_index && existing_index->complete() && existing_index->video_length()) {
+			/* We already ran through the whole content last time it was examined */
+			_video_length = *existing_index->video_length ();
+			_need_video_length = false;
 		}
 	}
 
@@ -102,10 +127,14 @@ FFmpegExaminer::FFmpegExaminer (shared_ptr<const FFmpegContent> c, shared_ptr<Jo
 	 *   - the first audio for each stream.
 	 */
 
+	/* true if we read every packet in the content */
+	bool reached_end = false;
 	int64_t const len = _file_group.length ();
 	while (true) {
 		int r = av_read_frame (_format_context, &_packet);
 		if (r < 0) {
+			/* Any other error means that we have not seen every packet */
+			reached_end = r == AVERROR_EOF;
 			break;
 		}
 
@@ -117,6 +146,11 @@ FFmpegExaminer::FFmpegExaminer (shared_ptr<const FFmpegContent> c, shared_ptr<Jo
 			}
 		}
 
+		if (new_index && _packet.pts != AV_NOPTS_VALUE) {
+			/* Only PTS go into the index, as that is what we seek with; packets without one are left out */
+			new_index->add (_packet.stream_index, _packet.pts, _packet.pos, _packet.flags & AV_PKT_FLAG_KEY);
+		}
+
 		AVCodecContext* context = _format_context->streams[_packet.stream_index]->codec;
 
 		if (_video_stream && _packet.stream_index == _video_stream.get()) {
@@ -142,6 +176,24 @@ FFmpegExaminer::FFmpegExaminer (shared_ptr<const FFmpegContent> c, shared_ptr<Jo
 		}
 	}
 
+	if (new_index) {
+		/* If we stopped early the index only covers the start of the content, and
+		   it will say so; we only know the video length if we got to the end.
+		*/
+		if (reached_end) {
+			new_index->set_video_length (_video_length);
+			new_index->set_complete ();
+		}
+
+		if (!new_index->empty ()) {
+			try {
+				new_index->write (*index);
+			} catch (std::exception& e) {
+				LOG_WARNING ("Could not write FFmpeg index %1 (%2)", index->string(), e.what());
+			}
+		}
+	}
+
 	if (_video_stream) {
 		/* This code taken from get_rotation() in ffmpeg:cmdutils.c */
 		AVStream* stream = _format_context->streams[*_video_stream];
@@ -31,7 +31,11 @@ class Job;
 class FFmpegExaminer : public FFmpeg, public VideoExaminer
 {
 public:
-	FFmpegExaminer (boost::shared_ptr<const FFmpegContent>, boost::shared_ptr<Job> job = boost::shared_ptr<Job> ());
+	FFmpegExaminer (
+		boost::shared_ptr<const FFmpegContent>,
+		boost::shared_ptr<Job> job = boost::shared_ptr<Job> (),
+		boost::optional<boost::filesystem::path> index = boost::optional<boost::filesystem::path> ()
+		);
 
 	bool has_video () const;
 
@@ -35,6 +35,7 @@ using std::string;
 using std::runtime_error;
 using std::cout;
 using std::pair;
+using std::min;
 using boost::shared_ptr;
 using boost::bind;
 using boost::weak_ptr;
@@ -42,6 +43,9 @@ using boost::weak_ptr;
 int FFmpegFileEncoder::_video_stream_index = 0;
 int FFmpegFileEncoder::_audio_stream_index = 1;
 
+/** @param channels Number of audio channels, or 0 to write a file with no audio.
+ *  @param threads Number of threads for the video encoder to use, or 0 to let it decide.
+ */
 FFmpegFileEncoder::FFmpegFileEncoder (
 	dcp::Size video_frame_size,
 	int video_frame_rate,
@@ -49,14 +53,82 @@ FFmpegFileEncoder::FFmpegFileEncoder (
 	int channels,
 	ExportFormat format,
 	int x264_crf,
+	int threads,
 	boost::filesystem::path output
 	)
-	: _video_options (0)
+	: _video_codec (0)
+	, _video_codec_context (0)
+	, _audio_codec (0)
+	, _audio_codec_context (0)
+	, _audio_stream (0)
+	, _video_options (0)
 	, _audio_channels (channels)
 	, _output (output)
 	, _video_frame_size (video_frame_size)
 	, _video_frame_rate (video_frame_rate)
 	, _audio_frame_rate (audio_frame_rate)
+{
+	setup_format (format);
+
+	switch (format) {
+	case EXPORT_FORMAT_PRORES:
+		av_dict_set (&_video_options, "profile", "3", 0);
+		break;
+	case EXPORT_FORMAT_H264:
+		av_dict_set_int (&_video_options, "crf", x264_crf, 0);
+		break;
+	}
+
+	if (threads > 0) {
+		av_dict_set_int (&_video_options, "threads", threads, 0);
+	} else {
+		av_dict_set (&_video_options, "threads", "auto", 0);
+	}
+
+	setup_video ();
+	if (_audio_channels > 0) {
+		setup_audio ();
+	}
+
+	open (0);
+}
+
+/** Make an encoder which does not encode video itself, but is given packets which have already been
+ *  encoded (by another FFmpegFileEncoder) to video_packet().
+ *  @param video_source Stream that those packets come from; our video stream is set up to match it.
+ *  @param channels Number of audio channels, or 0 to write a file with no audio.
+ */
+FFmpegFileEncoder::FFmpegFileEncoder (
+	AVStream const * video_source,
+	int video_frame_rate,
+	int audio_frame_rate,
+	int channels,
+	ExportFormat format,
+	boost::filesystem::path output
+	)
+	: _video_codec (0)
+	, _video_codec_context (0)
+	, _audio_codec (0)
+	, _audio_codec_context (0)
+	, _audio_stream (0)
+	, _video_options (0)
+	, _audio_channels (channels)
+	, _output (output)
+	, _video_frame_size (video_source->codecpar->width, video_source->codecpar->height)
+	, _video_frame_rate (video_frame_rate)
+	, _audio_frame_rate (audio_frame_rate)
+{
+	setup_format (format);
+
+	if (_audio_channels > 0) {
+		setup_audio ();
+	}
+
+	open (video_source);
+}
+
+void
+FFmpegFileEncoder::setup_format (ExportFormat format)
 {
 	_pixel_format = pixel_format (format);
 
@@ -65,20 +137,21 @@ FFmpegFileEncoder::FFmpegFileEncoder (
 		_sample_format = AV_SAMPLE_FMT_S16;
 		_video_codec_name = "prores_ks";
 		_audio_codec_name = "pcm_s16le";
-		av_dict_set (&_video_options, "profile", "3", 0);
-		av_dict_set (&_video_options, "threads", "auto", 0);
 		break;
 	case EXPORT_FORMAT_H264:
 		_sample_format = AV_SAMPLE_FMT_FLTP;
 		_video_codec_name = "libx264";
 		_audio_codec_name = "aac";
-		av_dict_set_int (&_video_options, "crf", x264_crf, 0);
 		break;
 	}
+}
 
-	setup_video ();
-	setup_audio ();
-
+/** Make our streams, open the codecs and the output file and write the header.
+ *  @param video_source Stream to copy our video stream's parameters from, or 0 to set it up for our own video encoder.
+ */
+void
+FFmpegFileEncoder::open (AVStream const * video_source)
+{
 	int r = avformat_alloc_output_context2 (&_format_context, 0, 0, _output.string().c_str());
 	if (!_format_context) {
 		throw runtime_error (String::compose("could not allocate FFmpeg format context (%1)", r));
@@ -89,26 +162,39 @@ FFmpegFileEncoder::FFmpegFileEncoder (
 		throw runtime_error ("could not create FFmpeg output video stream");
 	}
 
-	_audio_stream = avformat_new_stream (_format_context, _audio_codec);
-	if (!_audio_stream) {
-		throw runtime_error ("could not create FFmpeg output audio stream");
+	_video_stream->id = _video_stream_index;
+	if (video_source) {
+		if (avcodec_parameters_copy (_video_stream->codecpar, video_source->codecpar) < 0) {
+			throw runtime_error ("could not copy FFmpeg video stream parameters");
+		}
+		/* Let the muxer choose a tag which suits its container */
+		_video_stream->codecpar->codec_tag = 0;
+		_video_stream->time_base = video_source->time_base;
+	} else {
+		_video_stream->codec = _video_codec_context;
 	}
 
-	_video_stream->id = _video_stream_index;
-	_video_stream->codec = _video_codec_context;
+	if (_audio_codec) {
+		_audio_stream = avformat_new_stream (_format_context, _audio_codec);
+		if (!_audio_stream) {
+			throw runtime_error ("could not create FFmpeg output audio stream");
+		}
 
-	_audio_stream->id = _audio_stream_index;
-	_audio_stream->codec = _audio_codec_context;
+		_audio_stream->id = _audio_stream_index;
+		_audio_stream->codec = _audio_codec_context;
+	}
 
-	if (avcodec_open2 (_video_codec_context, _video_codec, &_video_options) < 0) {
+	if (_video_codec_context && avcodec_open2 (_video_codec_context, _video_codec, &_video_options) < 0) {
 		throw runtime_error ("could not open FFmpeg video codec");
 	}
 
-	r = avcodec_open2 (_audio_codec_context, _audio_codec, 0);
-	if (r < 0) {
-		char buffer[256];
-		av_strerror (r, buffer, sizeof(buffer));
-		throw runtime_error (String::compose ("could not open FFmpeg audio codec (%1)", buffer));
+	if (_audio_codec_context) {
+		r = avcodec_open2 (_audio_codec_context, _audio_codec, 0);
+		if (r < 0) {
+			char buffer[256];
+			av_strerror (r, buffer, sizeof(buffer));
+			throw runtime_error (String::compose ("could not open FFmpeg audio codec (%1)", buffer));
+		}
 	}
 
 	if (avio_open_boost (&_format_context->pb, _output, AVIO_FLAG_WRITE) < 0) {
@@ -119,7 +205,7 @@ FFmpegFileEncoder::FFmpegFileEncoder (
 		throw runtime_error ("could not write header to FFmpeg output file");
 	}
 
-	_pending_audio.reset (new AudioBuffers(channels, 0));
+	_pending_audio.reset (new AudioBuffers(_audio_channels, 0));
 }
 
 AVPixelFormat
@@ -188,27 +274,35 @@ void
 FFmpegFileEncoder::flush ()
 {
 	if (_pending_audio->frames() > 0) {
-		audio_frame (_pending_audio->frames ());
+		audio_frame (_pending_audio, 0, _pending_audio->frames ());
 	}
 
-	bool flushed_video = false;
-	bool flushed_audio = false;
+	/* If we have no video encoder our video was all given to video_packet() */
+	bool flushed_video = !_video_codec_context;
+	bool flushed_audio = !_audio_codec_context;
 
 	while (!flushed_video || !flushed_audio) {
 		AVPacket packet;
-		av_init_packet (&packet);
-		packet.data = 0;
-		packet.size = 0;
-
 		int got_packet;
-		avcodec_encode_video2 (_video_codec_context, &packet, 0, &got_packet);
-		if (got_packet) {
-			packet.stream_index = 0;
-			av_interleaved_write_frame (_format_context, &packet);
-		} else {
-			flushed_video = true;
+
+		if (!flushed_video) {
+			av_init_packet (&packet);
+			packet.data = 0;
+			packet.size = 0;
+
+			avcodec_encode_video2 (_video_codec_context, &packet, 0, &got_packet);
+			if (got_packet) {
+				packet.stream_index = _video_stream_index;
+				av_interleaved_write_frame (_format_context, &packet);
+			} else {
+				flushed_video = true;
+			}
+			av_packet_unref (&packet);
+		}
+
+		if (flushed_audio) {
+			continue;
 		}
-		av_packet_unref (&packet);
 
 		av_init_packet (&packet);
 		packet.data = 0;
@@ -216,7 +310,7 @@ FFmpegFileEncoder::flush ()
 
 		avcodec_encode_audio2 (_audio_codec_context, &packet, 0, &got_packet);
 		if (got_packet) {
-			packet.stream_index = 0;
+			packet.stream_index = _audio_stream_index;
 			av_interleaved_write_frame (_format_context, &packet);
 		} else {
 			flushed_audio = true;
@@ -226,8 +320,12 @@ FFmpegFileEncoder::flush ()
 
 	av_write_trailer (_format_context);
 
-	avcodec_close (_video_codec_context);
-	avcodec_close (_audio_codec_context);
+	if (_video_codec_context) {
+		avcodec_close (_video_codec_context);
+	}
+	if (_audio_codec_context) {
+		avcodec_close (_audio_codec_context);
+	}
 	avio_close (_format_context->pb);
 	avformat_free_context (_format_context);
 }
@@ -235,6 +333,8 @@ FFmpegFileEncoder::flush ()
 void
 FFmpegFileEncoder::video (shared_ptr<PlayerVideo> video, DCPTime time)
 {
+	DCPOMATIC_ASSERT (_video_codec_context);
+
 	shared_ptr<Image> image = video->image (
 		bind (&PlayerVideo::force, _1, _pixel_format),
 		true,
@@ -282,11 +382,36 @@ FFmpegFileEncoder::video (shared_ptr<PlayerVideo> video, DCPTime time)
 
 }
 
+/** Write some video which has already been encoded, for example by another FFmpegFileEncoder
+ *  with the same settings.
+ *  @param packet Packet; this will be unreferenced.
+ *  @param time_base Time base of the packet's timestamps.
+ *  @param offset Time to add to the packet's timestamps.
+ */
+void
+FFmpegFileEncoder::video_packet (AVPacket* packet, AVRational time_base, DCPTime offset)
+{
+	av_packet_rescale_ts (packet, time_base, _video_stream->time_base);
+	int64_t const o = offset.seconds() / av_q2d (_video_stream->time_base);
+	if (packet->pts != AV_NOPTS_VALUE) {
+		packet->pts += o;
+	}
+	if (packet->dts != AV_NOPTS_VALUE) {
+		packet->dts += o;
+	}
+	packet->stream_index = _video_stream_index;
+	packet->pos = -1;
+
+	if (av_interleaved_write_frame (_format_context, packet) < 0) {
+		throw EncodeError ("FFmpeg video write failed");
+	}
+}
+
 /** Called when the player gives us some audio */
 void
 FFmpegFileEncoder::audio (shared_ptr<AudioBuffers> audio)
 {
-	_pending_audio->append (audio);
+	DCPOMATIC_ASSERT (_audio_codec_context);
 
 	int frame_size = _audio_codec_context->frame_size;
 	if (frame_size == 0) {
@@ -294,20 +419,46 @@ FFmpegFileEncoder::audio (shared_ptr<AudioBuffers> audio)
 		frame_size = _audio_frame_rate / _video_frame_rate;
 	}
 
-	while (_pending_audio->frames() >= frame_size) {
-		audio_frame (frame_size);
+	int offset = 0;
+
+	if (_pending_audio->frames() > 0) {
+		/* Make up a frame with what we had left over last time */
+		int const to_do = min (frame_size - _pending_audio->frames(), audio->frames());
+		_pending_audio->append (shared_ptr<const AudioBuffers> (new AudioBuffers (audio, to_do, 0)));
+		offset = to_do;
+		if (_pending_audio->frames() < frame_size) {
+			return;
+		}
+		audio_frame (_pending_audio, 0, frame_size);
+		_pending_audio->set_frames (0);
+	}
+
+	/* Encode whole frames straight from what we have been given */
+	while ((audio->frames() - offset) >= frame_size) {
+		audio_frame (audio, offset, frame_size);
+		offset += frame_size;
+	}
+
+	/* and keep the rest until next time */
+	if (offset < audio->frames()) {
+		_pending_audio->append (shared_ptr<const AudioBuffers> (new AudioBuffers (audio, audio->frames() - offset, offset)));
 	}
 }
 
+/** Convert some audio to the codec's sample format and encode it.
+ *  @param audio Audio.
+ *  @param offset Offset of the first frame to encode within audio.
+ *  @param size Number of frames to encode.
+ */
 void
-FFmpegFileEncoder::audio_frame (int size)
+FFmpegFileEncoder::audio_frame (shared_ptr<const AudioBuffers> audio, int offset, int size)
 {
 	DCPOMATIC_ASSERT (size);
 
 	AVFrame* frame = av_frame_alloc ();
 	DCPOMATIC_ASSERT (frame);
 
-	int const channels = _pending_audio->channels();
+	int const channels = audio->channels();
 	DCPOMATIC_ASSERT (channels);
 
 	int const buffer_size = av_samples_get_buffer_size (0, channels, size, _audio_codec_context->sample_fmt, 0);
@@ -320,14 +471,18 @@ FFmpegFileEncoder::audio_frame (int size)
 	int r = avcodec_fill_audio_frame (frame, channels, _audio_codec_context->sample_fmt, (const uint8_t *) samples, buffer_size, 0);
 	DCPOMATIC_ASSERT (r >= 0);
 
-	float** p = _pending_audio->data ();
+	float** p = audio->data ();
 	switch (_audio_codec_context->sample_fmt) {
 	case AV_SAMPLE_FMT_S16:
 	{
+		/* Interleave straight from our planar data */
 		int16_t* q = reinterpret_cast<int16_t*> (samples);
-		for (int i = 0; i < size; ++i) {
-			for (int j = 0; j < channels; ++j) {
-				*q++ = p[j][i] * 32767;
+		for (int i = 0; i < channels; ++i) {
+			float const * r = p[i] + offset;
+			int16_t* s = q + i;
+			for (int j = 0; j < size; ++j) {
+				*s = r[j] * 32767;
+				s += channels;
 			}
 		}
 		break;
@@ -336,7 +491,7 @@ FFmpegFileEncoder::audio_frame (int size)
 	{
 		float* q = reinterpret_cast<float*> (samples);
 		for (int i = 0; i < channels; ++i) {
-			memcpy (q, p[i], sizeof(float) * size);
+			memcpy (q, p[i] + offset, sizeof(float) * size);
 			q += size;
 		}
 		break;
@@ -363,8 +518,6 @@ FFmpegFileEncoder::audio_frame (int size)
 
 	av_free (samples);
 	av_frame_free (&frame);
-
-	_pending_audio->trim_start (size);
 }
 
 void
@@ -40,27 +40,46 @@ public:
 		int channels,
 		ExportFormat,
 		int x264_crf,
+		int threads,
+		boost::filesystem::path output
+		);
+
+	FFmpegFileEncoder (
+		AVStream const * video_source,
+		int video_frame_rate,
+		int audio_frame_rate,
+		int channels,
+		ExportFormat,
 		boost::filesystem::path output
 		);
 
 	void video (boost::shared_ptr<PlayerVideo>, DCPTime);
+	void video_packet (AVPacket* packet, AVRational time_base, DCPTime offset);
 	void audio (boost::shared_ptr<AudioBuffers>);
 	void subtitle (PlayerText, DCPTimePeriod);
 
 	void flush ();
 
+	/** @return parameters of the video stream that we are writing */
+	AVCodecParameters const * video_parameters () const {
+		return _video_stream->codecpar;
+	}
+
 	static AVPixelFormat pixel_format (ExportFormat format);
 
 private:
+	void setup_format (ExportFormat format);
 	void setup_video ();
 	void setup_audio ();
+	void open (AVStream const * video_source);
 
-	void audio_frame (int size);
+	void audio_frame (boost::shared_ptr<const AudioBuffers> audio, int offset, int size);
 
 	static void buffer_free(void* opaque, uint8_t* data);
 	void buffer_free2(uint8_t* data);
 
 	AVCodec* _video_codec;
+	/** context for our video encoder, or 0 if we are only given packets which are already encoded */
 	AVCodecContext* _video_codec_context;
 	AVCodec* _audio_codec;
 	AVCodecContext* _audio_codec_context;
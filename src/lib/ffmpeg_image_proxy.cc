@@ -60,6 +60,17 @@ FFmpegImageProxy::FFmpegImageProxy (dcp::Data data)
 
 }
 
+/** @param path File that data was read from, used only for error messages.
+ *  @param data Contents of the file.
+ */
+FFmpegImageProxy::FFmpegImageProxy (boost::filesystem::path path, dcp::Data data)
+	: _data (data)
+	, _pos (0)
+	, _path (path)
+{
+
+}
+
 FFmpegImageProxy::FFmpegImageProxy (shared_ptr<cxml::Node>, shared_ptr<Socket> socket)
 	: _pos (0)
 {
@@ -28,6 +28,7 @@ class FFmpegImageProxy : public ImageProxy
 public:
 	explicit FFmpegImageProxy (boost::filesystem::path);
 	explicit FFmpegImageProxy (dcp::Data);
+	FFmpegImageProxy (boost::filesystem::path, dcp::Data);
 	FFmpegImageProxy (boost::shared_ptr<cxml::Node> xml, boost::shared_ptr<Socket> socket);
 
 	std::pair<boost::shared_ptr<Image>, int> image (
@@ -0,0 +1,298 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/ffmpeg_index.cc
+ *  @brief FFmpegIndex class.
+ */
+
+#include "ffmpeg_index.h"
+#include "cross.h"
+#include "exceptions.h"
+#include "util.h"
+extern "C" {
+#include <libavformat/avformat.h>
+}
+#include <algorithm>
+
+using std::map;
+using std::upper_bound;
+using boost::optional;
+using boost::shared_ptr;
+using boost::weak_ptr;
+
+/** Index files are written in the machine's byte order, since they are only
+ *  a cache and are not expected to be moved between machines.
+ */
+static uint32_t const index_magic = 0x494d4646;
+static int32_t const index_version = 2;
+/** Bytes used in an index file by each packet */
+static int64_t const packet_bytes = sizeof (int64_t) * 2 + 1;
+
+boost::mutex FFmpegIndex::_cache_mutex;
+map<boost::filesystem::path, weak_ptr<const FFmpegIndex> > FFmpegIndex::_cache;
+
+FFmpegIndex::FFmpegIndex ()
+	: _complete (false)
+{
+
+}
+
+/** Read an index which was written by write().  FileError is thrown if the file
+ *  is not a valid index.
+ */
+FFmpegIndex::FFmpegIndex (boost::filesystem::path file)
+	: _complete (false)
+{
+	FILE* f = fopen_boost (file, "rb");
+	if (!f) {
+		throw OpenFileError (file, errno, OpenFileError::READ);
+	}
+
+	try {
+		int64_t remaining = boost::filesystem::file_size (file);
+
+		uint32_t magic;
+		checked_fread (&magic, sizeof (magic), f, file);
+		int32_t version;
+		checked_fread (&version, sizeof (version), f, file);
+		if (magic != index_magic || version != index_version) {
+			throw FileError ("Unrecognised FFmpeg index", file);
+		}
+
+		int64_t video_length;
+		checked_fread (&video_length, sizeof (video_length), f, file);
+		if (video_length >= 0) {
+			_video_length = video_length;
+		}
+
+		uint8_t complete;
+		checked_fread (&complete, sizeof (complete), f, file);
+		_complete = complete;
+
+		int32_t streams;
+		checked_fread (&streams, sizeof (streams), f, file);
+		remaining -= sizeof (magic) + sizeof (version) + sizeof (video_length) + sizeof (complete) + sizeof (streams);
+
+		for (int32_t i = 0; i < streams; ++i) {
+			int32_t index;
+			checked_fread (&index, sizeof (index), f, file);
+			int64_t end;
+			checked_fread (&end, sizeof (end), f, file);
+			uint32_t count;
+			checked_fread (&count, sizeof (count), f, file);
+			remaining -= sizeof (index) + sizeof (end) + sizeof (count);
+
+			/* Check the count before we use it, so that a corrupt file does not make us allocate lots of memory */
+			if (remaining < 0 || int64_t (count) * packet_bytes > remaining) {
+				throw FileError ("Corrupt FFmpeg index", file);
+			}
+			remaining -= int64_t (count) * packet_bytes;
+
+			Stream& s = _streams[index];
+			s.end = end;
+			s.pts.resize (count);
+			s.position.resize (count);
+			s.key.resize (count);
+			if (count) {
+				checked_fread (&s.pts[0], count * sizeof (int64_t), f, file);
+				checked_fread (&s.position[0], count * sizeof (int64_t), f, file);
+				checked_fread (&s.key[0], count, f, file);
+			}
+
+			for (size_t j = 0; j < count; ++j) {
+				if (s.key[j]) {
+					s.add_key (s.pts[j]);
+				}
+			}
+		}
+	} catch (...) {
+		fclose (f);
+		throw;
+	}
+
+	fclose (f);
+}
+
+/** Add a keyframe's PTS to keys, keeping it sorted */
+void
+FFmpegIndex::Stream::add_key (int64_t pts)
+{
+	/* Keyframes nearly always arrive in order, so this is usually an append */
+	keys.insert (upper_bound (keys.begin(), keys.end(), pts), pts);
+}
+
+/** Add a packet to the index.
+ *  @param stream Index of the packet's stream in the AVFormatContext.
+ *  @param pts PTS of the packet in its stream's time base; every packet in the index must
+ *  use PTS, so that keyframe_before() can compare them.
+ *  @param position Byte offset of the packet in the file, or -1 if it is not known.
+ *  @param key true if the packet is a keyframe.
+ */
+void
+FFmpegIndex::add (int stream, int64_t pts, int64_t position, bool key)
+{
+	Stream& s = _streams[stream];
+	s.pts.push_back (pts);
+	s.position.push_back (position);
+	s.key.push_back (key ? 1 : 0);
+	if (key) {
+		s.add_key (pts);
+	}
+	s.end = std::max (s.end, pts);
+}
+
+/** Give our keyframes to FFmpeg, for any streams in context which have no index of their
+ *  own, so that its seeks can go straight to them.  This is only done if we are complete,
+ *  as FFmpeg would otherwise read forward from our last keyframe to get to anything after it.
+ */
+void
+FFmpegIndex::add_to (AVFormatContext* context) const
+{
+	if (!_complete) {
+		return;
+	}
+
+	for (map<int, Stream>::const_iterator i = _streams.begin(); i != _streams.end(); ++i) {
+		if (i->first < 0 || i->first >= int (context->nb_streams)) {
+			continue;
+		}
+
+		AVStream* s = context->streams[i->first];
+		if (s->nb_index_entries > 0) {
+			continue;
+		}
+
+		Stream const & stream = i->second;
+		for (size_t j = 0; j < stream.pts.size(); ++j) {
+			if (stream.key[j] && stream.position[j] >= 0) {
+				av_add_index_entry (s, stream.position[j], stream.pts[j], 0, 0, AVINDEX_KEYFRAME);
+			}
+		}
+	}
+}
+
+void
+FFmpegIndex::write (boost::filesystem::path file) const
+{
+	/* Write to a temporary file and then move it into place so that nobody
+	   can read a half-written index.
+	*/
+	boost::filesystem::path tmp = file;
+	tmp += ".tmp";
+
+	FILE* f = fopen_boost (tmp, "wb");
+	if (!f) {
+		throw OpenFileError (tmp, errno, OpenFileError::WRITE);
+	}
+
+	checked_fwrite (&index_magic, sizeof (index_magic), f, tmp);
+	checked_fwrite (&index_version, sizeof (index_version), f, tmp);
+	int64_t const video_length = _video_length.get_value_or (-1);
+	checked_fwrite (&video_length, sizeof (video_length), f, tmp);
+	uint8_t const complete = _complete ? 1 : 0;
+	checked_fwrite (&complete, sizeof (complete), f, tmp);
+	int32_t const streams = _streams.size ();
+	checked_fwrite (&streams, sizeof (streams), f, tmp);
+	for (map<int, Stream>::const_iterator i = _streams.begin(); i != _streams.end(); ++i) {
+		int32_t const index = i->first;
+		checked_fwrite (&index, sizeof (index), f, tmp);
+		checked_fwrite (&i->second.end, sizeof (i->second.end), f, tmp);
+		uint32_t const count = i->second.pts.size ();
+		checked_fwrite (&count, sizeof (count), f, tmp);
+		if (count) {
+			checked_fwrite (&i->second.pts[0], count * sizeof (int64_t), f, tmp);
+			checked_fwrite (&i->second.position[0], count * sizeof (int64_t), f, tmp);
+			checked_fwrite (&i->second.key[0], count, f, tmp);
+		}
+	}
+
+	fclose (f);
+	boost::filesystem::rename (tmp, file);
+}
+
+/** @param stream Index of a stream in the AVFormatContext.
+ *  @param pts PTS in the stream's time base.
+ *  @return PTS of the last keyframe in the stream whose PTS is not later than pts, if there is one
+ *  and the index reaches as far as pts.
+ */
+optional<int64_t>
+FFmpegIndex::keyframe_before (int stream, int64_t pts) const
+{
+	map<int, Stream>::const_iterator i = _streams.find (stream);
+	if (i == _streams.end ()) {
+		return optional<int64_t> ();
+	}
+
+	Stream const & s = i->second;
+	if (!_complete && pts > s.end) {
+		/* We don't know what keyframes there are between the end of the index and pts */
+		return optional<int64_t> ();
+	}
+
+	std::vector<int64_t>::const_iterator j = upper_bound (s.keys.begin(), s.keys.end(), pts);
+	if (j == s.keys.begin()) {
+		return optional<int64_t> ();
+	}
+
+	return *(--j);
+}
+
+size_t
+FFmpegIndex::packets (int stream) const
+{
+	map<int, Stream>::const_iterator i = _streams.find (stream);
+	if (i == _streams.end ()) {
+		return 0;
+	}
+
+	return i->second.pts.size ();
+}
+
+/** @return The index in a file, which may be shared with other callers; index files
+ *  are named after the content's digest so their contents never change once written.
+ */
+shared_ptr<const FFmpegIndex>
+FFmpegIndex::get (boost::filesystem::path file)
+{
+	boost::mutex::scoped_lock lm (_cache_mutex);
+
+	/* Forget about any indices that are no longer being used */
+	map<boost::filesystem::path, weak_ptr<const FFmpegIndex> >::iterator i = _cache.begin ();
+	while (i != _cache.end ()) {
+		map<boost::filesystem::path, weak_ptr<const FFmpegIndex> >::iterator tmp = i;
+		++tmp;
+		if (i->second.expired ()) {
+			_cache.erase (i);
+		}
+		i = tmp;
+	}
+
+	i = _cache.find (file);
+	if (i != _cache.end ()) {
+		shared_ptr<const FFmpegIndex> index = i->second.lock ();
+		if (index) {
+			return index;
+		}
+	}
+
+	shared_ptr<const FFmpegIndex> index (new FFmpegIndex (file));
+	_cache[file] = index;
+	return index;
+}
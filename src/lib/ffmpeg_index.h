@@ -0,0 +1,120 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/ffmpeg_index.h
+ *  @brief FFmpegIndex class.
+ */
+
+#ifndef DCPOMATIC_FFMPEG_INDEX_H
+#define DCPOMATIC_FFMPEG_INDEX_H
+
+#include "types.h"
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <vector>
+
+struct AVFormatContext;
+
+/** @class FFmpegIndex
+ *  @brief A list of the packets in a piece of FFmpeg content, made when the content is examined.
+ *
+ *  For each stream we keep the PTS (in the stream's time base), byte offset and keyframe flag of each
+ *  packet.  The index is written to a file in the film directory so that we can use it when the
+ *  content is examined again (to avoid running through the whole file to find its length) and when
+ *  decoding (to seek straight to keyframes).
+ *
+ *  An index may only cover the start of the content.  It is only marked complete if every packet
+ *  in the content was added to it; otherwise each stream's index is taken to reach as far as the
+ *  latest PTS that was added to it, and nothing is assumed about anything after that.
+ */
+class FFmpegIndex
+{
+public:
+	FFmpegIndex ();
+	explicit FFmpegIndex (boost::filesystem::path file);
+
+	void add (int stream, int64_t pts, int64_t position, bool key);
+	void add_to (AVFormatContext* context) const;
+	void write (boost::filesystem::path file) const;
+
+	boost::optional<int64_t> keyframe_before (int stream, int64_t pts) const;
+
+	/** @return true if there are no packets in the index */
+	bool empty () const {
+		return _streams.empty ();
+	}
+
+	/** @return true if the index lists every packet in the content */
+	bool complete () const {
+		return _complete;
+	}
+
+	void set_complete () {
+		_complete = true;
+	}
+
+	/** @return Number of packets in the index for a stream */
+	size_t packets (int stream) const;
+
+	/** @return Video length found by reading every packet in the content, if we did that */
+	boost::optional<Frame> video_length () const {
+		return _video_length;
+	}
+
+	void set_video_length (Frame length) {
+		_video_length = length;
+	}
+
+	static boost::shared_ptr<const FFmpegIndex> get (boost::filesystem::path file);
+
+private:
+	struct Stream
+	{
+		Stream ()
+			: end (INT64_MIN)
+		{}
+
+		void add_key (int64_t pts);
+
+		/** PTS, byte offset and keyframe flag of each packet, in the order that they were added */
+		std::vector<int64_t> pts;
+		std::vector<int64_t> position;
+		std::vector<uint8_t> key;
+		/** PTS of the keyframes, sorted */
+		std::vector<int64_t> keys;
+		/** latest PTS that was added */
+		int64_t end;
+	};
+
+	/** Streams, indexed by their index in the AVFormatContext */
+	std::map<int, Stream> _streams;
+	boost::optional<Frame> _video_length;
+	bool _complete;
+
+	static boost::mutex _cache_mutex;
+	/** Indices which have been read, held weakly so that they are freed once nobody is using them */
+	static std::map<boost::filesystem::path, boost::weak_ptr<const FFmpegIndex> > _cache;
+};
+
+#endif
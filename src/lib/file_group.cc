@@ -1,5 +1,5 @@
 /*
-    Copyright (C) 2013-2018 Carl Hetherington <cth@carlh.net>
+    Copyright (C) 2013-2019 Carl Hetherington <cth@carlh.net>
 
     This file is part of DCP-o-matic.
 
@@ -27,54 +27,266 @@
 #include "cross.h"
 #include "compose.hpp"
 #include <sndfile.h>
+#ifdef DCPOMATIC_POSIX
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <boost/bind.hpp>
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
 
 using std::vector;
 using std::cout;
+using std::min;
+
+/** Largest amount that the readahead thread will read in one go */
+static int const readahead_chunk = 256 * 1024;
+
+/** Most readahead threads that may be running at once, between all FileGroups */
+int const FileGroup::maximum_readahead_threads = 8;
+
+/** Mutex to protect readahead_threads */
+static boost::mutex readahead_threads_mutex;
+/** Number of readahead threads that are running */
+static int readahead_threads = 0;
+
+/** @return true if another readahead thread may be started, in which case it is counted */
+static bool
+claim_readahead_thread ()
+{
+	boost::mutex::scoped_lock lm (readahead_threads_mutex);
+	if (readahead_threads >= FileGroup::maximum_readahead_threads) {
+		return false;
+	}
+	++readahead_threads;
+	return true;
+}
+
+static void
+release_readahead_thread ()
+{
+	boost::mutex::scoped_lock lm (readahead_threads_mutex);
+	--readahead_threads;
+}
 
 /** Construct a FileGroup with no files */
 FileGroup::FileGroup ()
-	: _current_path (0)
+	: _position (0)
+	, _current_path (0)
 	, _current_file (0)
+	, _current_file_position (0)
+	, _use_mmap (false)
+	, _readahead (0)
+	, _readahead_thread (0)
+	, _buffer_start (0)
+	, _buffer_head (0)
+	, _buffer_fill (0)
+	, _buffer_eof (false)
+	, _generation (0)
+	, _stop (false)
 {
 
 }
 
 /** Construct a FileGroup with a single file */
 FileGroup::FileGroup (boost::filesystem::path p)
-	: _current_path (0)
+	: _position (0)
+	, _current_path (0)
 	, _current_file (0)
+	, _current_file_position (0)
+	, _use_mmap (false)
+	, _readahead (0)
+	, _readahead_thread (0)
+	, _buffer_start (0)
+	, _buffer_head (0)
+	, _buffer_fill (0)
+	, _buffer_eof (false)
+	, _generation (0)
+	, _stop (false)
 {
 	_paths.push_back (p);
-	ensure_open_path (0);
-	seek (0, SEEK_SET);
+	setup ();
 }
 
 /** Construct a FileGroup with multiple files */
 FileGroup::FileGroup (vector<boost::filesystem::path> const & p)
 	: _paths (p)
+	, _position (0)
 	, _current_path (0)
 	, _current_file (0)
+	, _current_file_position (0)
+	, _use_mmap (false)
+	, _readahead (0)
+	, _readahead_thread (0)
+	, _buffer_start (0)
+	, _buffer_head (0)
+	, _buffer_fill (0)
+	, _buffer_eof (false)
+	, _generation (0)
+	, _stop (false)
 {
-	ensure_open_path (0);
-	seek (0, SEEK_SET);
+	setup ();
 }
 
 /** Destroy a FileGroup, closing any open file */
 FileGroup::~FileGroup ()
 {
-	if (_current_file) {
-		fclose (_current_file);
-	}
+	teardown ();
 }
 
 void
 FileGroup::set_paths (vector<boost::filesystem::path> const & p)
 {
+	teardown ();
 	_paths = p;
+	setup ();
+}
+
+/** @param m true to memory-map the files if they are all on local filesystems */
+void
+FileGroup::set_mmap (bool m)
+{
+	if (m == _use_mmap) {
+		return;
+	}
+
+	teardown ();
+	_use_mmap = m;
+	setup ();
+}
+
+/** @param bytes Number of bytes to read ahead of the current position in a separate thread,
+ *  or 0 to read only when read() is called.
+ */
+void
+FileGroup::set_readahead (int bytes)
+{
+	if (bytes == _readahead) {
+		return;
+	}
+
+	teardown ();
+	_readahead = bytes;
+	setup ();
+}
+
+/** Find the offsets of our paths, open the first one and start any mapping or readahead
+ *  which has been asked for.  The position is reset to 0.
+ */
+void
+FileGroup::setup ()
+{
+	_offsets.clear ();
+	_offsets.push_back (0);
+	for (vector<boost::filesystem::path>::const_iterator i = _paths.begin(); i != _paths.end(); ++i) {
+		_offsets.push_back (_offsets.back() + boost::filesystem::file_size (*i));
+	}
+
+	_position = 0;
+
+	if (_paths.empty ()) {
+		return;
+	}
+
 	ensure_open_path (0);
-	seek (0, SEEK_SET);
+
+	if (_use_mmap) {
+		map_files ();
+	}
+
+	if (_readahead > 0 && !mapped () && claim_readahead_thread ()) {
+		_buffer.resize (_readahead);
+		_buffer_start = 0;
+		_buffer_head = 0;
+		_buffer_fill = 0;
+		_buffer_eof = false;
+		_readahead_exception = boost::exception_ptr ();
+		_stop = false;
+		_readahead_thread = new boost::thread (boost::bind (&FileGroup::readahead_thread, this));
+#ifdef DCPOMATIC_LINUX
+		pthread_setname_np (_readahead_thread->native_handle(), "file-readahead");
+#endif
+	}
+}
+
+/** Stop any readahead thread, remove any mapping and close any open file */
+void
+FileGroup::teardown ()
+{
+	if (_readahead_thread) {
+		{
+			boost::mutex::scoped_lock lm (_readahead_mutex);
+			_stop = true;
+			_readahead_condition.notify_all ();
+		}
+		_readahead_thread->join ();
+		delete _readahead_thread;
+		_readahead_thread = 0;
+		_buffer.clear ();
+		release_readahead_thread ();
+	}
+
+	unmap_files ();
+
+	if (_current_file) {
+		fclose (_current_file);
+		_current_file = 0;
+	}
+}
+
+/** Try to memory-map all our paths.  If any of them is not on a local filesystem,
+ *  or if mapping fails, nothing is mapped.
+ */
+void
+FileGroup::map_files ()
+{
+#ifdef DCPOMATIC_POSIX
+	for (vector<boost::filesystem::path>::const_iterator i = _paths.begin(); i != _paths.end(); ++i) {
+		if (!local_filesystem (*i)) {
+			return;
+		}
+	}
+
+	for (size_t i = 0; i < _paths.size(); ++i) {
+		int64_t const size = _offsets[i + 1] - _offsets[i];
+		if (size == 0) {
+			_maps.push_back (0);
+			continue;
+		}
+
+		int const fd = open (_paths[i].c_str(), O_RDONLY);
+		if (fd == -1) {
+			unmap_files ();
+			return;
+		}
+
+		void* m = mmap (0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close (fd);
+		if (m == MAP_FAILED) {
+			unmap_files ();
+			return;
+		}
+
+		madvise (m, size, MADV_SEQUENTIAL);
+		_maps.push_back (static_cast<uint8_t const *> (m));
+	}
+#endif
+}
+
+void
+FileGroup::unmap_files ()
+{
+#ifdef DCPOMATIC_POSIX
+	for (size_t i = 0; i < _maps.size(); ++i) {
+		if (_maps[i]) {
+			munmap (const_cast<uint8_t*> (_maps[i]), _offsets[i + 1] - _offsets[i]);
+		}
+	}
+#endif
+	_maps.clear ();
 }
 
 /** Ensure that the given path index in the content is the _current_file */
@@ -95,6 +307,17 @@ FileGroup::ensure_open_path (size_t p) const
 	if (_current_file == 0) {
 		throw OpenFileError (_paths[_current_path], errno, OpenFileError::READ);
 	}
+	_current_file_position = 0;
+}
+
+/** @param position Offset from the start of the group, which must be less than length().
+ *  @return Index of the path which contains position.
+ */
+size_t
+FileGroup::path_index (int64_t position) const
+{
+	/* upper_bound skips any empty paths which start at the same offset as the one we want */
+	return std::upper_bound (_offsets.begin(), _offsets.end(), position) - _offsets.begin() - 1;
 }
 
 int64_t
@@ -109,39 +332,40 @@ FileGroup::seek (int64_t pos, int whence) const
 		full_pos = pos;
 		break;
 	case SEEK_CUR:
-		for (size_t i = 0; i < _current_path; ++i) {
-			full_pos += boost::filesystem::file_size (_paths[i]);
-		}
-#ifdef DCPOMATIC_WINDOWS
-		full_pos += _ftelli64 (_current_file);
-#else
-		full_pos += ftell (_current_file);
-#endif
-		full_pos += pos;
+		full_pos = _position + pos;
 		break;
 	case SEEK_END:
 		full_pos = length() - pos;
 		break;
 	}
 
-	/* Seek to full_pos */
-	size_t i = 0;
-	int64_t sub_pos = full_pos;
-	while (i < _paths.size ()) {
-		boost::uintmax_t len = boost::filesystem::file_size (_paths[i]);
-		if (sub_pos < int64_t (len)) {
-			break;
-		}
-		sub_pos -= len;
-		++i;
+	if (full_pos < 0 || full_pos >= length()) {
+		return -1;
 	}
 
-	if (i == _paths.size ()) {
-		return -1;
+	_position = full_pos;
+
+	if (_readahead_thread) {
+		boost::mutex::scoped_lock lm (_readahead_mutex);
+		int64_t const buffer_end = _buffer_start + _buffer_fill;
+		if (full_pos >= _buffer_start && (full_pos < buffer_end || (full_pos == buffer_end && !_buffer_eof))) {
+			/* We already have this position in the buffer, or the readahead thread is just about
+			   to read it; just drop what comes before it.
+			*/
+			int const skip = full_pos - _buffer_start;
+			_buffer_head = (_buffer_head + skip) % _buffer.size();
+			_buffer_fill -= skip;
+			_buffer_start = full_pos;
+		} else {
+			_buffer_start = full_pos;
+			_buffer_head = 0;
+			_buffer_fill = 0;
+			_buffer_eof = false;
+			++_generation;
+		}
+		_readahead_condition.notify_all ();
 	}
 
-	ensure_open_path (i);
-	dcpomatic_fseek (_current_file, sub_pos, SEEK_SET);
 	return full_pos;
 }
 
@@ -154,38 +378,173 @@ int
 FileGroup::read (uint8_t* buffer, int amount) const
 {
 	int read = 0;
-	while (true) {
-		int const this_time = fread (buffer + read, 1, amount - read, _current_file);
-		read += this_time;
-		if (read == amount) {
-			/* Done */
+	if (_readahead_thread) {
+		read = read_ahead (buffer, amount);
+	} else if (mapped ()) {
+		read = read_mapped (buffer, _position, amount);
+	} else {
+		read = read_direct (buffer, _position, amount);
+	}
+
+	_position += read;
+	return read;
+}
+
+/** Read from our files using stdio.
+ *  @param buffer Buffer to write data into.
+ *  @param position Offset from the start of the group to read from.
+ *  @param amount Number of bytes to read.
+ *  @return Number of bytes read.
+ */
+int
+FileGroup::read_direct (uint8_t* buffer, int64_t position, int amount) const
+{
+	int read = 0;
+	while (read < amount && position < length()) {
+		size_t const p = path_index (position);
+		ensure_open_path (p);
+
+		int64_t const sub_pos = position - _offsets[p];
+		if (sub_pos != _current_file_position) {
+			dcpomatic_fseek (_current_file, sub_pos, SEEK_SET);
+			_current_file_position = sub_pos;
+		}
+
+		int const this_time = min (int64_t (amount - read), _offsets[p + 1] - position);
+		int const done = fread (buffer + read, 1, this_time, _current_file);
+		if (ferror (_current_file)) {
+			throw FileError (String::compose("fread error %1", errno), _paths[p]);
+		}
+
+		read += done;
+		position += done;
+		_current_file_position += done;
+
+		if (done < this_time) {
+			/* The file is shorter than it was when we looked at its size */
 			break;
 		}
+	}
+
+	return read;
+}
 
-		if (ferror(_current_file)) {
-			throw FileError (String::compose("fread error %1", errno), _paths[_current_path]);
+/** Read from our memory-mapped files.
+ *  @param buffer Buffer to write data into.
+ *  @param position Offset from the start of the group to read from.
+ *  @param amount Number of bytes to read.
+ *  @return Number of bytes read.
+ */
+int
+FileGroup::read_mapped (uint8_t* buffer, int64_t position, int amount) const
+{
+	int read = 0;
+	while (read < amount && position < length()) {
+		size_t const p = path_index (position);
+		int const this_time = min (int64_t (amount - read), _offsets[p + 1] - position);
+		memcpy (buffer + read, _maps[p] + position - _offsets[p], this_time);
+		read += this_time;
+		position += this_time;
+	}
+
+	return read;
+}
+
+/** Read from the readahead buffer at _position, waiting for the readahead thread if necessary.
+ *  @param buffer Buffer to write data into.
+ *  @param amount Number of bytes to read.
+ *  @return Number of bytes read.
+ */
+int
+FileGroup::read_ahead (uint8_t* buffer, int amount) const
+{
+	int read = 0;
+	boost::mutex::scoped_lock lm (_readahead_mutex);
+	while (read < amount) {
+		while (_buffer_fill == 0 && !_buffer_eof) {
+			_readahead_condition.wait (lm);
 		}
 
-		if (feof (_current_file)) {
-			/* See if there is another file to use */
-			if ((_current_path + 1) >= _paths.size()) {
-				break;
+		if (_buffer_fill == 0) {
+			/* End of the files, or an error */
+			if (_readahead_exception) {
+				boost::exception_ptr e = _readahead_exception;
+				_readahead_exception = boost::exception_ptr ();
+				boost::rethrow_exception (e);
 			}
-			ensure_open_path (_current_path + 1);
+			break;
 		}
+
+		int const size = _buffer.size ();
+		int const this_time = min (min (amount - read, _buffer_fill), size - _buffer_head);
+		memcpy (buffer + read, &_buffer[_buffer_head], this_time);
+		read += this_time;
+		_buffer_head = (_buffer_head + this_time) % size;
+		_buffer_fill -= this_time;
+		_buffer_start += this_time;
+		_readahead_condition.notify_all ();
 	}
 
 	return read;
 }
 
+void
+FileGroup::readahead_thread ()
+{
+	boost::mutex::scoped_lock lm (_readahead_mutex);
+
+	while (true) {
+		while (!_stop && (_buffer_eof || _buffer_fill == int (_buffer.size()))) {
+			_readahead_condition.wait (lm);
+		}
+
+		if (_stop) {
+			return;
+		}
+
+		int const generation = _generation;
+		int64_t const position = _buffer_start + _buffer_fill;
+		int const size = _buffer.size ();
+		int const tail = (_buffer_head + _buffer_fill) % size;
+		int const space = min (size - _buffer_fill, size - tail);
+
+		/* The part of _buffer that we read into is not touched by anybody else
+		   until we increase _buffer_fill, so we can release the lock while we read.
+		*/
+		lm.unlock ();
+		int done = 0;
+		boost::exception_ptr exception;
+		try {
+			done = read_direct (&_buffer[tail], position, min (space, readahead_chunk));
+		} catch (...) {
+			exception = boost::current_exception ();
+		}
+		lm.lock ();
+
+		if (generation != _generation) {
+			/* There was a seek while we were reading, so this data is no use */
+			continue;
+		}
+
+		if (exception) {
+			/* Pass the error on to read(), and stop until the next seek */
+			_readahead_exception = exception;
+			done = 0;
+		}
+
+		if (done == 0) {
+			_buffer_eof = true;
+		} else {
+			_buffer_fill += done;
+		}
+
+		_readahead_condition.notify_all ();
+	}
+}
+
 /** @return Combined length of all the files */
 int64_t
 FileGroup::length () const
 {
-	int64_t len = 0;
-	for (size_t i = 0; i < _paths.size(); ++i) {
-		len += boost::filesystem::file_size (_paths[i]);
-	}
-
-	return len;
+	return _offsets.back ();
 }
@@ -1,5 +1,5 @@
 /*
-    Copyright (C) 2013-2014 Carl Hetherington <cth@carlh.net>
+    Copyright (C) 2013-2019 Carl Hetherington <cth@carlh.net>
 
     This file is part of DCP-o-matic.
 
@@ -26,12 +26,31 @@
 #define DCPOMATIC_FILE_GROUP_H
 
 #include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/exception/all.hpp>
 #include <vector>
 
 /** @class FileGroup
  *  @brief A class to make a list of files behave like they were concatenated.
+ *
+ *  By default data are read with stdio on the caller's thread.  Two faster
+ *  ways of reading can be enabled:
+ *
+ *  - set_mmap(true) will memory-map the files, if they are all on local
+ *    filesystems and the platform supports it.  The files must not be
+ *    truncated while they are mapped, as reading a part of a mapping which
+ *    is no longer in the file kills the process.
+ *  - set_readahead(n) will start a thread which reads up to n bytes ahead
+ *    of the current position, so that read() does not have to wait for
+ *    storage if the caller is reading sequentially.  There is a limit on
+ *    the number of these threads that all FileGroups can have between them;
+ *    past that, FileGroups read on the caller's thread.
+ *
+ *  If both are enabled and the files can be mapped no readahead thread is used.
  */
-class FileGroup
+class FileGroup : public boost::noncopyable
 {
 public:
 	FileGroup ();
@@ -40,18 +59,82 @@ public:
 	~FileGroup ();
 
 	void set_paths (std::vector<boost::filesystem::path> const &);
+	void set_mmap (bool m);
+	void set_readahead (int bytes);
 
 	int64_t seek (int64_t, int) const;
 	int read (uint8_t*, int) const;
 	int64_t length () const;
 
+	/** @return true if the files are memory-mapped */
+	bool mapped () const {
+		return !_maps.empty ();
+	}
+
+	/** @return true if a thread is reading ahead in the files */
+	bool reading_ahead () const {
+		return _readahead_thread;
+	}
+
+	static int const maximum_readahead_threads;
+
 private:
+	void setup ();
+	void teardown ();
+	void map_files ();
+	void unmap_files ();
 	void ensure_open_path (size_t) const;
+	size_t path_index (int64_t position) const;
+	int read_direct (uint8_t* buffer, int64_t position, int amount) const;
+	int read_mapped (uint8_t* buffer, int64_t position, int amount) const;
+	int read_ahead (uint8_t* buffer, int amount) const;
+	void readahead_thread ();
 
 	std::vector<boost::filesystem::path> _paths;
+	/** Offset of the start of each path from the start of the group, with
+	 *  an extra entry at the end for the total length.
+	 */
+	std::vector<int64_t> _offsets;
+	/** Current position, as an offset from the start of the group */
+	mutable int64_t _position;
 	/** Index of path that we are currently reading from */
 	mutable size_t _current_path;
 	mutable FILE* _current_file;
+	/** Position within _current_file */
+	mutable int64_t _current_file_position;
+
+	bool _use_mmap;
+	/** Start of the mapping of each path, or 0 for empty paths */
+	std::vector<uint8_t const *> _maps;
+
+	/** Size of the readahead buffer in bytes, or 0 for no readahead */
+	int _readahead;
+	boost::thread* _readahead_thread;
+	/** Mutex for _buffer_start, _buffer_head, _buffer_fill, _buffer_eof, _generation,
+	 *  _readahead_exception and _stop
+	 */
+	mutable boost::mutex _readahead_mutex;
+	/** Condition to tell the readahead thread that there is space in the buffer, or to tell
+	 *  read() that there is data in it.
+	 */
+	mutable boost::condition _readahead_condition;
+	/** Ring buffer of data which has been read ahead */
+	std::vector<uint8_t> _buffer;
+	/** Offset in the group of the first byte in _buffer */
+	mutable int64_t _buffer_start;
+	/** Index in _buffer of the byte at _buffer_start */
+	mutable int _buffer_head;
+	/** Number of bytes in _buffer */
+	mutable int _buffer_fill;
+	/** true if the readahead thread has reached the end of the group */
+	mutable bool _buffer_eof;
+	/** Incremented on each seek so that the readahead thread can discard data that it
+	 *  read from before the seek.
+	 */
+	mutable int _generation;
+	/** Exception thrown by the readahead thread, to be re-thrown by read() */
+	mutable boost::exception_ptr _readahead_exception;
+	bool _stop;
 };
 
 #endif
@@ -54,6 +54,7 @@
 #include "cinema.h"
 #include "change_signaller.h"
 #include "check_content_change_job.h"
+#include "frame_info_file.h"
 #include <libcxml/cxml.h>
 #include <dcp/cpl.h>
 #include <dcp/certificate_chain.h>
@@ -68,6 +69,7 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/foreach.hpp>
 #include <boost/regex.hpp>
+#include <boost/exception_ptr.hpp>
 #include <unistd.h>
 #include <stdexcept>
 #include <iostream>
@@ -297,6 +299,63 @@ Film::audio_analysis_path (shared_ptr<const Playlist> playlist) const
 	return p;
 }
 
+/** @return Path to the FFmpegIndex for some content, or none if this film has no directory */
+optional<boost::filesystem::path>
+Film::ffmpeg_index_path (shared_ptr<const Content> content) const
+{
+	if (!_directory) {
+		return optional<boost::filesystem::path> ();
+	}
+
+	return dir ("index") / content->digest ();
+}
+
+/** Remove the FFmpegIndex for content with a given digest, unless some content in this
+ *  film still has that digest.
+ */
+void
+Film::remove_ffmpeg_index (string digest) const
+{
+	if (!_directory) {
+		return;
+	}
+
+	BOOST_FOREACH (shared_ptr<Content> i, content ()) {
+		if (i->digest() == digest) {
+			return;
+		}
+	}
+
+	boost::system::error_code ec;
+	boost::filesystem::remove (_directory.get() / "index" / digest, ec);
+}
+
+/** Remove any FFmpegIndex files which are not for any of the content in this film */
+void
+Film::clean_ffmpeg_indices () const
+{
+	if (!_directory) {
+		return;
+	}
+
+	boost::filesystem::path const dir = _directory.get() / "index";
+	if (!boost::filesystem::is_directory (dir)) {
+		return;
+	}
+
+	set<string> digests;
+	BOOST_FOREACH (shared_ptr<Content> i, content ()) {
+		digests.insert (i->digest ());
+	}
+
+	boost::system::error_code ec;
+	for (boost::filesystem::directory_iterator i = boost::filesystem::directory_iterator(dir, ec); i != boost::filesystem::directory_iterator(); i.increment(ec)) {
+		if (digests.find (i->path().filename().string()) == digests.end()) {
+			boost::filesystem::remove (i->path(), ec);
+		}
+	}
+}
+
 /** Add suitable Jobs to the JobManager to create a DCP for this Film */
 void
 Film::make_dcp ()
@@ -540,6 +599,10 @@ Film::read_metadata (optional<boost::filesystem::path> path)
 		set_backtrace_file (file ("backtrace.txt"));
 	}
 
+	if (!path) {
+		clean_ffmpeg_indices ();
+	}
+
 	_dirty = false;
 	return notes;
 }
@@ -1032,6 +1095,9 @@ Film::set_isdcf_date_today ()
 	_isdcf_date = boost::gregorian::day_clock::local_day ();
 }
 
+/** @return Path of a file that Writer can use to hold one encoded video frame which
+ *  it can't yet write to the picture asset, for when its spill file is full.
+ */
 boost::filesystem::path
 Film::j2c_path (int reel, Frame frame, Eyes eyes, bool tmp) const
 {
@@ -1059,6 +1125,19 @@ Film::j2c_path (int reel, Frame frame, Eyes eyes, bool tmp) const
 	return file (p);
 }
 
+/** @return Path of the file that Writer uses to hold encoded video frames which
+ *  it can't yet write to the picture asset.
+ */
+boost::filesystem::path
+Film::spill_path () const
+{
+	boost::filesystem::path p;
+	p /= "j2c";
+	p /= video_identifier ();
+	p /= "spill";
+	return file (p);
+}
+
 static
 bool
 cpl_summary_compare (CPLSummary const & a, CPLSummary const & b)
@@ -1194,6 +1273,7 @@ void
 Film::remove_content (shared_ptr<Content> c)
 {
 	_playlist->remove (c);
+	remove_ffmpeg_index (c->digest ());
 }
 
 void
@@ -1362,6 +1442,17 @@ Film::make_kdm (
 		throw InvalidSignerError ();
 	}
 
+	return dcp::DecryptedKDM (
+		cpl->id(), kdm_keys(cpl), from, until, cpl->content_title_text(), cpl->content_title_text(), dcp::LocalTime().as_string()
+		).encrypt (signer, recipient, trusted_devices, formulation, disable_forensic_marking_picture, disable_forensic_marking_audio);
+}
+
+/** @return The keys to put in a KDM for a CPL made from this film; these are any keys
+ *  which were imported with encrypted DCP content, and our own key for everything else.
+ */
+map<shared_ptr<const dcp::ReelMXF>, dcp::Key>
+Film::kdm_keys (shared_ptr<const dcp::CPL> cpl) const
+{
 	/* Find keys that have been added to imported, encrypted DCP content */
 	list<dcp::DecryptedKDMKey> imported_keys;
 	BOOST_FOREACH (shared_ptr<Content> i, content()) {
@@ -1398,12 +1489,86 @@ Film::make_kdm (
 		}
 	}
 
-	return dcp::DecryptedKDM (
-		cpl->id(), keys, from, until, cpl->content_title_text(), cpl->content_title_text(), dcp::LocalTime().as_string()
-		).encrypt (signer, recipient, trusted_devices, formulation, disable_forensic_marking_picture, disable_forensic_marking_audio);
+	return keys;
+}
+
+/** State shared between the threads of Film::make_kdms */
+struct KDMWork
+{
+	KDMWork ()
+		: next (0)
+	{}
+
+	boost::mutex mutex;
+	/** index into screens of the next screen to make a KDM for */
+	size_t next;
+	/** first exception thrown by any thread */
+	boost::exception_ptr error;
+
+	shared_ptr<const dcp::CPL> cpl;
+	map<shared_ptr<const dcp::ReelMXF>, dcp::Key> keys;
+	shared_ptr<const dcp::CertificateChain> signer;
+	vector<shared_ptr<Screen> > screens;
+	boost::posix_time::ptime from;
+	boost::posix_time::ptime until;
+	dcp::Formulation formulation;
+	bool disable_forensic_marking_picture;
+	optional<int> disable_forensic_marking_audio;
+	/** KDMs, in the same order as screens */
+	vector<optional<dcp::EncryptedKDM> > kdms;
+};
+
+static void
+make_kdms_thread (KDMWork* work)
+{
+	while (true) {
+		size_t index;
+		{
+			boost::mutex::scoped_lock lm (work->mutex);
+			if (work->next == work->screens.size() || work->error) {
+				return;
+			}
+			index = work->next++;
+		}
+
+		shared_ptr<Screen> screen = work->screens[index];
+		int const hour = screen->cinema ? screen->cinema->utc_offset_hour() : 0;
+		int const minute = screen->cinema ? screen->cinema->utc_offset_minute() : 0;
+
+		try {
+			dcp::EncryptedKDM const kdm = dcp::DecryptedKDM (
+				work->cpl->id(),
+				work->keys,
+				dcp::LocalTime (work->from, hour, minute),
+				dcp::LocalTime (work->until, hour, minute),
+				work->cpl->content_title_text(),
+				work->cpl->content_title_text(),
+				dcp::LocalTime().as_string()
+				).encrypt (
+					work->signer,
+					screen->recipient.get(),
+					screen->trusted_device_thumbprints(),
+					work->formulation,
+					work->disable_forensic_marking_picture,
+					work->disable_forensic_marking_audio
+					);
+
+			boost::mutex::scoped_lock lm (work->mutex);
+			work->kdms[index] = kdm;
+		} catch (...) {
+			boost::mutex::scoped_lock lm (work->mutex);
+			if (!work->error) {
+				work->error = boost::current_exception ();
+			}
+		}
+	}
 }
 
-/** @param screens Screens to make KDMs for.
+/** Make KDMs for a list of screens.  The CPL is read and the keys found once, and then
+ *  the KDMs are encrypted and signed in parallel; this gives the same result as calling
+ *  make_kdm() for each screen.  OpenSSL and xmlsec must have been set up for use from more
+ *  than one thread, which dcpomatic_setup() does with crypto_thread_setup().
+ *  @param screens Screens to make KDMs for.
  *  @param cpl_file Path to CPL to make KDMs for.
  *  @param from KDM from time expressed as a local time in the time zone of the Screen's Cinema.
  *  @param until KDM to time expressed as a local time in the time zone of the Screen's Cinema.
@@ -1411,6 +1576,7 @@ Film::make_kdm (
  *  @param disable_forensic_marking_picture true to disable forensic marking of picture.
  *  @param disable_forensic_marking_audio if not set, don't disable forensic marking of audio.  If set to 0,
  *  disable all forensic marking; if set above 0, disable forensic marking above that channel.
+ *  @return KDMs, in the same order as screens; screens without a recipient are skipped.
  */
 list<ScreenKDM>
 Film::make_kdms (
@@ -1423,25 +1589,52 @@ Film::make_kdms (
 	optional<int> disable_forensic_marking_audio
 	) const
 {
-	list<ScreenKDM> kdms;
+	KDMWork work;
 
 	BOOST_FOREACH (shared_ptr<Screen> i, screens) {
 		if (i->recipient) {
-			dcp::EncryptedKDM const kdm = make_kdm (
-				i->recipient.get(),
-				i->trusted_device_thumbprints(),
-				cpl_file,
-				dcp::LocalTime (from,  i->cinema ? i->cinema->utc_offset_hour() : 0, i->cinema ? i->cinema->utc_offset_minute() : 0),
-				dcp::LocalTime (until, i->cinema ? i->cinema->utc_offset_hour() : 0, i->cinema ? i->cinema->utc_offset_minute() : 0),
-				formulation,
-				disable_forensic_marking_picture,
-				disable_forensic_marking_audio
-				);
-
-			kdms.push_back (ScreenKDM (i, kdm));
+			work.screens.push_back (i);
 		}
 	}
 
+	if (work.screens.empty ()) {
+		return list<ScreenKDM> ();
+	}
+
+	if (!_encrypted) {
+		throw runtime_error (_("Cannot make a KDM as this project is not encrypted."));
+	}
+
+	work.cpl.reset (new dcp::CPL (cpl_file));
+	work.signer = Config::instance()->signer_chain ();
+	if (!work.signer->valid ()) {
+		throw InvalidSignerError ();
+	}
+
+	work.keys = kdm_keys (work.cpl);
+	work.from = from;
+	work.until = until;
+	work.formulation = formulation;
+	work.disable_forensic_marking_picture = disable_forensic_marking_picture;
+	work.disable_forensic_marking_audio = disable_forensic_marking_audio;
+	work.kdms.resize (work.screens.size ());
+
+	size_t const threads = min (work.screens.size(), size_t (max (1U, boost::thread::hardware_concurrency ())));
+	boost::thread_group pool;
+	for (size_t i = 0; i < threads; ++i) {
+		pool.create_thread (boost::bind (&make_kdms_thread, &work));
+	}
+	pool.join_all ();
+
+	if (work.error) {
+		boost::rethrow_exception (work.error);
+	}
+
+	list<ScreenKDM> kdms;
+	for (size_t i = 0; i < work.screens.size(); ++i) {
+		kdms.push_back (ScreenKDM (work.screens[i], work.kdms[i].get()));
+	}
+
 	return kdms;
 }
 
@@ -1543,6 +1736,9 @@ void
 Film::remove_content (ContentList c)
 {
 	_playlist->remove (c);
+	BOOST_FOREACH (shared_ptr<Content> i, c) {
+		remove_ffmpeg_index (i->digest ());
+	}
 }
 
 void
@@ -1694,36 +1890,10 @@ Film::closed_caption_tracks () const
 	return tt;
 }
 
-shared_ptr<InfoFileHandle>
-Film::info_file_handle (DCPTimePeriod period, bool read) const
-{
-	return shared_ptr<InfoFileHandle> (new InfoFileHandle(_info_file_mutex, info_file(period), read));
-}
-
-InfoFileHandle::InfoFileHandle (boost::mutex& mutex, boost::filesystem::path file, bool read)
-	: _lock (mutex)
-	, _file (file)
-{
-	if (read) {
-		_handle = fopen_boost (file, "rb");
-		if (!_handle) {
-			throw OpenFileError (file, errno, OpenFileError::READ);
-		}
-	} else {
-		bool const exists = boost::filesystem::exists (file);
-		if (exists) {
-			_handle = fopen_boost (file, "r+b");
-		} else {
-			_handle = fopen_boost (file, "wb");
-		}
-
-		if (!_handle) {
-			throw OpenFileError (file, errno, exists ? OpenFileError::READ_WRITE : OpenFileError::WRITE);
-		}
-	}
-}
-
-InfoFileHandle::~InfoFileHandle ()
+/** @return The video frame info file for a reel, opened and with space for all the reel's frames */
+shared_ptr<FrameInfoFile>
+Film::frame_info_file (DCPTimePeriod period) const
 {
-	fclose (_handle);
+	int64_t const frames = period.duration().frames_round (video_frame_rate ());
+	return shared_ptr<FrameInfoFile> (new FrameInfoFile (info_file (period), three_d() ? frames * 2 : frames));
 }
@@ -41,12 +41,18 @@
 #include <boost/thread/mutex.hpp>
 #include <string>
 #include <vector>
+#include <map>
 #include <inttypes.h>
 
 namespace xmlpp {
 	class Document;
 }
 
+namespace dcp {
+	class CPL;
+	class ReelMXF;
+}
+
 class DCPContentType;
 class Log;
 class Content;
@@ -59,31 +65,9 @@ class Ratio;
 class Job;
 class ScreenKDM;
 class Film;
+class FrameInfoFile;
 struct isdcf_name_test;
 
-class InfoFileHandle
-{
-public:
-	~InfoFileHandle ();
-
-	FILE* get () const {
-		return _handle;
-	}
-
-	boost::filesystem::path file () const {
-		return _file;
-	}
-
-private:
-	friend class Film;
-
-	InfoFileHandle (boost::mutex& mutex, boost::filesystem::path file, bool read);
-
-	boost::mutex::scoped_lock _lock;
-	FILE* _handle;
-	boost::filesystem::path _file;
-};
-
 /** @class Film
  *
  *  @brief A representation of some audio and video content, and details of
@@ -97,12 +81,15 @@ public:
 	explicit Film (boost::optional<boost::filesystem::path> dir);
 	~Film ();
 
-	boost::shared_ptr<InfoFileHandle> info_file_handle (DCPTimePeriod period, bool read) const;
+	boost::shared_ptr<FrameInfoFile> frame_info_file (DCPTimePeriod period) const;
 	boost::filesystem::path j2c_path (int, Frame, Eyes, bool) const;
+	boost::filesystem::path spill_path () const;
 	boost::filesystem::path internal_video_asset_dir () const;
 	boost::filesystem::path internal_video_asset_filename (DCPTimePeriod p) const;
 
 	boost::filesystem::path audio_analysis_path (boost::shared_ptr<const Playlist>) const;
+	boost::optional<boost::filesystem::path> ffmpeg_index_path (boost::shared_ptr<const Content> content) const;
+	void remove_ffmpeg_index (std::string digest) const;
 
 	void send_dcp_to_tms ();
 	void make_dcp ();
@@ -381,6 +368,8 @@ private:
 	void playlist_content_change (ChangeType type, boost::weak_ptr<Content>, int, bool frequent);
 	void maybe_add_content (boost::weak_ptr<Job>, boost::weak_ptr<Content>, bool disable_audio_analysis);
 	void audio_analysis_finished ();
+	void clean_ffmpeg_indices () const;
+	std::map<boost::shared_ptr<const dcp::ReelMXF>, dcp::Key> kdm_keys (boost::shared_ptr<const dcp::CPL> cpl) const;
 
 	static std::string const metadata_file;
 
@@ -442,9 +431,6 @@ private:
 	/** film being used as a template, or 0 */
 	boost::shared_ptr<Film> _template_film;
 
-
-	mutable boost::mutex _info_file_mutex;
-
 	boost::signals2::scoped_connection _playlist_change_connection;
 	boost::signals2::scoped_connection _playlist_order_changed_connection;
 	boost::signals2::scoped_connection _playlist_content_change_connection;
@@ -0,0 +1,235 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/frame_info_file.cc
+ *  @brief FrameInfoFile class.
+ */
+
+#include "frame_info_file.h"
+#include "exceptions.h"
+#include "cross.h"
+#ifdef DCPOMATIC_POSIX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <cstring>
+
+using std::max;
+using std::min;
+using std::string;
+
+/* 8 bytes of offset, 8 of size and 32 of hash */
+int const FrameInfoFile::record_size = 48;
+
+/** Open a frame info file, creating it if it does not exist.
+ *  @param file File name.
+ *  @param records Number of records to make space for; the file will grow if more are written.
+ */
+FrameInfoFile::FrameInfoFile (boost::filesystem::path file, int64_t records)
+	: _file (file)
+	, _records (0)
+	, _data (0)
+	, _handle (0)
+	, _last_written (-1)
+{
+	open_file (records);
+	_last_written = find_last_written ();
+}
+
+FrameInfoFile::~FrameInfoFile ()
+{
+	close_file ();
+}
+
+/** Open or map _file, making sure that it has space for at least the given number of records */
+void
+FrameInfoFile::open_file (int64_t records)
+{
+#ifdef DCPOMATIC_POSIX
+	int const fd = ::open (_file.c_str(), O_RDWR | O_CREAT, 0644);
+	if (fd == -1) {
+		throw OpenFileError (_file, errno, OpenFileError::READ_WRITE);
+	}
+
+	struct stat st;
+	if (fstat (fd, &st) == -1) {
+		int const e = errno;
+		::close (fd);
+		throw ReadFileError (_file, e);
+	}
+
+	_records = max (records, int64_t ((st.st_size + record_size - 1) / record_size));
+	int64_t const size = _records * record_size;
+	if (st.st_size < size && ftruncate (fd, size) == -1) {
+		int const e = errno;
+		::close (fd);
+		throw WriteFileError (_file, e);
+	}
+
+	if (size > 0) {
+		void* m = mmap (0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (m != MAP_FAILED) {
+			_data = static_cast<uint8_t*> (m);
+		}
+	}
+
+	::close (fd);
+
+	if (_data) {
+		return;
+	}
+#endif
+
+	/* We can't map the file, so keep it open and use stdio instead */
+	bool const exists = boost::filesystem::exists (_file);
+	_handle = fopen_boost (_file, exists ? "r+b" : "w+b");
+	if (!_handle) {
+		throw OpenFileError (_file, errno, exists ? OpenFileError::READ_WRITE : OpenFileError::WRITE);
+	}
+	_records = max (records, int64_t ((boost::filesystem::file_size (_file) + record_size - 1) / record_size));
+}
+
+void
+FrameInfoFile::close_file ()
+{
+#ifdef DCPOMATIC_POSIX
+	if (_data) {
+		munmap (_data, _records * record_size);
+		_data = 0;
+	}
+#endif
+
+	if (_handle) {
+		fclose (_handle);
+		_handle = 0;
+	}
+}
+
+/** Write a record.
+ *  @param index Index of the record to write.
+ *  @param info FrameInfo to write.
+ */
+void
+FrameInfoFile::write (int64_t index, dcp::FrameInfo const & info)
+{
+	uint8_t record[record_size];
+	memset (record, 0, record_size);
+	memcpy (record, &info.offset, 8);
+	memcpy (record + 8, &info.size, 8);
+	memcpy (record + 16, info.hash.c_str(), min (info.hash.size(), size_t (32)));
+
+	boost::mutex::scoped_lock lm (_mutex);
+
+	if (index >= _records) {
+		/* We need a bigger file */
+		close_file ();
+		open_file (max (index + 1, _records * 2));
+	}
+
+	if (_data) {
+		memcpy (_data + index * record_size, record, record_size);
+	} else {
+		dcpomatic_fseek (_handle, index * record_size, SEEK_SET);
+		if (fwrite (record, 1, record_size, _handle) != size_t (record_size)) {
+			throw WriteFileError (_file, errno);
+		}
+		fflush (_handle);
+	}
+
+	_last_written = max (_last_written, index);
+}
+
+/** Make sure that everything that has been written is in the file on disk */
+void
+FrameInfoFile::flush ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+#ifdef DCPOMATIC_POSIX
+	if (_data && msync (_data, _records * record_size, MS_SYNC) == -1) {
+		throw WriteFileError (_file, errno);
+	}
+#endif
+
+	if (_handle) {
+		fflush (_handle);
+	}
+}
+
+/** Read a record.
+ *  @param index Index of the record to read.
+ *  @return FrameInfo from the record.
+ */
+dcp::FrameInfo
+FrameInfoFile::read (int64_t index) const
+{
+	uint8_t record[record_size];
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		if (index < 0 || index >= _records) {
+			throw FileError ("Frame info index out of range", _file);
+		}
+		read_record (index, record);
+	}
+
+	dcp::FrameInfo info;
+	memcpy (&info.offset, record, 8);
+	memcpy (&info.size, record + 8, 8);
+	char const * hash = reinterpret_cast<char const *> (record + 16);
+	info.hash = string (hash, std::find (hash, hash + 32, '\0'));
+	return info;
+}
+
+/** Read a record's bytes; _mutex must be held by the caller */
+void
+FrameInfoFile::read_record (int64_t index, uint8_t* record) const
+{
+	if (_data) {
+		memcpy (record, _data + index * record_size, record_size);
+	} else {
+		dcpomatic_fseek (_handle, index * record_size, SEEK_SET);
+		size_t const N = fread (record, 1, record_size, _handle);
+		if (N != size_t (record_size)) {
+			/* Unwritten records past the end of the file are zeros */
+			memset (record + N, 0, record_size - N);
+		}
+	}
+}
+
+/** @return Index of the last record in the file that has been written (i.e. has a hash), or -1 */
+int64_t
+FrameInfoFile::find_last_written () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	uint8_t record[record_size];
+	for (int64_t i = _records - 1; i >= 0; --i) {
+		read_record (i, record);
+		if (record[16] != '\0') {
+			return i;
+		}
+	}
+
+	return -1;
+}
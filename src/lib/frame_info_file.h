@@ -0,0 +1,85 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/frame_info_file.h
+ *  @brief FrameInfoFile class.
+ */
+
+#ifndef DCPOMATIC_FRAME_INFO_FILE_H
+#define DCPOMATIC_FRAME_INFO_FILE_H
+
+#include <dcp/picture_asset_writer.h>
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <cstdio>
+
+/** @class FrameInfoFile
+ *  @brief An open video frame info file.
+ *
+ *  The file is an array of fixed-size records, each holding the dcp::FrameInfo
+ *  (offset, size and hash) of one J2K frame in a video asset.  It is made big enough
+ *  for the whole reel when it is opened, and held open (memory-mapped, where that is
+ *  possible) until this object is destroyed, so reading and writing records does not
+ *  need any system calls.  Records which have not yet been written are all zeros.
+ */
+class FrameInfoFile : public boost::noncopyable
+{
+public:
+	FrameInfoFile (boost::filesystem::path file, int64_t records);
+	~FrameInfoFile ();
+
+	void write (int64_t index, dcp::FrameInfo const & info);
+	dcp::FrameInfo read (int64_t index) const;
+	void flush ();
+
+	/** @return Index of the last record that has been written, or -1 if none has */
+	int64_t last_written () const {
+		boost::mutex::scoped_lock lm (_mutex);
+		return _last_written;
+	}
+
+	boost::filesystem::path file () const {
+		return _file;
+	}
+
+	/** size of each record in bytes */
+	static int const record_size;
+
+private:
+	void open_file (int64_t records);
+	void close_file ();
+	void read_record (int64_t index, uint8_t* record) const;
+	int64_t find_last_written () const;
+
+	boost::filesystem::path _file;
+	/** mutex for everything below */
+	mutable boost::mutex _mutex;
+	/** number of records that the file has space for */
+	int64_t _records;
+	/** the mapping of the file, or 0 if it could not be mapped */
+	uint8_t* _data;
+	/** handle used if the file could not be mapped */
+	FILE* _handle;
+	/** index of the last record that has been written, or -1 */
+	int64_t _last_written;
+};
+
+#endif
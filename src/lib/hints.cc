@@ -32,7 +32,14 @@
 #include "util.h"
 #include "cross.h"
 #include "player.h"
+#include "audio_analyser.h"
+#include "audio_analysis_pass.h"
+#include "job_manager.h"
+#include "digester.h"
+#include "exceptions.h"
 #include <dcp/raw_convert.h>
+#include <libcxml/cxml.h>
+#include <libxml++/libxml++.h>
 #include <boost/foreach.hpp>
 #include <boost/algorithm/string.hpp>
 #include <iostream>
@@ -228,67 +235,198 @@ Hints::thread ()
 		hint (_("You are using 3D content but your DCP is set to 2D.  Set the DCP to 3D if you want to play it back on a 3D system (e.g. Real-D, MasterImage etc.)"));
 	}
 
-	boost::filesystem::path path = film->audio_analysis_path (film->playlist ());
-	if (boost::filesystem::exists (path)) {
-		try {
-			shared_ptr<AudioAnalysis> an (new AudioAnalysis (path));
+	/* Look at the audio and the closed captions in one pass of a Player, unless
+	   we already have the results.  The audio analysis is written to the same
+	   place as an AnalyseAudioJob would write it, so the audio dialog can use it
+	   and we will not need to make it again next time.
+	*/
+	boost::filesystem::path const audio_path = film->audio_analysis_path (film->playlist ());
+	bool analyse_audio = false;
+	/* If an AnalyseAudioJob is already making the analysis there's no point in doing it again here */
+	if (!boost::filesystem::exists (audio_path) && !JobManager::instance()->analysing_audio (audio_path)) {
+		BOOST_FOREACH (shared_ptr<const Content> i, content) {
+			if (i->audio) {
+				analyse_audio = true;
+			}
+		}
+	}
+
+	boost::filesystem::path const text_path = text_hints_path (film);
+	bool const check_text = !read_text_hints (text_path);
+
+	if (analyse_audio || check_text) {
+		if (analyse_audio) {
+			emit (bind(boost::ref(Progress), _("Examining audio and closed captions")));
+		} else {
+			emit (bind(boost::ref(Progress), _("Examining closed captions")));
+		}
+
+		shared_ptr<Player> player (new Player (film, film->playlist ()));
+		player->set_ignore_video ();
+		player->set_fast ();
+		player->set_play_referenced ();
+		shared_ptr<AudioAnalyser> audio_analyser;
+		shared_ptr<AudioAnalysisPass> audio_pass;
+		if (analyse_audio) {
+			audio_analyser.reset (new AudioAnalyser (film, film->playlist(), true));
+			audio_pass.reset (new AudioAnalysisPass (audio_analyser, 0, audio_analyser->ebur128 ()));
+			player->Audio.connect (bind(&AudioAnalysisPass::audio, audio_pass.get(), _1, _2));
+		} else {
+			player->set_ignore_audio ();
+		}
+		if (check_text) {
+			player->Text.connect (bind(&Hints::text, this, _1, _2, _4));
+		} else {
+			player->set_ignore_text ();
+		}
 
-			string ch;
+		struct timeval last_pulse;
+		gettimeofday (&last_pulse, 0);
 
-			vector<AudioAnalysis::PeakTime> sample_peak = an->sample_peak ();
-			vector<float> true_peak = an->true_peak ();
+		bool stopped = false;
+		while (!player->pass()) {
 
-			for (size_t i = 0; i < sample_peak.size(); ++i) {
-				float const peak = max (sample_peak[i].peak, true_peak.empty() ? 0 : true_peak[i]);
-				float const peak_dB = 20 * log10 (peak) + an->gain_correction (film->playlist ());
-				if (peak_dB > -3) {
-					ch += dcp::raw_convert<string> (short_audio_channel_name (i)) + ", ";
+			struct timeval now;
+			gettimeofday (&now, 0);
+			if ((seconds(now) - seconds(last_pulse)) > 1) {
+				{
+					boost::mutex::scoped_lock lm (_mutex);
+					if (_stop) {
+						stopped = true;
+						break;
+					}
 				}
+				emit (bind (boost::ref(Pulse)));
+				last_pulse = now;
 			}
+		}
 
-			ch = ch.substr (0, ch.length() - 2);
-
-			if (!ch.empty ()) {
-				hint (String::compose (
-					      _("Your audio level is very high (on %1).  You should reduce the gain of your audio content."),
-					      ch
-					      )
-					);
+		/* Don't write anything that we have only half-finished */
+		if (!stopped) {
+			if (analyse_audio) {
+				audio_pass->finish ();
+				audio_analyser->finish()->write (audio_path);
+			}
+			if (check_text) {
+				write_text_hints (text_path);
 			}
-		} catch (OldFormatError& e) {
-			/* The audio analysis is too old to load in; just skip this hint as if
-			   it had never been run.
-			*/
 		}
 	}
 
-	emit (bind(boost::ref(Progress), _("Examining closed captions")));
+	audio_level_hint (film, audio_path);
+
+	emit (bind(boost::ref(Finished)));
+}
+
+void
+Hints::audio_level_hint (shared_ptr<const Film> film, boost::filesystem::path path)
+{
+	if (!boost::filesystem::exists (path)) {
+		return;
+	}
 
-	shared_ptr<Player> player (new Player (film, film->playlist ()));
-	player->set_ignore_video ();
-	player->set_ignore_audio ();
-	player->Text.connect (bind(&Hints::text, this, _1, _2, _4));
+	try {
+		shared_ptr<AudioAnalysis> an (new AudioAnalysis (path));
 
-	struct timeval last_pulse;
-	gettimeofday (&last_pulse, 0);
+		string ch;
 
-	while (!player->pass()) {
+		vector<AudioAnalysis::PeakTime> sample_peak = an->sample_peak ();
+		vector<float> true_peak = an->true_peak ();
 
-		struct timeval now;
-		gettimeofday (&now, 0);
-		if ((seconds(now) - seconds(last_pulse)) > 1) {
-			{
-				boost::mutex::scoped_lock lm (_mutex);
-				if (_stop) {
-					break;
-				}
+		for (size_t i = 0; i < sample_peak.size(); ++i) {
+			float const peak = max (sample_peak[i].peak, true_peak.empty() ? 0 : true_peak[i]);
+			float const peak_dB = 20 * log10 (peak) + an->gain_correction (film->playlist ());
+			if (peak_dB > -3) {
+				ch += dcp::raw_convert<string> (short_audio_channel_name (i)) + ", ";
 			}
-			emit (bind (boost::ref(Pulse)));
-			last_pulse = now;
 		}
+
+		ch = ch.substr (0, ch.length() - 2);
+
+		if (!ch.empty ()) {
+			hint (String::compose (
+				      _("Your audio level is very high (on %1).  You should reduce the gain of your audio content."),
+				      ch
+				      )
+				);
+		}
+	} catch (OldFormatError& e) {
+		/* The audio analysis is too old to load in; just skip this hint as if
+		   it had never been run.
+		*/
 	}
+}
 
-	emit (bind(boost::ref(Finished)));
+/** @return Path to a file in which to keep the results of our closed caption checks;
+ *  the name depends on everything which can change those results.
+ */
+boost::filesystem::path
+Hints::text_hints_path (shared_ptr<const Film> film) const
+{
+	Digester digester;
+	BOOST_FOREACH (shared_ptr<const Content> i, film->content()) {
+		if (i->text.empty()) {
+			continue;
+		}
+		digester.add (i->identifier ());
+		BOOST_FOREACH (shared_ptr<const TextContent> j, i->text) {
+			digester.add (j->use ());
+			digester.add (j->type ());
+			digester.add (j->identifier ());
+		}
+	}
+
+	digester.add (film->interop ());
+	digester.add (film->video_frame_rate ());
+
+	return film->dir("analysis") / ("hints_" + digester.get ());
+}
+
+/** Read the results of our closed caption checks from a previous run, and give the
+ *  corresponding hints.
+ *  @return true if the results were read.
+ */
+bool
+Hints::read_text_hints (boost::filesystem::path path)
+{
+	if (!boost::filesystem::exists (path)) {
+		return false;
+	}
+
+	try {
+		cxml::Document f ("TextHints");
+		f.read_file (path);
+		_long_ccap = f.bool_child ("LongCCAP");
+		_overlap_ccap = f.bool_child ("OverlapCCAP");
+		_too_many_ccap_lines = f.bool_child ("TooManyCCAPLines");
+	} catch (...) {
+		/* Something wrong with the file; just check again */
+		_long_ccap = _overlap_ccap = _too_many_ccap_lines = false;
+		return false;
+	}
+
+	if (_long_ccap) {
+		long_ccap_hint ();
+	}
+	if (_too_many_ccap_lines) {
+		too_many_ccap_lines_hint ();
+	}
+	if (_overlap_ccap) {
+		overlap_ccap_hint ();
+	}
+
+	return true;
+}
+
+void
+Hints::write_text_hints (boost::filesystem::path path) const
+{
+	xmlpp::Document doc;
+	xmlpp::Element* root = doc.create_root_node ("TextHints");
+	root->add_child("LongCCAP")->add_child_text (_long_ccap ? "1" : "0");
+	root->add_child("OverlapCCAP")->add_child_text (_overlap_ccap ? "1" : "0");
+	root->add_child("TooManyCCAPLines")->add_child_text (_too_many_ccap_lines ? "1" : "0");
+	doc.write_to_file_formatted (path.string ());
 }
 
 void
@@ -297,6 +435,24 @@ Hints::hint (string h)
 	emit(bind(boost::ref(Hint), h));
 }
 
+void
+Hints::long_ccap_hint ()
+{
+	hint (String::compose(_("Some of your closed captions have lines longer than %1 characters, so they will probably be word-wrapped."), CLOSED_CAPTION_LENGTH));
+}
+
+void
+Hints::too_many_ccap_lines_hint ()
+{
+	hint (String::compose(_("Some of your closed captions span more than %1 lines, so they will be truncated."), CLOSED_CAPTION_LINES));
+}
+
+void
+Hints::overlap_ccap_hint ()
+{
+	hint (_("You have overlapping closed captions, which are not allowed in Interop DCPs.  Change your DCP standard to SMPTE."));
+}
+
 void
 Hints::text (PlayerText text, TextType type, DCPTimePeriod period)
 {
@@ -310,13 +466,13 @@ Hints::text (PlayerText text, TextType type, DCPTimePeriod period)
 			++lines;
 			if (!_long_ccap) {
 				_long_ccap = true;
-				hint (String::compose(_("Some of your closed captions have lines longer than %1 characters, so they will probably be word-wrapped."), CLOSED_CAPTION_LENGTH));
+				long_ccap_hint ();
 			}
 		}
 	}
 
 	if (!_too_many_ccap_lines && lines > CLOSED_CAPTION_LINES) {
-		hint (String::compose(_("Some of your closed captions span more than %1 lines, so they will be truncated."), CLOSED_CAPTION_LINES));
+		too_many_ccap_lines_hint ();
 		_too_many_ccap_lines = true;
 	}
 
@@ -326,7 +482,7 @@ Hints::text (PlayerText text, TextType type, DCPTimePeriod period)
 	/* XXX: maybe overlapping closed captions (i.e. different languages) are OK with Interop? */
 	if (film->interop() && !_overlap_ccap && _last && _last->overlap(period)) {
 		_overlap_ccap = true;
-		hint (_("You have overlapping closed captions, which are not allowed in Interop DCPs.  Change your DCP standard to SMPTE."));
+		overlap_ccap_hint ();
 	}
 
 	_last = period;
@@ -24,6 +24,7 @@
 #include "dcp_text_track.h"
 #include "dcpomatic_time.h"
 #include <boost/weak_ptr.hpp>
+#include <boost/filesystem.hpp>
 #include <boost/signals2.hpp>
 #include <vector>
 #include <string>
@@ -47,6 +48,13 @@ private:
 	void thread ();
 	void hint (std::string h);
 	void text (PlayerText text, TextType type, DCPTimePeriod period);
+	void audio_level_hint (boost::shared_ptr<const Film> film, boost::filesystem::path path);
+	void long_ccap_hint ();
+	void overlap_ccap_hint ();
+	void too_many_ccap_lines_hint ();
+	boost::filesystem::path text_hints_path (boost::shared_ptr<const Film> film) const;
+	bool read_text_hints (boost::filesystem::path path);
+	void write_text_hints (boost::filesystem::path path) const;
 
 	boost::weak_ptr<const Film> _film;
 	boost::thread* _thread;
@@ -55,6 +55,11 @@ using std::runtime_error;
 using boost::shared_ptr;
 using dcp::Size;
 
+/** Approximate number of bytes of each strip of rows processed by crop_scale_window when
+ *  it is asked to work in strips.
+ */
+static int const strip_bytes = 128 * 1024;
+
 int
 Image::vertical_factor (int n) const
 {
@@ -126,10 +131,20 @@ Image::planes () const
  *  @param out_aligned true to make the output image aligned.
  *  @param fast Try to be fast at the possible expense of quality; at present this means using
  *  fast bilinear rather than bicubic scaling.
+ *  @param rows_ready If set, the scale is done in strips of rows and this is called with the output
+ *  image, the index of the first row and the number of rows as each strip becomes ready.  This allows
+ *  the caller to do further processing on each strip while it is still in cache.
  */
 shared_ptr<Image>
 Image::crop_scale_window (
-	Crop crop, dcp::Size inter_size, dcp::Size out_size, dcp::YUVToRGB yuv_to_rgb, AVPixelFormat out_format, bool out_aligned, bool fast
+	Crop crop,
+	dcp::Size inter_size,
+	dcp::Size out_size,
+	dcp::YUVToRGB yuv_to_rgb,
+	AVPixelFormat out_format,
+	bool out_aligned,
+	bool fast,
+	boost::function<void (Image const &, int, int)> rows_ready
 	) const
 {
 	/* Empirical testing suggests that sws_scale() will crash if
@@ -163,7 +178,14 @@ Image::crop_scale_window (
 	*/
 
 	shared_ptr<Image> out (new Image (out_format, out_size, out_aligned, (out_size.width - inter_size.width) / 2));
-	out->make_black ();
+	if (inter_size != out_size || rows_ready.empty()) {
+		/* Black out any padding, and also the bytes at the end of each line which sws_scale does
+		   not write, so that the image is the same every time.  If we are passing strips to
+		   rows_ready and there is no padding the image is only looked at by rows_ready, and only
+		   in the pixels that sws_scale writes, so we can save the time.
+		*/
+		out->make_black ();
+	}
 
 	/* Size of the image after any crop */
 	dcp::Size const cropped_size = crop.apply (size ());
@@ -236,12 +258,47 @@ Image::crop_scale_window (
 		scale_out_data[c] = out->data()[c] + x + out->stride()[c] * (corner.y / out->vertical_factor(c));
 	}
 
-	sws_scale (
-		scale_context,
-		scale_in_data, stride(),
-		0, cropped_size.height,
-		scale_out_data, out->stride()
-		);
+	if (rows_ready.empty()) {
+		sws_scale (
+			scale_context,
+			scale_in_data, stride(),
+			0, cropped_size.height,
+			scale_out_data, out->stride()
+			);
+	} else {
+		/* Feed the scaler with strips of input and pass each strip of output on as soon as
+		   sws_scale has finished with it.  The strip height must be a multiple of any vertical
+		   chroma subsampling.
+		*/
+		int const align = 1 << in_desc->log2_chroma_h;
+		int const strip = max (align, (strip_bytes / max (stride()[0], out->stride()[0])) & ~(align - 1));
+
+		if (corner.y > 0) {
+			rows_ready (*out, 0, corner.y);
+		}
+
+		int done = corner.y;
+		for (int y = 0; y < cropped_size.height; y += strip) {
+			uint8_t* slice_in_data[planes()];
+			for (int c = 0; c < planes(); ++c) {
+				slice_in_data[c] = scale_in_data[c] + stride()[c] * (y / vertical_factor(c));
+			}
+			int const rows = sws_scale (
+				scale_context,
+				slice_in_data, stride(),
+				y, min (strip, cropped_size.height - y),
+				scale_out_data, out->stride()
+				);
+			if (rows > 0) {
+				rows_ready (*out, done, rows);
+				done += rows;
+			}
+		}
+
+		if (done < out_size.height) {
+			rows_ready (*out, done, out_size.height - done);
+		}
+	}
 
 	sws_freeContext (scale_context);
 
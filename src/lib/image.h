@@ -34,6 +34,7 @@ extern "C" {
 #include <dcp/colour_conversion.h>
 #include <boost/shared_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
 
 struct AVFrame;
 class Socket;
@@ -63,7 +64,14 @@ public:
 	boost::shared_ptr<Image> convert_pixel_format (dcp::YUVToRGB yuv_to_rgb, AVPixelFormat out_format, bool aligned, bool fast) const;
 	boost::shared_ptr<Image> scale (dcp::Size out_size, dcp::YUVToRGB yuv_to_rgb, AVPixelFormat out_format, bool aligned, bool fast) const;
 	boost::shared_ptr<Image> crop_scale_window (
-		Crop crop, dcp::Size inter_size, dcp::Size out_size, dcp::YUVToRGB yuv_to_rgb, AVPixelFormat out_format, bool aligned, bool fast
+		Crop crop,
+		dcp::Size inter_size,
+		dcp::Size out_size,
+		dcp::YUVToRGB yuv_to_rgb,
+		AVPixelFormat out_format,
+		bool aligned,
+		bool fast,
+		boost::function<void (Image const &, int, int)> rows_ready = boost::function<void (Image const &, int, int)> ()
 		) const;
 
 	void make_black ();
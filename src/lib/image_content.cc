@@ -121,7 +121,7 @@ ImageContent::examine (shared_ptr<const Film> film, shared_ptr<Job> job)
 			throw FileError (_("No valid image files were found in the folder."), *_path_to_scan);
 		}
 
-		sort (paths.begin(), paths.end(), ImageFilenameSorter());
+		ImageFilenameSorter::sort (paths);
 		set_paths (paths);
 	}
 
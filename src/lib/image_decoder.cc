@@ -24,6 +24,8 @@
 #include "image.h"
 #include "ffmpeg_image_proxy.h"
 #include "j2k_image_proxy.h"
+#include "image_prefetcher.h"
+#include "config.h"
 #include "film.h"
 #include "exceptions.h"
 #include "video_content.h"
@@ -54,6 +56,18 @@ ImageDecoder::pass ()
 	if (!_image_content->still() || !_image) {
 		/* Either we need an image or we are using moving images, so load one */
 		boost::filesystem::path path = _image_content->path (_image_content->still() ? 0 : _frame_video_position);
+
+		if (!_image_content->still() && !_prefetcher && Config::instance()->image_readahead() > 0) {
+			_prefetcher.reset (new ImagePrefetcher (_image_content->paths(), Config::instance()->image_readahead()));
+		}
+
+		dcp::Data data;
+		if (_prefetcher) {
+			data = _prefetcher->get (_frame_video_position);
+		} else {
+			data = ImagePrefetcher::read (path);
+		}
+
 		if (valid_j2k_file (path)) {
 			AVPixelFormat pf;
 			if (_image_content->video->colour_conversion()) {
@@ -66,9 +80,9 @@ ImageDecoder::pass ()
 			/* We can't extract image size from a JPEG2000 codestream without decoding it,
 			   so pass in the image content's size here.
 			*/
-			_image.reset (new J2KImageProxy (path, _image_content->video->size(), pf));
+			_image.reset (new J2KImageProxy (data, _image_content->video->size(), pf));
 		} else {
-			_image.reset (new FFmpegImageProxy (path));
+			_image.reset (new FFmpegImageProxy (path, data));
 		}
 	}
 
@@ -23,6 +23,7 @@
 class ImageContent;
 class Log;
 class ImageProxy;
+class ImagePrefetcher;
 
 class ImageDecoder : public Decoder
 {
@@ -41,4 +42,6 @@ private:
 	boost::shared_ptr<const ImageContent> _image_content;
 	boost::shared_ptr<ImageProxy> _image;
 	Frame _frame_video_position;
+	/** Reader of files ahead of _frame_video_position, for moving images */
+	boost::shared_ptr<ImagePrefetcher> _prefetcher;
 };
@@ -31,6 +31,7 @@
 #include <dcp/openjpeg_image.h>
 #include <dcp/exceptions.h>
 #include <dcp/j2k.h>
+#include <cstring>
 #include <iostream>
 
 #include "i18n.h"
@@ -41,27 +42,119 @@ using std::sort;
 using boost::shared_ptr;
 using boost::optional;
 
+static uint32_t
+read_be32 (uint8_t const * p)
+{
+	return (uint32_t (p[0]) << 24) | (uint32_t (p[1]) << 16) | (uint32_t (p[2]) << 8) | p[3];
+}
+
+/** Read the image size from the SIZ marker segment which follows the SOC marker at the
+ *  start of a JPEG2000 codestream.
+ *  @param f File, positioned at the start of the codestream.
+ */
+static optional<dcp::Size>
+codestream_size (FILE* f)
+{
+	/* SOC, SIZ, Lsiz, Rsiz, Xsiz, Ysiz, XOsiz, YOsiz */
+	uint8_t b[24];
+	if (fread (b, 1, sizeof (b), f) != sizeof (b)) {
+		return optional<dcp::Size> ();
+	}
+
+	if (b[0] != 0xff || b[1] != 0x4f || b[2] != 0xff || b[3] != 0x51) {
+		return optional<dcp::Size> ();
+	}
+
+	uint32_t const width = read_be32 (b + 8);
+	uint32_t const height = read_be32 (b + 12);
+	uint32_t const x_offset = read_be32 (b + 16);
+	uint32_t const y_offset = read_be32 (b + 20);
+	if (width <= x_offset || height <= y_offset) {
+		return optional<dcp::Size> ();
+	}
+
+	return dcp::Size (width - x_offset, height - y_offset);
+}
+
+/** Find the size of a JPEG2000 image from its headers, without decoding it.
+ *  @param path Raw codestream or JP2 file.
+ *  @return Size, or empty if the headers could not be understood.
+ */
+optional<dcp::Size>
+j2k_size (boost::filesystem::path path)
+{
+	FILE* f = fopen_boost (path, "rb");
+	if (!f) {
+		return optional<dcp::Size> ();
+	}
+
+	optional<dcp::Size> size;
+
+	uint8_t b[16];
+	if (fread (b, 1, 2, f) == 2 && b[0] == 0xff && b[1] == 0x4f) {
+		/* Raw codestream */
+		dcpomatic_fseek (f, 0, SEEK_SET);
+		size = codestream_size (f);
+	} else {
+		/* JP2; look through the top-level boxes for the codestream */
+		int64_t position = 0;
+		dcpomatic_fseek (f, 0, SEEK_SET);
+		while (fread (b, 1, 8, f) == 8) {
+			int64_t length = read_be32 (b);
+			int header = 8;
+			if (length == 1) {
+				/* 64-bit length follows */
+				if (fread (b + 8, 1, 8, f) != 8) {
+					break;
+				}
+				length = (int64_t (read_be32 (b + 8)) << 32) | read_be32 (b + 12);
+				header = 16;
+			}
+
+			if (memcmp (b + 4, "jp2c", 4) == 0) {
+				size = codestream_size (f);
+				break;
+			}
+
+			if (length < header) {
+				/* Either this box runs to the end of the file or it is broken */
+				break;
+			}
+
+			position += length;
+			dcpomatic_fseek (f, position, SEEK_SET);
+		}
+	}
+
+	fclose (f);
+	return size;
+}
+
 ImageExaminer::ImageExaminer (shared_ptr<const Film> film, shared_ptr<const ImageContent> content, shared_ptr<Job>)
 	: _film (film)
 	, _image_content (content)
 {
 	boost::filesystem::path path = content->path(0).string ();
 	if (valid_j2k_file (path)) {
-		boost::uintmax_t size = boost::filesystem::file_size (path);
-		FILE* f = fopen_boost (path, "rb");
-		if (!f) {
-			throw FileError ("Could not open file for reading", path);
-		}
-		uint8_t* buffer = new uint8_t[size];
-		checked_fread (buffer, size, f, path);
-		fclose (f);
-		try {
-			_video_size = dcp::decompress_j2k (buffer, size, 0)->size ();
-		} catch (dcp::DCPReadError& e) {
+		/* Decoding a whole frame just to find its size is slow, so look at the headers first */
+		_video_size = j2k_size (path);
+		if (!_video_size) {
+			boost::uintmax_t size = boost::filesystem::file_size (path);
+			FILE* f = fopen_boost (path, "rb");
+			if (!f) {
+				throw FileError ("Could not open file for reading", path);
+			}
+			uint8_t* buffer = new uint8_t[size];
+			checked_fread (buffer, size, f, path);
+			fclose (f);
+			try {
+				_video_size = dcp::decompress_j2k (buffer, size, 0)->size ();
+			} catch (dcp::DCPReadError& e) {
+				delete[] buffer;
+				throw DecodeError (String::compose (_("Could not decode JPEG2000 file %1 (%2)"), path, e.what ()));
+			}
 			delete[] buffer;
-			throw DecodeError (String::compose (_("Could not decode JPEG2000 file %1 (%2)"), path, e.what ()));
 		}
-		delete[] buffer;
 	} else {
 		FFmpegImageProxy proxy(content->path(0));
 		_video_size = proxy.image().first->size();
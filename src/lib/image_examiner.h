@@ -43,3 +43,5 @@ private:
 	boost::optional<dcp::Size> _video_size;
 	Frame _video_length;
 };
+
+extern boost::optional<dcp::Size> j2k_size (boost::filesystem::path path);
@@ -23,40 +23,69 @@
 #include <boost/filesystem.hpp>
 #include <boost/foreach.hpp>
 #include <boost/optional.hpp>
+#include <algorithm>
 #include <iostream>
 
 using std::list;
 using std::string;
+using std::vector;
+using std::pair;
+using std::make_pair;
+using std::stable_sort;
 using dcp::locale_convert;
 using boost::optional;
 
-bool
-ImageFilenameSorter::operator() (boost::filesystem::path a, boost::filesystem::path b)
-{
-	string an = extract_numbers (a);
-	string bn = extract_numbers (b);
-
-	int const anl = an.length ();
-	int const bnl = bn.length ();
-
-	if (anl > bnl) {
-		bn = string(anl - bnl, '0') + bn;
-	} else if (bnl > anl) {
-		an = string(bnl - anl, '0') + an;
-	}
-
-	return an < bn;
-}
-
-string
-ImageFilenameSorter::extract_numbers (boost::filesystem::path p)
+/** @return The digits in the leaf of p without any leading zeros, so that two keys
+ *  can be compared as numbers of any length by key_less().
+ */
+static string
+key (boost::filesystem::path p)
 {
 	string numbers;
 	string const ps = p.leaf().string();
 	for (size_t i = 0; i < ps.size(); ++i) {
-		if (isdigit (ps[i])) {
+		if (isdigit (ps[i]) && (!numbers.empty() || ps[i] != '0')) {
 			numbers += ps[i];
 		}
 	}
 	return numbers;
 }
+
+static bool
+key_less (string const & a, string const & b)
+{
+	if (a.length() != b.length()) {
+		return a.length() < b.length();
+	}
+
+	return a < b;
+}
+
+static bool
+keyed_less (pair<string, boost::filesystem::path> const & a, pair<string, boost::filesystem::path> const & b)
+{
+	return key_less (a.first, b.first);
+}
+
+bool
+ImageFilenameSorter::operator() (boost::filesystem::path a, boost::filesystem::path b)
+{
+	return key_less (key (a), key (b));
+}
+
+/** Sort some paths, working out the key of each one only once */
+void
+ImageFilenameSorter::sort (vector<boost::filesystem::path>& paths)
+{
+	vector<pair<string, boost::filesystem::path> > keyed;
+	keyed.reserve (paths.size ());
+	BOOST_FOREACH (boost::filesystem::path const & i, paths) {
+		keyed.push_back (make_pair (key (i), i));
+	}
+
+	stable_sort (keyed.begin(), keyed.end(), keyed_less);
+
+	for (size_t i = 0; i < keyed.size(); ++i) {
+		paths[i] = keyed[i].second;
+	}
+}
@@ -20,12 +20,15 @@
 
 #include <boost/filesystem.hpp>
 #include <boost/optional.hpp>
+#include <vector>
 
+/** @class ImageFilenameSorter
+ *  @brief Order image filenames by the number made from all the digits in their leaf names.
+ */
 class ImageFilenameSorter
 {
 public:
 	bool operator() (boost::filesystem::path a, boost::filesystem::path b);
 
-private:
-	std::string extract_numbers (boost::filesystem::path p);
+	static void sort (std::vector<boost::filesystem::path>& paths);
 };
@@ -0,0 +1,245 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/image_prefetcher.cc
+ *  @brief ImagePrefetcher class.
+ */
+
+#include "image_prefetcher.h"
+#include "exceptions.h"
+#include "dcpomatic_assert.h"
+#include <dcp/exceptions.h>
+#ifdef DCPOMATIC_POSIX
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <boost/bind.hpp>
+#include <cerrno>
+
+using std::vector;
+using std::map;
+using std::min;
+
+/** Largest number of threads that we will use to read files */
+static int const max_threads = 8;
+
+/** @param paths Files in the sequence, one per frame.
+ *  @param frames Number of frames to read ahead of the one that was last asked for.
+ */
+ImagePrefetcher::ImagePrefetcher (vector<boost::filesystem::path> paths, int frames)
+	: _paths (paths)
+	, _frames (frames)
+	, _position (0)
+	, _next (0)
+	, _generation (0)
+	, _started (false)
+	, _stop (false)
+	, _memory (MemoryBudget::PREFETCHER)
+{
+	DCPOMATIC_ASSERT (_frames > 0);
+}
+
+ImagePrefetcher::~ImagePrefetcher ()
+{
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_stop = true;
+		_condition.notify_all ();
+	}
+
+	_threads.join_all ();
+}
+
+/** @return Contents of the file for a frame, waiting for it to be read if necessary.
+ *  Any error that happened when reading it is thrown here.
+ */
+dcp::Data
+ImagePrefetcher::get (Frame frame)
+{
+	DCPOMATIC_ASSERT (frame < Frame (_paths.size ()));
+
+	boost::mutex::scoped_lock lm (_mutex);
+
+	if (frame < _position || frame > _next) {
+		/* This frame isn't one that we have read or are reading, so start again from here */
+		_slots.clear ();
+		_next = frame;
+		++_generation;
+	} else {
+		/* Frames before this one won't be asked for */
+		_slots.erase (_slots.begin(), _slots.lower_bound (frame));
+	}
+
+	update_memory ();
+	_position = frame;
+
+	if (!_started) {
+		/* Start here, rather than in the constructor, so that we don't read from the
+		   start of the sequence if the first thing that happens is a seek.
+		*/
+		for (int i = 0; i < min (_frames, max_threads); ++i) {
+			boost::thread* t = _threads.create_thread (boost::bind (&ImagePrefetcher::thread, this));
+#ifdef DCPOMATIC_LINUX
+			pthread_setname_np (t->native_handle(), "image-prefetch");
+#else
+			(void) t;
+#endif
+		}
+		_started = true;
+	}
+
+	_condition.notify_all ();
+
+	map<Frame, Slot>::iterator i;
+	while ((i = _slots.find (frame)) == _slots.end() || !i->second.done) {
+		_condition.wait (lm);
+	}
+
+	Slot const slot = i->second;
+	_slots.erase (i);
+	update_memory ();
+	_position = frame + 1;
+	_condition.notify_all ();
+
+	if (slot.error) {
+		boost::rethrow_exception (slot.error);
+	}
+
+	return slot.data;
+}
+
+void
+ImagePrefetcher::thread ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	while (true) {
+		/* Wait until there is a frame within our readahead to read.  If memory is short
+		   we only read the one that get() wants next.
+		*/
+		while (
+			!_stop &&
+			(_next >= Frame (_paths.size ()) || _next >= _position + _frames || (_next > _position && MemoryBudget::instance()->exceeded()))
+			) {
+			_condition.wait (lm);
+		}
+
+		if (_stop) {
+			return;
+		}
+
+		Frame const frame = _next++;
+		int const generation = _generation;
+		boost::filesystem::path const path = _paths[frame];
+		_slots[frame] = Slot ();
+
+		lm.unlock ();
+		dcp::Data data;
+		boost::exception_ptr error;
+		/* current_exception() would make a std::runtime_error of what read() throws,
+		   so copy those exceptions to keep their type for whoever calls get().
+		*/
+		try {
+			data = read (path);
+		} catch (OpenFileError& e) {
+			error = boost::copy_exception (e);
+		} catch (ReadFileError& e) {
+			error = boost::copy_exception (e);
+		} catch (dcp::FileError& e) {
+			error = boost::copy_exception (e);
+		} catch (...) {
+			error = boost::current_exception ();
+		}
+		lm.lock ();
+
+		map<Frame, Slot>::iterator i = _slots.find (frame);
+		if (generation != _generation || i == _slots.end ()) {
+			/* The decoder has gone somewhere else while we were reading, so this is no use */
+			continue;
+		}
+
+		i->second.done = true;
+		i->second.data = data;
+		i->second.error = error;
+		update_memory ();
+		_condition.notify_all ();
+	}
+}
+
+/** Set our MemoryBudget account to the size of the files that we are holding; _mutex must be held */
+void
+ImagePrefetcher::update_memory ()
+{
+	uint64_t bytes = 0;
+	for (map<Frame, Slot>::const_iterator i = _slots.begin(); i != _slots.end(); ++i) {
+		bytes += i->second.data.size ();
+	}
+	_memory.set (bytes);
+}
+
+/** Read the whole of a file, telling the OS that we will read it once, in order,
+ *  where we can.
+ */
+dcp::Data
+ImagePrefetcher::read (boost::filesystem::path path)
+{
+#ifdef DCPOMATIC_POSIX
+	int const fd = open (path.c_str(), O_RDONLY);
+	if (fd == -1) {
+		throw OpenFileError (path, errno, OpenFileError::READ);
+	}
+
+#ifdef DCPOMATIC_LINUX
+	posix_fadvise (fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+#ifdef DCPOMATIC_OSX
+	fcntl (fd, F_RDAHEAD, 1);
+#endif
+
+	struct stat st;
+	if (fstat (fd, &st) == -1) {
+		int const e = errno;
+		close (fd);
+		throw ReadFileError (path, e);
+	}
+
+	dcp::Data data (st.st_size);
+	uint8_t* p = data.data().get ();
+	int64_t remaining = st.st_size;
+	while (remaining > 0) {
+		ssize_t const r = ::read (fd, p, remaining);
+		if (r == -1 && errno == EINTR) {
+			continue;
+		} else if (r <= 0) {
+			int const e = r == -1 ? errno : 0;
+			close (fd);
+			throw ReadFileError (path, e);
+		}
+		p += r;
+		remaining -= r;
+	}
+
+	close (fd);
+	return data;
+#else
+	return dcp::Data (path);
+#endif
+}
@@ -0,0 +1,100 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/image_prefetcher.h
+ *  @brief ImagePrefetcher class.
+ */
+
+#ifndef DCPOMATIC_IMAGE_PREFETCHER_H
+#define DCPOMATIC_IMAGE_PREFETCHER_H
+
+#include "types.h"
+#include "memory_budget.h"
+#include <dcp/data.h>
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/exception/all.hpp>
+#include <map>
+#include <vector>
+
+/** @class ImagePrefetcher
+ *  @brief Some threads which read the files of an image sequence ahead of the decoder.
+ *
+ *  Up to a given number of files after the one most recently asked for are read
+ *  in parallel, so that a decoder reading frames in order does not have to wait
+ *  for each file in turn (which is slow on network storage).  The threads are started
+ *  by the first get(), and the files that they have read count towards the MemoryBudget;
+ *  when that is exceeded only the file that get() is waiting for is read.
+ */
+class ImagePrefetcher : public boost::noncopyable
+{
+public:
+	ImagePrefetcher (std::vector<boost::filesystem::path> paths, int frames);
+	~ImagePrefetcher ();
+
+	dcp::Data get (Frame frame);
+
+	static dcp::Data read (boost::filesystem::path path);
+
+private:
+	struct Slot
+	{
+		Slot ()
+			: done (false)
+		{}
+
+		bool done;
+		dcp::Data data;
+		boost::exception_ptr error;
+	};
+
+	void thread ();
+	void update_memory ();
+
+	std::vector<boost::filesystem::path> _paths;
+	/** Maximum number of frames to read ahead */
+	int _frames;
+	boost::thread_group _threads;
+	/** Mutex for everything below */
+	boost::mutex _mutex;
+	/** Condition to tell the threads that there is something to read, or to tell
+	 *  get() that something has been read.
+	 */
+	boost::condition _condition;
+	/** Frames that are being read, or have been read, indexed by frame */
+	std::map<Frame, Slot> _slots;
+	/** Frame that we expect to be asked for next */
+	Frame _position;
+	/** Next frame for a thread to read */
+	Frame _next;
+	/** Incremented when the decoder jumps to a frame that we did not expect, so
+	 *  that threads can discard data that they were reading from before.
+	 */
+	int _generation;
+	/** true if the threads have been started */
+	bool _started;
+	bool _stop;
+	/** Memory used by the files in _slots */
+	MemoryBudget::Account _memory;
+};
+
+#endif
@@ -67,6 +67,8 @@ get_from_url (string url, bool pasv, bool skip_pasv_ip, ScopedTemporary& temp)
 
 	/* Maximum time is 20s */
 	curl_easy_setopt (curl, CURLOPT_TIMEOUT, 20);
+	/* This may be called from any thread, where signals cannot be used to time out */
+	curl_easy_setopt (curl, CURLOPT_NOSIGNAL, 1L);
 
 	CURLcode const cr = curl_easy_perform (curl);
 
@@ -55,6 +55,8 @@ using dcp::Data;
 J2KEncoder::J2KEncoder (shared_ptr<const Film> film, shared_ptr<Writer> writer)
 	: _film (film)
 	, _history (200)
+	, _memory (MemoryBudget::ENCODER)
+	, _memory_logged (false)
 	, _writer (writer)
 {
 	servers_list_changed ();
@@ -189,9 +191,14 @@ J2KEncoder::encode (shared_ptr<PlayerVideo> pv, DCPTime time)
 	boost::mutex::scoped_lock queue_lock (_queue_mutex);
 
 	/* Wait until the queue has gone down a bit.  Allow one thing in the queue even
-	   when there are no threads.
+	   when there are no threads.  If frames are using too much memory, wait until
+	   the queue has emptied so that we do not make it any worse.
 	*/
-	while (_queue.size() >= (threads * 2) + 1) {
+	while (_queue.size() >= (threads * 2) + 1 || (!_queue.empty() && MemoryBudget::instance()->exceeded())) {
+		if (_queue.size() < (threads * 2) + 1 && !_memory_logged) {
+			LOG_GENERAL ("Encoder waiting for memory: %1", MemoryBudget::instance()->summary());
+			_memory_logged = true;
+		}
 		LOG_TIMING ("decoder-sleep queue=%1 threads=%2", _queue.size(), threads);
 		_full_condition.wait (queue_lock);
 		LOG_TIMING ("decoder-wake queue=%1 threads=%2", _queue.size(), threads);
@@ -231,6 +238,7 @@ J2KEncoder::encode (shared_ptr<PlayerVideo> pv, DCPTime time)
 						  _film->resolution()
 						  )
 					  ));
+		update_memory ();
 
 		/* The queue might not be empty any more, so notify anything which is
 		   waiting on that.
@@ -301,6 +309,7 @@ try
 
 			LOG_TIMING ("encoder-pop thread=%1 frame=%2 eyes=%3", thread_id(), vf->index(), (int) vf->eyes ());
 			_queue.pop_front ();
+			update_memory ();
 
 			lock.unlock ();
 
@@ -348,6 +357,7 @@ try
 				lock.lock ();
 				LOG_GENERAL (N_("[%1] J2KEncoder thread pushes frame %2 back onto queue after failure"), thread_id(), vf->index());
 				_queue.push_front (vf);
+				update_memory ();
 				lock.unlock ();
 			}
 		}
@@ -372,6 +382,17 @@ catch (...)
 	_full_condition.notify_all ();
 }
 
+/** Tell the memory budget how much our queue is using.  Caller must hold a lock on _queue_mutex */
+void
+J2KEncoder::update_memory ()
+{
+	uint64_t m = 0;
+	BOOST_FOREACH (shared_ptr<DCPVideo> i, _queue) {
+		m += i->memory_used ();
+	}
+	_memory.set (m);
+}
+
 void
 J2KEncoder::servers_list_changed ()
 {
@@ -29,6 +29,7 @@
 #include "cross.h"
 #include "event_history.h"
 #include "exception_store.h"
+#include "memory_budget.h"
 #include <boost/shared_ptr.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition.hpp>
@@ -80,6 +81,7 @@ private:
 	void frame_done ();
 
 	void encoder_thread (boost::optional<EncodeServerDescription>);
+	void update_memory ();
 	void terminate_threads ();
 
 	/** Film that we are encoding */
@@ -96,6 +98,10 @@ private:
 	boost::condition _empty_condition;
 	/** condition to manage thread wakeups when we have too much to do */
 	boost::condition _full_condition;
+	/** our share of the memory budget; protected by _queue_mutex */
+	MemoryBudget::Account _memory;
+	/** true if we have logged that the memory budget has made us wait; protected by _queue_mutex */
+	bool _memory_logged;
 
 	boost::shared_ptr<Writer> _writer;
 	Waker _waker;
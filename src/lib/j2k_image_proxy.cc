@@ -46,6 +46,34 @@ using boost::dynamic_pointer_cast;
 using dcp::Data;
 using dcp::raw_convert;
 
+/** A `deleter' for a boost::shared_array which points into a frame that we
+ *  got from libdcp.  It deletes nothing, but keeps the frame alive for as long
+ *  as anything refers to its data.
+ */
+template <class T>
+class FrameKeeper
+{
+public:
+	explicit FrameKeeper (shared_ptr<const T> frame)
+		: _frame (frame)
+	{}
+
+	void operator() (uint8_t *) {}
+
+private:
+	shared_ptr<const T> _frame;
+};
+
+/** @return Data which refers to some JPEG2000 data inside a frame from libdcp,
+ *  without copying it.  The data must not be modified.
+ */
+template <class T>
+static Data
+frame_data (shared_ptr<const T> frame, uint8_t const * data, int size)
+{
+	return Data (boost::shared_array<uint8_t> (const_cast<uint8_t*> (data), FrameKeeper<T> (frame)), size);
+}
+
 /** Construct a J2KImageProxy from a JPEG2000 file */
 J2KImageProxy::J2KImageProxy (boost::filesystem::path path, dcp::Size size, AVPixelFormat pixel_format)
 	: _data (path)
@@ -62,14 +90,13 @@ J2KImageProxy::J2KImageProxy (
 	AVPixelFormat pixel_format,
 	optional<int> forced_reduction
 	)
-	: _data (frame->j2k_size ())
+	: _data (frame_data (frame, frame->j2k_data(), frame->j2k_size()))
 	, _size (size)
 	, _pixel_format (pixel_format)
 	, _forced_reduction (forced_reduction)
 {
 	/* ::image assumes 16bpp */
 	DCPOMATIC_ASSERT (_pixel_format == AV_PIX_FMT_RGB48 || _pixel_format == AV_PIX_FMT_XYZ12LE);
-	memcpy (_data.data().get(), frame->j2k_data(), _data.size ());
 }
 
 J2KImageProxy::J2KImageProxy (
@@ -86,14 +113,13 @@ J2KImageProxy::J2KImageProxy (
 {
 	/* ::image assumes 16bpp */
 	DCPOMATIC_ASSERT (_pixel_format == AV_PIX_FMT_RGB48 || _pixel_format == AV_PIX_FMT_XYZ12LE);
+	/* Both eyes' proxies can share the same frame, so there is no need to read it twice */
 	switch (eye) {
 	case dcp::EYE_LEFT:
-		_data = Data (frame->left_j2k_size ());
-		memcpy (_data.data().get(), frame->left_j2k_data(), _data.size ());
+		_data = frame_data (frame, frame->left_j2k_data(), frame->left_j2k_size());
 		break;
 	case dcp::EYE_RIGHT:
-		_data = Data (frame->right_j2k_size ());
-		memcpy (_data.data().get(), frame->right_j2k_data(), _data.size ());
+		_data = frame_data (frame, frame->right_j2k_data(), frame->right_j2k_size());
 		break;
 	}
 }
@@ -113,6 +139,34 @@ J2KImageProxy::J2KImageProxy (shared_ptr<cxml::Node> xml, shared_ptr<Socket> soc
 	socket->read (_data.data().get (), _data.size ());
 }
 
+/** Interleave three planes of ints from OpenJPEG into a packed 16-bit-per-component image.
+ *  The inner loop has no dependencies between iterations and stores each component at a
+ *  fixed stride, so that the compiler can vectorise it.
+ *  @param a First component.
+ *  @param b Second component.
+ *  @param c Third component.
+ *  @param size Size of the components in pixels.
+ *  @param shift Amount to shift each value left by.
+ *  @param out First row of the output.
+ *  @param out_stride Stride of the output in bytes.
+ */
+static void
+planar_to_packed_16 (int const * a, int const * b, int const * c, dcp::Size size, int shift, uint8_t* out, int out_stride)
+{
+	int const width = size.width;
+	for (int y = 0; y < size.height; ++y) {
+		uint16_t* q = reinterpret_cast<uint16_t*> (out + y * out_stride);
+		for (int x = 0; x < width; ++x) {
+			q[x * 3 + 0] = a[x] << shift;
+			q[x * 3 + 1] = b[x] << shift;
+			q[x * 3 + 2] = c[x] << shift;
+		}
+		a += width;
+		b += width;
+		c += width;
+	}
+}
+
 int
 J2KImageProxy::prepare (optional<dcp::Size> target_size) const
 {
@@ -146,27 +200,14 @@ J2KImageProxy::prepare (optional<dcp::Size> target_size) const
 	*/
 	_image.reset (new Image (_pixel_format, decompressed->size(), true, decompressed->size().width));
 
-	int const shift = 16 - decompressed->precision (0);
-
 	/* Copy data in whatever format (sRGB or XYZ) into our Image; I'm assuming
 	   the data is 12-bit either way.
 	*/
-
-	int const width = decompressed->size().width;
-
-	int p = 0;
-	int* decomp_0 = decompressed->data (0);
-	int* decomp_1 = decompressed->data (1);
-	int* decomp_2 = decompressed->data (2);
-	for (int y = 0; y < decompressed->size().height; ++y) {
-		uint16_t* q = (uint16_t *) (_image->data()[0] + y * _image->stride()[0]);
-		for (int x = 0; x < width; ++x) {
-			*q++ = decomp_0[p] << shift;
-			*q++ = decomp_1[p] << shift;
-			*q++ = decomp_2[p] << shift;
-			++p;
-		}
-	}
+	planar_to_packed_16 (
+		decompressed->data(0), decompressed->data(1), decompressed->data(2),
+		decompressed->size(), 16 - decompressed->precision(0),
+		_image->data()[0], _image->stride()[0]
+		);
 
 	_target_size = target_size;
 	_reduce = reduce;
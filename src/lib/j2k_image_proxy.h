@@ -32,6 +32,7 @@ class J2KImageProxy : public ImageProxy
 {
 public:
 	J2KImageProxy (boost::filesystem::path path, dcp::Size, AVPixelFormat pixel_format);
+	J2KImageProxy (dcp::Data data, dcp::Size size, AVPixelFormat pixel_format);
 
 	J2KImageProxy (
 		boost::shared_ptr<const dcp::MonoPictureFrame> frame,
@@ -71,11 +72,6 @@ public:
 	size_t memory_used () const;
 
 private:
-	friend struct client_server_test_j2k;
-
-	/* For tests */
-	J2KImageProxy (dcp::Data data, dcp::Size size, AVPixelFormat pixel_format);
-
 	dcp::Data _data;
 	dcp::Size _size;
 	boost::optional<dcp::Eye> _eye;
@@ -219,6 +219,22 @@ JobManager::drop ()
 	_instance = 0;
 }
 
+/** @return true if an AnalyseAudioJob which will write an analysis to path is waiting or running */
+bool
+JobManager::analysing_audio (boost::filesystem::path path) const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	BOOST_FOREACH (shared_ptr<Job> i, _jobs) {
+		shared_ptr<AnalyseAudioJob> a = dynamic_pointer_cast<AnalyseAudioJob> (i);
+		if (a && a->path() == path && !a->finished()) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 void
 JobManager::analyse_audio (
 	shared_ptr<const Film> film,
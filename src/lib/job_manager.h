@@ -26,6 +26,7 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/thread.hpp>
 #include <boost/signals2.hpp>
+#include <boost/filesystem.hpp>
 #include <boost/thread/condition.hpp>
 #include <list>
 
@@ -64,6 +65,8 @@ public:
 		boost::function<void()> ready
 		);
 
+	bool analysing_audio (boost::filesystem::path path) const;
+
 	boost::signals2::signal<void (boost::weak_ptr<Job>)> JobAdded;
 	boost::signals2::signal<void ()> JobsReordered;
 	boost::signals2::signal<void (boost::optional<std::string>, boost::optional<std::string>)> ActiveJobsChanged;
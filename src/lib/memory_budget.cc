@@ -0,0 +1,155 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/memory_budget.cc
+ *  @brief MemoryBudget class.
+ */
+
+#include "memory_budget.h"
+#include "config.h"
+#include "cross.h"
+#include "compose.hpp"
+#include "dcpomatic_assert.h"
+
+using std::string;
+
+boost::mutex MemoryBudget::_instance_mutex;
+MemoryBudget* MemoryBudget::_instance = 0;
+
+MemoryBudget::MemoryBudget ()
+	: _physical (physical_memory ())
+{
+	for (int i = 0; i < STAGES; ++i) {
+		_used[i] = 0;
+	}
+}
+
+/** @return Maximum number of bytes that frames should use, or 0 for no limit */
+uint64_t
+MemoryBudget::limit () const
+{
+	int const budget = Config::instance()->memory_budget ();
+	if (budget > 0) {
+		return uint64_t (budget) * 1024 * 1024;
+	}
+
+	/* Leave the other half for everything else that we (and anyone else) are doing */
+	return _physical / 2;
+}
+
+/** @return true if frames are using more memory than they should be */
+bool
+MemoryBudget::exceeded () const
+{
+	uint64_t const l = limit ();
+	return l > 0 && used () > l;
+}
+
+/** @return Total memory used by frames in the stages which count towards the limit, in bytes */
+uint64_t
+MemoryBudget::used () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return used_unlocked ();
+}
+
+/** As used(), but _mutex must be held by the caller */
+uint64_t
+MemoryBudget::used_unlocked () const
+{
+	uint64_t u = 0;
+	for (int i = 0; i < STAGES; ++i) {
+		if (i != PREVIEW) {
+			u += _used[i];
+		}
+	}
+	return u;
+}
+
+/** @return Memory used by frames in one stage, in bytes */
+uint64_t
+MemoryBudget::used (Stage stage) const
+{
+	DCPOMATIC_ASSERT (stage >= 0 && stage < STAGES);
+	boost::mutex::scoped_lock lm (_mutex);
+	return _used[stage];
+}
+
+/** @return Description of the memory used in each stage, for logs */
+string
+MemoryBudget::summary () const
+{
+	uint64_t const mb = 1024 * 1024;
+	return String::compose (
+		"butler %1MB, encoder %2MB, writer %3MB, prefetcher %4MB; limit %5MB; preview %6MB",
+		used(BUTLER) / mb, used(ENCODER) / mb, used(WRITER) / mb, used(PREFETCHER) / mb, limit() / mb, used(PREVIEW) / mb
+		);
+}
+
+void
+MemoryBudget::change (Stage stage, uint64_t from, uint64_t to)
+{
+	DCPOMATIC_ASSERT (stage >= 0 && stage < STAGES);
+
+	uint64_t const l = limit ();
+
+	boost::mutex::scoped_lock lm (_mutex);
+	DCPOMATIC_ASSERT (_used[stage] >= from);
+	uint64_t const before = used_unlocked ();
+	_used[stage] = _used[stage] - from + to;
+	uint64_t const after = used_unlocked ();
+	lm.unlock ();
+
+	if (l > 0 && before > l && after <= l) {
+		Freed ();
+	}
+}
+
+MemoryBudget*
+MemoryBudget::instance ()
+{
+	boost::mutex::scoped_lock lm (_instance_mutex);
+	if (!_instance) {
+		_instance = new MemoryBudget ();
+	}
+	return _instance;
+}
+
+MemoryBudget::Account::Account (Stage stage)
+	: _stage (stage)
+	, _bytes (0)
+{
+
+}
+
+MemoryBudget::Account::~Account ()
+{
+	set (0);
+}
+
+/** Set the memory used by this account.  This must not be called from more than one
+ *  thread at once; usually the caller will hold a lock on whatever is being accounted.
+ */
+void
+MemoryBudget::Account::set (uint64_t bytes)
+{
+	MemoryBudget::instance()->change (_stage, _bytes, bytes);
+	_bytes = bytes;
+}
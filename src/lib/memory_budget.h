@@ -0,0 +1,112 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/memory_budget.h
+ *  @brief MemoryBudget class.
+ */
+
+#ifndef DCPOMATIC_MEMORY_BUDGET_H
+#define DCPOMATIC_MEMORY_BUDGET_H
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/signals2.hpp>
+#include <stdint.h>
+#include <string>
+
+/** @class MemoryBudget
+ *  @brief Keeper of the total memory used by frames which are waiting somewhere in the
+ *  pipeline between decoding and writing.
+ *
+ *  Each butler, J2K encoder, writer and image prefetcher has an Account which it keeps up
+ *  to date with the memory that its frames are using.  When the total goes over the limit
+ *  (from Config) they each hold fewer frames than they otherwise would: the butler stops
+ *  reading ahead once it has the minimum that it needs, the encoder stops accepting frames
+ *  until its queue has emptied, the writer pushes more of its waiting frames to disk and
+ *  the prefetcher only reads the file that its decoder is waiting for.
+ *
+ *  Butlers which feed previews use the PREVIEW stage; that is counted so that it can be
+ *  reported, but not against the limit, so that an idle viewer does not slow down an encode.
+ */
+class MemoryBudget : public boost::noncopyable
+{
+public:
+	enum Stage {
+		BUTLER,
+		ENCODER,
+		WRITER,
+		PREFETCHER,
+		/** not counted towards the limit */
+		PREVIEW,
+		STAGES
+	};
+
+	/** @class Account
+	 *  @brief Memory used by one thing in a given stage.
+	 */
+	class Account : public boost::noncopyable
+	{
+	public:
+		explicit Account (Stage stage);
+		~Account ();
+
+		void set (uint64_t bytes);
+
+		Stage stage () const {
+			return _stage;
+		}
+
+	private:
+		Stage _stage;
+		uint64_t _bytes;
+	};
+
+	bool exceeded () const;
+	uint64_t used () const;
+	uint64_t used (Stage stage) const;
+	uint64_t limit () const;
+	std::string summary () const;
+
+	static MemoryBudget* instance ();
+
+	/** Emitted, from the thread which changed an Account, when memory has been freed
+	 *  so that the limit is no longer exceeded.  Handlers must not take any lock which
+	 *  may be held by something calling Account::set().
+	 */
+	boost::signals2::signal<void ()> Freed;
+
+private:
+	MemoryBudget ();
+
+	void change (Stage stage, uint64_t from, uint64_t to);
+	uint64_t used_unlocked () const;
+
+	/** Physical memory in the machine, or 0 if we don't know */
+	uint64_t _physical;
+	/** Mutex for _used */
+	mutable boost::mutex _mutex;
+	/** Memory used in each stage, in bytes */
+	uint64_t _used[STAGES];
+
+	static boost::mutex _instance_mutex;
+	static MemoryBudget* _instance;
+};
+
+#endif
@@ -44,6 +44,8 @@
 #include "text_decoder.h"
 #include "ffmpeg_content.h"
 #include "audio_content.h"
+#include "audio_matrix.h"
+#include "video_content.h"
 #include "dcp_decoder.h"
 #include "image_decoder.h"
 #include "compose.hpp"
@@ -73,6 +75,7 @@ using std::copy;
 using boost::shared_ptr;
 using boost::weak_ptr;
 using boost::dynamic_pointer_cast;
+using boost::const_pointer_cast;
 using boost::optional;
 using boost::scoped_ptr;
 
@@ -100,7 +103,7 @@ Player::Player (shared_ptr<const Film> film, shared_ptr<const Playlist> playlist
 	   be first.
 	*/
 	_playlist_change_connection = _playlist->Change.connect (bind (&Player::playlist_change, this, _1), boost::signals2::at_front);
-	_playlist_content_change_connection = _playlist->ContentChange.connect (bind(&Player::playlist_content_change, this, _1, _3, _4));
+	_playlist_content_change_connection = _playlist->ContentChange.connect (bind(&Player::playlist_content_change, this, _1, _2, _3, _4));
 	set_video_container_size (_film->frame_size ());
 
 	film_change (CHANGE_TYPE_DONE, Film::AUDIO_PROCESSOR);
@@ -133,108 +136,223 @@ have_audio (shared_ptr<Piece> piece)
 	return piece->decoder && piece->decoder->audio;
 }
 
-void
-Player::setup_pieces_unlocked ()
+/** Make a Piece for some content.
+ *  @return Piece, or 0 if we can't or needn't play the content.
+ */
+shared_ptr<Piece>
+Player::make_piece (shared_ptr<Content> content)
 {
-	_pieces.clear ();
+	if (!content->paths_valid ()) {
+		return shared_ptr<Piece> ();
+	}
 
-	delete _shuffler;
-	_shuffler = new Shuffler();
-	_shuffler->Video.connect(bind(&Player::video, this, _1, _2));
+	if (_ignore_video && _ignore_audio && content->text.empty()) {
+		/* We're only interested in text and this content has none */
+		return shared_ptr<Piece> ();
+	}
 
-	BOOST_FOREACH (shared_ptr<Content> i, _playlist->content ()) {
+	shared_ptr<Decoder> decoder = decoder_factory (_film, content, _fast);
+	FrameRateChange frc (_film, content);
 
-		if (!i->paths_valid ()) {
-			continue;
-		}
+	if (!decoder) {
+		/* Not something that we can decode; e.g. Atmos content */
+		return shared_ptr<Piece> ();
+	}
 
-		if (_ignore_video && _ignore_audio && i->text.empty()) {
-			/* We're only interested in text and this content has none */
-			continue;
-		}
+	if (decoder->video && _ignore_video) {
+		decoder->video->set_ignore (true);
+	}
 
-		shared_ptr<Decoder> decoder = decoder_factory (_film, i, _fast);
-		FrameRateChange frc (_film, i);
+	if (decoder->audio && _ignore_audio) {
+		decoder->audio->set_ignore (true);
+	}
 
-		if (!decoder) {
-			/* Not something that we can decode; e.g. Atmos content */
-			continue;
+	if (_ignore_text) {
+		BOOST_FOREACH (shared_ptr<TextDecoder> i, decoder->text) {
+			i->set_ignore (true);
 		}
+	}
 
-		if (decoder->video && _ignore_video) {
-			decoder->video->set_ignore (true);
+	shared_ptr<DCPDecoder> dcp = dynamic_pointer_cast<DCPDecoder> (decoder);
+	if (dcp) {
+		dcp->set_decode_referenced (_play_referenced);
+		if (_play_referenced) {
+			dcp->set_forced_reduction (_dcp_decode_reduction);
 		}
+	}
 
-		if (decoder->audio && _ignore_audio) {
-			decoder->audio->set_ignore (true);
-		}
+	shared_ptr<Piece> piece (new Piece (content, decoder, frc));
 
-		if (_ignore_text) {
-			BOOST_FOREACH (shared_ptr<TextDecoder> i, decoder->text) {
-				i->set_ignore (true);
-			}
+	if (decoder->video) {
+		if (content->video->frame_type() == VIDEO_FRAME_TYPE_3D_LEFT || content->video->frame_type() == VIDEO_FRAME_TYPE_3D_RIGHT) {
+			/* We need a Shuffler to cope with 3D L/R video data arriving out of sequence */
+			decoder->video->Data.connect (bind (&Shuffler::video, _shuffler, weak_ptr<Piece>(piece), _1));
+		} else {
+			decoder->video->Data.connect (bind (&Player::video, this, weak_ptr<Piece>(piece), _1));
 		}
+	}
 
-		shared_ptr<DCPDecoder> dcp = dynamic_pointer_cast<DCPDecoder> (decoder);
-		if (dcp) {
-			dcp->set_decode_referenced (_play_referenced);
-			if (_play_referenced) {
-				dcp->set_forced_reduction (_dcp_decode_reduction);
-			}
-		}
+	if (decoder->audio) {
+		decoder->audio->Data.connect (bind (&Player::audio, this, weak_ptr<Piece> (piece), _1, _2));
+	}
 
-		shared_ptr<Piece> piece (new Piece (i, decoder, frc));
-		_pieces.push_back (piece);
+	list<shared_ptr<TextDecoder> >::const_iterator j = decoder->text.begin();
 
-		if (decoder->video) {
-			if (i->video->frame_type() == VIDEO_FRAME_TYPE_3D_LEFT || i->video->frame_type() == VIDEO_FRAME_TYPE_3D_RIGHT) {
-				/* We need a Shuffler to cope with 3D L/R video data arriving out of sequence */
-				decoder->video->Data.connect (bind (&Shuffler::video, _shuffler, weak_ptr<Piece>(piece), _1));
-			} else {
-				decoder->video->Data.connect (bind (&Player::video, this, weak_ptr<Piece>(piece), _1));
-			}
-		}
+	while (j != decoder->text.end()) {
+		(*j)->BitmapStart.connect (
+			bind(&Player::bitmap_text_start, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>((*j)->content()), _1)
+			);
+		(*j)->PlainStart.connect (
+			bind(&Player::plain_text_start, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>((*j)->content()), _1)
+			);
+		(*j)->Stop.connect (
+			bind(&Player::subtitle_stop, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>((*j)->content()), _1)
+			);
 
-		if (decoder->audio) {
-			decoder->audio->Data.connect (bind (&Player::audio, this, weak_ptr<Piece> (piece), _1, _2));
-		}
+		++j;
+	}
 
-		list<shared_ptr<TextDecoder> >::const_iterator j = decoder->text.begin();
+	return piece;
+}
 
-		while (j != decoder->text.end()) {
-			(*j)->BitmapStart.connect (
-				bind(&Player::bitmap_text_start, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>((*j)->content()), _1)
-				);
-			(*j)->PlainStart.connect (
-				bind(&Player::plain_text_start, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>((*j)->content()), _1)
-				);
-			(*j)->Stop.connect (
-				bind(&Player::subtitle_stop, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>((*j)->content()), _1)
-				);
+void
+Player::setup_pieces_unlocked ()
+{
+	_pieces.clear ();
 
-			++j;
+	delete _shuffler;
+	_shuffler = new Shuffler();
+	_shuffler->Video.connect(bind(&Player::video, this, _1, _2));
+
+	BOOST_FOREACH (shared_ptr<Content> i, _playlist->content ()) {
+		shared_ptr<Piece> piece = make_piece (i);
+		if (piece) {
+			_pieces.push_back (piece);
 		}
 	}
 
-	_stream_states.clear ();
+	setup_piece_state ();
+
+	_last_video_time = DCPTime ();
+	_last_video_eyes = EYES_BOTH;
+	_last_audio_time = DCPTime ();
+}
+
+/** Set up the things that we derive from _pieces.  Streams of pieces which we already
+ *  had keep the time that their audio has been pushed up to.
+ */
+void
+Player::setup_piece_state ()
+{
+	map<AudioStreamPtr, StreamState> old;
+	old.swap (_stream_states);
 	BOOST_FOREACH (shared_ptr<Piece> i, _pieces) {
 		if (i->content->audio) {
 			BOOST_FOREACH (AudioStreamPtr j, i->content->audio->streams()) {
-				_stream_states[j] = StreamState (i, i->content->position ());
+				map<AudioStreamPtr, StreamState>::const_iterator k = old.find (j);
+				if (k != old.end() && k->second.piece == i) {
+					_stream_states[j] = StreamState (i, k->second.last_push_end);
+				} else {
+					_stream_states[j] = StreamState (i, i->content->position ());
+				}
 			}
 		}
 	}
 
 	_black = Empty (_film, _pieces, bind(&have_video, _1));
 	_silent = Empty (_film, _pieces, bind(&have_audio, _1));
+}
 
-	_last_video_time = DCPTime ();
-	_last_video_eyes = EYES_BOTH;
-	_last_audio_time = DCPTime ();
+/** @return true if a change to the given content property can be handled without
+ *  making a new decoder for the content; i.e. the property is only looked at as
+ *  the content's data passes through the Player, or when seeking.
+ */
+static bool
+decoder_independent (int property)
+{
+	return property == ContentProperty::POSITION ||
+		property == ContentProperty::TRIM_START ||
+		property == ContentProperty::TRIM_END ||
+		property == VideoContentProperty::CROP ||
+		property == VideoContentProperty::SCALE ||
+		property == VideoContentProperty::COLOUR_CONVERSION ||
+		property == VideoContentProperty::FADE_IN ||
+		property == VideoContentProperty::FADE_OUT ||
+		property == AudioContentProperty::GAIN ||
+		property == TextContentProperty::X_OFFSET ||
+		property == TextContentProperty::Y_OFFSET ||
+		property == TextContentProperty::X_SCALE ||
+		property == TextContentProperty::Y_SCALE ||
+		property == TextContentProperty::USE ||
+		property == TextContentProperty::BURN ||
+		property == TextContentProperty::OUTLINE_WIDTH;
+}
+
+/** Update _pieces after a change to one piece of content.  Unlike setup_pieces_unlocked()
+ *  this keeps the existing pieces (and their decoders) for any content which is still in
+ *  the playlist, except the changed content if the change means that it needs a new
+ *  decoder.  The kept decoders are left where they are, and any new decoder (or the kept
+ *  one for the changed content, as its timing may have changed) is seeked to where we
+ *  are, so that we carry on from the same place.
+ */
+void
+Player::update_pieces (shared_ptr<const Content> changed, int property)
+{
+	bool const renew = !changed || !decoder_independent (property);
+
+	list<shared_ptr<Piece> > old;
+	old.swap (_pieces);
+
+	/* Pieces whose decoders are not where the rest are */
+	list<shared_ptr<Piece> > to_seek;
+
+	BOOST_FOREACH (shared_ptr<Content> i, _playlist->content ()) {
+		shared_ptr<Piece> piece;
+		if (i != changed || !renew) {
+			BOOST_FOREACH (shared_ptr<Piece> j, old) {
+				if (j->content == i) {
+					piece = j;
+					piece->frc = FrameRateChange (_film, i);
+					break;
+				}
+			}
+		}
+
+		if (!piece) {
+			piece = make_piece (i);
+			if (piece) {
+				to_seek.push_back (piece);
+			}
+		} else if (i == changed) {
+			to_seek.push_back (piece);
+		}
+
+		if (piece) {
+			_pieces.push_back (piece);
+		}
+	}
+
+	setup_piece_state ();
+
+	optional<DCPTime> position = _last_video_time;
+	if (!position) {
+		position = _last_audio_time;
+	}
+
+	if (position) {
+		BOOST_FOREACH (shared_ptr<Piece> i, to_seek) {
+			seek_piece (i, *position, true);
+			if (i->content->audio) {
+				BOOST_FOREACH (AudioStreamPtr j, i->content->audio->streams()) {
+					_stream_states[j].last_push_end = max (*position, i->content->position());
+				}
+			}
+		}
+	}
 }
 
 void
-Player::playlist_content_change (ChangeType type, int property, bool frequent)
+Player::playlist_content_change (ChangeType type, weak_ptr<Content> content, int property, bool frequent)
 {
 	if (type == CHANGE_TYPE_PENDING) {
 		boost::mutex::scoped_lock lm (_mutex);
@@ -244,8 +362,9 @@ Player::playlist_content_change (ChangeType type, int property, bool frequent)
 		*/
 		_suspended = true;
 	} else if (type == CHANGE_TYPE_DONE) {
-		/* A change in our content has gone through.  Re-build our pieces. */
-		setup_pieces ();
+		/* A change in our content has gone through.  Update our pieces. */
+		boost::mutex::scoped_lock lm (_mutex);
+		update_pieces (content.lock(), property);
 		_suspended = false;
 	} else if (type == CHANGE_TYPE_CANCELLED) {
 		boost::mutex::scoped_lock lm (_mutex);
@@ -674,11 +793,12 @@ Player::pass ()
 	for (list<pair<shared_ptr<AudioBuffers>, DCPTime> >::iterator i = audio.begin(); i != audio.end(); ++i) {
 		if (_last_audio_time && i->second < *_last_audio_time) {
 			/* This new data comes before the last we emitted (or the last seek); discard it */
-			pair<shared_ptr<AudioBuffers>, DCPTime> cut = discard_audio (i->first, i->second, *_last_audio_time);
+			pair<shared_ptr<const AudioBuffers>, DCPTime> cut = discard_audio (i->first, i->second, *_last_audio_time);
 			if (!cut.first) {
 				continue;
 			}
-			*i = cut;
+			/* cut is a view onto i->first, which is ours to change */
+			*i = make_pair (const_pointer_cast<AudioBuffers> (cut.first), cut.second);
 		} else if (_last_audio_time && i->second > *_last_audio_time) {
 			/* There's a gap between this data and the last we emitted; fill with silence */
 			fill_audio (DCPTimePeriod (*_last_audio_time, i->second));
@@ -863,7 +983,7 @@ Player::audio (weak_ptr<Piece> wp, AudioStreamPtr stream, ContentAudio content_a
 
 	/* Remove anything that comes before the start or after the end of the content */
 	if (time < piece->content->position()) {
-		pair<shared_ptr<AudioBuffers>, DCPTime> cut = discard_audio (content_audio.audio, time, piece->content->position());
+		pair<shared_ptr<const AudioBuffers>, DCPTime> cut = discard_audio (content_audio.audio, time, piece->content->position());
 		if (!cut.first) {
 			/* This audio is entirely discarded */
 			return;
@@ -878,24 +998,26 @@ Player::audio (weak_ptr<Piece> wp, AudioStreamPtr stream, ContentAudio content_a
 		if (remaining_frames == 0) {
 			return;
 		}
-		shared_ptr<AudioBuffers> cut (new AudioBuffers (content_audio.audio->channels(), remaining_frames));
-		cut->copy_from (content_audio.audio.get(), remaining_frames, 0, 0);
-		content_audio.audio = cut;
+		content_audio.audio = AudioBuffers::view (content_audio.audio, remaining_frames, 0);
 	}
 
 	DCPOMATIC_ASSERT (content_audio.audio->frames() > 0);
 
-	/* Gain */
+	/* Gain and remap */
 
-	if (content->gain() != 0) {
-		shared_ptr<AudioBuffers> gain (new AudioBuffers (content_audio.audio));
-		gain->apply_gain (content->gain ());
-		content_audio.audio = gain;
+	DCPOMATIC_ASSERT (_stream_states.find (stream) != _stream_states.end ());
+	StreamState& state = _stream_states[stream];
+	if (!state.matrix || state.matrix->output_channels() != _film->audio_channels()) {
+		state.matrix.reset (new AudioMatrix (stream->mapping(), _film->audio_channels(), content->gain()));
 	}
 
-	/* Remap */
+	/* We can re-use our output buffer if nobody is still holding on to it */
+	if (!_remapped || !_remapped.unique() || _remapped->shared() || _remapped->channels() != _film->audio_channels()) {
+		_remapped.reset (new AudioBuffers (_film->audio_channels(), content_audio.audio->frames()));
+	}
 
-	content_audio.audio = remap (content_audio.audio, _film->audio_channels(), stream->mapping());
+	state.matrix->apply (content_audio.audio.get(), _remapped.get());
+	content_audio.audio = _remapped;
 
 	/* Process */
 
@@ -906,8 +1028,7 @@ Player::audio (weak_ptr<Piece> wp, AudioStreamPtr stream, ContentAudio content_a
 	/* Push */
 
 	_audio_merger.push (content_audio.audio, time);
-	DCPOMATIC_ASSERT (_stream_states.find (stream) != _stream_states.end ());
-	_stream_states[stream].last_push_end = time + DCPTime::from_frames (content_audio.audio->frames(), _film->audio_frame_rate());
+	state.last_push_end = time + DCPTime::from_frames (content_audio.audio->frames(), _film->audio_frame_rate());
 }
 
 void
@@ -1026,6 +1147,12 @@ Player::seek (DCPTime time, bool accurate)
 		return;
 	}
 
+	seek_unlocked (time, accurate);
+}
+
+void
+Player::seek_unlocked (DCPTime time, bool accurate)
+{
 	if (_shuffler) {
 		_shuffler->clear ();
 	}
@@ -1042,18 +1169,7 @@ Player::seek (DCPTime time, bool accurate)
 	}
 
 	BOOST_FOREACH (shared_ptr<Piece> i, _pieces) {
-		if (time < i->content->position()) {
-			/* Before; seek to the start of the content */
-			i->decoder->seek (dcp_to_content_time (i, i->content->position()), accurate);
-			i->done = false;
-		} else if (i->content->position() <= time && time < i->content->end(_film)) {
-			/* During; seek to position */
-			i->decoder->seek (dcp_to_content_time (i, time), accurate);
-			i->done = false;
-		} else {
-			/* After; this piece is done */
-			i->done = true;
-		}
+		seek_piece (i, time, accurate);
 	}
 
 	if (accurate) {
@@ -1072,6 +1188,24 @@ Player::seek (DCPTime time, bool accurate)
 	_last_video.clear ();
 }
 
+/** Seek one piece's decoder so that it will give data from `time' onwards */
+void
+Player::seek_piece (shared_ptr<Piece> piece, DCPTime time, bool accurate)
+{
+	if (time < piece->content->position()) {
+		/* Before; seek to the start of the content */
+		piece->decoder->seek (dcp_to_content_time (piece, piece->content->position()), accurate);
+		piece->done = false;
+	} else if (piece->content->position() <= time && time < piece->content->end(_film)) {
+		/* During; seek to position */
+		piece->decoder->seek (dcp_to_content_time (piece, time), accurate);
+		piece->done = false;
+	} else {
+		/* After; this piece is done */
+		piece->done = true;
+	}
+}
+
 void
 Player::emit_video (shared_ptr<PlayerVideo> pv, DCPTime time)
 {
@@ -1153,18 +1287,16 @@ Player::one_video_frame () const
 	return DCPTime::from_frames (1, _film->video_frame_rate ());
 }
 
-pair<shared_ptr<AudioBuffers>, DCPTime>
+pair<shared_ptr<const AudioBuffers>, DCPTime>
 Player::discard_audio (shared_ptr<const AudioBuffers> audio, DCPTime time, DCPTime discard_to) const
 {
 	DCPTime const discard_time = discard_to - time;
 	Frame const discard_frames = discard_time.frames_round(_film->audio_frame_rate());
 	Frame remaining_frames = audio->frames() - discard_frames;
 	if (remaining_frames <= 0) {
-		return make_pair(shared_ptr<AudioBuffers>(), DCPTime());
+		return make_pair(shared_ptr<const AudioBuffers>(), DCPTime());
 	}
-	shared_ptr<AudioBuffers> cut (new AudioBuffers (audio->channels(), remaining_frames));
-	cut->copy_from (audio.get(), remaining_frames, discard_frames, 0);
-	return make_pair(cut, time + discard_time);
+	return make_pair(AudioBuffers::view (audio, remaining_frames, discard_frames), time + discard_time);
 }
 
 void
@@ -45,6 +45,7 @@ class PlayerVideo;
 class Playlist;
 class Font;
 class AudioBuffers;
+class AudioMatrix;
 class ReferencedReelAsset;
 class Shuffler;
 
@@ -105,15 +106,21 @@ private:
 	friend struct player_time_calculation_test2;
 	friend struct player_time_calculation_test3;
 	friend struct player_subframe_test;
+	friend struct player_incremental_pieces_test;
 	friend struct empty_test1;
 	friend struct empty_test2;
 
 	void setup_pieces ();
 	void setup_pieces_unlocked ();
+	void setup_piece_state ();
+	void update_pieces (boost::shared_ptr<const Content> changed, int property);
+	boost::shared_ptr<Piece> make_piece (boost::shared_ptr<Content> content);
+	void seek_unlocked (DCPTime time, bool accurate);
+	void seek_piece (boost::shared_ptr<Piece> piece, DCPTime time, bool accurate);
 	void flush ();
 	void film_change (ChangeType, Film::Property);
 	void playlist_change (ChangeType);
-	void playlist_content_change (ChangeType, int, bool);
+	void playlist_content_change (ChangeType, boost::weak_ptr<Content>, int, bool);
 	Frame dcp_to_content_video (boost::shared_ptr<const Piece> piece, DCPTime t) const;
 	DCPTime content_video_to_dcp (boost::shared_ptr<const Piece> piece, Frame f) const;
 	Frame dcp_to_resampled_audio (boost::shared_ptr<const Piece> piece, DCPTime t) const;
@@ -128,7 +135,7 @@ private:
 	void subtitle_stop (boost::weak_ptr<Piece>, boost::weak_ptr<const TextContent>, ContentTime);
 	DCPTime one_video_frame () const;
 	void fill_audio (DCPTimePeriod period);
-	std::pair<boost::shared_ptr<AudioBuffers>, DCPTime> discard_audio (
+	std::pair<boost::shared_ptr<const AudioBuffers>, DCPTime> discard_audio (
 		boost::shared_ptr<const AudioBuffers> audio, DCPTime time, DCPTime discard_to
 		) const;
 	boost::optional<PositionImage> open_subtitles_for_frame (DCPTime time) const;
@@ -191,8 +198,12 @@ private:
 
 		boost::shared_ptr<Piece> piece;
 		DCPTime last_push_end;
+		/** gain and mapping to apply to this stream's audio; made when it is first needed */
+		boost::shared_ptr<AudioMatrix> matrix;
 	};
 	std::map<AudioStreamPtr, StreamState> _stream_states;
+	/** buffer for the output of StreamState::matrix, re-used where possible */
+	boost::shared_ptr<AudioBuffers> _remapped;
 
 	Empty _black;
 	Empty _silent;
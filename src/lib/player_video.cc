@@ -25,11 +25,16 @@
 #include "image_proxy.h"
 #include "j2k_image_proxy.h"
 #include "film.h"
+#include "rgb_to_xyz.h"
+#include "compose.hpp"
 #include <dcp/raw_convert.h>
+#include <dcp/openjpeg_image.h>
 extern "C" {
 #include <libavutil/pixfmt.h>
 }
 #include <libxml++/libxml++.h>
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
 #include <iostream>
 
 using std::string;
@@ -40,6 +45,7 @@ using boost::weak_ptr;
 using boost::dynamic_pointer_cast;
 using boost::optional;
 using boost::function;
+using boost::bind;
 using dcp::Data;
 using dcp::raw_convert;
 
@@ -108,12 +114,21 @@ PlayerVideo::image (function<AVPixelFormat (AVPixelFormat)> pixel_format, bool a
 	/* XXX: this assumes that image() and prepare() are only ever called with the same parameters (except crop, inter size, out size, fade) */
 
 	boost::mutex::scoped_lock lm (_mutex);
-	if (!_image || _crop != _image_crop || _inter_size != _image_inter_size || _out_size != _image_out_size || _fade != _image_fade) {
+	if (image_out_of_date ()) {
 		make_image (pixel_format, aligned, fast);
 	}
 	return _image;
 }
 
+/** @return true if _image is not set, or was made with different parameters to the ones we now have.
+ *  A lock must be held on _mutex.
+ */
+bool
+PlayerVideo::image_out_of_date () const
+{
+	return !_image || _crop != _image_crop || _inter_size != _image_inter_size || _out_size != _image_out_size || _fade != _image_fade;
+}
+
 /** Create an image for this frame.  A lock must be held on _mutex.
  *  @param pixel_format Function which is called to decide what pixel format the output image should be;
  *  it is passed the pixel format of the input image from the ImageProxy, and should return the desired
@@ -129,6 +144,25 @@ PlayerVideo::make_image (function<AVPixelFormat (AVPixelFormat)> pixel_format, b
 	_image_out_size = _out_size;
 	_image_fade = _fade;
 
+	_image = crop_scale_window (pixel_format, aligned, fast, function<void (Image const &, int, int)> ());
+
+	if (_text) {
+		_image->alpha_blend (Image::ensure_aligned (_text->image), _text->position);
+	}
+
+	if (_fade) {
+		_image->fade (_fade.get ());
+	}
+}
+
+/** Get the image from our ImageProxy then crop, scale and window it, without adding any text or fade.
+ *  Parameters are as for make_image and Image::crop_scale_window.
+ */
+shared_ptr<Image>
+PlayerVideo::crop_scale_window (
+	function<AVPixelFormat (AVPixelFormat)> pixel_format, bool aligned, bool fast, function<void (Image const &, int, int)> rows_ready
+	) const
+{
 	pair<shared_ptr<Image>, int> prox = _in->image (_inter_size);
 	shared_ptr<Image> im = prox.first;
 	int const reduce = prox.second;
@@ -165,17 +199,79 @@ PlayerVideo::make_image (function<AVPixelFormat (AVPixelFormat)> pixel_format, b
 		yuv_to_rgb = _colour_conversion.get().yuv_to_rgb();
 	}
 
-	_image = im->crop_scale_window (
-		total_crop, _inter_size, _out_size, yuv_to_rgb, pixel_format (im->pixel_format()), aligned, fast
+	return im->crop_scale_window (
+		total_crop, _inter_size, _out_size, yuv_to_rgb, pixel_format (im->pixel_format()), aligned, fast, rows_ready
 		);
+}
+
+/** Converts strips of an image to XYZ as they come out of Image::crop_scale_window */
+class XYZStripConverter
+{
+public:
+	XYZStripConverter (shared_ptr<const RGBToXYZ> converter, shared_ptr<dcp::OpenJPEGImage> xyz, float fade)
+		: clamped (0)
+		, _converter (converter)
+		, _xyz (xyz)
+		, _fade (fade)
+	{}
+
+	void operator() (Image const & image, int y, int rows)
+	{
+		int const width = image.size().width;
+		int const offset = y * width;
+		clamped += _converter->convert_rows (
+			image.data()[0] + y * image.stride()[0], image.stride()[0], width, rows,
+			_xyz->data(0) + offset, _xyz->data(1) + offset, _xyz->data(2) + offset,
+			_fade
+			);
+	}
+
+	int clamped;
+
+private:
+	shared_ptr<const RGBToXYZ> _converter;
+	shared_ptr<dcp::OpenJPEGImage> _xyz;
+	float _fade;
+};
+
+/** Make an XYZ version of this frame, ready for JPEG2000 encoding; we must have a colour conversion.
+ *
+ *  If image() or prepare() have already made our image it is converted directly.  Otherwise
+ *  the crop / scale / window, fade and colour conversion are done together in strips of rows
+ *  so that each strip is processed by all the stages while it is still in cache.  In that case
+ *  the RGB image is not kept.
+ *
+ *  @param note Handler for notes about the colour conversion.
+ */
+shared_ptr<dcp::OpenJPEGImage>
+PlayerVideo::xyz_image (dcp::NoteHandler note) const
+{
+	DCPOMATIC_ASSERT (_colour_conversion);
+	shared_ptr<const RGBToXYZ> converter = RGBToXYZ::get (_colour_conversion.get());
+
+	boost::mutex::scoped_lock lm (_mutex);
+
+	if (!image_out_of_date () && (_image->pixel_format() == AV_PIX_FMT_RGB48LE || _image->pixel_format() == AV_PIX_FMT_XYZ12LE)) {
+		return converter->convert (_image->data()[0], _image->size(), _image->stride()[0], note);
+	}
+
+	shared_ptr<dcp::OpenJPEGImage> xyz (new dcp::OpenJPEGImage (_out_size));
+	XYZStripConverter strip_converter (converter, xyz, _fade.get_value_or (1));
 
 	if (_text) {
-		_image->alpha_blend (Image::ensure_aligned (_text->image), _text->position);
+		/* Text must be blended in before the colour conversion, so we can't do the stages in strips */
+		shared_ptr<Image> image = crop_scale_window (bind (&PlayerVideo::keep_xyz_or_rgb, _1), true, false, function<void (Image const &, int, int)> ());
+		image->alpha_blend (Image::ensure_aligned (_text->image), _text->position);
+		strip_converter (*image, 0, image->size().height);
+	} else {
+		crop_scale_window (bind (&PlayerVideo::keep_xyz_or_rgb, _1), true, false, boost::ref (strip_converter));
 	}
 
-	if (_fade) {
-		_image->fade (_fade.get ());
+	if (strip_converter.clamped) {
+		note (dcp::DCP_NOTE, String::compose ("%1 XYZ value(s) clamped", strip_converter.clamped));
 	}
+
+	return xyz;
 }
 
 void
@@ -293,7 +389,17 @@ PlayerVideo::prepare (function<AVPixelFormat (AVPixelFormat)> pixel_format, bool
 size_t
 PlayerVideo::memory_used () const
 {
-	return _in->memory_used();
+	size_t m = _in->memory_used ();
+
+	/* If _image is being made right now we won't count it, but whoever is making it
+	   can ask again when it has finished.
+	*/
+	boost::mutex::scoped_lock lm (_mutex, boost::try_to_lock);
+	if (lm && _image) {
+		m += _image->memory_used ();
+	}
+
+	return m;
 }
 
 /** @return Shallow copy of this; _in and _text are shared between the original and the copy */
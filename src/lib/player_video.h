@@ -33,6 +33,10 @@ extern "C" {
 #include <boost/weak_ptr.hpp>
 #include <boost/thread/mutex.hpp>
 
+namespace dcp {
+	class OpenJPEGImage;
+}
+
 class Image;
 class ImageProxy;
 class Film;
@@ -66,6 +70,7 @@ public:
 
 	void prepare (boost::function<AVPixelFormat (AVPixelFormat)> pixel_format, bool aligned, bool fast);
 	boost::shared_ptr<Image> image (boost::function<AVPixelFormat (AVPixelFormat)> pixel_format, bool aligned, bool fast) const;
+	boost::shared_ptr<dcp::OpenJPEGImage> xyz_image (dcp::NoteHandler note) const;
 
 	static AVPixelFormat force (AVPixelFormat, AVPixelFormat);
 	static AVPixelFormat keep_xyz_or_rgb (AVPixelFormat);
@@ -108,6 +113,13 @@ public:
 
 private:
 	void make_image (boost::function<AVPixelFormat (AVPixelFormat)> pixel_format, bool aligned, bool fast) const;
+	boost::shared_ptr<Image> crop_scale_window (
+		boost::function<AVPixelFormat (AVPixelFormat)> pixel_format,
+		bool aligned,
+		bool fast,
+		boost::function<void (Image const &, int, int)> rows_ready
+		) const;
+	bool image_out_of_date () const;
 
 	boost::shared_ptr<const ImageProxy> _in;
 	Crop _crop;
@@ -20,6 +20,7 @@
 
 #include "reel_writer.h"
 #include "film.h"
+#include "frame_info_file.h"
 #include "cross.h"
 #include "job.h"
 #include "log.h"
@@ -61,8 +62,6 @@ using boost::dynamic_pointer_cast;
 using dcp::Data;
 using dcp::raw_convert;
 
-int const ReelWriter::_info_size = 48;
-
 /** @param job Related job, or 0 */
 ReelWriter::ReelWriter (
 	shared_ptr<const Film> film, DCPTimePeriod period, shared_ptr<Job> job, int reel_index, int reel_count, optional<string> content_summary
@@ -100,6 +99,7 @@ ReelWriter::ReelWriter (
 		_film->internal_video_asset_dir() / _film->internal_video_asset_filename(_period)
 		);
 
+	_info_file = _film->frame_info_file (_period);
 	_first_nonexistant_frame = check_existing_picture_asset ();
 
 	_picture_asset_writer = _picture_asset->start_write (
@@ -131,39 +131,27 @@ ReelWriter::ReelWriter (
 void
 ReelWriter::write_frame_info (Frame frame, Eyes eyes, dcp::FrameInfo info) const
 {
-	shared_ptr<InfoFileHandle> handle = _film->info_file_handle(_period, false);
-	dcpomatic_fseek (handle->get(), frame_info_position(frame, eyes), SEEK_SET);
-	checked_fwrite (&info.offset, sizeof(info.offset), handle->get(), handle->file());
-	checked_fwrite (&info.size, sizeof (info.size), handle->get(), handle->file());
-	checked_fwrite (info.hash.c_str(), info.hash.size(), handle->get(), handle->file());
+	_info_file->write (frame_info_index(frame, eyes), info);
 }
 
+/** @param frame reel-relative frame */
 dcp::FrameInfo
-ReelWriter::read_frame_info (shared_ptr<InfoFileHandle> info, Frame frame, Eyes eyes) const
+ReelWriter::read_frame_info (Frame frame, Eyes eyes) const
 {
-	dcp::FrameInfo frame_info;
-	dcpomatic_fseek (info->get(), frame_info_position(frame, eyes), SEEK_SET);
-	checked_fread (&frame_info.offset, sizeof(frame_info.offset), info->get(), info->file());
-	checked_fread (&frame_info.size, sizeof(frame_info.size), info->get(), info->file());
-
-	char hash_buffer[33];
-	checked_fread (hash_buffer, 32, info->get(), info->file());
-	hash_buffer[32] = '\0';
-	frame_info.hash = hash_buffer;
-
-	return frame_info;
+	return _info_file->read (frame_info_index(frame, eyes));
 }
 
-long
-ReelWriter::frame_info_position (Frame frame, Eyes eyes) const
+/** @return Index of the record for a given frame and eyes in our info file */
+int64_t
+ReelWriter::frame_info_index (Frame frame, Eyes eyes) const
 {
 	switch (eyes) {
 	case EYES_BOTH:
-		return frame * _info_size;
+		return frame;
 	case EYES_LEFT:
-		return frame * _info_size * 2;
+		return frame * 2;
 	case EYES_RIGHT:
-		return frame * _info_size * 2 + _info_size;
+		return frame * 2 + 1;
 	default:
 		DCPOMATIC_ASSERT (false);
 	}
@@ -207,37 +195,49 @@ ReelWriter::check_existing_picture_asset ()
 		LOG_GENERAL ("Opened existing asset at %1", asset.string());
 	}
 
-	shared_ptr<InfoFileHandle> info_file;
-
-	try {
-		info_file = _film->info_file_handle (_period, true);
-	} catch (OpenFileError) {
-		LOG_GENERAL_NC ("Could not open film info file");
-		fclose (asset_file);
-		return 0;
-	}
-
-	/* Offset of the last dcp::FrameInfo in the info file */
-	int const n = (boost::filesystem::file_size(info_file->file()) / _info_size) - 1;
-	LOG_GENERAL ("The last FI is %1; info file is %2, info size %3", n, boost::filesystem::file_size(info_file->file()), _info_size);
+	/* Index of the last dcp::FrameInfo in the info file */
+	int64_t const n = _info_file->last_written ();
+	LOG_GENERAL ("The last FI is %1", n);
 
-	Frame first_nonexistant_frame;
-	if (_film->three_d ()) {
+	/* Last frame that the info file knows about, or -1 if there are none */
+	Frame last;
+	if (n < 0) {
+		last = -1;
+	} else if (_film->three_d ()) {
 		/* Start looking at the last left frame */
-		first_nonexistant_frame = n / 2;
+		last = n / 2;
 	} else {
-		first_nonexistant_frame = n;
+		last = n;
 	}
 
-	while (!existing_picture_frame_ok(asset_file, info_file, first_nonexistant_frame) && first_nonexistant_frame > 0) {
-		--first_nonexistant_frame;
+	/* Frames are written in order, so the good frames in the asset are the ones
+	   before some point; find the last good one with a binary search, or -1 if
+	   there are none.
+	*/
+	Frame last_good = -1;
+	if (last >= 0 && existing_picture_frame_ok (asset_file, last)) {
+		last_good = last;
+	} else if (last > 0) {
+		/* The last good frame is in [lower, upper); lower is -1 as frame 0 might not be good */
+		Frame lower = -1;
+		Frame upper = last;
+		while (upper - lower > 1) {
+			Frame const middle = lower + (upper - lower) / 2;
+			if (existing_picture_frame_ok (asset_file, middle)) {
+				lower = middle;
+			} else {
+				upper = middle;
+			}
+		}
+		last_good = lower;
 	}
 
-	if (!_film->three_d() && first_nonexistant_frame > 0) {
+	Frame first_nonexistant_frame = 0;
+	if (last_good >= 0) {
 		/* If we are doing 3D we might have found a good L frame with no R, so only
-		   do this if we're in 2D and we've just found a good B(oth) frame.
+		   start after it if we're in 2D and we've just found a good B(oth) frame.
 		*/
-		++first_nonexistant_frame;
+		first_nonexistant_frame = _film->three_d() ? last_good : last_good + 1;
 	}
 
 	LOG_GENERAL ("Proceeding with first nonexistant frame %1", first_nonexistant_frame);
@@ -280,6 +280,9 @@ ReelWriter::repeat_write (Frame frame, Eyes eyes)
 void
 ReelWriter::finish ()
 {
+	/* Make sure that the frame info for what we have written is on disk, in case we need it next time */
+	_info_file->flush ();
+
 	if (!_picture_asset_writer->finalize ()) {
 		/* Nothing was written to the picture asset */
 		LOG_GENERAL ("Nothing was written to reel %1 of %2", _reel_index, _reel_count);
@@ -647,14 +650,14 @@ ReelWriter::write (PlayerText subs, TextType type, optional<DCPTextTrack> track,
 }
 
 bool
-ReelWriter::existing_picture_frame_ok (FILE* asset_file, shared_ptr<InfoFileHandle> info_file, Frame frame) const
+ReelWriter::existing_picture_frame_ok (FILE* asset_file, Frame frame) const
 {
 	LOG_GENERAL ("Checking existing picture frame %1", frame);
 
 	/* Read the data from the info file; for 3D we just check the left
 	   frames until we find a good one.
 	*/
-	dcp::FrameInfo const info = read_frame_info (info_file, frame, _film->three_d () ? EYES_LEFT : EYES_BOTH);
+	dcp::FrameInfo const info = read_frame_info (frame, _film->three_d () ? EYES_LEFT : EYES_BOTH);
 
 	bool ok = true;
 
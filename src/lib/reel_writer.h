@@ -31,7 +31,7 @@ class Film;
 class Job;
 class Font;
 class AudioBuffers;
-class InfoFileHandle;
+class FrameInfoFile;
 struct write_frame_info_test;
 
 namespace dcp {
@@ -88,16 +88,16 @@ public:
 		return _first_nonexistant_frame;
 	}
 
-	dcp::FrameInfo read_frame_info (boost::shared_ptr<InfoFileHandle> info, Frame frame, Eyes eyes) const;
+	dcp::FrameInfo read_frame_info (Frame frame, Eyes eyes) const;
 
 private:
 
 	friend struct ::write_frame_info_test;
 
 	void write_frame_info (Frame frame, Eyes eyes, dcp::FrameInfo info) const;
-	long frame_info_position (Frame frame, Eyes eyes) const;
+	int64_t frame_info_index (Frame frame, Eyes eyes) const;
 	Frame check_existing_picture_asset ();
-	bool existing_picture_frame_ok (FILE* asset_file, boost::shared_ptr<InfoFileHandle> info_file, Frame frame) const;
+	bool existing_picture_frame_ok (FILE* asset_file, Frame frame) const;
 
 	boost::shared_ptr<const Film> _film;
 
@@ -123,5 +123,6 @@ private:
 	boost::shared_ptr<dcp::SubtitleAsset> _subtitle_asset;
 	std::map<DCPTextTrack, boost::shared_ptr<dcp::SubtitleAsset> > _closed_caption_assets;
 
-	static int const _info_size;
+	/** our frame info file, which is kept open while we exist */
+	boost::shared_ptr<FrameInfoFile> _info_file;
 };
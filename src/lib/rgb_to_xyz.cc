@@ -0,0 +1,181 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "rgb_to_xyz.h"
+#include "compose.hpp"
+#include <dcp/openjpeg_image.h>
+#include <dcp/rgb_xyz.h>
+#include <dcp/transfer_function.h>
+#include <algorithm>
+#include <cmath>
+
+using std::map;
+using std::string;
+using std::vector;
+using boost::shared_ptr;
+
+int const RGBToXYZ::lut_in_bits = 24;
+int const RGBToXYZ::matrix_bits = 38;
+
+boost::mutex RGBToXYZ::_cache_mutex;
+map<string, shared_ptr<const RGBToXYZ> > RGBToXYZ::_cache;
+
+RGBToXYZ::RGBToXYZ (ColourConversion const & conversion)
+	: _lut_out (65536)
+{
+	double const * lut_in = conversion.in()->lut (12, false);
+	for (int i = 0; i < 4096; ++i) {
+		_lut_in[i] = lrint (lut_in[i] * (1 << lut_in_bits));
+	}
+
+	double const * lut_out = conversion.out()->lut (16, true);
+	for (int i = 0; i < 65536; ++i) {
+		_lut_out[i] = lrint (lut_out[i] * 4095);
+	}
+
+	/* This is the same combined RGB -> XYZ / Bradford / DCI companding matrix that
+	   dcp::rgb_to_xyz uses, scaled so that linear RGB from _lut_in gives 16-bit XYZ
+	   with matrix_bits of fraction.
+	*/
+	double fast_matrix[9];
+	dcp::combined_rgb_to_xyz (conversion, fast_matrix);
+	double const scale = pow (2, matrix_bits - lut_in_bits);
+	for (int i = 0; i < 9; ++i) {
+		_matrix[i] = llrint (fast_matrix[i] * scale);
+	}
+}
+
+/** Convert some rows of RGB48LE to 12-bit XYZ.
+ *  @param rgb RGB48LE data for the first row.
+ *  @param stride Stride of rgb in bytes.
+ *  @param width Width of the rows in pixels.
+ *  @param rows Number of rows to convert.
+ *  @param x Output for X components; width * rows values are written.
+ *  @param y Output for Y components; width * rows values are written.
+ *  @param z Output for Z components; width * rows values are written.
+ *  @param fade Amount to fade the RGB by before conversion, in the same way as Image::fade; 0 is black, 1 is no fade.
+ *  @return Number of pixels whose XYZ values had to be clamped.
+ */
+int
+RGBToXYZ::convert_rows (uint8_t const * rgb, int stride, int width, int rows, int* x, int* y, int* z, float fade) const
+{
+	vector<int32_t> linear (width * 3);
+	int32_t* lr = &linear[0];
+	int32_t* lg = lr + width;
+	int32_t* lb = lg + width;
+
+	int64_t const m0 = _matrix[0];
+	int64_t const m1 = _matrix[1];
+	int64_t const m2 = _matrix[2];
+	int64_t const m3 = _matrix[3];
+	int64_t const m4 = _matrix[4];
+	int64_t const m5 = _matrix[5];
+	int64_t const m6 = _matrix[6];
+	int64_t const m7 = _matrix[7];
+	int64_t const m8 = _matrix[8];
+	int64_t const round = INT64_C(1) << (matrix_bits - 1);
+	int32_t const* lut_out = &_lut_out[0];
+
+	int clamped = 0;
+
+	for (int i = 0; i < rows; ++i) {
+
+		/* In gamma LUT (converting 16-bit to 12-bit); this is a gather so keep it on its own */
+		uint16_t const * p = reinterpret_cast<uint16_t const *> (rgb + i * stride);
+		if (fade == 1) {
+			for (int j = 0; j < width; ++j) {
+				lr[j] = _lut_in[p[0] >> 4];
+				lg[j] = _lut_in[p[1] >> 4];
+				lb[j] = _lut_in[p[2] >> 4];
+				p += 3;
+			}
+		} else {
+			for (int j = 0; j < width; ++j) {
+				lr[j] = _lut_in[int (float (p[0]) * fade) >> 4];
+				lg[j] = _lut_in[int (float (p[1]) * fade) >> 4];
+				lb[j] = _lut_in[int (float (p[2]) * fade) >> 4];
+				p += 3;
+			}
+		}
+
+		/* RGB to XYZ, Bradford transform and DCI companding, then clamp */
+		for (int j = 0; j < width; ++j) {
+			int64_t const r = lr[j];
+			int64_t const g = lg[j];
+			int64_t const b = lb[j];
+			int64_t const dx = (r * m0 + g * m1 + b * m2 + round) >> matrix_bits;
+			int64_t const dy = (r * m3 + g * m4 + b * m5 + round) >> matrix_bits;
+			int64_t const dz = (r * m6 + g * m7 + b * m8 + round) >> matrix_bits;
+			clamped += (dx < 0 || dy < 0 || dz < 0 || dx > 65535 || dy > 65535 || dz > 65535);
+			x[j] = std::min (std::max (dx, INT64_C(0)), INT64_C(65535));
+			y[j] = std::min (std::max (dy, INT64_C(0)), INT64_C(65535));
+			z[j] = std::min (std::max (dz, INT64_C(0)), INT64_C(65535));
+		}
+
+		/* Out gamma LUT */
+		for (int j = 0; j < width; ++j) {
+			x[j] = lut_out[x[j]];
+			y[j] = lut_out[y[j]];
+			z[j] = lut_out[z[j]];
+		}
+
+		x += width;
+		y += width;
+		z += width;
+	}
+
+	return clamped;
+}
+
+/** Convert an RGB48LE image to 12-bit XYZ.
+ *  @param rgb RGB48LE data.
+ *  @param size Size of the image in pixels.
+ *  @param stride Stride of rgb in bytes.
+ *  @param note Handler for notes about the conversion.
+ */
+shared_ptr<dcp::OpenJPEGImage>
+RGBToXYZ::convert (uint8_t const * rgb, dcp::Size size, int stride, dcp::NoteHandler note) const
+{
+	shared_ptr<dcp::OpenJPEGImage> xyz (new dcp::OpenJPEGImage (size));
+
+	int const clamped = convert_rows (rgb, stride, size.width, size.height, xyz->data(0), xyz->data(1), xyz->data(2));
+	if (clamped) {
+		note (dcp::DCP_NOTE, String::compose ("%1 XYZ value(s) clamped", clamped));
+	}
+
+	return xyz;
+}
+
+/** @return A converter for a ColourConversion, which may be shared with other callers */
+shared_ptr<const RGBToXYZ>
+RGBToXYZ::get (ColourConversion const & conversion)
+{
+	string const id = conversion.identifier ();
+
+	boost::mutex::scoped_lock lm (_cache_mutex);
+	map<string, shared_ptr<const RGBToXYZ> >::const_iterator i = _cache.find (id);
+	if (i != _cache.end ()) {
+		return i->second;
+	}
+
+	shared_ptr<const RGBToXYZ> c (new RGBToXYZ (conversion));
+	_cache[id] = c;
+	return c;
+}
@@ -0,0 +1,76 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_RGB_TO_XYZ_H
+#define DCPOMATIC_RGB_TO_XYZ_H
+
+#include "colour_conversion.h"
+#include <dcp/types.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <vector>
+#include <stdint.h>
+
+namespace dcp {
+	class OpenJPEGImage;
+}
+
+/** @class RGBToXYZ
+ *  @brief A converter from RGB48LE to 12-bit XYZ for one particular ColourConversion.
+ *
+ *  This gives the same results as dcp::rgb_to_xyz (to within a code value or so) but
+ *  does all its per-pixel work with integers: the input and output transfer functions
+ *  are held as integer LUTs and the RGB -> XYZ / Bradford matrix is applied in fixed
+ *  point.  Each row is processed in a couple of simple loops which the compiler can
+ *  vectorise.
+ *
+ *  Setting up the LUTs is not free, so converters should be obtained using get(), which
+ *  caches them by ColourConversion::identifier().
+ */
+class RGBToXYZ : public boost::noncopyable
+{
+public:
+	explicit RGBToXYZ (ColourConversion const & conversion);
+
+	boost::shared_ptr<dcp::OpenJPEGImage> convert (uint8_t const * rgb, dcp::Size size, int stride, dcp::NoteHandler note) const;
+	int convert_rows (uint8_t const * rgb, int stride, int width, int rows, int* x, int* y, int* z, float fade = 1) const;
+
+	static boost::shared_ptr<const RGBToXYZ> get (ColourConversion const & conversion);
+
+private:
+	/** number of fractional bits in the values in _lut_in */
+	static int const lut_in_bits;
+	/** number of fractional bits in _matrix */
+	static int const matrix_bits;
+
+	/** 12-bit gamma-encoded RGB to linear RGB, scaled by 2^lut_in_bits */
+	int32_t _lut_in[4096];
+	/** linear RGB (scaled by 2^lut_in_bits) to 16-bit linear XYZ, scaled by 2^matrix_bits */
+	int64_t _matrix[9];
+	/** 16-bit linear XYZ to 12-bit gamma-encoded XYZ */
+	std::vector<int32_t> _lut_out;
+
+	static boost::mutex _cache_mutex;
+	static std::map<std::string, boost::shared_ptr<const RGBToXYZ> > _cache;
+};
+
+#endif
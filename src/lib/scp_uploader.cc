@@ -24,105 +24,298 @@
 #include "config.h"
 #include "cross.h"
 #include "compose.hpp"
+#include "dcpomatic_log.h"
 #include <sys/stat.h>
+#include <fcntl.h>
 
 #include "i18n.h"
 
 using std::string;
 using std::min;
+using std::vector;
 using boost::shared_ptr;
 using boost::function;
 
+/** Size of the pieces that we read from files and send */
+static boost::uintmax_t const buffer_size = 4 * 1024 * 1024;
+
 SCPUploader::SCPUploader (function<void (string)> set_status, function<void (float)> set_progress)
 	: Uploader (set_status, set_progress)
 {
-	_session = ssh_new ();
-	if (!_session) {
+	int const streams = Config::instance()->upload_streams ();
+	_streams.reserve (streams);
+
+	for (int i = 0; i < streams; ++i) {
+		_streams.push_back (Stream ());
+		try {
+			connect (_streams.back ());
+		} catch (NetworkError& e) {
+			disconnect (_streams.back ());
+			_streams.pop_back ();
+			if (i == 0) {
+				throw;
+			}
+			/* Some servers limit the number of sessions that one user can have open;
+			   we can get by with the ones we have.
+			*/
+			LOG_GENERAL ("Could only open %1 of %2 SCP sessions (%3)", i, streams, e.what());
+			break;
+		}
+	}
+}
+
+SCPUploader::~SCPUploader ()
+{
+	for (vector<Stream>::iterator i = _streams.begin(); i != _streams.end(); ++i) {
+		disconnect (*i);
+	}
+}
+
+void
+SCPUploader::connect (Stream& stream)
+{
+	stream.session = ssh_new ();
+	if (!stream.session) {
 		throw NetworkError (_("could not start SSH session"));
 	}
 
-	ssh_options_set (_session, SSH_OPTIONS_HOST, Config::instance()->tms_ip().c_str ());
-	ssh_options_set (_session, SSH_OPTIONS_USER, Config::instance()->tms_user().c_str ());
+	ssh_options_set (stream.session, SSH_OPTIONS_HOST, Config::instance()->tms_ip().c_str ());
+	ssh_options_set (stream.session, SSH_OPTIONS_USER, Config::instance()->tms_user().c_str ());
 	int const port = 22;
-	ssh_options_set (_session, SSH_OPTIONS_PORT, &port);
+	ssh_options_set (stream.session, SSH_OPTIONS_PORT, &port);
 
-	int r = ssh_connect (_session);
+	int r = ssh_connect (stream.session);
 	if (r != SSH_OK) {
-		throw NetworkError (String::compose (_("Could not connect to server %1 (%2)"), Config::instance()->tms_ip(), ssh_get_error (_session)));
+		throw NetworkError (String::compose (_("Could not connect to server %1 (%2)"), Config::instance()->tms_ip(), ssh_get_error (stream.session)));
 	}
 
-	r = ssh_is_server_known (_session);
+	r = ssh_is_server_known (stream.session);
 	if (r == SSH_SERVER_ERROR) {
-		throw NetworkError (String::compose (_("SSH error (%1)"), ssh_get_error (_session)));
+		throw NetworkError (String::compose (_("SSH error (%1)"), ssh_get_error (stream.session)));
 	}
 
-	r = ssh_userauth_password (_session, 0, Config::instance()->tms_password().c_str ());
+	r = ssh_userauth_password (stream.session, 0, Config::instance()->tms_password().c_str ());
 	if (r != SSH_AUTH_SUCCESS) {
-		throw NetworkError (String::compose (_("Failed to authenticate with server (%1)"), ssh_get_error (_session)));
+		throw NetworkError (String::compose (_("Failed to authenticate with server (%1)"), ssh_get_error (stream.session)));
 	}
 
-	_scp = ssh_scp_new (_session, SSH_SCP_WRITE | SSH_SCP_RECURSIVE, Config::instance()->tms_path().c_str ());
-	if (!_scp) {
-		throw NetworkError (String::compose (_("could not start SCP session (%1)"), ssh_get_error (_session)));
+	stream.scp = ssh_scp_new (stream.session, SSH_SCP_WRITE | SSH_SCP_RECURSIVE, Config::instance()->tms_path().c_str ());
+	if (!stream.scp) {
+		throw NetworkError (String::compose (_("could not start SCP session (%1)"), ssh_get_error (stream.session)));
 	}
 
-	r = ssh_scp_init (_scp);
+	r = ssh_scp_init (stream.scp);
 	if (r != SSH_OK) {
-		throw NetworkError (String::compose (_("Could not start SCP session (%1)"), ssh_get_error (_session)));
+		throw NetworkError (String::compose (_("Could not start SCP session (%1)"), ssh_get_error (stream.session)));
+	}
+
+	/* We use SFTP, if it's there, to find out what is already on the server
+	   and to finish sending files that were only partly sent before.
+	*/
+	stream.sftp = sftp_new (stream.session);
+	if (stream.sftp && sftp_init (stream.sftp) != SSH_OK) {
+		sftp_free (stream.sftp);
+		stream.sftp = 0;
 	}
 }
 
-SCPUploader::~SCPUploader ()
+void
+SCPUploader::disconnect (Stream& stream)
+{
+	if (stream.sftp) {
+		sftp_free (stream.sftp);
+	}
+	if (stream.scp) {
+		ssh_scp_free (stream.scp);
+	}
+	if (stream.session) {
+		ssh_disconnect (stream.session);
+		ssh_free (stream.session);
+	}
+}
+
+int
+SCPUploader::streams () const
 {
-	ssh_scp_free (_scp);
-	ssh_disconnect (_session);
-	ssh_free (_session);
+	return _streams.size ();
+}
+
+/** Move a stream's SCP session into a directory (relative to the target path),
+ *  creating it if required.
+ */
+void
+SCPUploader::change_directory (Stream& stream, boost::filesystem::path directory)
+{
+	boost::filesystem::path::iterator i = stream.directory.begin ();
+	boost::filesystem::path::iterator j = directory.begin ();
+	while (i != stream.directory.end() && j != directory.end() && *i == *j) {
+		++i;
+		++j;
+	}
+
+	/* Leave the parts of the current directory that aren't in the new one */
+	for (; i != stream.directory.end(); ++i) {
+		if (ssh_scp_leave_directory (stream.scp) != SSH_OK) {
+			throw NetworkError (String::compose (_("Could not create remote directory %1 (%2)"), directory, ssh_get_error (stream.session)));
+		}
+	}
+
+	/* and go into the rest of the new one, one part at a time */
+	for (; j != directory.end(); ++j) {
+		/* Use generic_string so that we get forward-slashes in the path, even on Windows */
+		int const r = ssh_scp_push_directory (stream.scp, j->generic_string().c_str(), S_IRWXU);
+		if (r != SSH_OK) {
+			throw NetworkError (String::compose (_("Could not create remote directory %1 (%2)"), directory, ssh_get_error (stream.session)));
+		}
+	}
+
+	stream.directory = directory;
 }
 
 void
 SCPUploader::create_directory (boost::filesystem::path directory)
 {
-	/* Use generic_string so that we get forward-slashes in the path, even on Windows */
-	int const r = ssh_scp_push_directory (_scp, directory.generic_string().c_str(), S_IRWXU);
-	if (r != SSH_OK) {
-		throw NetworkError (String::compose (_("Could not create remote directory %1 (%2)"), directory, ssh_get_error (_session)));
+	change_directory (_streams.front(), directory);
+}
+
+Uploader::RemoteFile
+SCPUploader::remote_file (boost::filesystem::path to, int stream)
+{
+	RemoteFile remote;
+
+	Stream& s = _streams[stream];
+	if (!s.sftp) {
+		return remote;
 	}
+
+	string const path = Config::instance()->tms_path() + "/" + to.generic_string();
+	sftp_attributes attributes = sftp_stat (s.sftp, path.c_str());
+	if (!attributes) {
+		return remote;
+	}
+
+	remote.size = attributes->size;
+	if (attributes->flags & SSH_FILEXFER_ATTR_ACMODTIME) {
+		remote.time = attributes->mtime;
+	}
+	sftp_attributes_free (attributes);
+	return remote;
+}
+
+/** Send the rest of a partly-sent file using SFTP.
+ *  @return true if this was done, false if it could not be started.
+ */
+bool
+SCPUploader::resume_file (Stream& stream, FILE* file, boost::filesystem::path from, boost::filesystem::path to, boost::uintmax_t offset, boost::uintmax_t size)
+{
+	if (!stream.sftp) {
+		return false;
+	}
+
+	string const path = Config::instance()->tms_path() + "/" + to.generic_string();
+	sftp_file remote = sftp_open (stream.sftp, path.c_str(), O_WRONLY, 0);
+	if (!remote) {
+		return false;
+	}
+
+	if (sftp_seek64 (remote, offset) != 0 || dcpomatic_fseek (file, offset, SEEK_SET) != 0) {
+		sftp_close (remote);
+		return false;
+	}
+
+	transferred (offset);
+
+	vector<char> buffer (buffer_size);
+	boost::uintmax_t to_do = size - offset;
+	while (to_do > 0) {
+		int const t = min (to_do, buffer_size);
+		size_t const read = fread (&buffer[0], 1, t, file);
+		if (read != size_t (t)) {
+			sftp_close (remote);
+			throw ReadFileError (from);
+		}
+
+		/* sftp_write may send less than we ask it to */
+		int done = 0;
+		while (done < t) {
+			ssize_t const w = sftp_write (remote, &buffer[done], t - done);
+			if (w <= 0) {
+				sftp_close (remote);
+				throw NetworkError (String::compose (_("Could not write to remote file (%1)"), ssh_get_error (stream.session)));
+			}
+			done += w;
+		}
+
+		to_do -= t;
+		transferred (t);
+	}
+
+	sftp_close (remote);
+	return true;
 }
 
 void
-SCPUploader::upload_file (boost::filesystem::path from, boost::filesystem::path to, boost::uintmax_t& transferred, boost::uintmax_t total_size)
+SCPUploader::upload_file (boost::filesystem::path from, boost::filesystem::path to, boost::uintmax_t offset, int stream)
 {
-	boost::uintmax_t to_do = boost::filesystem::file_size (from);
-	/* Use generic_string so that we get forward-slashes in the path, even on Windows */
-	ssh_scp_push_file (_scp, to.generic_string().c_str(), to_do, S_IRUSR | S_IWUSR);
+	Stream& s = _streams[stream];
+
+	boost::uintmax_t const size = boost::filesystem::file_size (from);
 
 	FILE* f = fopen_boost (from, "rb");
 	if (f == 0) {
 		throw NetworkError (String::compose (_("Could not open %1 to send"), from));
 	}
 
-	boost::uintmax_t buffer_size = 64 * 1024;
-	char buffer[buffer_size];
+#ifdef DCPOMATIC_LINUX
+	posix_fadvise (fileno (f), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	try {
+		if (offset > 0 && resume_file (s, f, from, to, offset, size)) {
+			fclose (f);
+			return;
+		}
+	} catch (...) {
+		fclose (f);
+		throw;
+	}
+
+	/* SCP can only send whole files */
+	if (offset > 0) {
+		dcpomatic_fseek (f, 0, SEEK_SET);
+	}
+
+	try {
+		change_directory (s, to.parent_path ());
+	} catch (...) {
+		fclose (f);
+		throw;
+	}
+
+	/* Use generic_string so that we get forward-slashes in the path, even on Windows */
+	int r = ssh_scp_push_file (s.scp, to.generic_string().c_str(), size, S_IRUSR | S_IWUSR);
+	if (r != SSH_OK) {
+		fclose (f);
+		throw NetworkError (String::compose (_("Could not write to remote file (%1)"), ssh_get_error (s.session)));
+	}
 
+	vector<char> buffer (buffer_size);
+	boost::uintmax_t to_do = size;
 	while (to_do > 0) {
 		int const t = min (to_do, buffer_size);
-		size_t const read = fread (buffer, 1, t, f);
+		size_t const read = fread (&buffer[0], 1, t, f);
 		if (read != size_t (t)) {
 			fclose (f);
 			throw ReadFileError (from);
 		}
 
-		int const r = ssh_scp_write (_scp, buffer, t);
+		r = ssh_scp_write (s.scp, &buffer[0], t);
 		if (r != SSH_OK) {
 			fclose (f);
-			throw NetworkError (String::compose (_("Could not write to remote file (%1)"), ssh_get_error (_session)));
+			throw NetworkError (String::compose (_("Could not write to remote file (%1)"), ssh_get_error (s.session)));
 		}
 		to_do -= t;
-		transferred += t;
-
-		if (total_size > 0) {
-			_set_progress ((double) transferred / total_size);
-		}
+		transferred (t);
 	}
 
 	fclose (f);
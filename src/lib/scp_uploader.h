@@ -20,6 +20,8 @@
 
 #include "uploader.h"
 #include <libssh/libssh.h>
+#include <libssh/sftp.h>
+#include <vector>
 
 class SCPUploader : public Uploader
 {
@@ -28,10 +30,33 @@ public:
 	~SCPUploader ();
 
 protected:
+	virtual int streams () const;
 	virtual void create_directory (boost::filesystem::path directory);
-	virtual void upload_file (boost::filesystem::path from, boost::filesystem::path to, boost::uintmax_t& transferred, boost::uintmax_t total_size);
+	virtual RemoteFile remote_file (boost::filesystem::path to, int stream);
+	virtual void upload_file (boost::filesystem::path from, boost::filesystem::path to, boost::uintmax_t offset, int stream);
 
 private:
-	ssh_session _session;
-	ssh_scp _scp;
+	/** A connection to the server */
+	struct Stream
+	{
+		Stream ()
+			: session (0)
+			, scp (0)
+			, sftp (0)
+		{}
+
+		ssh_session session;
+		ssh_scp scp;
+		/** SFTP session, or 0 if the server does not offer SFTP */
+		sftp_session sftp;
+		/** Directory, relative to the target path, that scp is in */
+		boost::filesystem::path directory;
+	};
+
+	void connect (Stream& stream);
+	void disconnect (Stream& stream);
+	void change_directory (Stream& stream, boost::filesystem::path directory);
+	bool resume_file (Stream& stream, FILE* file, boost::filesystem::path from, boost::filesystem::path to, boost::uintmax_t offset, boost::uintmax_t size);
+
+	std::vector<Stream> _streams;
 };
@@ -0,0 +1,213 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/spill_file.cc
+ *  @brief SpillFile class.
+ */
+
+#include "spill_file.h"
+#include "exceptions.h"
+#include "cross.h"
+#include "dcpomatic_assert.h"
+#ifdef DCPOMATIC_POSIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <cerrno>
+
+using std::map;
+using dcp::Data;
+
+/** Create a spill file, replacing any existing file of the same name.
+ *  @param file File name.
+ *  @param chunk Amount of space to allocate in the file at once, in bytes.
+ */
+SpillFile::SpillFile (boost::filesystem::path file, int64_t chunk)
+	: _file (file)
+	, _chunk (chunk)
+	, _end (0)
+	, _used (0)
+	, _allocated (0)
+{
+#ifdef DCPOMATIC_POSIX
+	_fd = ::open (_file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (_fd == -1) {
+		throw OpenFileError (_file, errno, OpenFileError::WRITE);
+	}
+#else
+	_handle = fopen_boost (_file, "w+b");
+	if (!_handle) {
+		throw OpenFileError (_file, errno, OpenFileError::WRITE);
+	}
+#endif
+}
+
+SpillFile::~SpillFile ()
+{
+#ifdef DCPOMATIC_POSIX
+	::close (_fd);
+#else
+	fclose (_handle);
+#endif
+
+	boost::system::error_code ec;
+	boost::filesystem::remove (_file, ec);
+}
+
+/** Make sure that the file has space for at least `length' bytes */
+void
+SpillFile::reserve (int64_t length)
+{
+	if (length <= _allocated) {
+		return;
+	}
+
+	int64_t const size = ((length + _chunk - 1) / _chunk) * _chunk;
+#ifdef DCPOMATIC_LINUX
+	/* This may fail if the filesystem does not support it, in which case the
+	   file will just be extended as it is written.
+	*/
+	posix_fallocate (_fd, _allocated, size - _allocated);
+#endif
+	_allocated = size;
+}
+
+/** @return Offset at which to write a block of `size' bytes; the first unused region
+ *  that it fits in, otherwise the end of the data.  The space is marked as used.
+ */
+int64_t
+SpillFile::find_space (int64_t size)
+{
+	for (map<int64_t, int64_t>::iterator i = _free.begin(); i != _free.end(); ++i) {
+		if (i->second >= size) {
+			int64_t const offset = i->first;
+			if (i->second > size) {
+				_free[offset + size] = i->second - size;
+			}
+			_free.erase (i);
+			return offset;
+		}
+	}
+
+	int64_t const offset = _end;
+	_end += size;
+	reserve (_end);
+	return offset;
+}
+
+/** Write some data to the file.
+ *  @return Offset of the data in the file, to pass to read().
+ */
+int64_t
+SpillFile::write (Data const & data)
+{
+	int64_t const offset = find_space (data.size());
+
+#ifdef DCPOMATIC_POSIX
+	uint8_t const * p = data.data().get();
+	int64_t done = 0;
+	while (done < data.size()) {
+		ssize_t const n = pwrite (_fd, p + done, data.size() - done, offset + done);
+		if (n == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			throw WriteFileError (_file, errno);
+		}
+		done += n;
+	}
+#else
+	dcpomatic_fseek (_handle, offset, SEEK_SET);
+	if (fwrite (data.data().get(), 1, data.size(), _handle) != size_t (data.size())) {
+		throw WriteFileError (_file, errno);
+	}
+#endif
+
+	_used += data.size ();
+	_index[offset] = data.size ();
+	return offset;
+}
+
+/** Read back some data that was written by write().  Each piece of data
+ *  can only be read once.
+ *  @param offset Offset that was returned by write().
+ */
+Data
+SpillFile::read (int64_t offset)
+{
+	map<int64_t, int>::iterator i = _index.find (offset);
+	DCPOMATIC_ASSERT (i != _index.end ());
+
+	Data data (i->second);
+	uint8_t* p = data.data().get();
+
+#ifdef DCPOMATIC_POSIX
+	int64_t done = 0;
+	while (done < i->second) {
+		ssize_t const n = pread (_fd, p + done, i->second - done, offset + done);
+		if (n == -1 && errno == EINTR) {
+			continue;
+		} else if (n <= 0) {
+			throw ReadFileError (_file, n == 0 ? 0 : errno);
+		}
+		done += n;
+	}
+#else
+	dcpomatic_fseek (_handle, offset, SEEK_SET);
+	if (fread (p, 1, i->second, _handle) != size_t (i->second)) {
+		throw ReadFileError (_file, errno);
+	}
+#endif
+
+	int const size = i->second;
+	_index.erase (i);
+	_used -= size;
+	release (offset, size);
+
+	return data;
+}
+
+/** Mark a region of the file as unused, merging it with any unused regions next to it */
+void
+SpillFile::release (int64_t offset, int64_t size)
+{
+	map<int64_t, int64_t>::iterator next = _free.lower_bound (offset);
+	if (next != _free.end() && next->first == offset + size) {
+		size += next->second;
+		_free.erase (next++);
+	}
+
+	if (next != _free.begin()) {
+		map<int64_t, int64_t>::iterator prev = next;
+		--prev;
+		if (prev->first + prev->second == offset) {
+			offset = prev->first;
+			size += prev->second;
+			_free.erase (prev);
+		}
+	}
+
+	if (offset + size == _end) {
+		/* This is the end of the data, so just shorten it */
+		_end = offset;
+	} else {
+		_free[offset] = size;
+	}
+}
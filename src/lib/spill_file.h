@@ -0,0 +1,88 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/spill_file.h
+ *  @brief SpillFile class.
+ */
+
+#ifndef DCPOMATIC_SPILL_FILE_H
+#define DCPOMATIC_SPILL_FILE_H
+
+#include <dcp/data.h>
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+#include <map>
+#include <cstdio>
+
+/** @class SpillFile
+ *  @brief A single file to which blocks of data can be written, and later read back once each.
+ *
+ *  Space in the file is allocated in chunks, and the offset and size of each block which has
+ *  been written but not yet read back are kept in memory.  The space used by a block which has
+ *  been read back is re-used for later blocks that fit in it.  The file is deleted when this
+ *  object is destroyed.
+ *
+ *  This class is not thread-safe.
+ */
+class SpillFile : public boost::noncopyable
+{
+public:
+	SpillFile (boost::filesystem::path file, int64_t chunk);
+	~SpillFile ();
+
+	int64_t write (dcp::Data const & data);
+	dcp::Data read (int64_t offset);
+
+	/** @return number of blocks which have been written but not read back */
+	size_t blocks () const {
+		return _index.size ();
+	}
+
+	/** @return total size of the blocks which have been written but not read back, in bytes */
+	int64_t length () const {
+		return _used;
+	}
+
+private:
+	void reserve (int64_t length);
+	int64_t find_space (int64_t size);
+	void release (int64_t offset, int64_t size);
+
+	boost::filesystem::path _file;
+	/** amount of space to allocate in the file at once, in bytes */
+	int64_t _chunk;
+#ifdef DCPOMATIC_POSIX
+	int _fd;
+#else
+	FILE* _handle;
+#endif
+	/** offset of the end of the last block which has been written and not read back */
+	int64_t _end;
+	/** total size of the blocks in _index */
+	int64_t _used;
+	/** space allocated in the file */
+	int64_t _allocated;
+	/** offsets and sizes of blocks which have been written and not read back */
+	std::map<int64_t, int> _index;
+	/** offsets and sizes of unused regions before _end */
+	std::map<int64_t, int64_t> _free;
+};
+
+#endif
@@ -22,6 +22,7 @@
 #include "cross.h"
 #include "exceptions.h"
 #include "string_text_file_content.h"
+#include "util.h"
 #include <sub/subrip_reader.h>
 #include <sub/ssa_reader.h>
 #include <sub/collect.h>
@@ -34,14 +35,80 @@
 using std::vector;
 using std::cout;
 using std::string;
+using std::map;
+using std::stable_sort;
 using boost::shared_ptr;
 using boost::scoped_array;
 using boost::optional;
 using dcp::Data;
 
+/** Size of the head and tail of a file to use for the digest which checks that it has not changed */
+static boost::uintmax_t const digest_size = 64 * 1024;
+/** Maximum number of files to keep in the cache */
+static size_t const max_cache_entries = 64;
+
+boost::mutex StringTextFile::_cache_mutex;
+map<boost::filesystem::path, StringTextFile::CacheEntry> StringTextFile::_cache;
+boost::uintmax_t StringTextFile::_cache_uses = 0;
+
+static bool
+starts_before (sub::Subtitle const & a, sub::Subtitle const & b)
+{
+	return a.from.all_as_seconds() < b.from.all_as_seconds();
+}
+
 StringTextFile::StringTextFile (shared_ptr<const StringTextFileContent> content)
 {
-	Data in (content->path (0));
+	boost::filesystem::path const path = content->path (0);
+	std::time_t const modified = boost::filesystem::last_write_time (path);
+	boost::uintmax_t const size = boost::filesystem::file_size (path);
+	/* The modification time might not change when the file does (e.g. if it is copied with
+	   its time preserved) so check some of the data too.
+	*/
+	string const digest = digest_head_tail (vector<boost::filesystem::path> (1, path), digest_size);
+
+	{
+		boost::mutex::scoped_lock lm (_cache_mutex);
+		map<boost::filesystem::path, CacheEntry>::iterator i = _cache.find (path);
+		if (i != _cache.end() && i->second.modified == modified && i->second.size == size && i->second.digest == digest) {
+			i->second.last_use = ++_cache_uses;
+			_subtitles = i->second.subtitles;
+			return;
+		}
+	}
+
+	/* Parse without the lock held; if another thread parses the same file at the same time
+	   one of the results will just be thrown away.
+	*/
+	_subtitles = parse (path);
+
+	boost::mutex::scoped_lock lm (_cache_mutex);
+	CacheEntry& e = _cache[path];
+	e.modified = modified;
+	e.size = size;
+	e.digest = digest;
+	e.subtitles = _subtitles;
+	e.last_use = ++_cache_uses;
+
+	if (_cache.size() > max_cache_entries) {
+		/* Remove the least recently used entry */
+		map<boost::filesystem::path, CacheEntry>::iterator oldest = _cache.begin ();
+		for (map<boost::filesystem::path, CacheEntry>::iterator i = _cache.begin(); i != _cache.end(); ++i) {
+			if (i->second.last_use < oldest->second.last_use) {
+				oldest = i;
+			}
+		}
+		_cache.erase (oldest);
+	}
+}
+
+/** Read a subtitle file, detecting its character set, and parse it.
+ *  @return Subtitles sorted by start time.
+ */
+shared_ptr<const vector<sub::Subtitle> >
+StringTextFile::parse (boost::filesystem::path path)
+{
+	Data in (path);
 
 	UErrorCode status = U_ZERO_ERROR;
 	UCharsetDetector* detector = ucsdet_open (&status);
@@ -78,7 +145,7 @@ StringTextFile::StringTextFile (shared_ptr<const StringTextFileContent> content)
 
 	sub::Reader* reader = 0;
 
-	string ext = content->path(0).extension().string();
+	string ext = path.extension().string();
 	transform (ext.begin(), ext.end(), ext.begin(), ::tolower);
 
 	if (ext == ".srt") {
@@ -87,30 +154,34 @@ StringTextFile::StringTextFile (shared_ptr<const StringTextFileContent> content)
 		reader = new sub::SSAReader (utf8.get());
 	}
 
+	shared_ptr<vector<sub::Subtitle> > subtitles (new vector<sub::Subtitle> ());
 	if (reader) {
-		_subtitles = sub::collect<vector<sub::Subtitle> > (reader->subtitles ());
+		*subtitles = sub::collect<vector<sub::Subtitle> > (reader->subtitles ());
+		/* Decoders seek by binary search, so make sure that these are in order */
+		stable_sort (subtitles->begin(), subtitles->end(), starts_before);
 	}
 
 	delete reader;
+	return subtitles;
 }
 
 /** @return time of first subtitle, if there is one */
 optional<ContentTime>
 StringTextFile::first () const
 {
-	if (_subtitles.empty()) {
+	if (_subtitles->empty()) {
 		return optional<ContentTime>();
 	}
 
-	return ContentTime::from_seconds(_subtitles[0].from.all_as_seconds());
+	return ContentTime::from_seconds((*_subtitles)[0].from.all_as_seconds());
 }
 
 ContentTime
 StringTextFile::length () const
 {
-	if (_subtitles.empty ()) {
+	if (_subtitles->empty ()) {
 		return ContentTime ();
 	}
 
-	return ContentTime::from_seconds (_subtitles.back().to.all_as_seconds ());
+	return ContentTime::from_seconds (_subtitles->back().to.all_as_seconds ());
 }
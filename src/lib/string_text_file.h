@@ -24,6 +24,10 @@
 #include "dcpomatic_time.h"
 #include <sub/subtitle.h>
 #include <boost/shared_ptr.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <string>
 #include <vector>
 
 class StringTextFileContent;
@@ -37,6 +41,9 @@ class plain_text_parse_test;
  *
  *  In fact this is sufficient for the examiner, so it's used as-is rather than deriving
  *  a pointless StringTextFileExaminer.
+ *
+ *  Parsed subtitles are kept in a cache shared by all instances, so that making a new
+ *  decoder for a file which has not changed does not parse it again.
  */
 class StringTextFile
 {
@@ -47,7 +54,28 @@ public:
 	ContentTime length () const;
 
 protected:
-	std::vector<sub::Subtitle> _subtitles;
+	/** Subtitles, sorted by start time */
+	boost::shared_ptr<const std::vector<sub::Subtitle> > _subtitles;
+
+private:
+	static boost::shared_ptr<const std::vector<sub::Subtitle> > parse (boost::filesystem::path path);
+
+	struct CacheEntry
+	{
+		std::time_t modified;
+		boost::uintmax_t size;
+		/** digest of the head and tail of the file */
+		std::string digest;
+		boost::shared_ptr<const std::vector<sub::Subtitle> > subtitles;
+		/** value of _cache_uses when this entry was last used */
+		boost::uintmax_t last_use;
+	};
+
+	static boost::mutex _cache_mutex;
+	/** Parsed subtitles, indexed by the path of the file that they came from */
+	static std::map<boost::filesystem::path, CacheEntry> _cache;
+	/** number of times that _cache has been used, so that the least recently used entry can be removed */
+	static boost::uintmax_t _cache_uses;
 };
 
 #endif
@@ -31,18 +31,25 @@ using std::vector;
 using std::string;
 using std::cout;
 using std::max;
+using std::lower_bound;
 using boost::shared_ptr;
 using boost::optional;
 using boost::dynamic_pointer_cast;
 
+static bool
+starts_before (sub::Subtitle const & s, ContentTime t)
+{
+	return ContentTime::from_seconds (s.from.all_as_seconds ()) < t;
+}
+
 StringTextFileDecoder::StringTextFileDecoder (shared_ptr<const Film> film, shared_ptr<const StringTextFileContent> content)
 	: Decoder (film)
 	, StringTextFile (content)
 	, _next (0)
 {
 	ContentTime first;
-	if (!_subtitles.empty()) {
-		first = content_time_period(_subtitles[0]).from;
+	if (!_subtitles->empty()) {
+		first = content_time_period((*_subtitles)[0]).from;
 	}
 	text.push_back (shared_ptr<TextDecoder> (new TextDecoder (this, content->only_text(), first)));
 }
@@ -60,21 +67,19 @@ StringTextFileDecoder::seek (ContentTime time, bool accurate)
 
 	Decoder::seek (time, accurate);
 
-	_next = 0;
-	while (_next < _subtitles.size() && ContentTime::from_seconds (_subtitles[_next].from.all_as_seconds ()) < time) {
-		++_next;
-	}
+	/* _subtitles is sorted by start time */
+	_next = lower_bound (_subtitles->begin(), _subtitles->end(), time, starts_before) - _subtitles->begin();
 }
 
 bool
 StringTextFileDecoder::pass ()
 {
-	if (_next >= _subtitles.size ()) {
+	if (_next >= _subtitles->size ()) {
 		return true;
 	}
 
-	ContentTimePeriod const p = content_time_period (_subtitles[_next]);
-	only_text()->emit_plain (p, _subtitles[_next]);
+	sub::Subtitle const & s = (*_subtitles)[_next];
+	only_text()->emit_plain (content_time_period (s), s);
 
 	++_next;
 	return false;
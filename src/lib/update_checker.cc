@@ -66,6 +66,8 @@ UpdateChecker::UpdateChecker ()
 	curl_easy_setopt (_curl, CURLOPT_WRITEFUNCTION, write_callback_wrapper);
 	curl_easy_setopt (_curl, CURLOPT_WRITEDATA, this);
 	curl_easy_setopt (_curl, CURLOPT_TIMEOUT, 20);
+	/* We check in our own thread, so the timeout must not use signals */
+	curl_easy_setopt (_curl, CURLOPT_NOSIGNAL, 1L);
 
 	string const agent = "dcpomatic/" + string (dcpomatic_version);
 	curl_easy_setopt (_curl, CURLOPT_USERAGENT, agent.c_str ());
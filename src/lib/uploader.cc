@@ -21,59 +21,194 @@
 #include "uploader.h"
 #include "dcpomatic_assert.h"
 #include "compose.hpp"
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/foreach.hpp>
 
 #include "i18n.h"
 
 using std::string;
+using std::vector;
+using std::min;
 using boost::shared_ptr;
 using boost::function;
 
+/** Files smaller than this are always sent again in full, rather than being skipped or resumed
+ *  if something of the right size is already on the server.  They are quick to send, and
+ *  some of them (e.g. ASSETMAP) may have changed without changing their size.
+ */
+static boost::uintmax_t const min_resume_size = 1024 * 1024;
+
 Uploader::Uploader (function<void (string)> set_status, function<void (float)> set_progress)
-	: _set_progress (set_progress)
-	, _set_status (set_status)
+	: _set_status (set_status)
+	, _set_progress (set_progress)
+	, _last_progress (0)
+	, _next_file (0)
+	, _transferred (0)
+	, _total_size (0)
 {
-	_set_status (_("connecting"));
+	set_status (_("connecting"));
 }
 
-boost::uintmax_t
-Uploader::count_file_sizes (boost::filesystem::path directory) const
+/** Find the files and directories in a directory, adding the files to _files.
+ *  @param base Path that should be removed from the start of paths to make the remote paths.
+ *  @param directory Directory to look in.
+ *  @param directories Filled in with remote paths of directories, parents before children.
+ */
+void
+Uploader::find_files (boost::filesystem::path base, boost::filesystem::path directory, vector<boost::filesystem::path>& directories)
 {
 	using namespace boost::filesystem;
 
-	boost::uintmax_t size = 0;
-
+	directories.push_back (remove_prefix (base, directory));
 	for (directory_iterator i = directory_iterator (directory); i != directory_iterator (); ++i) {
 		if (is_directory (i->path ())) {
-			size += count_file_sizes (i->path ());
+			find_files (base, i->path (), directories);
 		} else {
-			size += file_size (*i);
+			boost::uintmax_t const size = file_size (*i);
+			_files.push_back (File (i->path (), remove_prefix (base, i->path ()), size));
+			_total_size += size;
 		}
 	}
-
-	return size;
 }
 
 void
 Uploader::upload (boost::filesystem::path directory)
 {
-	boost::uintmax_t transferred = 0;
-	upload_directory (directory.parent_path (), directory, transferred, count_file_sizes (directory));
+	_files.clear ();
+	_next_file = 0;
+	_transferred = 0;
+	_total_size = 0;
+	_error = boost::exception_ptr ();
+
+	{
+		boost::mutex::scoped_lock lm (_report_mutex);
+		_last_progress = 0;
+	}
+
+	vector<boost::filesystem::path> directories;
+	find_files (directory.parent_path (), directory, directories);
+
+	BOOST_FOREACH (boost::filesystem::path i, directories) {
+		create_directory (i);
+	}
+
+	int const threads = min (streams (), int (_files.size ()));
+
+	boost::thread_group group;
+	for (int i = 0; i < threads; ++i) {
+		boost::thread* t = group.create_thread (boost::bind (&Uploader::thread, this, i));
+#ifdef DCPOMATIC_LINUX
+		pthread_setname_np (t->native_handle(), "upload");
+#else
+		(void) t;
+#endif
+	}
+
+	try {
+		group.join_all ();
+	} catch (boost::thread_interrupted &) {
+		/* The job has been cancelled */
+		group.interrupt_all ();
+		group.join_all ();
+		throw;
+	}
+
+	boost::mutex::scoped_lock lm (_mutex);
+	if (_error) {
+		boost::rethrow_exception (_error);
+	}
 }
 
+/** Send files using a given stream until there are none left or one of the streams fails */
 void
-Uploader::upload_directory (boost::filesystem::path base, boost::filesystem::path directory, boost::uintmax_t& transferred, boost::uintmax_t total_size)
+Uploader::thread (int stream)
 {
-	using namespace boost::filesystem;
+	while (true) {
+		boost::mutex::scoped_lock lm (_mutex);
+		if (_error || _next_file == _files.size ()) {
+			return;
+		}
+		File const file = _files[_next_file++];
+		lm.unlock ();
+
+		try {
+			send (file, stream);
+		} catch (boost::thread_interrupted &) {
+			return;
+		} catch (...) {
+			lm.lock ();
+			if (!_error) {
+				_error = boost::current_exception ();
+			}
+			return;
+		}
+	}
+}
 
-	create_directory (remove_prefix (base, directory));
-	for (directory_iterator i = directory_iterator (directory); i != directory_iterator (); ++i) {
-		if (is_directory (i->path ())) {
-			upload_directory (base, i->path (), transferred, total_size);
-		} else {
-			_set_status (String::compose (_("copying %1"), i->path().leaf ()));
-			upload_file (i->path (), remove_prefix (base, i->path ()), transferred, total_size);
+void
+Uploader::send (File const& file, int stream)
+{
+	set_status (String::compose (_("copying %1"), file.from.leaf ()));
+
+	boost::uintmax_t offset = 0;
+	if (file.size >= min_resume_size) {
+		RemoteFile const remote = remote_file (file.to, stream);
+		/* We can only trust what is on the server if it was written after our file last
+		   changed; otherwise our file may have changed since it was sent, perhaps without
+		   changing its size.
+		*/
+		if (remote.time && *remote.time >= boost::filesystem::last_write_time (file.from)) {
+			offset = remote.size;
+		}
+		if (offset == file.size) {
+			/* This is already on the server */
+			transferred (file.size);
+			return;
+		} else if (offset > file.size) {
+			/* Whatever is there is not what we are sending */
+			offset = 0;
 		}
 	}
+
+	upload_file (file.from, file.to, offset, stream);
+}
+
+/** Note that some bytes have been sent.  This may be called from any thread */
+void
+Uploader::transferred (boost::uintmax_t bytes)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_transferred += bytes;
+	if (_total_size == 0) {
+		return;
+	}
+	float const progress = double (_transferred) / _total_size;
+	lm.unlock ();
+
+	set_progress (progress);
+}
+
+/** Report our status.  This may be called from any thread */
+void
+Uploader::set_status (string s)
+{
+	boost::mutex::scoped_lock lm (_report_mutex);
+	_set_status (s);
+}
+
+/** Report our progress, if it is more than we last reported.  This may be called from any
+ *  thread; the check means that progress which is worked out in one thread but reported
+ *  after some from another does not make the progress go backwards.
+ */
+void
+Uploader::set_progress (float p)
+{
+	boost::mutex::scoped_lock lm (_report_mutex);
+	if (p > _last_progress) {
+		_last_progress = p;
+		_set_progress (p);
+	}
 }
 
 boost::filesystem::path
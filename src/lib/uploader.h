@@ -24,9 +24,23 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/function.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/exception/all.hpp>
+#include <vector>
+#include <ctime>
 
 class Job;
 
+/** @class Uploader
+ *  @brief Parent class for something which can send a directory to a server.
+ *
+ *  Files are sent using as many streams (separate connections to the server) as
+ *  the subclass offers, each stream taking the next file that has not yet been
+ *  started.  Files which are already (fully or partially) on the server are not
+ *  sent again if the subclass can tell how much of them is there, and that it was
+ *  written since the local file was last changed.
+ */
 class Uploader
 {
 public:
@@ -37,17 +51,90 @@ public:
 
 protected:
 
+	/** @return Number of streams that files can be sent on at the same time; remote_file()
+	 *  and upload_file() will be called with stream indices from 0 to one less than this.
+	 */
+	virtual int streams () const {
+		return 1;
+	}
+
 	virtual void create_directory (boost::filesystem::path directory) = 0;
-	virtual void upload_file (boost::filesystem::path from, boost::filesystem::path to, boost::uintmax_t& transferred, boost::uintmax_t total_size) = 0;
 
-	boost::function<void (float)> _set_progress;
+	/** Details of a file on the server */
+	struct RemoteFile
+	{
+		RemoteFile ()
+			: size (0)
+		{}
+
+		/** number of bytes of the file that are on the server, or 0 if it is not there */
+		boost::uintmax_t size;
+		/** time that the file on the server was last modified, if it is known */
+		boost::optional<std::time_t> time;
+	};
+
+	/** @param to Remote path, relative to the target directory on the server.
+	 *  @param stream Stream to use.
+	 *  @return Details of what is on the server at that path, with a size of 0 if
+	 *  there is nothing there or we cannot tell.
+	 */
+	virtual RemoteFile remote_file (boost::filesystem::path, int) {
+		return RemoteFile ();
+	}
+
+	/** Send a file.  Subclasses must call transferred() with the size of each
+	 *  piece of the file that they send, and also with the size of any part of
+	 *  the file that they do not send because it is already on the server.
+	 *  @param from Local file.
+	 *  @param to Remote path, relative to the target directory on the server.
+	 *  @param offset Number of bytes at the start of the file which are already on the server;
+	 *  the transfer should carry on from here if possible, otherwise the whole file should be sent.
+	 *  @param stream Stream to use.
+	 */
+	virtual void upload_file (boost::filesystem::path from, boost::filesystem::path to, boost::uintmax_t offset, int stream) = 0;
+
+	void transferred (boost::uintmax_t bytes);
 
 private:
-	void upload_directory (boost::filesystem::path base, boost::filesystem::path directory, boost::uintmax_t& transferred, boost::uintmax_t total_size);
-	boost::uintmax_t count_file_sizes (boost::filesystem::path) const;
+	struct File
+	{
+		File (boost::filesystem::path from_, boost::filesystem::path to_, boost::uintmax_t size_)
+			: from (from_)
+			, to (to_)
+			, size (size_)
+		{}
+
+		boost::filesystem::path from;
+		boost::filesystem::path to;
+		boost::uintmax_t size;
+	};
+
+	void find_files (boost::filesystem::path base, boost::filesystem::path directory, std::vector<boost::filesystem::path>& directories);
+	void thread (int stream);
+	void send (File const& file, int stream);
 	boost::filesystem::path remove_prefix (boost::filesystem::path prefix, boost::filesystem::path target) const;
+	void set_status (std::string s);
+	void set_progress (float p);
 
+	/** Mutex held while calling _set_status or _set_progress, so that only one
+	 *  stream calls them at a time, and for _last_progress.
+	 */
+	boost::mutex _report_mutex;
 	boost::function<void (std::string)> _set_status;
+	boost::function<void (float)> _set_progress;
+	/** last progress that we gave to _set_progress */
+	float _last_progress;
+
+	/** Mutex for everything below */
+	boost::mutex _mutex;
+	/** Files to send */
+	std::vector<File> _files;
+	/** Index into _files of the next one to start */
+	size_t _next_file;
+	boost::uintmax_t _transferred;
+	boost::uintmax_t _total_size;
+	/** First error that happened in one of the streams */
+	boost::exception_ptr _error;
 };
 
 #endif
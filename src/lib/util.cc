@@ -38,6 +38,7 @@
 #include "crypto.h"
 #include "compose.hpp"
 #include "audio_buffers.h"
+#include "audio_matrix.h"
 #include "string_text.h"
 #include "font.h"
 #include "render_text.h"
@@ -57,6 +58,8 @@ extern "C" {
 #include <libavcodec/avcodec.h>
 }
 #include <curl/curl.h>
+#include <libssh/libssh.h>
+#include <libssh/callbacks.h>
 #include <glib.h>
 #include <pangomm/init.h>
 #include <boost/algorithm/string.hpp>
@@ -378,6 +381,7 @@ dcpomatic_setup ()
 #endif
 
 	Pango::init ();
+	dcpomatic::crypto_thread_setup ();
 	dcp::init ();
 
 #if defined(DCPOMATIC_WINDOWS) || defined(DCPOMATIC_OSX)
@@ -400,6 +404,9 @@ dcpomatic_setup ()
 	AudioProcessor::setup_audio_processors ();
 
 	curl_global_init (CURL_GLOBAL_ALL);
+	/* SCPUploader uses sessions from several threads at once */
+	ssh_threads_set_callbacks (ssh_threads_get_pthread ());
+	ssh_init ();
 
 	ui_thread = boost::this_thread::get_id ();
 }
@@ -819,23 +826,7 @@ audio_channel_types (list<int> mapped, int channels)
 shared_ptr<AudioBuffers>
 remap (shared_ptr<const AudioBuffers> input, int output_channels, AudioMapping map)
 {
-	shared_ptr<AudioBuffers> mapped (new AudioBuffers (output_channels, input->frames()));
-	mapped->make_silent ();
-
-	for (int i = 0; i < map.input_channels(); ++i) {
-		for (int j = 0; j < mapped->channels(); ++j) {
-			if (map.get (i, static_cast<dcp::Channel> (j)) > 0) {
-				mapped->accumulate_channel (
-					input.get(),
-					i,
-					static_cast<dcp::Channel> (j),
-					map.get (i, static_cast<dcp::Channel> (j))
-					);
-			}
-		}
-	}
-
-	return mapped;
+	return AudioMatrix(map, output_channels).apply(input);
 }
 
 Eyes
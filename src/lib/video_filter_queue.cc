@@ -0,0 +1,238 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/video_filter_queue.cc
+ *  @brief VideoFilterQueue class.
+ */
+
+#include "video_filter_queue.h"
+#include "video_filter_graph.h"
+#include "image.h"
+#include "dcpomatic_log.h"
+#include "compose.hpp"
+extern "C" {
+#include <libavutil/frame.h>
+}
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <new>
+
+#include "i18n.h"
+
+using std::list;
+using std::vector;
+using boost::shared_ptr;
+
+/** Number of frames that can be waiting to be filtered before put() blocks */
+static size_t const maximum_waiting = 4;
+
+/** @param filters Filters to run; may be empty.
+ *  @param frame_rate Frame rate of the video that will be given to put().
+ */
+VideoFilterQueue::VideoFilterQueue (vector<Filter const *> filters, dcp::Fraction frame_rate)
+	: _filters (filters)
+	, _frame_rate (frame_rate)
+	, _thread (0)
+	, _busy (false)
+	, _reset (false)
+	, _generation (0)
+	, _stop (false)
+{
+	if (!_filters.empty ()) {
+		_thread = new boost::thread (boost::bind (&VideoFilterQueue::thread, this));
+#ifdef DCPOMATIC_LINUX
+		pthread_setname_np (_thread->native_handle(), "video-filter");
+#endif
+	}
+}
+
+VideoFilterQueue::~VideoFilterQueue ()
+{
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_stop = true;
+		_condition.notify_all ();
+	}
+
+	if (_thread) {
+		_thread->join ();
+		delete _thread;
+	}
+
+	BOOST_FOREACH (AVFrame* i, _in) {
+		av_frame_free (&i);
+	}
+}
+
+/** Add a frame to be filtered.  If there are filters this will wait if too many frames
+ *  are already waiting for the filter thread.  Caller handles memory management of the frame.
+ */
+void
+VideoFilterQueue::put (AVFrame* frame)
+{
+	if (!_thread) {
+		Images images = process (frame);
+		boost::mutex::scoped_lock lm (_mutex);
+		_out.splice (_out.end(), images);
+		return;
+	}
+
+	/* This takes a reference to the frame's buffers, so it stays valid after the decoder
+	   has moved on to the next one.
+	*/
+	AVFrame* copy = av_frame_clone (frame);
+	if (!copy) {
+		throw std::bad_alloc ();
+	}
+
+	boost::mutex::scoped_lock lm (_mutex);
+
+	while (!_error && _in.size() >= maximum_waiting) {
+		_condition.wait (lm);
+	}
+
+	if (_error) {
+		av_frame_free (&copy);
+		boost::rethrow_exception (_error);
+	}
+
+	_in.push_back (copy);
+	_condition.notify_all ();
+}
+
+/** @param wait true to wait for all frames given to put() to be filtered, false to return
+ *  only what has been filtered so far.
+ *  @return Filtered images with their timestamps, in order.
+ */
+VideoFilterQueue::Images
+VideoFilterQueue::get (bool wait)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	if (wait) {
+		while (!_error && (!_in.empty() || _busy)) {
+			_condition.wait (lm);
+		}
+	}
+
+	if (_error) {
+		boost::rethrow_exception (_error);
+	}
+
+	Images images;
+	images.swap (_out);
+	return images;
+}
+
+/** Throw away anything that has not yet been collected by get(), and reset the filters
+ *  so that they do not carry anything over from frames that were given before now.
+ */
+void
+VideoFilterQueue::clear ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	BOOST_FOREACH (AVFrame* i, _in) {
+		av_frame_free (&i);
+	}
+	_in.clear ();
+	_out.clear ();
+	++_generation;
+
+	if (_thread) {
+		_reset = true;
+		_condition.notify_all ();
+	} else {
+		_graphs.clear ();
+	}
+}
+
+void
+VideoFilterQueue::thread ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	while (true) {
+		while (!_stop && _in.empty()) {
+			_condition.wait (lm);
+		}
+
+		if (_stop) {
+			return;
+		}
+
+		AVFrame* frame = _in.front ();
+		_in.pop_front ();
+		int const generation = _generation;
+		if (_reset) {
+			_graphs.clear ();
+			_reset = false;
+		}
+		_busy = true;
+		/* There is now room for put() to add another frame */
+		_condition.notify_all ();
+
+		lm.unlock ();
+		Images images;
+		boost::exception_ptr error;
+		try {
+			images = process (frame);
+		} catch (...) {
+			error = boost::current_exception ();
+		}
+		av_frame_free (&frame);
+		lm.lock ();
+
+		_busy = false;
+		if (error) {
+			_error = error;
+			_condition.notify_all ();
+			return;
+		}
+
+		if (generation == _generation) {
+			_out.splice (_out.end(), images);
+		}
+		_condition.notify_all ();
+	}
+}
+
+/** Run a frame through a graph which can handle its size and pixel format, making one if required */
+VideoFilterQueue::Images
+VideoFilterQueue::process (AVFrame* frame)
+{
+	shared_ptr<VideoFilterGraph> graph;
+
+	list<shared_ptr<VideoFilterGraph> >::iterator i = _graphs.begin();
+	while (i != _graphs.end() && !(*i)->can_process (dcp::Size (frame->width, frame->height), (AVPixelFormat) frame->format)) {
+		++i;
+	}
+
+	if (i == _graphs.end ()) {
+		graph.reset (new VideoFilterGraph (dcp::Size (frame->width, frame->height), (AVPixelFormat) frame->format, _frame_rate));
+		graph->setup (_filters);
+		_graphs.push_back (graph);
+		LOG_GENERAL (N_("New graph for %1x%2, pixel format %3"), frame->width, frame->height, frame->format);
+	} else {
+		graph = *i;
+	}
+
+	return graph->process (frame);
+}
@@ -0,0 +1,100 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/video_filter_queue.h
+ *  @brief VideoFilterQueue class.
+ */
+
+#ifndef DCPOMATIC_VIDEO_FILTER_QUEUE_H
+#define DCPOMATIC_VIDEO_FILTER_QUEUE_H
+
+#include <dcp/types.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/exception/all.hpp>
+#include <list>
+#include <vector>
+#include <stdint.h>
+
+struct AVFrame;
+class Filter;
+class Image;
+class VideoFilterGraph;
+
+/** @class VideoFilterQueue
+ *  @brief Something to pass decoded video frames through FFmpeg filters.
+ *
+ *  Frames are given to put() and the filtered images (with their timestamps) come
+ *  out of get() in the same order.  If there are filters to run they are run in a
+ *  separate thread, a few frames behind the decoder, so that heavy filters (such
+ *  as de-interlacers and denoisers) do not hold up decoding.  All frames go through
+ *  the same thread in order, so filters which look at more than one frame still work.
+ *
+ *  With no filters the frames are just copied into Images in put().
+ */
+class VideoFilterQueue : public boost::noncopyable
+{
+public:
+	VideoFilterQueue (std::vector<Filter const *> filters, dcp::Fraction frame_rate);
+	~VideoFilterQueue ();
+
+	typedef std::list<std::pair<boost::shared_ptr<Image>, int64_t> > Images;
+
+	void put (AVFrame* frame);
+	Images get (bool wait);
+	void clear ();
+
+private:
+	void thread ();
+	Images process (AVFrame* frame);
+
+	std::vector<Filter const *> _filters;
+	dcp::Fraction _frame_rate;
+	/** Graphs for each size and pixel format that we have seen; this is only used by
+	 *  whichever thread is doing the filtering.
+	 */
+	std::list<boost::shared_ptr<VideoFilterGraph> > _graphs;
+	/** our thread, or 0 if there are no filters */
+	boost::thread* _thread;
+
+	/** Mutex for everything below */
+	boost::mutex _mutex;
+	/** Condition to tell the thread that there is something to filter, or to tell
+	 *  put() and get() that something has been filtered.
+	 */
+	boost::condition _condition;
+	/** Frames waiting to be filtered; these are our own references which we must free */
+	std::list<AVFrame*> _in;
+	/** Images which have been filtered and not yet collected by get() */
+	Images _out;
+	/** true if the thread is filtering a frame */
+	bool _busy;
+	/** true if _graphs should be thrown away before the next frame is filtered */
+	bool _reset;
+	/** Incremented by clear() so that the thread can discard whatever it was filtering at the time */
+	int _generation;
+	/** Error thrown by the thread, if any */
+	boost::exception_ptr _error;
+	bool _stop;
+};
+
+#endif
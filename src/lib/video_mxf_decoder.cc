@@ -88,17 +88,18 @@ VideoMXFDecoder::pass ()
 			frame
 			);
 	} else {
+		shared_ptr<const dcp::StereoPictureFrame> stereo_frame = _stereo_reader->get_frame (frame);
 		video->emit (
 			film(),
 			shared_ptr<ImageProxy> (
-				new J2KImageProxy (_stereo_reader->get_frame(frame), _size, dcp::EYE_LEFT, AV_PIX_FMT_XYZ12LE, optional<int>())
+				new J2KImageProxy (stereo_frame, _size, dcp::EYE_LEFT, AV_PIX_FMT_XYZ12LE, optional<int>())
 				),
 			frame
 			);
 		video->emit (
 			film(),
 			shared_ptr<ImageProxy> (
-				new J2KImageProxy (_stereo_reader->get_frame(frame), _size, dcp::EYE_RIGHT, AV_PIX_FMT_XYZ12LE, optional<int>())
+				new J2KImageProxy (stereo_frame, _size, dcp::EYE_RIGHT, AV_PIX_FMT_XYZ12LE, optional<int>())
 				),
 			frame
 			);
@@ -33,11 +33,36 @@ using std::string;
 using boost::shared_ptr;
 using boost::optional;
 
+VideoRingBuffers::VideoRingBuffers ()
+	: _memory_used (0)
+{
+
+}
+
 void
 VideoRingBuffers::put (shared_ptr<PlayerVideo> frame, DCPTime time)
 {
 	boost::mutex::scoped_lock lm (_mutex);
-	_data.push_back (make_pair (frame, time));
+	_data.push_back (Entry (frame, time));
+	_memory_used += _data.back().memory;
+}
+
+/** Count any memory that frame has started using since it was put(), e.g. for its
+ *  prepared image.  This does nothing if frame has already been taken with get().
+ */
+void
+VideoRingBuffers::prepared (shared_ptr<PlayerVideo> frame)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	/* frame is most likely to be one of the more recent ones */
+	for (list<Entry>::reverse_iterator i = _data.rbegin(); i != _data.rend(); ++i) {
+		if (i->video == frame) {
+			size_t const m = frame->memory_used ();
+			_memory_used = _memory_used - i->memory + m;
+			i->memory = m;
+			return;
+		}
+	}
 }
 
 pair<shared_ptr<PlayerVideo>, DCPTime>
@@ -47,9 +72,10 @@ VideoRingBuffers::get ()
 	if (_data.empty ()) {
 		return make_pair(shared_ptr<PlayerVideo>(), DCPTime());
 	}
-	pair<shared_ptr<PlayerVideo>, DCPTime> const r = _data.front ();
+	Entry const e = _data.front ();
 	_data.pop_front ();
-	return r;
+	_memory_used -= e.memory;
+	return make_pair (e.video, e.time);
 }
 
 Frame
@@ -71,14 +97,12 @@ VideoRingBuffers::clear ()
 {
 	boost::mutex::scoped_lock lm (_mutex);
 	_data.clear ();
+	_memory_used = 0;
 }
 
 pair<size_t, string>
 VideoRingBuffers::memory_used () const
 {
-	size_t m = 0;
-	for (list<pair<shared_ptr<PlayerVideo>, DCPTime> >::const_iterator i = _data.begin(); i != _data.end(); ++i) {
-		m += i->first->memory_used();
-	}
-	return make_pair(m, String::compose("%1 frames", _data.size()));
+	boost::mutex::scoped_lock lm (_mutex);
+	return make_pair(_memory_used, String::compose("%1 frames", _data.size()));
 }
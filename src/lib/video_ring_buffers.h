@@ -31,7 +31,10 @@ class PlayerVideo;
 class VideoRingBuffers : public boost::noncopyable
 {
 public:
+	VideoRingBuffers ();
+
 	void put (boost::shared_ptr<PlayerVideo> frame, DCPTime time);
+	void prepared (boost::shared_ptr<PlayerVideo> frame);
 	std::pair<boost::shared_ptr<PlayerVideo>, DCPTime> get ();
 
 	void clear ();
@@ -41,6 +44,22 @@ public:
 	std::pair<size_t, std::string> memory_used () const;
 
 private:
+	struct Entry
+	{
+		Entry (boost::shared_ptr<PlayerVideo> video_, DCPTime time_)
+			: video (video_)
+			, time (time_)
+			, memory (video_->memory_used ())
+		{}
+
+		boost::shared_ptr<PlayerVideo> video;
+		DCPTime time;
+		/** memory used by video when we last looked */
+		size_t memory;
+	};
+
 	mutable boost::mutex _mutex;
-	std::list<std::pair<boost::shared_ptr<PlayerVideo>, DCPTime> > _data;
+	std::list<Entry> _data;
+	/** total of the memory of the entries in _data */
+	size_t _memory_used;
 };
@@ -35,6 +35,7 @@
 #include "font.h"
 #include "util.h"
 #include "reel_writer.h"
+#include "spill_file.h"
 #include "text_content.h"
 #include <dcp/cpl.h>
 #include <dcp/locale_convert.h>
@@ -53,6 +54,7 @@ using std::make_pair;
 using std::pair;
 using std::string;
 using std::list;
+using std::multiset;
 using std::cout;
 using std::map;
 using std::min;
@@ -64,12 +66,19 @@ using boost::dynamic_pointer_cast;
 using boost::optional;
 using dcp::Data;
 
+/** Most data that we put in the spill file, in bytes; enough for a few minutes of frames
+ *  at the highest bandwidth.  Once it is reached frames are pushed to files of their own.
+ */
+static int64_t const maximum_spill = int64_t (8) * 1024 * 1024 * 1024;
+
 Writer::Writer (shared_ptr<const Film> film, weak_ptr<Job> j)
 	: _film (film)
 	, _job (j)
 	, _thread (0)
 	, _finish (false)
 	, _queued_full_in_memory (0)
+	, _queued_full_bytes (0)
+	, _memory (MemoryBudget::WRITER)
 	/* These will be reset to sensible values when J2KEncoder is created */
 	, _maximum_frames_in_memory (8)
 	, _maximum_queue_size (8)
@@ -77,6 +86,7 @@ Writer::Writer (shared_ptr<const Film> film, weak_ptr<Job> j)
 	, _fake_written (0)
 	, _repeat_written (0)
 	, _pushed_to_disk (0)
+	, _maximum_spill (maximum_spill)
 {
 	shared_ptr<Job> job = _job.lock ();
 	DCPOMATIC_ASSERT (job);
@@ -128,31 +138,32 @@ Writer::write (Data encoded, Frame frame, Eyes eyes)
 {
 	boost::mutex::scoped_lock lock (_state_mutex);
 
-	while (_queued_full_in_memory > _maximum_frames_in_memory) {
-		/* There are too many full frames in memory; wake the main writer thread and
-		   wait until it sorts everything out */
-		_empty_condition.notify_all ();
-		_full_condition.wait (lock);
-	}
-
 	QueueItem qi;
 	qi.type = QueueItem::FULL;
 	qi.encoded = encoded;
 	qi.reel = video_reel (frame);
 	qi.frame = frame - _reels[qi.reel].start ();
+	qi.eyes = (_film->three_d() && eyes == EYES_BOTH) ? EYES_LEFT : eyes;
+
+	while (_queued_full_in_memory > maximum_frames_in_memory () && !awaited (qi)) {
+		/* There are too many full frames in memory; wake the main writer
+		   thread and wait until it sorts everything out */
+		_empty_condition.notify_all ();
+		_full_condition.wait (lock);
+	}
 
 	if (_film->three_d() && eyes == EYES_BOTH) {
 		/* 2D material in a 3D DCP; fake the 3D */
 		qi.eyes = EYES_LEFT;
-		_queue.push_back (qi);
-		++_queued_full_in_memory;
+		_queue.insert (qi);
+		add_full_in_memory (qi);
 		qi.eyes = EYES_RIGHT;
-		_queue.push_back (qi);
-		++_queued_full_in_memory;
+		_queue.insert (qi);
+		add_full_in_memory (qi);
 	} else {
 		qi.eyes = eyes;
-		_queue.push_back (qi);
-		++_queued_full_in_memory;
+		_queue.insert (qi);
+		add_full_in_memory (qi);
 	}
 
 	/* Now there's something to do: wake anything wait()ing on _empty_condition */
@@ -188,12 +199,12 @@ Writer::repeat (Frame frame, Eyes eyes)
 	qi.frame = frame - _reels[qi.reel].start ();
 	if (_film->three_d() && eyes == EYES_BOTH) {
 		qi.eyes = EYES_LEFT;
-		_queue.push_back (qi);
+		_queue.insert (qi);
 		qi.eyes = EYES_RIGHT;
-		_queue.push_back (qi);
+		_queue.insert (qi);
 	} else {
 		qi.eyes = eyes;
-		_queue.push_back (qi);
+		_queue.insert (qi);
 	}
 
 	/* Now there's something to do: wake anything wait()ing on _empty_condition */
@@ -219,21 +230,18 @@ Writer::fake_write (Frame frame, Eyes eyes)
 	QueueItem qi;
 	qi.type = QueueItem::FAKE;
 
-	{
-		shared_ptr<InfoFileHandle> info_file = _film->info_file_handle(_reels[reel].period(), true);
-		qi.size = _reels[reel].read_frame_info(info_file, reel_frame, eyes).size;
-	}
+	qi.size = _reels[reel].read_frame_info(reel_frame, eyes).size;
 
 	qi.reel = reel;
 	qi.frame = reel_frame;
 	if (_film->three_d() && eyes == EYES_BOTH) {
 		qi.eyes = EYES_LEFT;
-		_queue.push_back (qi);
+		_queue.insert (qi);
 		qi.eyes = EYES_RIGHT;
-		_queue.push_back (qi);
+		_queue.insert (qi);
 	} else {
 		qi.eyes = eyes;
-		_queue.push_back (qi);
+		_queue.insert (qi);
 	}
 
 	/* Now there's something to do: wake anything wait()ing on _empty_condition */
@@ -284,15 +292,11 @@ Writer::write (shared_ptr<const AudioBuffers> audio, DCPTime const time)
 			};
 
 			if (part_frames[0]) {
-				shared_ptr<AudioBuffers> part (new AudioBuffers (audio->channels(), part_frames[0]));
-				part->copy_from (audio.get(), part_frames[0], 0, 0);
-				_audio_reel->write (part);
+				_audio_reel->write (AudioBuffers::view (audio, part_frames[0], 0));
 			}
 
 			if (part_frames[1]) {
-				shared_ptr<AudioBuffers> part (new AudioBuffers (audio->channels(), part_frames[1]));
-				part->copy_from (audio.get(), part_frames[1], part_frames[0], 0);
-				audio = part;
+				audio = AudioBuffers::view (audio, part_frames[1], part_frames[0]);
 			} else {
 				audio.reset ();
 			}
@@ -311,9 +315,7 @@ Writer::have_sequenced_image_at_queue_head ()
 		return false;
 	}
 
-	_queue.sort ();
-
-	QueueItem const & f = _queue.front();
+	QueueItem const & f = *_queue.begin();
 	ReelWriter const & reel = _reels[f.reel];
 
 	/* The queue should contain only EYES_LEFT/EYES_RIGHT pairs or EYES_BOTH */
@@ -336,6 +338,47 @@ Writer::have_sequenced_image_at_queue_head ()
 	return false;
 }
 
+/** @return Number of FULL frames that we should hold in memory at the moment; fewer than usual
+ *  if the memory budget has been exceeded.  Caller must hold a lock on _state_mutex.
+ */
+int
+Writer::maximum_frames_in_memory () const
+{
+	if (MemoryBudget::instance()->exceeded()) {
+		return max (1, _maximum_frames_in_memory / 4);
+	}
+
+	return _maximum_frames_in_memory;
+}
+
+/** @return true if qi comes before everything in the queue.  We never make write() wait
+ *  for such a frame, as the writer thread may need it before it can write anything.
+ *  Caller must hold a lock on _state_mutex.
+ */
+bool
+Writer::awaited (QueueItem const & qi) const
+{
+	return _queue.empty() || qi < *_queue.begin();
+}
+
+/** Note that a FULL frame's data is now held in memory.  Caller must hold a lock on _state_mutex */
+void
+Writer::add_full_in_memory (QueueItem const & qi)
+{
+	++_queued_full_in_memory;
+	_queued_full_bytes += qi.encoded->size ();
+	_memory.set (_queued_full_bytes);
+}
+
+/** Note that a FULL frame's data is no longer held in memory.  Caller must hold a lock on _state_mutex */
+void
+Writer::remove_full_in_memory (QueueItem const & qi)
+{
+	--_queued_full_in_memory;
+	_queued_full_bytes -= qi.encoded->size ();
+	_memory.set (_queued_full_bytes);
+}
+
 void
 Writer::thread ()
 try
@@ -346,11 +389,14 @@ try
 
 		while (true) {
 
-			if (_finish || _queued_full_in_memory > _maximum_frames_in_memory || have_sequenced_image_at_queue_head ()) {
+			if (_finish || _queued_full_in_memory > maximum_frames_in_memory () || have_sequenced_image_at_queue_head ()) {
 				/* We've got something to do: go and do it */
 				break;
 			}
 
+			/* The memory budget may have changed since write() last looked at it, so let it look again */
+			_full_condition.notify_all ();
+
 			/* Nothing to do: wait until something happens which may indicate that we do */
 			LOG_TIMING (N_("writer-sleep queue=%1"), _queue.size());
 			_empty_condition.wait (lock);
@@ -370,7 +416,7 @@ try
 			/* (Hopefully temporarily) log anything that was not written */
 			if (!_queue.empty() && !have_sequenced_image_at_queue_head()) {
 				LOG_WARNING (N_("Finishing writer with a left-over queue of %1:"), _queue.size());
-				for (list<QueueItem>::const_iterator i = _queue.begin(); i != _queue.end(); ++i) {
+				for (multiset<QueueItem>::const_iterator i = _queue.begin(); i != _queue.end(); ++i) {
 					if (i->type == QueueItem::FULL) {
 						LOG_WARNING (N_("- type FULL, frame %1, eyes %2"), i->frame, (int) i->eyes);
 					} else {
@@ -383,10 +429,10 @@ try
 
 		/* Write any frames that we can write; i.e. those that are in sequence. */
 		while (have_sequenced_image_at_queue_head ()) {
-			QueueItem qi = _queue.front ();
-			_queue.pop_front ();
+			QueueItem qi = *_queue.begin ();
+			_queue.erase (_queue.begin ());
 			if (qi.type == QueueItem::FULL && qi.encoded) {
-				--_queued_full_in_memory;
+				remove_full_in_memory (qi);
 			}
 
 			lock.unlock ();
@@ -396,8 +442,12 @@ try
 			switch (qi.type) {
 			case QueueItem::FULL:
 				LOG_DEBUG_ENCODE (N_("Writer FULL-writes %1 (%2)"), qi.frame, (int) qi.eyes);
-				if (!qi.encoded) {
-					qi.encoded = Data (_film->j2c_path (qi.reel, qi.frame, qi.eyes, false));
+				if (!qi.encoded && qi.spill_offset) {
+					qi.encoded = _spill->read (qi.spill_offset.get());
+				} else if (!qi.encoded) {
+					boost::filesystem::path const file = _film->j2c_path (qi.reel, qi.frame, qi.eyes, false);
+					qi.encoded = Data (file);
+					boost::filesystem::remove (file);
 				}
 				reel.write (qi.encoded, qi.frame, qi.eyes);
 				++_full_written;
@@ -418,39 +468,55 @@ try
 			_full_condition.notify_all ();
 		}
 
-		while (_queued_full_in_memory > _maximum_frames_in_memory) {
+		while (_queued_full_in_memory > maximum_frames_in_memory ()) {
 			/* Too many frames in memory which can't yet be written to the stream.
 			   Write some FULL frames to disk.
 			*/
 
 			/* Find one from the back of the queue */
-			_queue.sort ();
-			list<QueueItem>::reverse_iterator i = _queue.rbegin ();
-			while (i != _queue.rend() && (i->type != QueueItem::FULL || !i->encoded)) {
-				++i;
+			multiset<QueueItem>::reverse_iterator r = _queue.rbegin ();
+			while (r != _queue.rend() && (r->type != QueueItem::FULL || !r->encoded)) {
+				++r;
 			}
 
-			DCPOMATIC_ASSERT (i != _queue.rend());
+			DCPOMATIC_ASSERT (r != _queue.rend());
+			/* Use a forward iterator from here on, as what a reverse iterator points
+			   to would change if something were inserted after the item.
+			*/
+			multiset<QueueItem>::iterator i = r.base ();
+			--i;
 			++_pushed_to_disk;
 			/* For the log message below */
-			int const awaiting = _reels[_queue.front().reel].last_written_video_frame() + 1;
+			int const awaiting = _reels[_queue.begin()->reel].last_written_video_frame() + 1;
 			lock.unlock ();
 
 			/* i is valid here, even though we don't hold a lock on the mutex,
-			   since list iterators are unaffected by insertion and only this
-			   thread could erase the last item in the list.
+			   since set iterators are unaffected by insertion and only this
+			   thread could erase the item.
 			*/
 
 			LOG_GENERAL ("Writer full; pushes %1 to disk while awaiting %2", i->frame, awaiting);
 
-			i->encoded->write_via_temp (
-				_film->j2c_path (i->reel, i->frame, i->eyes, true),
-				_film->j2c_path (i->reel, i->frame, i->eyes, false)
-				);
+			optional<int64_t> offset;
+			if ((_spill ? _spill->length() : 0) + i->encoded->size() <= _maximum_spill) {
+				if (!_spill) {
+					/* Allocate space for a good few frames at a time */
+					int64_t const frame = _film->j2k_bandwidth() / 8 / _film->video_frame_rate();
+					_spill.reset (new SpillFile (_film->spill_path(), max (int64_t (16 * 1024 * 1024), frame * _maximum_frames_in_memory)));
+				}
+				offset = _spill->write (i->encoded.get());
+			} else {
+				/* The spill file is as big as we allow; use a file of its own for this frame */
+				i->encoded->write_via_temp (
+					_film->j2c_path (i->reel, i->frame, i->eyes, true),
+					_film->j2c_path (i->reel, i->frame, i->eyes, false)
+					);
+			}
 
 			lock.lock ();
+			remove_full_in_memory (*i);
 			i->encoded.reset ();
-			--_queued_full_in_memory;
+			i->spill_offset = offset;
 			_full_condition.notify_all ();
 		}
 	}
@@ -496,6 +562,9 @@ Writer::finish ()
 
 	terminate_thread (true);
 
+	/* Anything that was pushed to disk has been written now */
+	_spill.reset ();
+
 	LOG_GENERAL_NC ("Finishing ReelWriters");
 
 	BOOST_FOREACH (ReelWriter& i, _reels) {
@@ -26,11 +26,13 @@
 #include "player_text.h"
 #include "exception_store.h"
 #include "dcp_text_track.h"
+#include "memory_budget.h"
 #include <boost/shared_ptr.hpp>
 #include <boost/weak_ptr.hpp>
 #include <boost/thread.hpp>
 #include <boost/thread/condition.hpp>
 #include <list>
+#include <set>
 
 namespace dcp {
 	class Data;
@@ -42,6 +44,8 @@ class Job;
 class Font;
 class ReferencedReelAsset;
 class ReelWriter;
+class SpillFile;
+struct writer_spill_limit_test;
 
 struct QueueItem
 {
@@ -64,8 +68,15 @@ public:
 		REPEAT,
 	} type;
 
-	/** encoded data for FULL */
-	boost::optional<dcp::Data> encoded;
+	/** encoded data for FULL; this is not part of the ordering so it can be
+	 *  changed while the item is in Writer's queue.
+	 */
+	mutable boost::optional<dcp::Data> encoded;
+	/** offset of the encoded data for FULL in Writer's spill file, if it
+	 *  has been pushed there to save memory.  If the data is in neither
+	 *  encoded nor the spill file it is in a file of its own.
+	 */
+	mutable boost::optional<int64_t> spill_offset;
 	/** size of data for FAKE */
 	int size;
 	/** reel index */
@@ -113,9 +124,15 @@ public:
 	void set_encoder_threads (int threads);
 
 private:
+	friend struct ::writer_spill_limit_test;
+
 	void thread ();
 	void terminate_thread (bool);
 	bool have_sequenced_image_at_queue_head ();
+	int maximum_frames_in_memory () const;
+	bool awaited (QueueItem const & qi) const;
+	void add_full_in_memory (QueueItem const & qi);
+	void remove_full_in_memory (QueueItem const & qi);
 	size_t video_reel (int frame) const;
 	void set_digest_progress (Job* job, float progress);
 	void write_cover_sheet ();
@@ -132,10 +149,16 @@ private:
 	boost::thread* _thread;
 	/** true if our thread should finish */
 	bool _finish;
-	/** queue of things to write to disk */
-	std::list<QueueItem> _queue;
+	/** queue of things to write to disk, sorted so that the next thing
+	 *  to write is at the start.
+	 */
+	std::multiset<QueueItem> _queue;
 	/** number of FULL frames whose JPEG200 data is currently held in RAM */
 	int _queued_full_in_memory;
+	/** number of bytes of JPEG2000 data in the frames counted by _queued_full_in_memory */
+	uint64_t _queued_full_bytes;
+	/** our share of the memory budget; protected by _state_mutex */
+	MemoryBudget::Account _memory;
 	/** mutex for thread state */
 	mutable boost::mutex _state_mutex;
 	/** condition to manage thread wakeups when we have nothing to do  */
@@ -157,6 +180,12 @@ private:
 	    due to the limit of frames to be held in memory.
 	*/
 	int _pushed_to_disk;
+	/** file that frames are pushed to, or 0; this is only used by our thread */
+	boost::shared_ptr<SpillFile> _spill;
+	/** length that _spill can reach before frames are pushed to files of their own instead;
+	 *  0 to always use files of their own.
+	 */
+	int64_t _maximum_spill;
 
 	boost::mutex _digest_progresses_mutex;
 	std::map<boost::thread::id, float> _digest_progresses;
@@ -0,0 +1,158 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/tools/xyz_benchmark.cc
+ *  @brief Time the preparation of frames for JPEG2000 encoding (crop / scale / fade / colour conversion),
+ *  comparing the fused strip-by-strip path in PlayerVideo with doing each stage over the whole frame.
+ */
+
+#include "lib/image.h"
+#include "lib/raw_image_proxy.h"
+#include "lib/player_video.h"
+#include "lib/rgb_to_xyz.h"
+#include "lib/colour_conversion.h"
+#include "lib/dcp_video.h"
+#include "lib/util.h"
+#include <dcp/openjpeg_image.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <getopt.h>
+#include <iostream>
+#include <iomanip>
+
+using std::cout;
+using std::cerr;
+using std::string;
+using boost::shared_ptr;
+using boost::optional;
+
+static void
+note (dcp::NoteType, string)
+{
+
+}
+
+static double
+seconds_since (boost::posix_time::ptime start)
+{
+	return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1e6;
+}
+
+static void
+report (string name, dcp::Size size, int frames, double seconds)
+{
+	cout << std::setw(4) << size.width << "x" << std::setw(4) << size.height << " " << std::setw(8) << name << ": "
+	     << std::fixed << std::setprecision(2) << std::setw(7) << (frames / seconds) << " fps\n";
+}
+
+static void
+benchmark (dcp::Size size, int frames, float fade)
+{
+	/* A YUV 4:2:2 10-bit source, as we might get from a ProRes file */
+	shared_ptr<Image> source (new Image (AV_PIX_FMT_YUV422P10LE, size, true));
+	for (int c = 0; c < source->planes(); ++c) {
+		for (int y = 0; y < source->sample_size(c).height; ++y) {
+			uint16_t* p = reinterpret_cast<uint16_t*> (source->data()[c] + y * source->stride()[c]);
+			for (int x = 0; x < source->sample_size(c).width; ++x) {
+				*p++ = (x + y + c * 64) & 1023;
+			}
+		}
+	}
+
+	ColourConversion conversion (dcp::ColourConversion::rec709_to_xyz ());
+	shared_ptr<const RGBToXYZ> converter = RGBToXYZ::get (conversion);
+
+	/* Each stage over the whole frame in turn */
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time ();
+	for (int i = 0; i < frames; ++i) {
+		shared_ptr<Image> rgb = source->crop_scale_window (Crop(), size, size, dcp::YUV_TO_RGB_REC709, AV_PIX_FMT_RGB48LE, true, false);
+		rgb->fade (fade);
+		converter->convert (rgb->data()[0], rgb->size(), rgb->stride()[0], &note);
+	}
+	report ("staged", size, frames, seconds_since (start));
+
+	/* Fused: the stages are done on strips of the frame, each of which is still in cache for the next stage */
+	start = boost::posix_time::microsec_clock::universal_time ();
+	for (int i = 0; i < frames; ++i) {
+		shared_ptr<PlayerVideo> pv (
+			new PlayerVideo (
+				shared_ptr<ImageProxy> (new RawImageProxy (source)),
+				Crop (),
+				fade,
+				size,
+				size,
+				EYES_BOTH,
+				PART_WHOLE,
+				conversion,
+				boost::weak_ptr<Content> (),
+				optional<Frame> ()
+				)
+			);
+		DCPVideo::convert_to_xyz (pv, &note);
+	}
+	report ("fused", size, frames, seconds_since (start));
+}
+
+static void
+help (string n)
+{
+	cerr << "Syntax: " << n << " [--help] [--frames <n>]\n";
+}
+
+int
+main (int argc, char* argv[])
+{
+	int frames = 24;
+
+	while (true) {
+		static struct option long_options[] = {
+			{ "help", no_argument, 0, 'h'},
+			{ "frames", required_argument, 0, 'f'},
+			{ 0, 0, 0, 0 }
+		};
+
+		int option_index = 0;
+		int c = getopt_long (argc, argv, "hf:", long_options, &option_index);
+
+		if (c == -1) {
+			break;
+		}
+
+		switch (c) {
+		case 'h':
+			help (argv[0]);
+			exit (EXIT_SUCCESS);
+		case 'f':
+			frames = atoi (optarg);
+			break;
+		}
+	}
+
+	if (frames < 1) {
+		help (argv[0]);
+		exit (EXIT_FAILURE);
+	}
+
+	dcpomatic_setup ();
+
+	benchmark (dcp::Size (1998, 1080), frames, 0.5);
+	benchmark (dcp::Size (3996, 2160), frames, 0.5);
+
+	return 0;
+}
@@ -672,6 +672,10 @@ private:
 		_tms_password = new wxTextCtrl (_panel, wxID_ANY);
 		table->Add (_tms_password, 1, wxEXPAND);
 
+		add_label_to_sizer (table, _panel, _("Files to send at once"), true);
+		_upload_streams = new wxSpinCtrl (_panel, wxID_ANY);
+		table->Add (_upload_streams, 1);
+
 		_tms_protocol->Append (_("SCP (for AAM and Doremi)"));
 		_tms_protocol->Append (_("FTP (for Dolby)"));
 
@@ -680,6 +684,8 @@ private:
 		_tms_path->Bind (wxEVT_TEXT, boost::bind (&TMSPage::tms_path_changed, this));
 		_tms_user->Bind (wxEVT_TEXT, boost::bind (&TMSPage::tms_user_changed, this));
 		_tms_password->Bind (wxEVT_TEXT, boost::bind (&TMSPage::tms_password_changed, this));
+		_upload_streams->SetRange (1, 16);
+		_upload_streams->Bind (wxEVT_SPINCTRL, boost::bind (&TMSPage::upload_streams_changed, this));
 	}
 
 	void config_changed ()
@@ -691,6 +697,7 @@ private:
 		checked_set (_tms_path, config->tms_path ());
 		checked_set (_tms_user, config->tms_user ());
 		checked_set (_tms_password, config->tms_password ());
+		checked_set (_upload_streams, config->upload_streams ());
 	}
 
 	void tms_protocol_changed ()
@@ -718,11 +725,17 @@ private:
 		Config::instance()->set_tms_password (wx_to_std (_tms_password->GetValue ()));
 	}
 
+	void upload_streams_changed ()
+	{
+		Config::instance()->set_upload_streams (_upload_streams->GetValue ());
+	}
+
 	wxChoice* _tms_protocol;
 	wxTextCtrl* _tms_ip;
 	wxTextCtrl* _tms_path;
 	wxTextCtrl* _tms_user;
 	wxTextCtrl* _tms_password;
+	wxSpinCtrl* _upload_streams;
 };
 
 static string
@@ -1431,6 +1444,54 @@ private:
 			table->Add (s, 1);
 		}
 
+		{
+			add_label_to_sizer (table, _panel, _("Read ahead in content files"), true);
+			wxBoxSizer* s = new wxBoxSizer (wxHORIZONTAL);
+			_content_readahead = new wxSpinCtrl (_panel);
+			s->Add (_content_readahead, 1);
+			add_label_to_sizer (s, _panel, _("MB"), false);
+			table->Add (s, 1);
+		}
+
+		{
+			add_label_to_sizer (table, _panel, _("Read ahead in image sequences"), true);
+			wxBoxSizer* s = new wxBoxSizer (wxHORIZONTAL);
+			_image_readahead = new wxSpinCtrl (_panel);
+			s->Add (_image_readahead, 1);
+			add_label_to_sizer (s, _panel, _("files"), false);
+			table->Add (s, 1);
+		}
+
+		{
+			add_label_to_sizer (table, _panel, _("Memory for frames being encoded"), true);
+			wxBoxSizer* s = new wxBoxSizer (wxHORIZONTAL);
+			_memory_budget = new wxSpinCtrl (_panel);
+			s->Add (_memory_budget, 1);
+			add_label_to_sizer (s, _panel, _("MB (0 for automatic)"), false);
+			table->Add (s, 1);
+		}
+
+		{
+			add_label_to_sizer (table, _panel, _("Threads for each export encoder"), true);
+			wxBoxSizer* s = new wxBoxSizer (wxHORIZONTAL);
+			_export_threads = new wxSpinCtrl (_panel);
+			s->Add (_export_threads, 1);
+			add_label_to_sizer (s, _panel, _("(0 for automatic)"), false);
+			table->Add (s, 1);
+		}
+
+		{
+			add_label_to_sizer (table, _panel, _("Parts of the film to export at once"), true);
+			wxBoxSizer* s = new wxBoxSizer (wxHORIZONTAL);
+			_export_segments = new wxSpinCtrl (_panel);
+			s->Add (_export_segments, 1);
+			table->Add (s, 1);
+		}
+
+		_memory_map_content = new CheckBox (_panel, _("Memory-map content files on local disks (they must not change while in use)"));
+		table->Add (_memory_map_content, 1, wxEXPAND | wxALL);
+		table->AddSpacer (0);
+
 		{
 			add_top_aligned_label_to_sizer (table, _panel, _("DCP metadata filename format"));
 			dcp::NameFormat::Map titles;
@@ -1494,6 +1555,17 @@ private:
 		_allow_any_container->Bind (wxEVT_CHECKBOX, boost::bind (&AdvancedPage::allow_any_container_changed, this));
 		_only_servers_encode->Bind (wxEVT_CHECKBOX, boost::bind (&AdvancedPage::only_servers_encode_changed, this));
 		_frames_in_memory_multiplier->Bind (wxEVT_SPINCTRL, boost::bind(&AdvancedPage::frames_in_memory_multiplier_changed, this));
+		_content_readahead->SetRange (0, 256);
+		_content_readahead->Bind (wxEVT_SPINCTRL, boost::bind(&AdvancedPage::content_readahead_changed, this));
+		_image_readahead->SetRange (0, 64);
+		_image_readahead->Bind (wxEVT_SPINCTRL, boost::bind(&AdvancedPage::image_readahead_changed, this));
+		_memory_budget->SetRange (0, 1024 * 1024);
+		_memory_budget->Bind (wxEVT_SPINCTRL, boost::bind(&AdvancedPage::memory_budget_changed, this));
+		_export_threads->SetRange (0, 128);
+		_export_threads->Bind (wxEVT_SPINCTRL, boost::bind(&AdvancedPage::export_threads_changed, this));
+		_export_segments->SetRange (1, 32);
+		_export_segments->Bind (wxEVT_SPINCTRL, boost::bind(&AdvancedPage::export_segments_changed, this));
+		_memory_map_content->Bind (wxEVT_CHECKBOX, boost::bind(&AdvancedPage::memory_map_content_changed, this));
 		_dcp_metadata_filename_format->Changed.connect (boost::bind (&AdvancedPage::dcp_metadata_filename_format_changed, this));
 		_dcp_asset_filename_format->Changed.connect (boost::bind (&AdvancedPage::dcp_asset_filename_format_changed, this));
 		_log_general->Bind (wxEVT_CHECKBOX, boost::bind (&AdvancedPage::log_changed, this));
@@ -1524,6 +1596,12 @@ private:
 		checked_set (_log_debug_encode, config->log_types() & LogEntry::TYPE_DEBUG_ENCODE);
 		checked_set (_log_debug_email, config->log_types() & LogEntry::TYPE_DEBUG_EMAIL);
 		checked_set (_frames_in_memory_multiplier, config->frames_in_memory_multiplier());
+		checked_set (_content_readahead, config->content_readahead());
+		checked_set (_image_readahead, config->image_readahead());
+		checked_set (_memory_budget, config->memory_budget());
+		checked_set (_export_threads, config->export_threads());
+		checked_set (_export_segments, config->export_segments());
+		checked_set (_memory_map_content, config->memory_map_content());
 #ifdef DCPOMATIC_WINDOWS
 		checked_set (_win32_console, config->win32_console());
 #endif
@@ -1539,6 +1617,36 @@ private:
 		Config::instance()->set_frames_in_memory_multiplier (_frames_in_memory_multiplier->GetValue());
 	}
 
+	void content_readahead_changed ()
+	{
+		Config::instance()->set_content_readahead (_content_readahead->GetValue());
+	}
+
+	void image_readahead_changed ()
+	{
+		Config::instance()->set_image_readahead (_image_readahead->GetValue());
+	}
+
+	void memory_budget_changed ()
+	{
+		Config::instance()->set_memory_budget (_memory_budget->GetValue());
+	}
+
+	void export_threads_changed ()
+	{
+		Config::instance()->set_export_threads (_export_threads->GetValue());
+	}
+
+	void export_segments_changed ()
+	{
+		Config::instance()->set_export_segments (_export_segments->GetValue());
+	}
+
+	void memory_map_content_changed ()
+	{
+		Config::instance()->set_memory_map_content (_memory_map_content->GetValue());
+	}
+
 	void allow_any_dcp_frame_rate_changed ()
 	{
 		Config::instance()->set_allow_any_dcp_frame_rate (_allow_any_dcp_frame_rate->GetValue ());
@@ -1600,6 +1708,12 @@ private:
 
 	wxSpinCtrl* _maximum_j2k_bandwidth;
 	wxSpinCtrl* _frames_in_memory_multiplier;
+	wxSpinCtrl* _content_readahead;
+	wxSpinCtrl* _image_readahead;
+	wxSpinCtrl* _memory_budget;
+	wxSpinCtrl* _export_threads;
+	wxSpinCtrl* _export_segments;
+	wxCheckBox* _memory_map_content;
 	wxCheckBox* _allow_any_dcp_frame_rate;
 	wxCheckBox* _allow_any_container;
 	wxCheckBox* _only_servers_encode;
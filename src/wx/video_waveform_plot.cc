@@ -36,6 +36,7 @@ using std::cout;
 using std::min;
 using std::max;
 using std::string;
+using std::vector;
 using boost::weak_ptr;
 using boost::shared_ptr;
 using dcp::locale_convert;
@@ -47,10 +48,12 @@ int const VideoWaveformPlot::_x_axis_width = 52;
 VideoWaveformPlot::VideoWaveformPlot (wxWindow* parent, weak_ptr<const Film> film, weak_ptr<FilmViewer> viewer)
 	: wxPanel (parent, wxID_ANY, wxDefaultPosition, wxDefaultSize, wxFULL_REPAINT_ON_RESIZE)
 	, _film (film)
-	, _dirty (true)
 	, _enabled (false)
+	, _thread (0)
+	, _dirty (true)
 	, _component (0)
 	, _contrast (0)
+	, _stop (false)
 {
 #ifndef __WXOSX__
 	SetDoubleBuffered (true);
@@ -67,6 +70,34 @@ VideoWaveformPlot::VideoWaveformPlot (wxWindow* parent, weak_ptr<const Film> fil
 
 	SetMinSize (wxSize (640, 512));
 	SetBackgroundColour (wxColour (0, 0, 0));
+
+	_size = waveform_size ();
+	_thread = new boost::thread (boost::bind (&VideoWaveformPlot::thread, this));
+#ifdef DCPOMATIC_LINUX
+	pthread_setname_np (_thread->native_handle(), "video-waveform");
+#endif
+}
+
+VideoWaveformPlot::~VideoWaveformPlot ()
+{
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_stop = true;
+		_condition.notify_all ();
+	}
+
+	_thread->join ();
+	delete _thread;
+}
+
+/** @return Size that the waveform should be, given the size of the panel */
+dcp::Size
+VideoWaveformPlot::waveform_size () const
+{
+	return dcp::Size (
+		max (0, GetSize().GetWidth() - _x_axis_width),
+		max (0, GetSize().GetHeight() - _vertical_margin * 2)
+		);
 }
 
 void
@@ -74,12 +105,13 @@ VideoWaveformPlot::paint ()
 {
 	wxPaintDC dc (this);
 
-	if (_dirty) {
-		create_waveform ();
-		_dirty = false;
+	shared_ptr<const Image> waveform;
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		waveform = _waveform;
 	}
 
-	if (!_waveform) {
+	if (!waveform) {
 		return;
 	}
 
@@ -88,7 +120,11 @@ VideoWaveformPlot::paint ()
 		return;
 	}
 
-	int const height = _waveform->size().height;
+	/* The waveform may have been made for a different size of panel; if so it will be
+	   stretched to fit until the thread makes a new one.
+	*/
+	dcp::Size const size = waveform_size ();
+	int const height = size.height;
 
 	gc->SetPen (wxPen (wxColour (255, 255, 255), 1, wxPENSTYLE_SOLID));
 
@@ -131,53 +167,77 @@ VideoWaveformPlot::paint ()
 		gc->DrawText (std_to_wx (locale_convert<string> (n)), x, y - (label_height / 2));
 	}
 
-	wxImage waveform (_waveform->size().width, height, _waveform->data()[0], true);
-	wxBitmap bitmap (waveform);
-	gc->DrawBitmap (bitmap, _x_axis_width, _vertical_margin, _waveform->size().width, height);
+	/* wxImage wants tightly-packed RGB so we need to remove any padding from the end of each line */
+	int const line = waveform->size().width * 3;
+	wxImage image (waveform->size().width, waveform->size().height);
+	for (int y = 0; y < waveform->size().height; ++y) {
+		memcpy (image.GetData() + y * line, waveform->data()[0] + y * waveform->stride()[0], line);
+	}
+	wxBitmap bitmap (image);
+	gc->DrawBitmap (bitmap, _x_axis_width, _vertical_margin, size.width, height);
 
 	delete gc;
 }
 
-void
-VideoWaveformPlot::create_waveform ()
+/** Make a waveform.  This is called in the plot's thread.
+ *  @param image XYZ image, with 12-bit components.
+ *  @param component Component to plot (0, 1 or 2).
+ *  @param contrast Multiplication factor for the counts (see set_contrast()).
+ *  @param size Size of the waveform image to make.
+ */
+shared_ptr<const Image>
+VideoWaveformPlot::create_waveform (shared_ptr<const dcp::OpenJPEGImage> image, int component, int contrast, dcp::Size size)
 {
-	_waveform.reset ();
-
-	if (!_image) {
-		return;
-	}
+	dcp::Size const image_size = image->size ();
 
-	dcp::Size const image_size = _image->size();
-	int const waveform_height = GetSize().GetHeight() - _vertical_margin * 2;
-	_waveform.reset (new Image (AV_PIX_FMT_RGB24, dcp::Size (image_size.width, waveform_height), true));
+	/* Counts of the samples in the image which fall into each pixel of the waveform,
+	   stored a waveform row at a time.  Each image column goes straight into the waveform
+	   column that it will be drawn in, so there is no need to scale afterwards.
+	*/
+	vector<int> counts (size.width * size.height, 0);
 
+	/* Offset into counts for each image column, and for each sample value */
+	vector<int> column (image_size.width);
 	for (int x = 0; x < image_size.width; ++x) {
+		column[x] = int64_t (x) * size.width / image_size.width;
+	}
+	vector<int> row (_pixel_values);
+	for (int v = 0; v < _pixel_values; ++v) {
+		row[v] = (v * size.height / _pixel_values) * size.width;
+	}
 
-		/* Work out one vertical `slice' of waveform pixels.  Each value in
-		   strip is the number of samples in image with the corresponding group of
-		   values.
-		*/
-		int strip[waveform_height];
-		memset (strip, 0, waveform_height * sizeof(int));
-
-		int* ip = _image->data (_component) + x;
-		for (int y = 0; y < image_size.height; ++y) {
-			strip[*ip * waveform_height / _pixel_values]++;
-			ip += image_size.width;
+	/* Images taller than this are plotted using only some of their lines */
+	int const max_lines = 1080;
+	int const step = max (1, image_size.height / max_lines);
+
+	/* Go through the image a line at a time, in the order that it is stored */
+	for (int y = 0; y < image_size.height; y += step) {
+		int const * p = image->data(component) + y * image_size.width;
+		int* c = &counts[0];
+		int const * col = &column[0];
+		for (int x = 0; x < image_size.width; ++x) {
+			++c[row[min (_pixel_values - 1, max (0, p[x]))] + col[x]];
 		}
+	}
 
-		/* Copy slice into the waveform */
-		uint8_t* wp = _waveform->data()[0] + x * 3;
-		for (int y = waveform_height - 1; y >= 0; --y) {
-			wp[0] = wp[1] = wp[2] = min (255, (strip[y] * 255 / waveform_height) * _contrast);
-			wp += _waveform->stride()[0];
+	/* Scale counts so that brightness is as if each waveform column was made from one image
+	   column using every line of the image.
+	*/
+	int64_t const scale_num = int64_t (255) * contrast * step * size.width;
+	int64_t const scale_den = max (int64_t (1), int64_t (size.height) * image_size.width);
+
+	shared_ptr<Image> waveform (new Image (AV_PIX_FMT_RGB24, size, true));
+	for (int y = 0; y < size.height; ++y) {
+		/* Higher values are at the top */
+		int const * c = &counts[(size.height - y - 1) * size.width];
+		uint8_t* wp = waveform->data()[0] + y * waveform->stride()[0];
+		for (int x = 0; x < size.width; ++x) {
+			wp[0] = wp[1] = wp[2] = min (int64_t (255), c[x] * scale_num / scale_den);
+			wp += 3;
 		}
 	}
 
-	_waveform = _waveform->scale (
-		dcp::Size (GetSize().GetWidth() - _x_axis_width, waveform_height),
-		dcp::YUV_TO_RGB_REC709, AV_PIX_FMT_RGB24, false, false
-		);
+	return waveform;
 }
 
 static void
@@ -186,6 +246,60 @@ note ()
 
 }
 
+void
+VideoWaveformPlot::thread ()
+{
+	shared_ptr<dcp::OpenJPEGImage> image;
+
+	while (true) {
+		boost::mutex::scoped_lock lm (_mutex);
+		while (!_stop && !_pending && !_dirty) {
+			_condition.wait (lm);
+		}
+
+		if (_stop) {
+			return;
+		}
+
+		/* If several frames have arrived since we last looked, only the latest one is used */
+		shared_ptr<PlayerVideo> pending = _pending;
+		_pending.reset ();
+		_dirty = false;
+		int const component = _component;
+		int const contrast = _contrast;
+		dcp::Size const size = _size;
+		lm.unlock ();
+
+		try {
+			if (pending) {
+				image = DCPVideo::convert_to_xyz (pending, boost::bind (&note));
+			}
+
+			if (!image || size.width == 0 || size.height == 0) {
+				continue;
+			}
+
+			shared_ptr<const Image> waveform = create_waveform (image, component, contrast, size);
+
+			lm.lock ();
+			_waveform = waveform;
+			lm.unlock ();
+		} catch (...) {
+			/* Nothing much we can do about this; it will just mean that the plot is not updated */
+			continue;
+		}
+
+		emit (boost::bind (&VideoWaveformPlot::waveform_ready, this));
+	}
+}
+
+/** Called in the GUI thread when the thread has made a new waveform */
+void
+VideoWaveformPlot::waveform_ready ()
+{
+	Refresh ();
+}
+
 void
 VideoWaveformPlot::set_image (weak_ptr<PlayerVideo> image)
 {
@@ -198,15 +312,18 @@ VideoWaveformPlot::set_image (weak_ptr<PlayerVideo> image)
 	/* We must copy the PlayerVideo here as we will call ::image() on it, potentially
 	   with a different pixel_format than was used when ::prepare() was called.
 	*/
-	_image = DCPVideo::convert_to_xyz (pv->shallow_copy(), boost::bind (&note));
-	_dirty = true;
-	Refresh ();
+	boost::mutex::scoped_lock lm (_mutex);
+	_pending = pv->shallow_copy ();
+	_condition.notify_all ();
 }
 
 void
 VideoWaveformPlot::sized (wxSizeEvent &)
 {
+	boost::mutex::scoped_lock lm (_mutex);
+	_size = waveform_size ();
 	_dirty = true;
+	_condition.notify_all ();
 }
 
 void
@@ -218,9 +335,10 @@ VideoWaveformPlot::set_enabled (bool e)
 void
 VideoWaveformPlot::set_component (int c)
 {
+	boost::mutex::scoped_lock lm (_mutex);
 	_component = c;
 	_dirty = true;
-	Refresh ();
+	_condition.notify_all ();
 }
 
 /** Set `contrast', i.e. a fudge multiplication factor to make low-level signals easier to see,
@@ -229,21 +347,25 @@ VideoWaveformPlot::set_component (int c)
 void
 VideoWaveformPlot::set_contrast (int b)
 {
+	boost::mutex::scoped_lock lm (_mutex);
 	_contrast = b;
 	_dirty = true;
-	Refresh ();
+	_condition.notify_all ();
 }
 
 void
 VideoWaveformPlot::mouse_moved (wxMouseEvent& ev)
 {
-	if (!_image) {
-		return;
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		if (!_waveform) {
+			return;
+		}
 	}
 
-	if (_dirty) {
-		create_waveform ();
-		_dirty = false;
+	dcp::Size const size = waveform_size ();
+	if (size.width == 0 || size.height == 0) {
+		return;
 	}
 
 	shared_ptr<const Film> film = _film.lock ();
@@ -253,12 +375,12 @@ VideoWaveformPlot::mouse_moved (wxMouseEvent& ev)
 
 	dcp::Size const full = film->frame_size ();
 
-	double const xs = static_cast<double> (full.width) / _waveform->size().width;
+	double const xs = static_cast<double> (full.width) / size.width;
 	int const x1 = max (0, min (full.width - 1, int (floor (ev.GetPosition().x - _x_axis_width - 0.5) * xs)));
 	int const x2 = max (0, min (full.width - 1, int (floor (ev.GetPosition().x - _x_axis_width + 0.5) * xs)));
 
-	double const ys = static_cast<double> (_pixel_values) / _waveform->size().height;
-	int const fy = _waveform->size().height - (ev.GetPosition().y - _vertical_margin);
+	double const ys = static_cast<double> (_pixel_values) / size.height;
+	int const fy = size.height - (ev.GetPosition().y - _vertical_margin);
 	int const y1 = max (0, min (_pixel_values - 1, int (floor (fy - 0.5) * ys)));
 	int const y2 = max (0, min (_pixel_values - 1, int (floor (fy + 0.5) * ys)));
 
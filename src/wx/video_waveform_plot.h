@@ -18,10 +18,14 @@
 
 */
 
+#include "lib/signaller.h"
+#include <dcp/types.h>
 #include <wx/wx.h>
 #include <boost/shared_ptr.hpp>
 #include <boost/weak_ptr.hpp>
 #include <boost/signals2.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
 
 namespace dcp {
 	class OpenJPEGImage;
@@ -32,10 +36,18 @@ class Image;
 class Film;
 class FilmViewer;
 
-class VideoWaveformPlot : public wxPanel
+/** @class VideoWaveformPlot
+ *  @brief A plot of how many pixels in each column of the image have each value of
+ *  one of the XYZ components.
+ *
+ *  The image is converted and the plot is made in a separate thread; the GUI just
+ *  draws the most recent plot that has been finished.
+ */
+class VideoWaveformPlot : public wxPanel, public Signaller
 {
 public:
 	VideoWaveformPlot (wxWindow* parent, boost::weak_ptr<const Film> film, boost::weak_ptr<FilmViewer> viewer);
+	~VideoWaveformPlot ();
 
 	void set_enabled (bool e);
 	void set_component (int c);
@@ -51,17 +63,34 @@ public:
 private:
 	void paint ();
 	void sized (wxSizeEvent &);
-	void create_waveform ();
 	void set_image (boost::weak_ptr<PlayerVideo>);
 	void mouse_moved (wxMouseEvent &);
+	dcp::Size waveform_size () const;
+	void thread ();
+	void waveform_ready ();
+
+	static boost::shared_ptr<const Image> create_waveform (
+		boost::shared_ptr<const dcp::OpenJPEGImage> image, int component, int contrast, dcp::Size size
+		);
 
 	boost::weak_ptr<const Film> _film;
-	boost::shared_ptr<dcp::OpenJPEGImage> _image;
-	boost::shared_ptr<const Image> _waveform;
-	bool _dirty;
 	bool _enabled;
+
+	boost::thread* _thread;
+	/** Mutex for everything below */
+	boost::mutex _mutex;
+	/** Condition to wake the thread when there is something for it to do */
+	boost::condition _condition;
+	/** Frame which should be converted and plotted next, or 0 */
+	boost::shared_ptr<PlayerVideo> _pending;
+	/** true if the waveform should be made again (with the same image) */
+	bool _dirty;
 	int _component;
 	int _contrast;
+	dcp::Size _size;
+	/** Most recent finished waveform */
+	boost::shared_ptr<const Image> _waveform;
+	bool _stop;
 
 	static int const _vertical_margin;
 	static int const _pixel_values;
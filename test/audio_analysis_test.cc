@@ -27,6 +27,10 @@
 
 #include <boost/test/unit_test.hpp>
 #include "lib/audio_analysis.h"
+#include "lib/audio_analyser.h"
+#include "lib/audio_buffers.h"
+#include "lib/image_content.h"
+#include "lib/video_content.h"
 #include "lib/analyse_audio_job.h"
 #include "lib/film.h"
 #include "lib/ffmpeg_content.h"
@@ -37,10 +41,12 @@
 #include "lib/audio_content.h"
 #include "lib/content_factory.h"
 #include "lib/playlist.h"
+#include "lib/config.h"
 #include "test.h"
 #include <iostream>
 
 using std::vector;
+using std::max;
 using boost::shared_ptr;
 
 static float
@@ -201,3 +207,68 @@ BOOST_AUTO_TEST_CASE (analyse_audio_test4)
 	JobManager::instance()->analyse_audio (film, playlist, false, c, boost::bind (&finished));
 	BOOST_CHECK (!wait_for_jobs ());
 }
+
+/** Check that splitting an analysis into segments gives the same result as doing it in one go */
+BOOST_AUTO_TEST_CASE (audio_analyser_segments_test)
+{
+	shared_ptr<Film> film = new_test_film ("audio_analyser_segments_test");
+	shared_ptr<ImageContent> content (new ImageContent("test/data/simple_testcard_640x480.png"));
+	film->examine_and_add_content (content);
+	BOOST_REQUIRE (!wait_for_jobs());
+	content->video->set_length (24 * 60 * 5);
+
+	bool const ebur128 = Config::instance()->analyse_ebur128 ();
+
+#ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
+	{
+		/* The peak and RMS analysis is still split when EBU R128 analysis is done too */
+		Config::instance()->set_analyse_ebur128 (true);
+		AudioAnalyser r128 (film, film->playlist(), true, 4);
+		BOOST_CHECK (r128.ebur128 ());
+		BOOST_CHECK_EQUAL (r128.segments(), 4);
+	}
+#endif
+
+	Config::instance()->set_analyse_ebur128 (false);
+	AudioAnalyser whole (film, film->playlist(), true);
+	AudioAnalyser split (film, film->playlist(), true, 4);
+	Config::instance()->set_analyse_ebur128 (ebur128);
+	BOOST_REQUIRE_EQUAL (whole.segments(), 1);
+	BOOST_REQUIRE_EQUAL (split.segments(), 4);
+
+	int const rate = film->audio_frame_rate ();
+	int const block = 4000;
+
+	srand (1);
+	vector<shared_ptr<AudioBuffers> > audio;
+	for (Frame i = 0; i < whole.length(); i += block) {
+		shared_ptr<AudioBuffers> buffers (new AudioBuffers (film->audio_channels(), block));
+		for (int j = 0; j < buffers->channels(); ++j) {
+			for (int k = 0; k < block; ++k) {
+				buffers->data(j)[k] = random_float ();
+			}
+		}
+		audio.push_back (buffers);
+		whole.analyse (0, buffers, DCPTime::from_frames (i, rate));
+	}
+
+	for (int i = 0; i < split.segments(); ++i) {
+		/* Start a little before the segment, as a Player might */
+		Frame const first_block = max (int64_t (0), split.segment_start(i).frames_round(rate) / block - 1);
+		for (size_t j = first_block; j < audio.size() && !split.segment_finished(i); ++j) {
+			split.analyse (i, audio[j], DCPTime::from_frames (j * block, rate));
+		}
+	}
+
+	shared_ptr<AudioAnalysis> a = whole.finish ();
+	shared_ptr<AudioAnalysis> b = split.finish ();
+	for (int i = 0; i < film->audio_channels(); ++i) {
+		BOOST_REQUIRE_EQUAL (a->points(i), b->points(i));
+		for (int j = 0; j < a->points(i); ++j) {
+			BOOST_CHECK_EQUAL (a->get_point(i, j)[AudioPoint::PEAK], b->get_point(i, j)[AudioPoint::PEAK]);
+			BOOST_CHECK_CLOSE (a->get_point(i, j)[AudioPoint::RMS], b->get_point(i, j)[AudioPoint::RMS], 1e-3);
+		}
+		BOOST_CHECK_EQUAL (a->sample_peak()[i].peak, b->sample_peak()[i].peak);
+		BOOST_CHECK (a->sample_peak()[i].time == b->sample_peak()[i].time);
+	}
+}
@@ -28,6 +28,7 @@
 #include "lib/audio_buffers.h"
 
 using std::pow;
+using boost::shared_ptr;
 
 static float tolerance = 1e-3;
 
@@ -303,3 +304,95 @@ BOOST_AUTO_TEST_CASE (audio_buffers_accumulate_frames)
 		}
 	}
 }
+
+/** Data are aligned, views share them and copies of parts of const data do not */
+BOOST_AUTO_TEST_CASE (audio_buffers_view)
+{
+	shared_ptr<AudioBuffers> a (new AudioBuffers (18, 1001));
+	srand (41);
+	random_fill (*a);
+
+	for (int c = 0; c < a->channels(); ++c) {
+		BOOST_CHECK_EQUAL (reinterpret_cast<uintptr_t> (a->data(c)) % 64, 0);
+	}
+
+	AudioBuffers v (a, 500, 250);
+	BOOST_CHECK_EQUAL (v.channels(), 18);
+	BOOST_CHECK_EQUAL (v.frames(), 500);
+	for (int c = 0; c < a->channels(); ++c) {
+		BOOST_CHECK (v.data(c) == a->data(c) + 250);
+	}
+
+	/* Extending a view gives it its own copy */
+	v.ensure_size (1000);
+	srand (41);
+	for (int i = 0; i < 1001; ++i) {
+		for (int c = 0; c < a->channels(); ++c) {
+			float const x = random_float ();
+			if (i >= 250 && i < 750) {
+				BOOST_CHECK_CLOSE (v.data(c)[i - 250], x, tolerance);
+			}
+		}
+	}
+	v.data(0)[0] = 42;
+	BOOST_CHECK (a->data(0)[250] != 42);
+
+	/* Const data are copied by the constructor... */
+	shared_ptr<const AudioBuffers> ca = a;
+	AudioBuffers copy (ca, 500, 250);
+	BOOST_CHECK_EQUAL (copy.frames(), 500);
+	for (int c = 0; c < a->channels(); ++c) {
+		BOOST_CHECK (copy.data(c) != a->data(c) + 250);
+		BOOST_CHECK_EQUAL (reinterpret_cast<uintptr_t> (copy.data(c)) % 64, 0);
+		for (int i = 0; i < 500; ++i) {
+			BOOST_CHECK_EQUAL (copy.data(c)[i], a->data(c)[i + 250]);
+		}
+	}
+
+	/* ...unless a const view is asked for */
+	shared_ptr<const AudioBuffers> cv = AudioBuffers::view (ca, 500, 250);
+	BOOST_CHECK_EQUAL (cv->frames(), 500);
+	BOOST_CHECK (a->shared ());
+	for (int c = 0; c < a->channels(); ++c) {
+		BOOST_CHECK (cv->data(c) == a->data(c) + 250);
+	}
+
+	/* Shortening a view, or something that is viewed, leaves the shared data alone */
+	shared_ptr<AudioBuffers> short_view (new AudioBuffers (a, 500, 250));
+	float const last = a->data(0)[749];
+	short_view->set_frames (100);
+	BOOST_CHECK_EQUAL (short_view->frames(), 100);
+	BOOST_CHECK_EQUAL (a->data(0)[749], last);
+	a->set_frames (600);
+	BOOST_CHECK_EQUAL (a->frames(), 600);
+	BOOST_CHECK_EQUAL (cv->data(0)[499], last);
+
+	/* and getting longer again means a copy */
+	short_view->ensure_size (200);
+	BOOST_CHECK (short_view->data(0) != a->data(0) + 250);
+}
+
+/** trim_start() followed by append(), as a FIFO */
+BOOST_AUTO_TEST_CASE (audio_buffers_trim_start)
+{
+	AudioBuffers fifo (2, 0);
+	int written = 0;
+	int read = 0;
+	srand (7);
+	for (int i = 0; i < 64; ++i) {
+		shared_ptr<AudioBuffers> in (new AudioBuffers (2, rand() % 900 + 1));
+		for (int j = 0; j < in->frames(); ++j) {
+			in->data(0)[j] = in->data(1)[j] = written++;
+		}
+		fifo.append (in);
+
+		int const take = rand() % (fifo.frames() + 1);
+		for (int j = 0; j < take; ++j) {
+			BOOST_REQUIRE_EQUAL (fifo.data(0)[j], read + j);
+			BOOST_REQUIRE_EQUAL (fifo.data(1)[j], read + j);
+		}
+		fifo.trim_start (take);
+		read += take;
+		BOOST_REQUIRE_EQUAL (fifo.frames(), written - read);
+	}
+}
@@ -26,8 +26,12 @@
 #include <boost/test/unit_test.hpp>
 #include "lib/audio_mapping.h"
 #include "lib/util.h"
+#include "lib/audio_matrix.h"
+#include "lib/audio_buffers.h"
+#include <cmath>
 
 using std::list;
+using boost::shared_ptr;
 
 BOOST_AUTO_TEST_CASE (audio_mapping_test)
 {
@@ -57,3 +61,68 @@ BOOST_AUTO_TEST_CASE (audio_mapping_test)
 		}
 	}
 }
+
+/** Check AudioMatrix against doing the gain and mapping by hand */
+BOOST_AUTO_TEST_CASE (audio_matrix_test)
+{
+	int const in_channels = 16;
+	int const out_channels = 16;
+	int const frames = 1923;
+
+	srand (1);
+
+	AudioMapping mapping (in_channels, MAX_DCP_AUDIO_CHANNELS);
+	for (int i = 0; i < in_channels; ++i) {
+		/* Each input goes to between 0 and 3 outputs, some with unity gain */
+		for (int j = 0; j < i % 4; ++j) {
+			mapping.set (i, rand() % out_channels, (j == 0) ? 1 : (rand() % 100) / 50.0);
+		}
+	}
+
+	shared_ptr<AudioBuffers> in (new AudioBuffers (in_channels, frames));
+	for (int i = 0; i < in_channels; ++i) {
+		for (int j = 0; j < frames; ++j) {
+			in->data(i)[j] = (rand() % 65536) / 32768.0 - 1;
+		}
+	}
+
+	float const gain = -3.5;
+	float const linear = pow (10, gain / 20);
+
+	AudioMatrix matrix (mapping, out_channels, gain);
+	BOOST_REQUIRE_EQUAL (matrix.output_channels(), out_channels);
+
+	/* Apply into a buffer with stale contents and the wrong size to check that it is properly re-made */
+	AudioBuffers out (out_channels, 10);
+	for (int i = 0; i < out_channels; ++i) {
+		for (int j = 0; j < 10; ++j) {
+			out.data(i)[j] = 42;
+		}
+	}
+	matrix.apply (in.get(), &out);
+	BOOST_REQUIRE_EQUAL (out.frames(), frames);
+
+	for (int i = 0; i < out_channels; ++i) {
+		for (int j = 0; j < frames; ++j) {
+			float ref = 0;
+			for (int k = 0; k < in_channels; ++k) {
+				ref += in->data(k)[j] * linear * mapping.get(k, i);
+			}
+			BOOST_REQUIRE_SMALL (out.data(i)[j] - ref, 1e-5f);
+		}
+	}
+
+	/* With no gain the result should be exactly what remap used to give */
+	shared_ptr<AudioBuffers> unity = AudioMatrix(mapping, out_channels).apply(in);
+	for (int i = 0; i < out_channels; ++i) {
+		for (int j = 0; j < frames; ++j) {
+			float ref = 0;
+			for (int k = 0; k < in_channels; ++k) {
+				if (mapping.get(k, i) > 0) {
+					ref += in->data(k)[j] * mapping.get(k, i);
+				}
+			}
+			BOOST_REQUIRE_EQUAL (unity->data(i)[j], ref);
+		}
+	}
+}
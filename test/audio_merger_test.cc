@@ -30,7 +30,9 @@
 #include <boost/function.hpp>
 #include <boost/signals2.hpp>
 #include <iostream>
+#include <map>
 
+using std::map;
 using std::pair;
 using std::list;
 using std::cout;
@@ -134,3 +136,121 @@ BOOST_AUTO_TEST_CASE (audio_merger_test3)
 		BOOST_CHECK_EQUAL (tb.front().first->data()[0][i], i);
 	}
 }
+
+/* Push lots of randomly-placed, overlapping blocks and check that everything we
+   pull back is the sum of what was pushed at that time.
+*/
+BOOST_AUTO_TEST_CASE (audio_merger_test4)
+{
+	srand (1);
+
+	for (int run = 0; run < 16; ++run) {
+		AudioMerger merger (sampling_rate);
+		map<Frame, float> reference;
+		Frame pulled = rand() % 1000;
+
+		for (int step = 0; step < 256; ++step) {
+			if (rand() % 3) {
+				Frame const at = pulled + rand() % 5000;
+				int const frames = 1 + rand() % 3000;
+				shared_ptr<AudioBuffers> buffers (new AudioBuffers (1, frames));
+				for (int i = 0; i < frames; ++i) {
+					buffers->data()[0][i] = rand() % 100;
+					reference[at + i] += buffers->data()[0][i];
+				}
+				merger.push (buffers, DCPTime::from_frames(at, sampling_rate));
+			} else {
+				pulled += rand() % 3000;
+				list<pair<shared_ptr<AudioBuffers>, DCPTime> > tb = merger.pull (DCPTime::from_frames(pulled, sampling_rate));
+				for (list<pair<shared_ptr<AudioBuffers>, DCPTime> >::const_iterator i = tb.begin(); i != tb.end(); ++i) {
+					Frame const start = i->second.frames_round (sampling_rate);
+					BOOST_REQUIRE (start + i->first->frames() <= pulled);
+					for (int j = 0; j < i->first->frames(); ++j) {
+						BOOST_REQUIRE_EQUAL (i->first->data()[0][j], reference[start + j]);
+						reference.erase (start + j);
+					}
+				}
+			}
+		}
+	}
+}
+
+/** Check some pulled audio against what was pushed, removing it from reference */
+static void
+check_pulled (list<pair<shared_ptr<AudioBuffers>, DCPTime> > const & pulled, Frame pulled_to, map<Frame, float>& reference, Frame& last_end)
+{
+	for (list<pair<shared_ptr<AudioBuffers>, DCPTime> >::const_iterator i = pulled.begin(); i != pulled.end(); ++i) {
+		Frame const start = i->second.frames_round (sampling_rate);
+		BOOST_REQUIRE (start >= last_end);
+		BOOST_REQUIRE (start + i->first->frames() <= pulled_to);
+		for (int j = 0; j < i->first->frames(); ++j) {
+			BOOST_REQUIRE_EQUAL (i->first->data()[0][j], reference[start + j]);
+			reference.erase (start + j);
+		}
+		last_end = start + i->first->frames();
+	}
+}
+
+/* As audio_merger_test4 but with some blocks pushed far ahead of the others, which
+   AudioMerger keeps to one side until it gets to them.
+*/
+BOOST_AUTO_TEST_CASE (audio_merger_test5)
+{
+	srand (1);
+
+	for (int run = 0; run < 16; ++run) {
+		AudioMerger merger (sampling_rate);
+		map<Frame, float> reference;
+		Frame pulled = rand() % 1000;
+		Frame last_end = 0;
+
+		for (int step = 0; step < 256; ++step) {
+			if (rand() % 3) {
+				Frame const at = pulled + ((rand() % 8) ? rand() % 5000 : rand() % (sampling_rate * 30));
+				int const frames = 1 + rand() % 3000;
+				shared_ptr<AudioBuffers> buffers (new AudioBuffers (1, frames));
+				for (int i = 0; i < frames; ++i) {
+					buffers->data()[0][i] = rand() % 100;
+					reference[at + i] += buffers->data()[0][i];
+				}
+				merger.push (buffers, DCPTime::from_frames(at, sampling_rate));
+			} else {
+				pulled += rand() % 30000;
+				check_pulled (merger.pull (DCPTime::from_frames(pulled, sampling_rate)), pulled, reference, last_end);
+			}
+		}
+
+		/* Get everything that is left */
+		pulled += sampling_rate * 40;
+		check_pulled (merger.pull (DCPTime::from_frames(pulled, sampling_rate)), pulled, reference, last_end);
+		BOOST_CHECK (reference.empty ());
+	}
+}
+
+/* Check that buffers returned by pull() are used again once nobody else has them */
+BOOST_AUTO_TEST_CASE (audio_merger_test6)
+{
+	AudioMerger merger (sampling_rate);
+
+	push (merger, 0, 64, 0);
+	list<pair<shared_ptr<AudioBuffers>, DCPTime> > tb = merger.pull (DCPTime::from_frames (64, sampling_rate));
+	BOOST_REQUIRE_EQUAL (tb.size(), 1U);
+	AudioBuffers* first = tb.front().first.get ();
+
+	/* Still in use, so we should get new buffers */
+	push (merger, 0, 96, 64);
+	list<pair<shared_ptr<AudioBuffers>, DCPTime> > tb2 = merger.pull (DCPTime::from_frames (160, sampling_rate));
+	BOOST_REQUIRE_EQUAL (tb2.size(), 1U);
+	BOOST_CHECK (tb2.front().first.get() != first);
+
+	/* Not in use, so they should be re-used */
+	tb.clear ();
+	push (merger, 0, 128, 160);
+	tb = merger.pull (DCPTime::from_frames (288, sampling_rate));
+	BOOST_REQUIRE_EQUAL (tb.size(), 1U);
+	BOOST_CHECK (tb.front().first.get() == first);
+	BOOST_CHECK_EQUAL (tb.front().first->frames(), 128);
+	for (int i = 0; i < 128; ++i) {
+		BOOST_REQUIRE_EQUAL (tb.front().first->data()[0][i], i);
+	}
+}
@@ -191,3 +191,55 @@ BOOST_AUTO_TEST_CASE (audio_ring_buffers_test3)
 	BOOST_CHECK (!rb.get(buffer, 2, 240));
 	BOOST_CHECK_EQUAL (buffer[240 * 2], CANARY);
 }
+
+/** Test getting planar data, with more and then fewer channels than were put in */
+BOOST_AUTO_TEST_CASE (audio_ring_buffers_test4)
+{
+	AudioRingBuffers rb;
+
+	/* Put some data in, in two lumps */
+	int value = 0;
+	for (int i = 0; i < 2; ++i) {
+		shared_ptr<AudioBuffers> data (new AudioBuffers (4, 50));
+		for (int j = 0; j < 50; ++j) {
+			for (int k = 0; k < 4; ++k) {
+				data->data(k)[j] = value++;
+			}
+		}
+		rb.put (data, DCPTime::from_frames(i * 50, 48000), 48000);
+	}
+	BOOST_CHECK_EQUAL (rb.size(), 100);
+
+	/* Get some of it out across the join with more channels than went in */
+	shared_ptr<AudioBuffers> out (new AudioBuffers (6, 70));
+	BOOST_CHECK (*rb.get(out) == DCPTime());
+	int check = 0;
+	for (int i = 0; i < 70; ++i) {
+		for (int j = 0; j < 4; ++j) {
+			BOOST_REQUIRE_EQUAL (out->data(j)[i], check++);
+		}
+		for (int j = 4; j < 6; ++j) {
+			BOOST_REQUIRE_EQUAL (out->data(j)[i], 0);
+		}
+	}
+	BOOST_CHECK_EQUAL (rb.size(), 30);
+
+	/* Get the rest, and then some, with fewer channels */
+	out.reset (new AudioBuffers (2, 40));
+	BOOST_CHECK (*rb.get(out) == DCPTime::from_frames(70, 48000));
+	for (int i = 0; i < 30; ++i) {
+		for (int j = 0; j < 2; ++j) {
+			BOOST_REQUIRE_EQUAL (out->data(j)[i], check++);
+		}
+		check += 2;
+	}
+	for (int i = 30; i < 40; ++i) {
+		for (int j = 0; j < 2; ++j) {
+			BOOST_REQUIRE_EQUAL (out->data(j)[i], 0);
+		}
+	}
+	BOOST_CHECK_EQUAL (rb.size(), 0);
+
+	/* Now there should be an underrun */
+	BOOST_CHECK (!rb.get(out));
+}
@@ -0,0 +1,132 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/check_content_change_test.cc
+ *  @brief Test CheckContentChangeJob.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/check_content_change_job.h"
+#include "lib/examine_content_job.h"
+#include "lib/job_manager.h"
+#include "lib/content_factory.h"
+#include "lib/content.h"
+#include "lib/film.h"
+#include "lib/compose.hpp"
+#include "test.h"
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+
+using std::list;
+using std::vector;
+using std::find;
+using boost::shared_ptr;
+using boost::dynamic_pointer_cast;
+
+/** Run a CheckContentChangeJob on film and wait for it, and any jobs that it adds, to finish.
+ *  @return Content that the job asked to be re-examined, in the order that it asked.
+ */
+static vector<shared_ptr<Content> >
+check (shared_ptr<Film> film)
+{
+	shared_ptr<Job> job (new CheckContentChangeJob (film));
+	JobManager::instance()->add (job);
+	BOOST_REQUIRE (!wait_for_jobs ());
+
+	list<shared_ptr<Job> > jobs = JobManager::instance()->get ();
+	list<shared_ptr<Job> >::const_iterator i = find (jobs.begin(), jobs.end(), job);
+	BOOST_REQUIRE (i != jobs.end());
+
+	vector<shared_ptr<Content> > examined;
+	for (++i; i != jobs.end(); ++i) {
+		shared_ptr<ExamineContentJob> e = dynamic_pointer_cast<ExamineContentJob> (*i);
+		if (e) {
+			examined.push_back (e->content ());
+		}
+	}
+
+	return examined;
+}
+
+/** Replace the file at path with a copy of other, keeping its modification time */
+static void
+replace_keeping_time (boost::filesystem::path path, boost::filesystem::path other)
+{
+	std::time_t const time = boost::filesystem::last_write_time (path);
+	boost::filesystem::copy_file (other, path, boost::filesystem::copy_option::overwrite_if_exists);
+	boost::filesystem::last_write_time (path, time);
+}
+
+/** Check that unchanged content is not re-examined, that content whose file is touched or
+ *  replaced is, and that changed content is reported in the order that it is in the film.
+ */
+BOOST_AUTO_TEST_CASE (check_content_change_test1)
+{
+	shared_ptr<Film> film = new_test_film2 ("check_content_change_test1");
+	boost::filesystem::path const dir = "build/test/check_content_change_test1";
+
+	char const * names[] = { "red", "green", "blue" };
+	vector<shared_ptr<Content> > content;
+	for (int i = 0; i < 3; ++i) {
+		boost::filesystem::path const path = dir / (String::compose ("%1.png", names[i]));
+		boost::filesystem::copy_file (String::compose ("test/data/flat_%1.png", names[i]), path, boost::filesystem::copy_option::overwrite_if_exists);
+		content.push_back (content_factory(path).front());
+		film->examine_and_add_content (content.back());
+		BOOST_REQUIRE (!wait_for_jobs ());
+	}
+
+	/* Nothing has changed; the first check calculates digests and the second need not */
+	BOOST_CHECK (check(film).empty());
+	BOOST_CHECK (check(film).empty());
+
+	/* Touch one file */
+	boost::filesystem::path const green = content[1]->path(0);
+	boost::filesystem::last_write_time (green, boost::filesystem::last_write_time(green) + 60);
+	vector<shared_ptr<Content> > examined = check (film);
+	BOOST_REQUIRE_EQUAL (examined.size(), 1U);
+	BOOST_CHECK (examined[0] == content[1]);
+
+	/* Now change the first piece of content so that only its digest shows it, and touch
+	   the third; they must be reported in film order even though the first is only found
+	   when the digests are checked.
+	*/
+	replace_keeping_time (content[0]->path(0), "test/data/simple_testcard_640x480.png");
+	boost::filesystem::path const blue = content[2]->path(0);
+	boost::filesystem::last_write_time (blue, boost::filesystem::last_write_time(blue) + 60);
+	examined = check (film);
+	BOOST_REQUIRE_EQUAL (examined.size(), 2U);
+	BOOST_CHECK (examined[0] == content[0]);
+	BOOST_CHECK (examined[1] == content[2]);
+
+	/* Re-order the content so that blue is first, then change both again in the same ways */
+	film->move_content_earlier (content[2]);
+	film->move_content_earlier (content[2]);
+	BOOST_REQUIRE (film->content().front() == content[2]);
+	replace_keeping_time (content[2]->path(0), "test/data/simple_testcard_640x480.png");
+	boost::filesystem::path const red = content[0]->path(0);
+	boost::filesystem::last_write_time (red, boost::filesystem::last_write_time(red) + 60);
+	examined = check (film);
+	BOOST_REQUIRE_EQUAL (examined.size(), 2U);
+	BOOST_CHECK (examined[0] == content[2]);
+	BOOST_CHECK (examined[1] == content[0]);
+
+	/* After re-examination everything is unchanged again */
+	BOOST_CHECK (check(film).empty());
+}
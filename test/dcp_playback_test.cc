@@ -44,7 +44,8 @@ BOOST_AUTO_TEST_CASE (dcp_playback_test)
 			6,
 			bind(&PlayerVideo::force, _1, AV_PIX_FMT_RGB24),
 			false,
-			true)
+			true,
+			MemoryBudget::PREVIEW)
 		);
 	float* audio_buffer = new float[2000*6];
 	while (true) {
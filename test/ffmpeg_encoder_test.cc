@@ -31,11 +31,20 @@
 #include "lib/text_content.h"
 #include "lib/compose.hpp"
 #include "lib/content_factory.h"
+#include "lib/config.h"
 #include "test.h"
+extern "C" {
+#include <libavformat/avformat.h>
+}
 #include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 using std::string;
+using std::vector;
 using boost::shared_ptr;
+using boost::optional;
 
 static void
 ffmpeg_content_test (int number, boost::filesystem::path content, ExportFormat format)
@@ -159,6 +168,76 @@ BOOST_AUTO_TEST_CASE (ffmpeg_encoder_prores_test7)
 	encoder.go ();
 }
 
+/** Check that the video in an export which was made in segments has the right number of frames,
+ *  with no gaps or repeats in their timestamps, and that the file is the right length.
+ */
+static void
+check_segmented_export (boost::filesystem::path file, int frames, int frame_rate)
+{
+	AVFormatContext* context = 0;
+	BOOST_REQUIRE (avformat_open_input (&context, file.string().c_str(), 0, 0) >= 0);
+	BOOST_REQUIRE (avformat_find_stream_info (context, 0) >= 0);
+	int const stream = av_find_best_stream (context, AVMEDIA_TYPE_VIDEO, -1, -1, 0, 0);
+	BOOST_REQUIRE (stream >= 0);
+	AVRational const time_base = context->streams[stream]->time_base;
+
+	vector<int64_t> pts;
+	optional<int64_t> last_dts;
+	AVPacket packet;
+	while (av_read_frame (context, &packet) >= 0) {
+		if (packet.stream_index == stream) {
+			BOOST_REQUIRE (packet.pts != AV_NOPTS_VALUE);
+			BOOST_REQUIRE (packet.dts != AV_NOPTS_VALUE);
+			/* Packets must come in decoding order across the joins */
+			if (last_dts) {
+				BOOST_REQUIRE (packet.dts > *last_dts);
+			}
+			last_dts = packet.dts;
+			pts.push_back (llrint (packet.pts * av_q2d (time_base) * frame_rate));
+		}
+		av_packet_unref (&packet);
+	}
+
+	BOOST_REQUIRE_EQUAL (pts.size(), size_t (frames));
+
+	/* Presentation times must go up a frame at a time once re-ordered */
+	std::sort (pts.begin(), pts.end());
+	for (size_t i = 1; i < pts.size(); ++i) {
+		BOOST_REQUIRE_EQUAL (pts[i] - pts[i - 1], 1);
+	}
+
+	BOOST_CHECK_CLOSE (double (context->duration) / AV_TIME_BASE, double (frames) / frame_rate, 0.5);
+
+	avformat_close_input (&context);
+}
+
+/** Still image -> Prores, encoded in 3 parts at the same time */
+BOOST_AUTO_TEST_CASE (ffmpeg_encoder_prores_test8)
+{
+	shared_ptr<Film> film = new_test_film ("ffmpeg_encoder_prores_test8");
+	film->set_name ("ffmpeg_encoder_prores_test8");
+	shared_ptr<ImageContent> c (new ImageContent(private_data / "bbc405.png"));
+	film->set_container (Ratio::from_id ("185"));
+	film->set_audio_channels (6);
+
+	film->examine_and_add_content (c);
+	BOOST_REQUIRE (!wait_for_jobs ());
+
+	c->video->set_length (24 * 60 * 3);
+
+	film->write_metadata ();
+	Config::instance()->set_export_segments (3);
+	shared_ptr<Job> job (new TranscodeJob (film));
+	FFmpegEncoder encoder (film, job, "build/test/ffmpeg_encoder_prores_test8.mov", EXPORT_FORMAT_PRORES, false, false, 23);
+	encoder.go ();
+	Config::instance()->set_export_segments (1);
+
+	BOOST_CHECK_EQUAL (encoder.frames_done(), 24 * 60 * 3);
+	BOOST_CHECK (!boost::filesystem::exists ("build/test/ffmpeg_encoder_prores_test8.part1.mov"));
+	BOOST_CHECK (!boost::filesystem::exists ("build/test/ffmpeg_encoder_prores_test8.part1.audio"));
+	check_segmented_export ("build/test/ffmpeg_encoder_prores_test8.mov", 24 * 60 * 3, 24);
+}
+
 /** Red / green / blue MP4 -> H264 */
 BOOST_AUTO_TEST_CASE (ffmpeg_encoder_h264_test1)
 {
@@ -306,3 +385,29 @@ BOOST_AUTO_TEST_CASE (ffmpeg_encoder_h264_test6)
 	FFmpegEncoder encoder (film2, job, "build/test/ffmpeg_encoder_h264_test6_vf.mp4", EXPORT_FORMAT_H264, true, false, 23);
 	encoder.go ();
 }
+
+/** Still image -> H264, encoded in 2 parts at the same time */
+BOOST_AUTO_TEST_CASE (ffmpeg_encoder_h264_test7)
+{
+	shared_ptr<Film> film = new_test_film ("ffmpeg_encoder_h264_test7");
+	film->set_name ("ffmpeg_encoder_h264_test7");
+	shared_ptr<ImageContent> c (new ImageContent(private_data / "bbc405.png"));
+	film->set_container (Ratio::from_id ("185"));
+	film->set_audio_channels (6);
+
+	film->examine_and_add_content (c);
+	BOOST_REQUIRE (!wait_for_jobs ());
+
+	c->video->set_length (24 * 60 * 2);
+
+	film->write_metadata ();
+	Config::instance()->set_export_segments (2);
+	shared_ptr<Job> job (new TranscodeJob (film));
+	FFmpegEncoder encoder (film, job, "build/test/ffmpeg_encoder_h264_test7.mp4", EXPORT_FORMAT_H264, false, false, 23);
+	encoder.go ();
+	Config::instance()->set_export_segments (1);
+
+	BOOST_CHECK_EQUAL (encoder.frames_done(), 24 * 60 * 2);
+	BOOST_CHECK (!boost::filesystem::exists ("build/test/ffmpeg_encoder_h264_test7.part1.mp4"));
+	check_segmented_export ("build/test/ffmpeg_encoder_h264_test7.mp4", 24 * 60 * 2, 24);
+}
@@ -0,0 +1,147 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/ffmpeg_index_test.cc
+ *  @brief Test FFmpegIndex.
+ *  @ingroup specific
+ */
+
+#include "lib/ffmpeg_index.h"
+#include "lib/ffmpeg_examiner.h"
+#include "lib/ffmpeg_content.h"
+#include "lib/film.h"
+#include "lib/cross.h"
+#include "lib/exceptions.h"
+#include "test.h"
+#include <boost/test/unit_test.hpp>
+
+using boost::shared_ptr;
+
+/** Write an index and read it back */
+BOOST_AUTO_TEST_CASE (ffmpeg_index_test1)
+{
+	FFmpegIndex index;
+	for (int i = 0; i < 100; ++i) {
+		index.add (0, i * 1000, i * 65536, (i % 10) == 0);
+		index.add (1, i * 1001, i * 65536 + 4096, true);
+	}
+	index.set_video_length (100);
+
+	boost::filesystem::create_directories ("build/test/ffmpeg_index_test1");
+	boost::filesystem::path const file = "build/test/ffmpeg_index_test1/index";
+	index.write (file);
+
+	FFmpegIndex check (file);
+	BOOST_REQUIRE (check.video_length ());
+	BOOST_CHECK_EQUAL (check.video_length().get(), 100);
+	BOOST_CHECK_EQUAL (check.packets (0), 100U);
+	BOOST_CHECK_EQUAL (check.packets (1), 100U);
+	BOOST_CHECK_EQUAL (check.packets (2), 0U);
+
+	BOOST_CHECK_EQUAL (check.keyframe_before(0, 0).get(), 0);
+	BOOST_CHECK_EQUAL (check.keyframe_before(0, 9999).get(), 0);
+	BOOST_CHECK_EQUAL (check.keyframe_before(0, 10000).get(), 10000);
+	BOOST_CHECK_EQUAL (check.keyframe_before(0, 55000).get(), 50000);
+	BOOST_CHECK_EQUAL (check.keyframe_before(1, 55000).get(), 54054);
+	BOOST_CHECK (!check.keyframe_before(0, -1));
+	BOOST_CHECK (!check.keyframe_before(2, 1000));
+	BOOST_CHECK (!check.complete());
+	/* We don't know about keyframes after the end of an incomplete index */
+	BOOST_CHECK_EQUAL (check.keyframe_before(0, 99000).get(), 90000);
+	BOOST_CHECK (!check.keyframe_before(0, 99001));
+
+	index.set_complete ();
+	index.write (file);
+	FFmpegIndex complete (file);
+	BOOST_CHECK (complete.complete());
+	BOOST_CHECK_EQUAL (complete.keyframe_before(0, 200000).get(), 90000);
+}
+
+/** Check that an index whose packet count is more than the file could hold is rejected */
+BOOST_AUTO_TEST_CASE (ffmpeg_index_test3)
+{
+	FFmpegIndex index;
+	for (int i = 0; i < 10; ++i) {
+		index.add (0, i * 1000, i * 65536, true);
+	}
+
+	boost::filesystem::create_directories ("build/test/ffmpeg_index_test3");
+	boost::filesystem::path const file = "build/test/ffmpeg_index_test3/index";
+	index.write (file);
+
+	/* Overwrite the packet count of the first stream, which comes after the magic, version,
+	   video length, complete flag, stream count, stream index and end.
+	*/
+	FILE* f = fopen_boost (file, "r+b");
+	BOOST_REQUIRE (f);
+	dcpomatic_fseek (f, 4 + 4 + 8 + 1 + 4 + 4 + 8, SEEK_SET);
+	uint32_t const count = 0xffffffff;
+	BOOST_REQUIRE_EQUAL (fwrite (&count, sizeof (count), 1, f), 1U);
+	fclose (f);
+
+	BOOST_CHECK_THROW (FFmpegIndex check (file), FileError);
+}
+
+/** Check that examining content writes an index, and that examining it again
+ *  using that index gives the same results.
+ */
+BOOST_AUTO_TEST_CASE (ffmpeg_index_test2)
+{
+	shared_ptr<Film> film = new_test_film ("ffmpeg_index_test2");
+	shared_ptr<FFmpegContent> content (new FFmpegContent ("test/data/test.mp4"));
+	film->examine_and_add_content (content);
+	BOOST_REQUIRE (!wait_for_jobs ());
+
+	BOOST_REQUIRE (film->ffmpeg_index_path (content));
+	boost::filesystem::path const index = film->ffmpeg_index_path(content).get();
+	BOOST_REQUIRE (boost::filesystem::exists (index));
+	BOOST_CHECK (!FFmpegIndex(index).empty());
+
+	shared_ptr<FFmpegExaminer> without (new FFmpegExaminer (content));
+	shared_ptr<FFmpegExaminer> with (new FFmpegExaminer (content, shared_ptr<Job> (), index));
+	BOOST_CHECK_EQUAL (without->video_length(), with->video_length());
+	BOOST_CHECK (without->first_video() == with->first_video());
+}
+
+/** Check that indices are removed when their content is removed, and that stale ones are
+ *  removed when a film is loaded.
+ */
+BOOST_AUTO_TEST_CASE (ffmpeg_index_test4)
+{
+	shared_ptr<Film> film = new_test_film ("ffmpeg_index_test4");
+	shared_ptr<FFmpegContent> content (new FFmpegContent ("test/data/test.mp4"));
+	film->examine_and_add_content (content);
+	BOOST_REQUIRE (!wait_for_jobs ());
+	film->write_metadata ();
+
+	boost::filesystem::path const index = film->ffmpeg_index_path(content).get();
+	BOOST_REQUIRE (boost::filesystem::exists (index));
+
+	boost::filesystem::path const stale = index.parent_path() / "stale";
+	boost::filesystem::copy_file (index, stale);
+
+	shared_ptr<Film> loaded (new Film (film->directory().get()));
+	loaded->read_metadata ();
+	BOOST_CHECK (!boost::filesystem::exists (stale));
+	BOOST_CHECK (boost::filesystem::exists (index));
+
+	film->remove_content (content);
+	BOOST_CHECK (!boost::filesystem::exists (index));
+}
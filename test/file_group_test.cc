@@ -27,14 +27,19 @@
 #include <cstdio>
 #include <boost/test/unit_test.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/shared_ptr.hpp>
 #include "lib/file_group.h"
 
 using std::vector;
 
-BOOST_AUTO_TEST_CASE (file_group_test)
+static uint8_t data[65536];
+static int total_length = 0;
+
+/** Write some files of random data and return their names */
+static vector<boost::filesystem::path>
+make_files ()
 {
 	/* Random data; must be big enough for all the files */
-	uint8_t data[65536];
 	for (int i = 0; i < 65536; ++i) {
 		data[i] = rand() & 0xff;
 	}
@@ -48,7 +53,7 @@ BOOST_AUTO_TEST_CASE (file_group_test)
 		42
 	};
 
-	int total_length = 0;
+	total_length = 0;
 	for (int i = 0; i < num_files; ++i) {
 		total_length += length[i];
 	}
@@ -68,7 +73,12 @@ BOOST_AUTO_TEST_CASE (file_group_test)
 		base += length[i];
 	}
 
-	FileGroup fg (name);
+	return name;
+}
+
+static void
+check (FileGroup const & fg)
+{
 	uint8_t test[65536];
 
 	int pos = 0;
@@ -110,3 +120,92 @@ BOOST_AUTO_TEST_CASE (file_group_test)
 	BOOST_CHECK_EQUAL (fg.read (test, 256), 256);
 	BOOST_CHECK_EQUAL (memcmp (data + total_length - 1077, test, 256), 0);
 }
+
+BOOST_AUTO_TEST_CASE (file_group_test)
+{
+	FileGroup fg (make_files ());
+	check (fg);
+}
+
+/** Check the same things with the files memory-mapped and/or read ahead in another thread */
+BOOST_AUTO_TEST_CASE (file_group_test2)
+{
+	vector<boost::filesystem::path> name = make_files ();
+
+	{
+		FileGroup fg;
+		fg.set_mmap (true);
+		fg.set_paths (name);
+		check (fg);
+	}
+
+	{
+		FileGroup fg;
+		fg.set_readahead (1024 * 1024);
+		fg.set_paths (name);
+		check (fg);
+	}
+
+	{
+		/* A buffer smaller than some of the reads, which will wrap */
+		FileGroup fg;
+		fg.set_readahead (1000);
+		fg.set_paths (name);
+		check (fg);
+	}
+
+	{
+		FileGroup fg;
+		fg.set_readahead (1000);
+		fg.set_paths (name);
+		uint8_t test[65536];
+		/* Lots of small reads and seeks which land inside and outside the readahead buffer */
+		int pos = 0;
+		for (int i = 0; i < 2000; ++i) {
+			int const n = rand() % 700;
+			int const got = fg.read (test, n);
+			BOOST_REQUIRE_EQUAL (got, std::min (n, total_length - pos));
+			BOOST_REQUIRE_EQUAL (memcmp (data + pos, test, got), 0);
+			pos += got;
+			if ((i % 3) == 0) {
+				int64_t const to = rand() % total_length;
+				BOOST_REQUIRE_EQUAL (fg.seek (to, SEEK_SET), to);
+				pos = to;
+			} else if ((i % 3) == 1 && pos + 100 < total_length) {
+				BOOST_REQUIRE_EQUAL (fg.seek (100, SEEK_CUR), pos + 100);
+				pos += 100;
+			}
+		}
+	}
+}
+
+/** Check that only a limited number of FileGroups read ahead at once, and that the others still work */
+BOOST_AUTO_TEST_CASE (file_group_test3)
+{
+	vector<boost::filesystem::path> name = make_files ();
+
+	vector<boost::shared_ptr<FileGroup> > groups;
+	int reading_ahead = 0;
+	for (int i = 0; i < FileGroup::maximum_readahead_threads + 4; ++i) {
+		boost::shared_ptr<FileGroup> fg (new FileGroup);
+		fg->set_readahead (1000);
+		fg->set_paths (name);
+		if (fg->reading_ahead ()) {
+			++reading_ahead;
+		}
+		groups.push_back (fg);
+	}
+
+	BOOST_CHECK_EQUAL (reading_ahead, FileGroup::maximum_readahead_threads);
+
+	for (size_t i = 0; i < groups.size(); ++i) {
+		check (*groups[i].get());
+	}
+
+	/* Threads are given back when a FileGroup is destroyed */
+	groups.clear ();
+	FileGroup fg;
+	fg.set_readahead (1000);
+	fg.set_paths (name);
+	BOOST_CHECK (fg.reading_ahead ());
+}
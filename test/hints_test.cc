@@ -0,0 +1,214 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/hints_test.cc
+ *  @brief Test Hints.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/hints.h"
+#include "lib/film.h"
+#include "lib/content_factory.h"
+#include "lib/string_text_file_content.h"
+#include "lib/text_content.h"
+#include "lib/audio_analysis.h"
+#include "lib/analyse_audio_job.h"
+#include "lib/job_manager.h"
+#include "lib/signal_manager.h"
+#include "lib/cross.h"
+#include "test.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+#include <boost/bind.hpp>
+#include <fstream>
+
+using std::string;
+using std::vector;
+using boost::shared_ptr;
+
+/** Collects what a Hints says */
+class HintsResult
+{
+public:
+	HintsResult ()
+		: finished (false)
+	{}
+
+	void hint (string h) {
+		hints.push_back (h);
+	}
+
+	void finish () {
+		finished = true;
+	}
+
+	/** @return true if we were given a hint containing s */
+	bool has (string s) const {
+		BOOST_FOREACH (string i, hints) {
+			if (i.find (s) != string::npos) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	vector<string> hints;
+	bool finished;
+};
+
+static HintsResult
+get_hints (shared_ptr<Film> film)
+{
+	HintsResult result;
+	Hints hints (film);
+	hints.Hint.connect (boost::bind (&HintsResult::hint, &result, _1));
+	hints.Finished.connect (boost::bind (&HintsResult::finish, &result));
+	hints.start ();
+
+	while (!result.finished) {
+		while (signal_manager->ui_idle ()) {}
+		dcpomatic_sleep (1);
+	}
+
+	return result;
+}
+
+/** @return The closed caption hints files in film's analysis directory */
+static vector<boost::filesystem::path>
+text_hints_files (shared_ptr<Film> film)
+{
+	vector<boost::filesystem::path> files;
+	for (boost::filesystem::directory_iterator i (film->dir("analysis")); i != boost::filesystem::directory_iterator(); ++i) {
+		if (i->path().filename().string().substr(0, 6) == "hints_") {
+			files.push_back (i->path ());
+		}
+	}
+	return files;
+}
+
+/** @return A film with some audio and a closed caption which is too long */
+static shared_ptr<Film>
+make_film (string name)
+{
+	shared_ptr<Film> film = new_test_film2 (name);
+
+	boost::filesystem::path const srt = film->directory().get() / "ccap.srt";
+	std::ofstream f (srt.string().c_str());
+	f << "1\n00:00:01,000 --> 00:00:03,000\nThis caption is longer than any closed caption should be\n\n";
+	f.close ();
+
+	shared_ptr<Content> audio = content_factory("test/data/staircase.wav").front();
+	film->examine_and_add_content (audio);
+	shared_ptr<StringTextFileContent> text (new StringTextFileContent (srt));
+	film->examine_and_add_content (text);
+	BOOST_REQUIRE (!wait_for_jobs ());
+	text->only_text()->set_type (TEXT_CLOSED_CAPTION);
+
+	return film;
+}
+
+/** Check that the audio analysis that Hints makes while it looks at the closed captions
+ *  is the same as the one made by AnalyseAudioJob, and that the closed captions are checked.
+ */
+BOOST_AUTO_TEST_CASE (hints_test1)
+{
+	shared_ptr<Film> film = make_film ("hints_test1");
+	boost::filesystem::path const path = film->audio_analysis_path (film->playlist ());
+	BOOST_REQUIRE (!boost::filesystem::exists (path));
+
+	HintsResult result = get_hints (film);
+	BOOST_CHECK (result.has ("longer than"));
+	BOOST_REQUIRE (boost::filesystem::exists (path));
+	BOOST_CHECK_EQUAL (text_hints_files(film).size(), 1U);
+
+	AudioAnalysis from_hints (path);
+	boost::filesystem::remove (path);
+
+	JobManager::instance()->add (shared_ptr<Job> (new AnalyseAudioJob (film, film->playlist(), true)));
+	BOOST_REQUIRE (!wait_for_jobs ());
+	AudioAnalysis from_job (path);
+
+	BOOST_REQUIRE_EQUAL (from_hints.channels(), from_job.channels());
+	for (int i = 0; i < from_job.channels(); ++i) {
+		BOOST_REQUIRE_EQUAL (from_hints.points(i), from_job.points(i));
+		for (int j = 0; j < from_job.points(i); ++j) {
+			for (int k = 0; k < AudioPoint::COUNT; ++k) {
+				BOOST_CHECK_CLOSE (from_hints.get_point(i, j)[k], from_job.get_point(i, j)[k], 1e-3);
+			}
+		}
+	}
+
+	BOOST_REQUIRE_EQUAL (from_hints.sample_peak().size(), from_job.sample_peak().size());
+	for (size_t i = 0; i < from_job.sample_peak().size(); ++i) {
+		BOOST_CHECK_CLOSE (from_hints.sample_peak()[i].peak, from_job.sample_peak()[i].peak, 1e-3);
+		BOOST_CHECK (from_hints.sample_peak()[i].time == from_job.sample_peak()[i].time);
+	}
+
+	BOOST_REQUIRE_EQUAL (from_hints.true_peak().size(), from_job.true_peak().size());
+	for (size_t i = 0; i < from_job.true_peak().size(); ++i) {
+		BOOST_CHECK_CLOSE (from_hints.true_peak()[i], from_job.true_peak()[i], 1e-3);
+	}
+
+	BOOST_REQUIRE_EQUAL (static_cast<bool> (from_hints.integrated_loudness()), static_cast<bool> (from_job.integrated_loudness()));
+	if (from_job.integrated_loudness()) {
+		BOOST_CHECK_CLOSE (from_hints.integrated_loudness().get(), from_job.integrated_loudness().get(), 1e-3);
+	}
+}
+
+/** Check that the results of the closed caption checks are kept, and used again
+ *  until something changes which could change them.
+ */
+BOOST_AUTO_TEST_CASE (hints_test2)
+{
+	shared_ptr<Film> film = make_film ("hints_test2");
+
+	HintsResult result = get_hints (film);
+	BOOST_CHECK (result.has ("longer than"));
+	BOOST_CHECK (!result.has ("overlapping"));
+	vector<boost::filesystem::path> files = text_hints_files (film);
+	BOOST_REQUIRE_EQUAL (files.size(), 1U);
+
+	/* Change what was written, so we can tell if it is read back rather than checked again */
+	std::ofstream f (files.front().string().c_str());
+	f << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+	  << "<TextHints><LongCCAP>0</LongCCAP><OverlapCCAP>1</OverlapCCAP><TooManyCCAPLines>0</TooManyCCAPLines></TextHints>\n";
+	f.close ();
+
+	result = get_hints (film);
+	BOOST_CHECK (!result.has ("longer than"));
+	BOOST_CHECK (result.has ("overlapping"));
+	BOOST_CHECK_EQUAL (text_hints_files(film).size(), 1U);
+
+	/* A change to the film which could change the results means the captions are checked again */
+	film->set_interop (!film->interop ());
+	result = get_hints (film);
+	BOOST_CHECK (result.has ("longer than"));
+	BOOST_CHECK (!result.has ("overlapping"));
+	BOOST_CHECK_EQUAL (text_hints_files(film).size(), 2U);
+
+	/* A broken file is ignored and the captions are checked again */
+	film->set_interop (!film->interop ());
+	f.open (files.front().string().c_str());
+	f << "not XML";
+	f.close ();
+	result = get_hints (film);
+	BOOST_CHECK (result.has ("longer than"));
+	BOOST_CHECK (!result.has ("overlapping"));
+}
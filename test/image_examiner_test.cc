@@ -0,0 +1,150 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/image_examiner_test.cc
+ *  @brief Test finding the size of JPEG2000 files from their headers.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/image_examiner.h"
+#include "lib/cross.h"
+#include "test.h"
+#include <dcp/openjpeg_image.h>
+#include <dcp/j2k.h>
+#include <dcp/data.h>
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <string>
+
+using std::string;
+using boost::shared_ptr;
+using boost::optional;
+
+/** @return A JPEG2000 codestream of a grey image of the given size */
+static dcp::Data
+codestream (dcp::Size size)
+{
+	shared_ptr<dcp::OpenJPEGImage> xyz (new dcp::OpenJPEGImage (size));
+	for (int c = 0; c < 3; ++c) {
+		std::fill (xyz->data(c), xyz->data(c) + size.width * size.height, 2048);
+	}
+	return dcp::compress_j2k (xyz, 100000000, 24, false, false);
+}
+
+static void
+write_be32 (FILE* f, uint32_t v)
+{
+	uint8_t const b[4] = { uint8_t (v >> 24), uint8_t (v >> 16), uint8_t (v >> 8), uint8_t (v) };
+	BOOST_REQUIRE_EQUAL (fwrite (b, 1, 4, f), 4U);
+}
+
+/** Write a JP2 box with a 32-bit length */
+static void
+write_box (FILE* f, char const * type, string payload)
+{
+	write_be32 (f, payload.size() + 8);
+	BOOST_REQUIRE_EQUAL (fwrite (type, 1, 4, f), 4U);
+	BOOST_REQUIRE_EQUAL (fwrite (payload.data(), 1, payload.size(), f), payload.size());
+}
+
+/** @return A string of the big-endian bytes of v */
+static string
+be32 (uint32_t v)
+{
+	string s;
+	s += char (v >> 24);
+	s += char (v >> 16);
+	s += char (v >> 8);
+	s += char (v);
+	return s;
+}
+
+/** Check that the size found from the headers of a raw codestream matches the decoded image */
+BOOST_AUTO_TEST_CASE (image_examiner_test1)
+{
+	dcp::Size const size (1998, 1080);
+	dcp::Data const data = codestream (size);
+	boost::filesystem::path const path = "build/test/image_examiner_test1.j2c";
+	data.write (path);
+
+	optional<dcp::Size> header = j2k_size (path);
+	BOOST_REQUIRE (header);
+	BOOST_CHECK (*header == size);
+	BOOST_CHECK (*header == dcp::decompress_j2k (data, 0)->size());
+}
+
+/** Check that the size found from the headers of a JP2 file matches the decoded image, when
+ *  there are other boxes (one with a 64-bit length) before the codestream.
+ */
+BOOST_AUTO_TEST_CASE (image_examiner_test2)
+{
+	dcp::Size const size (1998, 1080);
+	dcp::Data const data = codestream (size);
+	boost::filesystem::path const path = "build/test/image_examiner_test2.jp2";
+
+	FILE* f = fopen_boost (path, "wb");
+	BOOST_REQUIRE (f);
+
+	/* Signature */
+	write_box (f, "jP  ", be32 (0x0d0a870a));
+	/* File type: brand, minor version, compatibility list */
+	write_box (f, "ftyp", "jp2 " + be32 (0) + "jp2 ");
+
+	/* Header, containing the image header (height, width, components, bits per component,
+	   compression type, colourspace unknown, IPR) and a colour specification of sRGB.
+	*/
+	string ihdr = be32 (size.height) + be32 (size.width);
+	ihdr += char (0);
+	ihdr += char (3);
+	ihdr += char (11);
+	ihdr += char (7);
+	ihdr += char (0);
+	ihdr += char (0);
+	string colr;
+	colr += char (1);
+	colr += char (0);
+	colr += char (0);
+	colr += be32 (16);
+	string const jp2h = be32 (ihdr.size() + 8) + "ihdr" + ihdr + be32 (colr.size() + 8) + "colr" + colr;
+	write_box (f, "jp2h", jp2h);
+
+	/* Some XML */
+	write_box (f, "xml ", "<?xml version=\"1.0\"?><foo>bar</foo>");
+
+	/* Some free space, with a 64-bit length */
+	string const padding (100, 'x');
+	write_be32 (f, 1);
+	BOOST_REQUIRE_EQUAL (fwrite ("free", 1, 4, f), 4U);
+	write_be32 (f, 0);
+	write_be32 (f, padding.size() + 16);
+	BOOST_REQUIRE_EQUAL (fwrite (padding.data(), 1, padding.size(), f), padding.size());
+
+	/* The codestream */
+	write_box (f, "jp2c", string (reinterpret_cast<char const *> (data.data().get()), data.size()));
+
+	fclose (f);
+
+	optional<dcp::Size> header = j2k_size (path);
+	BOOST_REQUIRE (header);
+	BOOST_CHECK (*header == size);
+
+	dcp::Data const jp2 (path);
+	BOOST_CHECK (*header == dcp::decompress_j2k (jp2, 0)->size());
+}
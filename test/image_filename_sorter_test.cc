@@ -70,3 +70,38 @@ BOOST_AUTO_TEST_CASE (image_filename_sorter_test2)
 		BOOST_CHECK_EQUAL(paths[i].string(), String::compose("some.filename.with.%1.number.tiff", i));
 	}
 }
+
+/** Test frame numbers which are written with different numbers of digits */
+BOOST_AUTO_TEST_CASE (image_filename_sorter_test3)
+{
+	ImageFilenameSorter x;
+	BOOST_CHECK (x ("frame_9.dpx", "frame_10.dpx"));
+	BOOST_CHECK (x ("frame_0009.dpx", "frame_10.dpx"));
+	BOOST_CHECK (x ("frame_9.dpx", "frame_0010.dpx"));
+	BOOST_CHECK (x ("frame_99999.dpx", "frame_100000.dpx"));
+	BOOST_CHECK (x ("frame_0.dpx", "frame_1.dpx"));
+
+	BOOST_CHECK (!x ("frame_10.dpx", "frame_9.dpx"));
+	BOOST_CHECK (!x ("frame_010.dpx", "frame_10.dpx"));
+	BOOST_CHECK (!x ("frame_10.dpx", "frame_010.dpx"));
+	BOOST_CHECK (!x ("frame_000.dpx", "frame_0.dpx"));
+
+	vector<boost::filesystem::path> paths;
+	for (int i = 0; i < 2000; ++i) {
+		/* Pad some numbers to 4 digits and leave others as they are */
+		if (i % 3) {
+			paths.push_back (String::compose("frame_%1.dpx", i));
+		} else {
+			paths.push_back (String::compose("frame_%1.dpx", String::compose("%1", i + 10000).substr(1)));
+		}
+	}
+	vector<boost::filesystem::path> const sorted = paths;
+	random_shuffle (paths.begin(), paths.end());
+
+	vector<boost::filesystem::path> with_operator = paths;
+	sort (with_operator.begin(), with_operator.end(), ImageFilenameSorter());
+	BOOST_CHECK (with_operator == sorted);
+
+	ImageFilenameSorter::sort (paths);
+	BOOST_CHECK (paths == sorted);
+}
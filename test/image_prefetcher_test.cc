@@ -0,0 +1,129 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/image_prefetcher_test.cc
+ *  @brief Test ImagePrefetcher.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/image_prefetcher.h"
+#include "lib/memory_budget.h"
+#include "lib/exceptions.h"
+#include "lib/cross.h"
+#include "lib/compose.hpp"
+#include "test.h"
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+
+using std::string;
+using std::vector;
+
+/** Make some files, each of which contains its own frame number */
+static vector<boost::filesystem::path>
+make_sequence (boost::filesystem::path dir, int frames)
+{
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir);
+
+	vector<boost::filesystem::path> paths;
+	for (int i = 0; i < frames; ++i) {
+		boost::filesystem::path const path = dir / String::compose ("%1.dat", i);
+		FILE* f = fopen_boost (path, "wb");
+		BOOST_REQUIRE (f);
+		string const s = String::compose ("frame %1", i);
+		BOOST_REQUIRE_EQUAL (fwrite (s.c_str(), 1, s.length(), f), s.length());
+		fclose (f);
+		paths.push_back (path);
+	}
+
+	return paths;
+}
+
+static string
+contents (dcp::Data data)
+{
+	return string (reinterpret_cast<char const *> (data.data().get()), data.size());
+}
+
+/** Check that we get the right frames when reading in order and after seeks
+ *  backwards and forwards.
+ */
+BOOST_AUTO_TEST_CASE (image_prefetcher_test1)
+{
+	vector<boost::filesystem::path> paths = make_sequence ("build/test/image_prefetcher_test1", 100);
+
+	{
+		ImagePrefetcher prefetcher (paths, 8);
+
+		/* Nothing should be read until we ask for something */
+		dcpomatic_sleep (1);
+		BOOST_CHECK_EQUAL (MemoryBudget::instance()->used (MemoryBudget::PREFETCHER), 0U);
+
+		for (int i = 0; i < 10; ++i) {
+			BOOST_CHECK_EQUAL (contents (prefetcher.get (i)), String::compose ("frame %1", i));
+		}
+
+		/* Forwards past what has been read ahead */
+		for (int i = 50; i < 60; ++i) {
+			BOOST_CHECK_EQUAL (contents (prefetcher.get (i)), String::compose ("frame %1", i));
+		}
+
+		/* Backwards */
+		for (int i = 5; i < 15; ++i) {
+			BOOST_CHECK_EQUAL (contents (prefetcher.get (i)), String::compose ("frame %1", i));
+		}
+
+		/* Skip forwards by less than the readahead */
+		BOOST_CHECK_EQUAL (contents (prefetcher.get (18)), "frame 18");
+		BOOST_CHECK_EQUAL (contents (prefetcher.get (19)), "frame 19");
+
+		/* Up to the end */
+		for (int i = 95; i < 100; ++i) {
+			BOOST_CHECK_EQUAL (contents (prefetcher.get (i)), String::compose ("frame %1", i));
+		}
+	}
+
+	BOOST_CHECK_EQUAL (MemoryBudget::instance()->used (MemoryBudget::PREFETCHER), 0U);
+}
+
+/** Check that an error reading one file comes out of get() for that frame, and that
+ *  the frames after it can still be read.
+ */
+BOOST_AUTO_TEST_CASE (image_prefetcher_test2)
+{
+	vector<boost::filesystem::path> paths = make_sequence ("build/test/image_prefetcher_test2", 40);
+	boost::filesystem::remove (paths[20]);
+
+	ImagePrefetcher prefetcher (paths, 4);
+
+	for (int i = 15; i < 20; ++i) {
+		BOOST_CHECK_EQUAL (contents (prefetcher.get (i)), String::compose ("frame %1", i));
+	}
+
+	BOOST_CHECK_THROW (prefetcher.get (20), OpenFileError);
+
+	for (int i = 21; i < 40; ++i) {
+		BOOST_CHECK_EQUAL (contents (prefetcher.get (i)), String::compose ("frame %1", i));
+	}
+
+	/* and seeking to it again gives the error again */
+	BOOST_CHECK_THROW (prefetcher.get (20), OpenFileError);
+	BOOST_CHECK_EQUAL (contents (prefetcher.get (21)), "frame 21");
+}
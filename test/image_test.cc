@@ -276,6 +276,23 @@ BOOST_AUTO_TEST_CASE (crop_scale_window_test2)
 	image->crop_scale_window (Crop(2048, 0, 0, 0), dcp::Size(1069, 448), dcp::Size(1069, 578), dcp::YUV_TO_RGB_REC709, AV_PIX_FMT_RGB24, false, false);
 }
 
+/** Check that the bytes at the end of each line of the output of Image::crop_scale_window are
+ *  black when there is no windowing, so that the image is the same every time it is made.
+ */
+BOOST_AUTO_TEST_CASE (crop_scale_window_test3)
+{
+	shared_ptr<FFmpegImageProxy> proxy(new FFmpegImageProxy("test/data/flat_red.png"));
+	shared_ptr<Image> raw = proxy->image().first;
+	shared_ptr<Image> out = raw->crop_scale_window(Crop(), dcp::Size(1998, 1080), dcp::Size(1998, 1080), dcp::YUV_TO_RGB_REC709, AV_PIX_FMT_RGB24, true, false);
+	BOOST_REQUIRE (out->stride()[0] > out->line_size()[0]);
+	for (int y = 0; y < out->size().height; ++y) {
+		uint8_t const * p = out->data()[0] + y * out->stride()[0];
+		for (int x = out->line_size()[0]; x < out->stride()[0]; ++x) {
+			BOOST_REQUIRE_EQUAL (p[x], 0);
+		}
+	}
+}
+
 BOOST_AUTO_TEST_CASE (as_png_test)
 {
 	shared_ptr<FFmpegImageProxy> proxy(new FFmpegImageProxy("test/data/3d_test/000001.png"));
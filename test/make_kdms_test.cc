@@ -0,0 +1,131 @@
+/*
+    Copyright (C) 2017-2018 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/make_kdms_test.cc
+ *  @brief Test Film::make_kdms.
+ *  @ingroup specific
+ */
+
+#include "lib/film.h"
+#include "lib/content_factory.h"
+#include "lib/config.h"
+#include "lib/screen.h"
+#include "lib/screen_kdm.h"
+#include "lib/cinema.h"
+#include "lib/compose.hpp"
+#include "test.h"
+#include <dcp/certificate_chain.h>
+#include <dcp/decrypted_kdm.h>
+#include <dcp/local_time.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+
+using std::list;
+using std::string;
+using std::vector;
+using boost::shared_ptr;
+using boost::optional;
+
+static void
+check_same_keys (dcp::EncryptedKDM a, dcp::EncryptedKDM b)
+{
+	dcp::PrivateKey const key = Config::instance()->decryption_chain()->key().get();
+	list<dcp::DecryptedKDMKey> a_keys = dcp::DecryptedKDM(a, key).keys();
+	list<dcp::DecryptedKDMKey> b_keys = dcp::DecryptedKDM(b, key).keys();
+	BOOST_REQUIRE_EQUAL (a_keys.size(), b_keys.size());
+
+	list<dcp::DecryptedKDMKey>::const_iterator i = a_keys.begin();
+	list<dcp::DecryptedKDMKey>::const_iterator j = b_keys.begin();
+	while (i != a_keys.end()) {
+		BOOST_CHECK_EQUAL (i->id(), j->id());
+		BOOST_CHECK_EQUAL (i->key().hex(), j->key().hex());
+		++i;
+		++j;
+	}
+}
+
+/** Check that make_kdms (which makes its KDMs in parallel) gives the same KDMs, in the same
+ *  order, as calling make_kdm for each screen in turn.
+ */
+BOOST_AUTO_TEST_CASE (make_kdms_test)
+{
+	shared_ptr<Film> film = new_test_film2 ("make_kdms_test");
+	shared_ptr<Content> content = content_factory("test/data/flat_red.png").front();
+	film->examine_and_add_content (content);
+	film->set_encrypted (true);
+	BOOST_REQUIRE (!wait_for_jobs());
+	film->make_dcp ();
+	BOOST_REQUIRE (!wait_for_jobs());
+
+	optional<boost::filesystem::path> cpl;
+	for (boost::filesystem::directory_iterator i(film->dir(film->dcp_name())); i != boost::filesystem::directory_iterator(); ++i) {
+		if (i->path().filename().string().substr(0, 4) == "cpl_") {
+			cpl = i->path();
+		}
+	}
+	BOOST_REQUIRE (cpl);
+
+	/* Some screens in cinemas in different time zones, so that the KDMs differ, and one without a recipient */
+	list<shared_ptr<Screen> > screens;
+	for (int i = 0; i < 24; ++i) {
+		shared_ptr<Cinema> cinema (new Cinema(String::compose("Cinema %1", i), list<string>(), "", i - 12, (i % 2) * 30));
+		optional<dcp::Certificate> recipient;
+		if (i != 5) {
+			recipient = Config::instance()->decryption_chain()->leaf();
+		}
+		shared_ptr<Screen> screen (new Screen(String::compose("Screen %1", i), recipient, vector<TrustedDevice>()));
+		cinema->add_screen (screen);
+		screens.push_back (screen);
+	}
+
+	boost::posix_time::ptime const from = boost::posix_time::time_from_string ("2019-01-01 10:30:00");
+	boost::posix_time::ptime const until = boost::posix_time::time_from_string ("2019-02-01 12:00:00");
+
+	list<ScreenKDM> parallel = film->make_kdms (screens, *cpl, from, until, dcp::MODIFIED_TRANSITIONAL_1, true, 0);
+	BOOST_REQUIRE_EQUAL (parallel.size(), 23);
+
+	list<ScreenKDM>::const_iterator j = parallel.begin();
+	BOOST_FOREACH (shared_ptr<Screen> i, screens) {
+		if (!i->recipient) {
+			continue;
+		}
+
+		int const hour = i->cinema->utc_offset_hour();
+		int const minute = i->cinema->utc_offset_minute();
+		dcp::EncryptedKDM const serial = film->make_kdm (
+			i->recipient.get(),
+			i->trusted_device_thumbprints(),
+			*cpl,
+			dcp::LocalTime(from, hour, minute),
+			dcp::LocalTime(until, hour, minute),
+			dcp::MODIFIED_TRANSITIONAL_1,
+			true,
+			0
+			);
+
+		BOOST_CHECK (j->screen == i);
+		BOOST_CHECK_EQUAL (j->kdm.cpl_id(), serial.cpl_id());
+		BOOST_CHECK_EQUAL (j->kdm.not_valid_before(), serial.not_valid_before());
+		BOOST_CHECK_EQUAL (j->kdm.not_valid_after(), serial.not_valid_after());
+		BOOST_CHECK_EQUAL (j->kdm.recipient_x509_subject_name(), serial.recipient_x509_subject_name());
+		check_same_keys (j->kdm, serial);
+		++j;
+	}
+}
@@ -0,0 +1,178 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/memory_budget_test.cc
+ *  @brief Test MemoryBudget and the butler's use of it.
+ *  @ingroup specific
+ */
+
+#include "lib/memory_budget.h"
+#include "lib/butler.h"
+#include "lib/config.h"
+#include "lib/film.h"
+#include "lib/player.h"
+#include "lib/player_video.h"
+#include "lib/audio_mapping.h"
+#include "lib/ratio.h"
+#include "lib/content_factory.h"
+#include "lib/cross.h"
+#include "test.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/bind.hpp>
+
+using boost::shared_ptr;
+
+static uint64_t const mb = 1024 * 1024;
+
+static void
+count (int* n)
+{
+	++(*n);
+}
+
+/** Check that accounts add to and take away from the right stage, and give back
+ *  what they have when they are destroyed.
+ */
+BOOST_AUTO_TEST_CASE (memory_budget_test1)
+{
+	MemoryBudget* budget = MemoryBudget::instance ();
+	uint64_t const writer = budget->used (MemoryBudget::WRITER);
+	uint64_t const encoder = budget->used (MemoryBudget::ENCODER);
+	uint64_t const total = budget->used ();
+
+	{
+		MemoryBudget::Account a (MemoryBudget::WRITER);
+		a.set (1000);
+		BOOST_CHECK_EQUAL (budget->used (MemoryBudget::WRITER), writer + 1000);
+		a.set (400);
+		BOOST_CHECK_EQUAL (budget->used (MemoryBudget::WRITER), writer + 400);
+
+		MemoryBudget::Account b (MemoryBudget::ENCODER);
+		b.set (5000);
+		BOOST_CHECK_EQUAL (budget->used (MemoryBudget::WRITER), writer + 400);
+		BOOST_CHECK_EQUAL (budget->used (MemoryBudget::ENCODER), encoder + 5000);
+		BOOST_CHECK_EQUAL (budget->used (), total + 5400);
+
+		{
+			MemoryBudget::Account c (MemoryBudget::WRITER);
+			c.set (42);
+			BOOST_CHECK_EQUAL (budget->used (MemoryBudget::WRITER), writer + 442);
+		}
+
+		BOOST_CHECK_EQUAL (budget->used (MemoryBudget::WRITER), writer + 400);
+	}
+
+	BOOST_CHECK_EQUAL (budget->used (MemoryBudget::WRITER), writer);
+	BOOST_CHECK_EQUAL (budget->used (MemoryBudget::ENCODER), encoder);
+	BOOST_CHECK_EQUAL (budget->used (), total);
+}
+
+/** Check exceeded(), that PREVIEW is not counted towards the limit, and that Freed
+ *  is emitted when the limit stops being exceeded.
+ */
+BOOST_AUTO_TEST_CASE (memory_budget_test2)
+{
+	MemoryBudget* budget = MemoryBudget::instance ();
+	Config::instance()->set_memory_budget (100);
+	BOOST_REQUIRE_EQUAL (budget->limit (), 100 * mb);
+	BOOST_REQUIRE (!budget->exceeded ());
+
+	int freed = 0;
+	boost::signals2::scoped_connection connection (budget->Freed.connect (boost::bind (&count, &freed)));
+
+	MemoryBudget::Account preview (MemoryBudget::PREVIEW);
+	preview.set (500 * mb);
+	BOOST_CHECK (!budget->exceeded ());
+	BOOST_CHECK_EQUAL (budget->used (MemoryBudget::PREVIEW), 500 * mb);
+
+	{
+		MemoryBudget::Account encoder (MemoryBudget::ENCODER);
+		encoder.set (60 * mb);
+		BOOST_CHECK (!budget->exceeded ());
+
+		MemoryBudget::Account writer (MemoryBudget::WRITER);
+		writer.set (60 * mb);
+		BOOST_CHECK (budget->exceeded ());
+		BOOST_CHECK_EQUAL (freed, 0);
+
+		writer.set (50 * mb);
+		BOOST_CHECK (budget->exceeded ());
+		BOOST_CHECK_EQUAL (freed, 0);
+
+		writer.set (10 * mb);
+		BOOST_CHECK (!budget->exceeded ());
+		BOOST_CHECK_EQUAL (freed, 1);
+
+		writer.set (50 * mb);
+		BOOST_CHECK (budget->exceeded ());
+		/* Destroying the accounts frees their memory too */
+	}
+
+	BOOST_CHECK (!budget->exceeded ());
+	BOOST_CHECK_EQUAL (freed, 2);
+
+	Config::instance()->set_memory_budget (0);
+}
+
+/** Check that an encoding butler stops filling up while the budget is exceeded,
+ *  and carries on without being asked when some memory is freed elsewhere.
+ */
+BOOST_AUTO_TEST_CASE (memory_budget_test3)
+{
+	shared_ptr<Film> film = new_test_film ("memory_budget_test3");
+	film->set_container (Ratio::from_id ("185"));
+	film->set_audio_channels (6);
+	shared_ptr<Content> video = content_factory("test/data/flat_red.png").front ();
+	film->examine_and_add_content (video);
+	BOOST_REQUIRE (!wait_for_jobs ());
+
+	MemoryBudget* budget = MemoryBudget::instance ();
+	Config::instance()->set_memory_budget (2048);
+
+	/* Something else is using all the memory */
+	shared_ptr<MemoryBudget::Account> other (new MemoryBudget::Account (MemoryBudget::ENCODER));
+	other->set (4096 * mb);
+	BOOST_REQUIRE (budget->exceeded ());
+
+	AudioMapping map (6, 6);
+	for (int i = 0; i < 6; ++i) {
+		map.set (i, i, 1);
+	}
+
+	Butler butler (
+		shared_ptr<Player>(new Player(film, film->playlist())), map, 6,
+		boost::bind(&PlayerVideo::force, _1, AV_PIX_FMT_RGB24), false, false, MemoryBudget::BUTLER
+		);
+
+	/* The butler should fill up to its minimum and then wait */
+	dcpomatic_sleep (2);
+	uint64_t const blocked = budget->used (MemoryBudget::BUTLER);
+	BOOST_CHECK (blocked > 0);
+	dcpomatic_sleep (1);
+	BOOST_CHECK_EQUAL (budget->used (MemoryBudget::BUTLER), blocked);
+
+	/* Free the other memory; the butler should now fill up to its maximum */
+	other.reset ();
+	BOOST_REQUIRE (!budget->exceeded ());
+	dcpomatic_sleep (2);
+	BOOST_CHECK (budget->used (MemoryBudget::BUTLER) > blocked * 2);
+
+	Config::instance()->set_memory_budget (0);
+}
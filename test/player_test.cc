@@ -213,7 +213,7 @@ BOOST_AUTO_TEST_CASE (player_seek_test)
 	player->set_always_burn_open_subtitles ();
 	player->set_play_referenced ();
 
-	shared_ptr<Butler> butler (new Butler (player, AudioMapping(), 2, bind(PlayerVideo::force, _1, AV_PIX_FMT_RGB24), false, true));
+	shared_ptr<Butler> butler (new Butler (player, AudioMapping(), 2, bind(PlayerVideo::force, _1, AV_PIX_FMT_RGB24), false, true, MemoryBudget::PREVIEW));
 	butler->disable_audio();
 
 	for (int i = 0; i < 10; ++i) {
@@ -244,7 +244,7 @@ BOOST_AUTO_TEST_CASE (player_seek_test2)
 	player->set_always_burn_open_subtitles ();
 	player->set_play_referenced ();
 
-	shared_ptr<Butler> butler (new Butler(player, AudioMapping(), 2, bind(PlayerVideo::force, _1, AV_PIX_FMT_RGB24), false, true));
+	shared_ptr<Butler> butler (new Butler(player, AudioMapping(), 2, bind(PlayerVideo::force, _1, AV_PIX_FMT_RGB24), false, true, MemoryBudget::PREVIEW));
 	butler->disable_audio();
 
 	butler->seek(DCPTime::from_seconds(5), true);
@@ -329,7 +329,7 @@ BOOST_AUTO_TEST_CASE (player_trim_crash)
 
 	shared_ptr<Player> player (new Player(film, film->playlist()));
 	player->set_fast ();
-	shared_ptr<Butler> butler (new Butler(player, AudioMapping(), 6, bind(&PlayerVideo::force, _1, AV_PIX_FMT_RGB24), false, true));
+	shared_ptr<Butler> butler (new Butler(player, AudioMapping(), 6, bind(&PlayerVideo::force, _1, AV_PIX_FMT_RGB24), false, true, MemoryBudget::PREVIEW));
 
 	/* Wait for the butler to fill */
 	dcpomatic_sleep (5);
@@ -343,3 +343,48 @@ BOOST_AUTO_TEST_CASE (player_trim_crash)
 
 	butler->rethrow ();
 }
+
+/** Check that changing one piece of content only makes a new decoder for that content,
+ *  and only when the change needs it.
+ */
+BOOST_AUTO_TEST_CASE (player_incremental_pieces_test)
+{
+	shared_ptr<Film> film = new_test_film2 ("player_incremental_pieces_test");
+	shared_ptr<Content> A = content_factory("test/data/flat_red.png").front();
+	film->examine_and_add_content (A);
+	shared_ptr<Content> B = content_factory("test/data/test.mp4").front();
+	film->examine_and_add_content (B);
+	BOOST_REQUIRE (!wait_for_jobs());
+
+	shared_ptr<Player> player (new Player(film, film->playlist()));
+	BOOST_REQUIRE_EQUAL (player->_pieces.size(), 2);
+	shared_ptr<Decoder> decoder_a = player->_pieces.front()->decoder;
+	shared_ptr<Decoder> decoder_b = player->_pieces.back()->decoder;
+
+	/* Play a little way in; the Player should stay where it is after the changes below */
+	for (int i = 0; i < 48; ++i) {
+		player->pass ();
+	}
+	optional<DCPTime> const position = player->_last_video_time;
+	BOOST_REQUIRE (position);
+	BOOST_REQUIRE (*position > DCPTime ());
+
+	/* Gain and crop are applied by the Player, so nothing should be re-made */
+	B->audio->set_gain (-4);
+	B->video->set_left_crop (16);
+	BOOST_REQUIRE_EQUAL (player->_pieces.size(), 2);
+	BOOST_CHECK (player->_pieces.front()->decoder == decoder_a);
+	BOOST_CHECK (player->_pieces.back()->decoder == decoder_b);
+	BOOST_CHECK (player->_last_video_time == position);
+
+	/* A new frame type needs a new decoder for B, but A should be left alone */
+	B->video->set_frame_type (VIDEO_FRAME_TYPE_3D_LEFT_RIGHT);
+	BOOST_REQUIRE_EQUAL (player->_pieces.size(), 2);
+	BOOST_CHECK (player->_pieces.front()->decoder == decoder_a);
+	BOOST_CHECK (player->_pieces.back()->decoder != decoder_b);
+	BOOST_CHECK (player->_last_video_time == position);
+
+	/* and should carry on from where it was */
+	BOOST_CHECK (!player->pass ());
+	BOOST_CHECK (player->_last_video_time >= position);
+}
@@ -26,6 +26,7 @@
 #include "lib/reel_writer.h"
 #include "lib/film.h"
 #include "lib/cross.h"
+#include "lib/frame_info_file.h"
 #include "test.h"
 #include <boost/test/unit_test.hpp>
 
@@ -33,9 +34,9 @@ using std::string;
 using boost::shared_ptr;
 using boost::optional;
 
-static bool equal (dcp::FrameInfo a, ReelWriter const & writer, shared_ptr<InfoFileHandle> file, Frame frame, Eyes eyes)
+static bool equal (dcp::FrameInfo a, ReelWriter const & writer, Frame frame, Eyes eyes)
 {
-	dcp::FrameInfo b = writer.read_frame_info(file, frame, eyes);
+	dcp::FrameInfo b = writer.read_frame_info(frame, eyes);
 	return a.offset == b.offset && a.size == b.size && a.hash == b.hash;
 }
 
@@ -50,41 +51,58 @@ BOOST_AUTO_TEST_CASE (write_frame_info_test)
 	dcp::FrameInfo info1(0, 123, "12345678901234567890123456789012");
 	writer.write_frame_info (0, EYES_LEFT, info1);
 
-	{
-		shared_ptr<InfoFileHandle> file = film->info_file_handle(period, true);
-		BOOST_CHECK (equal(info1, writer, file, 0, EYES_LEFT));
-	}
+	BOOST_CHECK (equal(info1, writer, 0, EYES_LEFT));
 
 	/* Write some more */
 
 	dcp::FrameInfo info2(596, 14921, "123acb789f1234ae782012n456339522");
 	writer.write_frame_info (5, EYES_RIGHT, info2);
 
-	{
-		shared_ptr<InfoFileHandle> file = film->info_file_handle(period, true);
-		BOOST_CHECK (equal(info1, writer, file, 0, EYES_LEFT));
-		BOOST_CHECK (equal(info2, writer, file, 5, EYES_RIGHT));
-	}
+	BOOST_CHECK (equal(info1, writer, 0, EYES_LEFT));
+	BOOST_CHECK (equal(info2, writer, 5, EYES_RIGHT));
 
 	dcp::FrameInfo info3(12494, 99157123, "xxxxyyyyabc12356ffsfdsf456339522");
 	writer.write_frame_info (10, EYES_LEFT, info3);
 
-	{
-		shared_ptr<InfoFileHandle> file = film->info_file_handle(period, true);
-		BOOST_CHECK (equal(info1, writer, file, 0, EYES_LEFT));
-		BOOST_CHECK (equal(info2, writer, file, 5, EYES_RIGHT));
-		BOOST_CHECK (equal(info3, writer, file, 10, EYES_LEFT));
-	}
+	BOOST_CHECK (equal(info1, writer, 0, EYES_LEFT));
+	BOOST_CHECK (equal(info2, writer, 5, EYES_RIGHT));
+	BOOST_CHECK (equal(info3, writer, 10, EYES_LEFT));
 
 	/* Overwrite one */
 
 	dcp::FrameInfo info4(55512494, 123599157123, "ABCDEFGyabc12356ffsfdsf4563395ZZ");
 	writer.write_frame_info (5, EYES_RIGHT, info4);
 
+	BOOST_CHECK (equal(info1, writer, 0, EYES_LEFT));
+	BOOST_CHECK (equal(info4, writer, 5, EYES_RIGHT));
+	BOOST_CHECK (equal(info3, writer, 10, EYES_LEFT));
+}
+
+/** Check that FrameInfoFile grows when written past its end, and that what it
+ *  writes can be found again when the file is re-opened.
+ */
+BOOST_AUTO_TEST_CASE (frame_info_file_test)
+{
+	boost::filesystem::path const file = "build/test/frame_info_file_test";
+	boost::filesystem::remove (file);
+
 	{
-		shared_ptr<InfoFileHandle> file = film->info_file_handle(period, true);
-		BOOST_CHECK (equal(info1, writer, file, 0, EYES_LEFT));
-		BOOST_CHECK (equal(info4, writer, file, 5, EYES_RIGHT));
-		BOOST_CHECK (equal(info3, writer, file, 10, EYES_LEFT));
+		FrameInfoFile info (file, 10);
+		BOOST_CHECK_EQUAL (info.last_written(), -1);
+		for (int i = 0; i < 25; ++i) {
+			info.write (i, dcp::FrameInfo(i * 1000, i + 1, "12345678901234567890123456789012"));
+		}
+		BOOST_CHECK_EQUAL (info.last_written(), 24);
+		/* Re-writing an earlier record does not change the last one written */
+		info.write (3, dcp::FrameInfo(3000, 4, "12345678901234567890123456789012"));
+		BOOST_CHECK_EQUAL (info.last_written(), 24);
+		info.flush ();
 	}
+
+	FrameInfoFile info (file, 10);
+	BOOST_CHECK_EQUAL (info.last_written(), 24);
+	dcp::FrameInfo const check = info.read (17);
+	BOOST_CHECK_EQUAL (check.offset, 17000);
+	BOOST_CHECK_EQUAL (check.size, 18);
+	BOOST_CHECK_EQUAL (check.hash, "12345678901234567890123456789012");
 }
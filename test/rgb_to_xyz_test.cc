@@ -0,0 +1,137 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/rgb_to_xyz_test.cc
+ *  @brief Test RGBToXYZ against dcp::rgb_to_xyz.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/rgb_to_xyz.h"
+#include "lib/image.h"
+#include "lib/player_video.h"
+#include "lib/raw_image_proxy.h"
+#include <dcp/rgb_xyz.h>
+#include <dcp/openjpeg_image.h>
+#include <boost/test/unit_test.hpp>
+
+using std::string;
+using boost::shared_ptr;
+
+static void
+note_handler (dcp::NoteType, string)
+{
+
+}
+
+static void
+check_against_libdcp (ColourConversion conversion, int seed)
+{
+	dcp::Size const size (640, 480);
+	shared_ptr<Image> rgb (new Image (AV_PIX_FMT_RGB48LE, size, true));
+
+	srand (seed);
+	for (int y = 0; y < size.height; ++y) {
+		uint16_t* p = reinterpret_cast<uint16_t*> (rgb->data()[0] + y * rgb->stride()[0]);
+		for (int x = 0; x < size.width * 3; ++x) {
+			*p++ = rand () & 0xffff;
+		}
+	}
+
+	shared_ptr<dcp::OpenJPEGImage> ref = dcp::rgb_to_xyz (rgb->data()[0], size, rgb->stride()[0], conversion);
+	shared_ptr<dcp::OpenJPEGImage> fast = RGBToXYZ::get(conversion)->convert (rgb->data()[0], size, rgb->stride()[0], &note_handler);
+
+	int max_error = 0;
+	for (int c = 0; c < 3; ++c) {
+		int const * r = ref->data (c);
+		int const * f = fast->data (c);
+		for (int i = 0; i < size.width * size.height; ++i) {
+			max_error = std::max (max_error, abs (*r++ - *f++));
+		}
+	}
+
+	BOOST_CHECK_LE (max_error, 1);
+}
+
+/** Check that RGBToXYZ gives the same answers as libdcp to within one code value */
+BOOST_AUTO_TEST_CASE (rgb_to_xyz_test1)
+{
+	check_against_libdcp (ColourConversion (dcp::ColourConversion::srgb_to_xyz ()), 1);
+	check_against_libdcp (ColourConversion (dcp::ColourConversion::rec709_to_xyz ()), 2);
+	check_against_libdcp (ColourConversion (dcp::ColourConversion::p3_to_xyz ()), 3);
+}
+
+/** Check that converters are shared between equal conversions */
+BOOST_AUTO_TEST_CASE (rgb_to_xyz_test2)
+{
+	shared_ptr<const RGBToXYZ> a = RGBToXYZ::get (ColourConversion (dcp::ColourConversion::srgb_to_xyz ()));
+	shared_ptr<const RGBToXYZ> b = RGBToXYZ::get (ColourConversion (dcp::ColourConversion::srgb_to_xyz ()));
+	shared_ptr<const RGBToXYZ> c = RGBToXYZ::get (ColourConversion (dcp::ColourConversion::rec709_to_xyz ()));
+	BOOST_CHECK (a == b);
+	BOOST_CHECK (a != c);
+}
+
+/** Check that PlayerVideo::xyz_image, which does its crop / scale / fade / colour conversion
+ *  in strips, gives the same result as doing each stage over the whole image.
+ */
+BOOST_AUTO_TEST_CASE (rgb_to_xyz_test3)
+{
+	dcp::Size const in_size (1024, 600);
+	shared_ptr<Image> source (new Image (AV_PIX_FMT_YUV420P, in_size, true));
+	srand (4);
+	for (int c = 0; c < source->planes(); ++c) {
+		for (int y = 0; y < source->sample_size(c).height; ++y) {
+			uint8_t* p = source->data()[c] + y * source->stride()[c];
+			for (int x = 0; x < source->sample_size(c).width; ++x) {
+				*p++ = rand () & 0xff;
+			}
+		}
+	}
+
+	Crop const crop (8, 16, 4, 2);
+	dcp::Size const inter_size (1998, 1040);
+	dcp::Size const out_size (1998, 1080);
+	ColourConversion const conversion (dcp::ColourConversion::rec709_to_xyz ());
+
+	shared_ptr<PlayerVideo> pv (
+		new PlayerVideo (
+			shared_ptr<ImageProxy> (new RawImageProxy (source)),
+			crop,
+			0.6,
+			inter_size,
+			out_size,
+			EYES_BOTH,
+			PART_WHOLE,
+			conversion,
+			boost::weak_ptr<Content> (),
+			boost::optional<Frame> ()
+			)
+		);
+
+	shared_ptr<dcp::OpenJPEGImage> fused = pv->xyz_image (&note_handler);
+
+	shared_ptr<Image> rgb = source->crop_scale_window (crop, inter_size, out_size, dcp::YUV_TO_RGB_REC709, AV_PIX_FMT_RGB48LE, true, false);
+	rgb->fade (0.6);
+	shared_ptr<dcp::OpenJPEGImage> staged = RGBToXYZ::get(conversion)->convert (rgb->data()[0], rgb->size(), rgb->stride()[0], &note_handler);
+
+	BOOST_REQUIRE (fused->size() == staged->size());
+	for (int c = 0; c < 3; ++c) {
+		BOOST_CHECK (memcmp (fused->data(c), staged->data(c), out_size.width * out_size.height * sizeof (int)) == 0);
+	}
+}
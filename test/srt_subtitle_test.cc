@@ -29,14 +29,21 @@
 #include "lib/font.h"
 #include "lib/ratio.h"
 #include "lib/text_content.h"
+#include "lib/text_decoder.h"
+#include "lib/content_text.h"
+#include "lib/string_text_file_decoder.h"
+#include "lib/cross.h"
 #include "test.h"
 #include <boost/test/unit_test.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 #include <list>
 
 using std::string;
 using std::list;
+using std::vector;
 using boost::shared_ptr;
+using boost::bind;
 
 /** Make a very short DCP with a single subtitle from .srt with no specified fonts */
 BOOST_AUTO_TEST_CASE (srt_subtitle_test)
@@ -180,6 +187,85 @@ BOOST_AUTO_TEST_CASE (srt_subtitle_test6)
 	check_dcp ("test/data/srt_subtitle_test6", film->dir(film->dcp_name()));
 }
 
+static void
+write_srt (boost::filesystem::path file, vector<string> const & subs)
+{
+	FILE* f = fopen_boost (file, "w");
+	BOOST_REQUIRE (f);
+	fprintf (f, "%s", boost::algorithm::join(subs, "\n").c_str());
+	fclose (f);
+}
+
+static void
+store_text (list<string>* texts, ContentStringText sub)
+{
+	texts->push_back (sub.subs.front().text());
+}
+
+/** Check that seeking works with a file whose subtitles are not in time order, and that
+ *  a changed file is read again even though an earlier version is in the cache, even if
+ *  its size and modification time are the same.
+ */
+BOOST_AUTO_TEST_CASE (srt_subtitle_seek_test)
+{
+	shared_ptr<Film> film = new_test_film2 ("srt_subtitle_seek_test");
+	boost::filesystem::path const file = "build/test/srt_subtitle_seek_test/subs.srt";
+
+	vector<string> subs;
+	subs.push_back ("1\n00:00:30,000 --> 00:00:31,000\nThird\n");
+	subs.push_back ("2\n00:00:10,000 --> 00:00:11,000\nFirst\n");
+	subs.push_back ("3\n00:00:20,000 --> 00:00:21,000\nSecond\n");
+	write_srt (file, subs);
+
+	shared_ptr<StringTextFileContent> content (new StringTextFileContent(file));
+	film->examine_and_add_content (content);
+	BOOST_REQUIRE (!wait_for_jobs());
+
+	{
+		list<string> texts;
+		shared_ptr<StringTextFileDecoder> decoder (new StringTextFileDecoder(film, content));
+		decoder->only_text()->PlainStart.connect (bind(&store_text, &texts, _1));
+		/* The decoder goes back 5s from here, so we should get Second then Third */
+		decoder->seek (ContentTime::from_seconds(16), true);
+		while (!decoder->pass()) {}
+		BOOST_REQUIRE_EQUAL (texts.size(), 2U);
+		BOOST_CHECK_EQUAL (texts.front(), "Second");
+		BOOST_CHECK_EQUAL (texts.back(), "Third");
+	}
+
+	subs.push_back ("4\n00:00:25,000 --> 00:00:26,000\nNew\n");
+	write_srt (file, subs);
+
+	{
+		list<string> texts;
+		shared_ptr<StringTextFileDecoder> decoder (new StringTextFileDecoder(film, content));
+		decoder->only_text()->PlainStart.connect (bind(&store_text, &texts, _1));
+		decoder->seek (ContentTime::from_seconds(16), true);
+		while (!decoder->pass()) {}
+		BOOST_REQUIRE_EQUAL (texts.size(), 3U);
+		list<string>::const_iterator i = texts.begin();
+		BOOST_CHECK_EQUAL (*i++, "Second");
+		BOOST_CHECK_EQUAL (*i++, "New");
+		BOOST_CHECK_EQUAL (*i++, "Third");
+	}
+
+	/* A change which keeps the file's size and modification time is still seen */
+	std::time_t const time = boost::filesystem::last_write_time (file);
+	subs[2] = "3\n00:00:20,000 --> 00:00:21,000\nSecund\n";
+	write_srt (file, subs);
+	boost::filesystem::last_write_time (file, time);
+
+	{
+		list<string> texts;
+		shared_ptr<StringTextFileDecoder> decoder (new StringTextFileDecoder(film, content));
+		decoder->only_text()->PlainStart.connect (bind(&store_text, &texts, _1));
+		decoder->seek (ContentTime::from_seconds(16), true);
+		while (!decoder->pass()) {}
+		BOOST_REQUIRE_EQUAL (texts.size(), 3U);
+		BOOST_CHECK_EQUAL (texts.front(), "Secund");
+	}
+}
+
 #if 0
 /* XXX: this is disabled; there is some difference in font rendering
    between the test machine and others.
@@ -0,0 +1,314 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/upload_test.cc
+ *  @brief Test Uploader and CurlUploader using a local directory in place of a server.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/uploader.h"
+#include "lib/curl_uploader.h"
+#include "lib/config.h"
+#include "lib/cross.h"
+#include "lib/util.h"
+#include "lib/compose.hpp"
+#include "lib/dcpomatic_assert.h"
+#include "test.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/bind.hpp>
+#include <map>
+
+using std::string;
+using std::map;
+using std::min;
+using std::vector;
+
+/** Uploader which copies files into a local directory */
+class LocalUploader : public Uploader
+{
+public:
+	LocalUploader (boost::filesystem::path target, int streams)
+		: Uploader (boost::bind (&LocalUploader::set_status, this, _1), boost::bind (&LocalUploader::set_progress, this, _1))
+		, progress (0)
+		, _target (target)
+		, _streams (streams)
+	{}
+
+	/** Offsets that upload_file() was called with, indexed by remote path */
+	map<boost::filesystem::path, boost::uintmax_t> offsets;
+	float progress;
+
+protected:
+	int streams () const {
+		return _streams;
+	}
+
+	void create_directory (boost::filesystem::path directory) {
+		boost::filesystem::create_directories (_target / directory);
+	}
+
+	/* These are called from the uploader's threads, so they use DCPOMATIC_ASSERT rather than BOOST_REQUIRE */
+
+	RemoteFile remote_file (boost::filesystem::path to, int stream) {
+		DCPOMATIC_ASSERT (stream >= 0 && stream < _streams);
+		RemoteFile remote;
+		boost::system::error_code ec;
+		boost::uintmax_t const size = boost::filesystem::file_size (_target / to, ec);
+		if (!ec) {
+			remote.size = size;
+			remote.time = boost::filesystem::last_write_time (_target / to);
+		}
+		return remote;
+	}
+
+	void upload_file (boost::filesystem::path from, boost::filesystem::path to, boost::uintmax_t offset, int stream) {
+		DCPOMATIC_ASSERT (stream >= 0 && stream < _streams);
+
+		{
+			boost::mutex::scoped_lock lm (_mutex);
+			offsets[to] = offset;
+		}
+
+		boost::uintmax_t const size = boost::filesystem::file_size (from);
+		FILE* in = fopen_boost (from, "rb");
+		DCPOMATIC_ASSERT (in);
+		FILE* out = fopen_boost (_target / to, offset > 0 ? "r+b" : "wb");
+		DCPOMATIC_ASSERT (out);
+		dcpomatic_fseek (in, offset, SEEK_SET);
+		dcpomatic_fseek (out, offset, SEEK_SET);
+		transferred (offset);
+
+		vector<uint8_t> buffer (65536);
+		boost::uintmax_t to_do = size - offset;
+		while (to_do > 0) {
+			size_t const t = min (to_do, boost::uintmax_t (buffer.size ()));
+			checked_fread (&buffer[0], t, in, from);
+			checked_fwrite (&buffer[0], t, out, _target / to);
+			to_do -= t;
+			transferred (t);
+		}
+
+		fclose (in);
+		fclose (out);
+	}
+
+private:
+	void set_status (string) {}
+
+	void set_progress (float p) {
+		boost::mutex::scoped_lock lm (_mutex);
+		progress = std::max (progress, p);
+	}
+
+	boost::filesystem::path _target;
+	int _streams;
+	boost::mutex _mutex;
+};
+
+static void
+make_upload_source (boost::filesystem::path dir)
+{
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir / "DCP");
+	make_random_file (dir / "DCP" / "ASSETMAP", 1000);
+	make_random_file (dir / "DCP" / "cpl.xml", 5000);
+	for (int i = 0; i < 6; ++i) {
+		make_random_file (dir / "DCP" / String::compose ("j2c_%1.mxf", i), 3 * 1024 * 1024 + i * 1000);
+	}
+}
+
+/** Send a directory using several streams and check that everything arrives */
+BOOST_AUTO_TEST_CASE (upload_test1)
+{
+	boost::filesystem::path const source = "build/test/upload_test1/source";
+	boost::filesystem::path const target = "build/test/upload_test1/target";
+	make_upload_source (source);
+	boost::filesystem::remove_all (target);
+
+	LocalUploader uploader (target, 4);
+	uploader.upload (source / "DCP");
+
+	BOOST_CHECK_EQUAL (uploader.offsets.size(), 8U);
+	BOOST_CHECK_CLOSE (uploader.progress, 1, 0.001);
+	for (boost::filesystem::directory_iterator i(source / "DCP"); i != boost::filesystem::directory_iterator(); ++i) {
+		check_file (i->path(), target / "DCP" / i->path().filename());
+	}
+}
+
+/** Check that files which are already on the server are not sent again, and that
+ *  partly-sent files are carried on from where they stopped.
+ */
+BOOST_AUTO_TEST_CASE (upload_test2)
+{
+	boost::filesystem::path const source = "build/test/upload_test2/source";
+	boost::filesystem::path const target = "build/test/upload_test2/target";
+	make_upload_source (source);
+	boost::filesystem::remove_all (target);
+
+	{
+		LocalUploader uploader (target, 2);
+		uploader.upload (source / "DCP");
+	}
+
+	boost::filesystem::resize_file (target / "DCP" / "j2c_1.mxf", 1024 * 1024);
+	boost::filesystem::remove (target / "DCP" / "j2c_2.mxf");
+
+	LocalUploader uploader (target, 3);
+	uploader.upload (source / "DCP");
+
+	/* Small files are always sent */
+	BOOST_REQUIRE (uploader.offsets.find ("DCP/ASSETMAP") != uploader.offsets.end());
+	BOOST_CHECK_EQUAL (uploader.offsets["DCP/ASSETMAP"], 0U);
+	BOOST_REQUIRE (uploader.offsets.find ("DCP/cpl.xml") != uploader.offsets.end());
+	/* The partial file is resumed */
+	BOOST_REQUIRE (uploader.offsets.find ("DCP/j2c_1.mxf") != uploader.offsets.end());
+	BOOST_CHECK_EQUAL (uploader.offsets["DCP/j2c_1.mxf"], 1024U * 1024U);
+	/* The missing one is sent in full */
+	BOOST_REQUIRE (uploader.offsets.find ("DCP/j2c_2.mxf") != uploader.offsets.end());
+	BOOST_CHECK_EQUAL (uploader.offsets["DCP/j2c_2.mxf"], 0U);
+	/* and nothing else */
+	BOOST_CHECK_EQUAL (uploader.offsets.size(), 4U);
+	BOOST_CHECK_CLOSE (uploader.progress, 1, 0.001);
+
+	for (boost::filesystem::directory_iterator i(source / "DCP"); i != boost::filesystem::directory_iterator(); ++i) {
+		check_file (i->path(), target / "DCP" / i->path().filename());
+	}
+}
+
+/** Check that a file which is already on the server is sent again in full if it has been
+ *  changed since it was sent, even if its size is the same.
+ */
+BOOST_AUTO_TEST_CASE (upload_test4)
+{
+	boost::filesystem::path const source = "build/test/upload_test4/source";
+	boost::filesystem::path const target = "build/test/upload_test4/target";
+	make_upload_source (source);
+	boost::filesystem::remove_all (target);
+
+	{
+		LocalUploader uploader (target, 2);
+		uploader.upload (source / "DCP");
+	}
+
+	/* Change one file without changing its size, and make it look newer than what was sent */
+	boost::filesystem::path const changed = source / "DCP" / "j2c_5.mxf";
+	boost::uintmax_t const size = boost::filesystem::file_size (changed);
+	make_random_file (changed, size);
+	boost::filesystem::last_write_time (changed, boost::filesystem::last_write_time (target / "DCP" / "j2c_5.mxf") + 60);
+
+	LocalUploader uploader (target, 2);
+	uploader.upload (source / "DCP");
+
+	BOOST_REQUIRE (uploader.offsets.find ("DCP/j2c_5.mxf") != uploader.offsets.end());
+	BOOST_CHECK_EQUAL (uploader.offsets["DCP/j2c_5.mxf"], 0U);
+	/* The small files are always sent, and nothing else should have been */
+	BOOST_CHECK_EQUAL (uploader.offsets.size(), 3U);
+	check_file (changed, target / "DCP" / "j2c_5.mxf");
+}
+
+/** CurlUploader which sends to a local directory using file:// URLs in place of an FTP server */
+class FileCurlUploader : public CurlUploader
+{
+public:
+	explicit FileCurlUploader (boost::filesystem::path target)
+		: CurlUploader (boost::bind (&FileCurlUploader::set_status, this, _1), boost::bind (&FileCurlUploader::set_progress, this, _1))
+		, progress (0)
+		, _target (boost::filesystem::absolute (target))
+	{}
+
+	/** Offsets that upload_file() was called with, indexed by remote path */
+	map<boost::filesystem::path, boost::uintmax_t> offsets;
+	float progress;
+
+protected:
+	string url (boost::filesystem::path to) const {
+		return "file://" + (_target / to).generic_string ();
+	}
+
+	void create_directory (boost::filesystem::path directory) {
+		/* libcurl only makes missing directories on FTP servers */
+		boost::filesystem::create_directories (_target / directory);
+	}
+
+	void upload_file (boost::filesystem::path from, boost::filesystem::path to, boost::uintmax_t offset, int stream) {
+		{
+			boost::mutex::scoped_lock lm (_mutex);
+			offsets[to] = offset;
+		}
+		CurlUploader::upload_file (from, to, offset, stream);
+	}
+
+private:
+	void set_status (string) {}
+
+	void set_progress (float p) {
+		boost::mutex::scoped_lock lm (_mutex);
+		progress = std::max (progress, p);
+	}
+
+	boost::filesystem::path _target;
+	boost::mutex _mutex;
+};
+
+/** Send a directory with CurlUploader on several streams, then send it again after
+ *  removing part of one file and all of another, and check that only the missing
+ *  parts are sent the second time.
+ */
+BOOST_AUTO_TEST_CASE (upload_test3)
+{
+	boost::filesystem::path const source = "build/test/upload_test3/source";
+	boost::filesystem::path const target = "build/test/upload_test3/target";
+	make_upload_source (source);
+	boost::filesystem::remove_all (target);
+
+	int const streams = Config::instance()->upload_streams ();
+	Config::instance()->set_upload_streams (3);
+
+	{
+		FileCurlUploader uploader (target);
+		uploader.upload (source / "DCP");
+		BOOST_CHECK_EQUAL (uploader.offsets.size(), 8U);
+		BOOST_CHECK_CLOSE (uploader.progress, 1, 0.001);
+	}
+
+	for (boost::filesystem::directory_iterator i(source / "DCP"); i != boost::filesystem::directory_iterator(); ++i) {
+		check_file (i->path(), target / "DCP" / i->path().filename());
+	}
+
+	boost::filesystem::resize_file (target / "DCP" / "j2c_3.mxf", 1024 * 1024 + 17);
+	boost::filesystem::remove (target / "DCP" / "j2c_4.mxf");
+
+	FileCurlUploader uploader (target);
+	uploader.upload (source / "DCP");
+
+	Config::instance()->set_upload_streams (streams);
+
+	BOOST_REQUIRE (uploader.offsets.find ("DCP/j2c_3.mxf") != uploader.offsets.end());
+	BOOST_CHECK_EQUAL (uploader.offsets["DCP/j2c_3.mxf"], 1024U * 1024U + 17U);
+	BOOST_REQUIRE (uploader.offsets.find ("DCP/j2c_4.mxf") != uploader.offsets.end());
+	BOOST_CHECK_EQUAL (uploader.offsets["DCP/j2c_4.mxf"], 0U);
+	/* The two small files are always sent, and nothing else should have been */
+	BOOST_CHECK_EQUAL (uploader.offsets.size(), 4U);
+	BOOST_CHECK_CLOSE (uploader.progress, 1, 0.001);
+
+	for (boost::filesystem::directory_iterator i(source / "DCP"); i != boost::filesystem::directory_iterator(); ++i) {
+		check_file (i->path(), target / "DCP" / i->path().filename());
+	}
+}
@@ -0,0 +1,107 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/video_filter_queue_test.cc
+ *  @brief Test VideoFilterQueue.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/video_filter_queue.h"
+#include "lib/filter.h"
+#include "lib/image.h"
+#include "test.h"
+extern "C" {
+#include <libavutil/frame.h>
+}
+#include <boost/test/unit_test.hpp>
+#include <cstring>
+
+using std::vector;
+
+/** @return A small YUV420P frame with every sample set to the low byte of \p pts */
+static AVFrame*
+make_frame (int64_t pts)
+{
+	AVFrame* frame = av_frame_alloc ();
+	BOOST_REQUIRE (frame);
+	frame->width = 64;
+	frame->height = 48;
+	frame->format = AV_PIX_FMT_YUV420P;
+	BOOST_REQUIRE (av_frame_get_buffer (frame, 32) == 0);
+	for (int i = 0; i < 3; ++i) {
+		memset (frame->data[i], pts & 0xff, frame->linesize[i] * (i == 0 ? frame->height : frame->height / 2));
+	}
+	av_frame_set_best_effort_timestamp (frame, pts);
+	return frame;
+}
+
+/** Check that frames come out of a queue with a filter in the order that they went in */
+BOOST_AUTO_TEST_CASE (video_filter_queue_test1)
+{
+	vector<Filter const *> filters;
+	filters.push_back (Filter::from_id ("vflip"));
+	VideoFilterQueue queue (filters, dcp::Fraction (24, 1));
+
+	VideoFilterQueue::Images out;
+	for (int i = 0; i < 50; ++i) {
+		AVFrame* frame = make_frame (i);
+		queue.put (frame);
+		av_frame_free (&frame);
+		VideoFilterQueue::Images images = queue.get (false);
+		out.splice (out.end(), images);
+	}
+
+	VideoFilterQueue::Images images = queue.get (true);
+	out.splice (out.end(), images);
+
+	BOOST_REQUIRE_EQUAL (out.size(), 50U);
+	int64_t n = 0;
+	for (VideoFilterQueue::Images::const_iterator i = out.begin(); i != out.end(); ++i) {
+		BOOST_CHECK_EQUAL (i->second, n);
+		BOOST_CHECK (i->first->size() == dcp::Size (64, 48));
+		BOOST_CHECK_EQUAL (int (i->first->data()[0][0]), n);
+		++n;
+	}
+}
+
+/** Check that nothing put into a queue before a clear() comes out afterwards */
+BOOST_AUTO_TEST_CASE (video_filter_queue_test2)
+{
+	vector<Filter const *> filters;
+	filters.push_back (Filter::from_id ("vflip"));
+	VideoFilterQueue queue (filters, dcp::Fraction (24, 1));
+
+	for (int i = 0; i < 10; ++i) {
+		AVFrame* frame = make_frame (i);
+		queue.put (frame);
+		av_frame_free (&frame);
+	}
+
+	queue.clear ();
+
+	AVFrame* frame = make_frame (100);
+	queue.put (frame);
+	av_frame_free (&frame);
+
+	VideoFilterQueue::Images out = queue.get (true);
+	BOOST_REQUIRE_EQUAL (out.size(), 1U);
+	BOOST_CHECK_EQUAL (out.front().second, 100);
+	BOOST_CHECK_EQUAL (int (out.front().first->data()[0][0]), 100);
+}
@@ -0,0 +1,237 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/writer_test.cc
+ *  @brief Test Writer.
+ *  @ingroup specific
+ */
+
+#include "lib/writer.h"
+#include "lib/film.h"
+#include "lib/ratio.h"
+#include "lib/dcp_content_type.h"
+#include "lib/content_factory.h"
+#include "lib/content.h"
+#include "lib/transcode_job.h"
+#include "lib/spill_file.h"
+#include "test.h"
+#include <dcp/dcp.h>
+#include <dcp/cpl.h>
+#include <dcp/reel.h>
+#include <dcp/reel_mono_picture_asset.h>
+#include <dcp/mono_picture_asset.h>
+#include <dcp/mono_picture_asset_reader.h>
+#include <dcp/mono_picture_frame.h>
+#include <dcp/openjpeg_image.h>
+#include <dcp/j2k.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+
+using std::vector;
+using boost::shared_ptr;
+using boost::dynamic_pointer_cast;
+
+static void
+write_frames (shared_ptr<Writer> writer, vector<Frame> const * frames, vector<dcp::Data> const * data, int start, int step)
+{
+	for (size_t i = start; i < frames->size(); i += step) {
+		Frame const f = (*frames)[i];
+		writer->write ((*data)[f % data->size()], f, EYES_BOTH);
+	}
+}
+
+/** Give Writer frames in a random order from several threads, holding only a few
+ *  in memory so that some are pushed to disk, and check that the DCP has them in
+ *  the right order.
+ */
+BOOST_AUTO_TEST_CASE (writer_reorder_test)
+{
+	shared_ptr<Film> film = new_test_film ("writer_reorder_test");
+	film->set_container (Ratio::from_id ("185"));
+	film->set_dcp_content_type (DCPContentType::from_isdcf_name ("TLR"));
+	film->set_name ("frobozz");
+	shared_ptr<Content> content = content_factory("test/data/flat_red.png").front ();
+	film->examine_and_add_content (content);
+	BOOST_REQUIRE (!wait_for_jobs ());
+
+	/* Some different J2K frames, so that we can tell them apart in the DCP */
+	vector<dcp::Data> data;
+	for (int i = 0; i < 7; ++i) {
+		shared_ptr<dcp::OpenJPEGImage> xyz (new dcp::OpenJPEGImage (film->frame_size ()));
+		for (int c = 0; c < 3; ++c) {
+			std::fill (xyz->data(c), xyz->data(c) + film->frame_size().width * film->frame_size().height, i * 500);
+		}
+		data.push_back (dcp::compress_j2k (xyz, 100000000, film->video_frame_rate(), false, false));
+	}
+
+	int const length = film->length().frames_round (film->video_frame_rate ());
+	vector<Frame> frames;
+	for (int i = 0; i < length; ++i) {
+		frames.push_back (i);
+	}
+	srand (1);
+	std::random_shuffle (frames.begin(), frames.end());
+
+	shared_ptr<Job> job (new TranscodeJob (film));
+	shared_ptr<Writer> writer (new Writer (film, job));
+	writer->set_encoder_threads (2);
+	writer->start ();
+
+	int const threads = 4;
+	boost::thread_group group;
+	for (int i = 0; i < threads; ++i) {
+		group.create_thread (boost::bind (&write_frames, writer, &frames, &data, i, threads));
+	}
+	group.join_all ();
+
+	writer->finish ();
+
+	dcp::DCP dcp (film->dir (film->dcp_name ()));
+	dcp.read ();
+	BOOST_REQUIRE_EQUAL (dcp.cpls().size(), 1U);
+	BOOST_REQUIRE_EQUAL (dcp.cpls().front()->reels().size(), 1U);
+	shared_ptr<dcp::ReelMonoPictureAsset> reel_picture = dynamic_pointer_cast<dcp::ReelMonoPictureAsset> (
+		dcp.cpls().front()->reels().front()->main_picture()
+		);
+	BOOST_REQUIRE (reel_picture);
+	shared_ptr<dcp::MonoPictureAsset> picture = reel_picture->mono_asset ();
+	BOOST_REQUIRE (picture);
+	BOOST_REQUIRE_EQUAL (picture->intrinsic_duration(), length);
+
+	shared_ptr<dcp::MonoPictureAssetReader> reader = picture->start_read ();
+	for (int i = 0; i < length; ++i) {
+		shared_ptr<const dcp::MonoPictureFrame> frame = reader->get_frame (i);
+		dcp::Data const & expected = data[i % data.size()];
+		BOOST_REQUIRE_EQUAL (frame->j2k_size(), expected.size());
+		BOOST_REQUIRE (memcmp (frame->j2k_data(), expected.data().get(), expected.size()) == 0);
+	}
+}
+
+/** Check that frames given to Writer in a random order still all get written when the spill
+ *  file is not allowed to hold more than one of them, so that others must go to files of their
+ *  own, and that those files are removed once they have been written to the DCP.
+ */
+BOOST_AUTO_TEST_CASE (writer_spill_limit_test)
+{
+	shared_ptr<Film> film = new_test_film ("writer_spill_limit_test");
+	film->set_container (Ratio::from_id ("185"));
+	film->set_dcp_content_type (DCPContentType::from_isdcf_name ("TLR"));
+	film->set_name ("frobozz");
+	shared_ptr<Content> content = content_factory("test/data/flat_red.png").front ();
+	film->examine_and_add_content (content);
+	BOOST_REQUIRE (!wait_for_jobs ());
+
+	vector<dcp::Data> data;
+	for (int i = 0; i < 7; ++i) {
+		shared_ptr<dcp::OpenJPEGImage> xyz (new dcp::OpenJPEGImage (film->frame_size ()));
+		for (int c = 0; c < 3; ++c) {
+			std::fill (xyz->data(c), xyz->data(c) + film->frame_size().width * film->frame_size().height, i * 500);
+		}
+		data.push_back (dcp::compress_j2k (xyz, 100000000, film->video_frame_rate(), false, false));
+	}
+
+	int const length = film->length().frames_round (film->video_frame_rate ());
+	vector<Frame> frames;
+	for (int i = 0; i < length; ++i) {
+		frames.push_back (i);
+	}
+	srand (2);
+	std::random_shuffle (frames.begin(), frames.end());
+
+	shared_ptr<Job> job (new TranscodeJob (film));
+	shared_ptr<Writer> writer (new Writer (film, job));
+	writer->set_encoder_threads (2);
+	writer->_maximum_spill = data.front().size();
+	writer->start ();
+
+	boost::thread_group group;
+	for (int i = 0; i < 4; ++i) {
+		group.create_thread (boost::bind (&write_frames, writer, &frames, &data, i, 4));
+	}
+	group.join_all ();
+
+	writer->finish ();
+
+	boost::filesystem::path const j2c = film->spill_path().parent_path();
+	if (boost::filesystem::exists (j2c)) {
+		BOOST_CHECK (boost::filesystem::directory_iterator (j2c) == boost::filesystem::directory_iterator ());
+	}
+
+	dcp::DCP dcp (film->dir (film->dcp_name ()));
+	dcp.read ();
+	BOOST_REQUIRE_EQUAL (dcp.cpls().size(), 1U);
+	shared_ptr<dcp::ReelMonoPictureAsset> reel_picture = dynamic_pointer_cast<dcp::ReelMonoPictureAsset> (
+		dcp.cpls().front()->reels().front()->main_picture()
+		);
+	BOOST_REQUIRE (reel_picture);
+	shared_ptr<dcp::MonoPictureAsset> picture = reel_picture->mono_asset ();
+	BOOST_REQUIRE (picture);
+	BOOST_REQUIRE_EQUAL (picture->intrinsic_duration(), length);
+
+	shared_ptr<dcp::MonoPictureAssetReader> reader = picture->start_read ();
+	for (int i = 0; i < length; ++i) {
+		shared_ptr<const dcp::MonoPictureFrame> frame = reader->get_frame (i);
+		dcp::Data const & expected = data[i % data.size()];
+		BOOST_REQUIRE_EQUAL (frame->j2k_size(), expected.size());
+		BOOST_REQUIRE (memcmp (frame->j2k_data(), expected.data().get(), expected.size()) == 0);
+	}
+}
+
+/** Check that SpillFile gives back what was put into it, in any order, and
+ *  removes its file when it is destroyed.
+ */
+BOOST_AUTO_TEST_CASE (spill_file_test)
+{
+	boost::filesystem::path const file = "build/test/spill_file_test";
+
+	{
+		SpillFile spill (file, 1000);
+		vector<int64_t> offsets;
+		for (int i = 0; i < 50; ++i) {
+			dcp::Data data (100 + i);
+			memset (data.data().get(), i, data.size());
+			offsets.push_back (spill.write (data));
+		}
+
+		/* Space that has been read back should be used again for blocks which fit in it */
+		spill.read (offsets[10]);
+		BOOST_CHECK_EQUAL (spill.write (dcp::Data (90)), offsets[10]);
+		spill.read (offsets[10]);
+		dcp::Data again (110);
+		memset (again.data().get(), 10, again.size());
+		BOOST_CHECK_EQUAL (spill.write (again), offsets[10]);
+
+		for (int i = 49; i >= 0; --i) {
+			dcp::Data data = spill.read (offsets[i]);
+			BOOST_REQUIRE_EQUAL (data.size(), 100 + i);
+			for (int j = 0; j < data.size(); ++j) {
+				BOOST_REQUIRE_EQUAL (data.data()[j], i);
+			}
+		}
+
+		BOOST_CHECK_EQUAL (spill.blocks(), 0U);
+		BOOST_CHECK_EQUAL (spill.length(), 0);
+		/* The file should be re-used from the start now that everything has been read */
+		BOOST_CHECK_EQUAL (spill.write (dcp::Data (10)), 0);
+	}
+
+	BOOST_CHECK (!boost::filesystem::exists (file));
+}